@@ -0,0 +1,272 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cublas_v2.h>
+
+#include "backend.h"
+#include "runtime.h"
+#include "common.h"
+
+/*
+ * The entry points used by the library. The names go through the
+ * preprocessor first, so that they match the versioned symbols that the
+ * CUDA headers map some of them to (e.g. cublasSgemm_v2).
+ */
+#define CUBLAS_SD(X, name)      X(cublasS##name) X(cublasD##name)
+#define CUBLAS_CZ(X, name)      X(cublasC##name) X(cublasZ##name)
+#define CUBLAS_SDCZ(X, name)    CUBLAS_SD(X, name) CUBLAS_CZ(X, name)
+
+#if USE_HOST
+#define BACKEND_EXTRA_SYMBOLS(X) X(host_link_configure)
+#else
+#define BACKEND_EXTRA_SYMBOLS(X)
+#endif
+
+#define BACKEND_SYMBOLS(X)\
+    X(cudaDeviceSynchronize) X(cudaEventCreateWithFlags) X(cudaEventDestroy)\
+    X(cudaEventQuery) X(cudaEventRecord) X(cudaEventSynchronize) X(cudaFree)\
+    X(cudaGetDeviceCount) X(cudaGetDeviceProperties) X(cudaGetErrorName)\
+    X(cudaGetErrorString) X(cudaGetLastError) X(cudaGraphDestroy)\
+    X(cudaGraphExecDestroy) X(cudaGraphExecUpdate) X(cudaGraphInstantiateWithFlags)\
+    X(cudaGraphLaunch) X(cudaMalloc) X(cudaMallocManaged) X(cudaMemcpy)\
+    X(cudaStreamBeginCapture) X(cudaStreamCreate) X(cudaStreamCreateWithFlags)\
+    X(cudaStreamDestroy) X(cudaStreamEndCapture) X(cudaStreamSynchronize)\
+    X(cudaStreamWaitEvent)\
+    X(cublasCreate) X(cublasDestroy) X(cublasSetStream) X(cublasSetPointerMode)\
+    /* level 1 */\
+    CUBLAS_SD(X, asum) X(cublasScasum) X(cublasDzasum)\
+    CUBLAS_SD(X, nrm2) X(cublasScnrm2) X(cublasDznrm2)\
+    X(cublasIsamax) X(cublasIdamax) X(cublasIcamax) X(cublasIzamax)\
+    X(cublasIsamin) X(cublasIdamin) X(cublasIcamin) X(cublasIzamin)\
+    CUBLAS_SDCZ(X, axpy) CUBLAS_SDCZ(X, copy) CUBLAS_SDCZ(X, scal)\
+    CUBLAS_SDCZ(X, swap) CUBLAS_SDCZ(X, rotg) X(cublasCsscal) X(cublasZdscal)\
+    CUBLAS_SD(X, dot) CUBLAS_CZ(X, dotc) CUBLAS_CZ(X, dotu)\
+    CUBLAS_SD(X, rot) X(cublasCsrot) X(cublasZdrot)\
+    CUBLAS_SD(X, rotm) CUBLAS_SD(X, rotmg)\
+    /* level 2 */\
+    CUBLAS_SDCZ(X, gbmv) CUBLAS_SDCZ(X, gemv) CUBLAS_SDCZ(X, tbmv)\
+    CUBLAS_SDCZ(X, tbsv) CUBLAS_SDCZ(X, tpmv) CUBLAS_SDCZ(X, tpsv)\
+    CUBLAS_SDCZ(X, trmv) CUBLAS_SDCZ(X, trsv)\
+    CUBLAS_SD(X, ger) CUBLAS_CZ(X, gerc) CUBLAS_CZ(X, geru)\
+    CUBLAS_SD(X, sbmv) CUBLAS_SD(X, spmv) CUBLAS_SD(X, spr) CUBLAS_SD(X, spr2)\
+    CUBLAS_SD(X, symv) CUBLAS_SD(X, syr) CUBLAS_SD(X, syr2)\
+    CUBLAS_CZ(X, hbmv) CUBLAS_CZ(X, hemv) CUBLAS_CZ(X, her) CUBLAS_CZ(X, her2)\
+    CUBLAS_CZ(X, hpmv) CUBLAS_CZ(X, hpr) CUBLAS_CZ(X, hpr2)\
+    /* level 3 and extensions */\
+    CUBLAS_SDCZ(X, gemm) CUBLAS_SDCZ(X, gemmBatched)\
+    CUBLAS_SDCZ(X, gemmStridedBatched) CUBLAS_CZ(X, gemm3m)\
+    CUBLAS_SDCZ(X, symm) CUBLAS_SDCZ(X, syrk) CUBLAS_SDCZ(X, syr2k)\
+    CUBLAS_SDCZ(X, syrkx) CUBLAS_SDCZ(X, trsm) CUBLAS_SDCZ(X, geam)\
+    CUBLAS_CZ(X, hemm) CUBLAS_CZ(X, herk) CUBLAS_CZ(X, her2k)\
+    BACKEND_EXTRA_SYMBOLS(X)
+
+#define CAT_(a, b) a##b
+#define CAT(a, b) CAT_(a, b)
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+/*
+ * The jump from a trampoline to the function in its slot, on the
+ * architectures that have one written out. Other architectures forward
+ * the arguments in C instead (see BACKEND_TRAMPOLINE).
+ */
+#if defined(__x86_64__)
+#ifdef __CET__
+#define TRAMPOLINE_JUMP(slot)   "endbr64\n" "jmp *" slot "(%rip)\n"
+#else
+#define TRAMPOLINE_JUMP(slot)   "jmp *" slot "(%rip)\n"
+#endif
+#elif defined(__aarch64__)
+#ifdef __ARM_FEATURE_BTI_DEFAULT
+#define TRAMPOLINE_BTI          "bti c\n"
+#else
+#define TRAMPOLINE_BTI          ""
+#endif
+#define TRAMPOLINE_JUMP(slot)   TRAMPOLINE_BTI "adrp x16, " slot "\n"\
+                                "ldr x16, [x16, :lo12:" slot "]\n" "br x16\n"
+#elif !defined(__GNUC__) || defined(__clang__)
+#error "The backend trampolines need GCC on architectures other than x86-64 and aarch64"
+#endif
+
+/* bytes of arguments passed on the stack that a C trampoline forwards */
+#define TRAMPOLINE_STACK_ARGS   256
+
+static void backend_missing(void) {
+    writef(STDERR_FILENO, "blas2cuda: called into the device runtime without a backend\n");
+    abort();
+}
+
+/*
+ * Each trampoline is a hidden symbol, so that the library's own calls
+ * (and the kernel pointers it passes around) bind to it, while a program
+ * that uses CUDA itself still gets the real thing.
+ */
+#ifdef TRAMPOLINE_JUMP
+#define BACKEND_TRAMPOLINE(sym)\
+    __attribute__((visibility("hidden"))) void *CAT(b2c_slot_, sym) = (void *) backend_missing;\
+    __asm__(".pushsection .text\n"\
+            ".p2align 4\n"\
+            ".globl " STR(sym) "\n"\
+            ".hidden " STR(sym) "\n"\
+            ".type " STR(sym) ", %function\n"\
+            STR(sym) ":\n"\
+            TRAMPOLINE_JUMP(STR(CAT(b2c_slot_, sym)))\
+            ".size " STR(sym) ", .-" STR(sym) "\n"\
+            ".popsection\n");
+#else
+/*
+ * The trampoline is defined under another name, since the CUDA headers
+ * declare {@sym} with its own type, and calls the slot with the arguments
+ * it was called with, whatever they are.
+ */
+#define BACKEND_TRAMPOLINE(sym)\
+    __attribute__((visibility("hidden"))) void *CAT(b2c_slot_, sym) = (void *) backend_missing;\
+    __attribute__((visibility("hidden"))) void CAT(b2c_tramp_, sym)(void) __asm__(STR(sym));\
+    void CAT(b2c_tramp_, sym)(void) {\
+        __builtin_return(__builtin_apply((void (*)()) CAT(b2c_slot_, sym),\
+                    __builtin_apply_args(), TRAMPOLINE_STACK_ARGS));\
+    }
+#endif
+
+BACKEND_SYMBOLS(BACKEND_TRAMPOLINE)
+
+static const struct backend_symbol {
+    const char *name;
+    void **slot;
+} backend_symbols[] = {
+#define BACKEND_SYMBOL(sym) { STR(sym), &CAT(b2c_slot_, sym) },
+    BACKEND_SYMBOLS(BACKEND_SYMBOL)
+};
+
+#define BACKEND_MAX_LIBS 2
+
+/**
+ * A backend is a set of libraries that together provide the symbols
+ * above. Each library can go by several names (separated by ':'), which
+ * are tried in order. By default, backends are tried in this order, and
+ * optional ones are skipped quietly if they are not installed or see no
+ * device.
+ */
+static const struct backend {
+    const char *name;
+    const char *libs[BACKEND_MAX_LIBS];
+    bool optional;
+} backends[] = {
+#if USE_HOST
+    { "remote", { "libblas2cuda-remote.so" }, true },
+    { "broker", { "libblas2cuda-broker.so" }, true },
+    { "host", { "libblas2cuda-host.so" }, false },
+#else
+    { "cuda", { "libcudart.so:libcudart.so.12:libcudart.so.11.0",
+                "libcublas.so:libcublas.so.12:libcublas.so.11" }, false },
+#endif
+};
+
+/**
+ * dlopen() the first of the ':'-separated {@names} that loads, looking
+ * next to this library before the search path.
+ */
+static void *backend_open(const char *names, bool quiet) {
+    static char dir[PATH_MAX];
+    char path[PATH_MAX];
+    const char *name = names;
+    Dl_info info;
+    void *handle;
+
+    if (!dir[0] && dladdr((void *) runtime_backend_load, &info) && info.dli_fname) {
+        const char *slash = strrchr(info.dli_fname, '/');
+
+        if (slash && (size_t) (slash - info.dli_fname) < sizeof dir)
+            memcpy(dir, info.dli_fname, slash - info.dli_fname);
+    }
+
+    while (*name) {
+        size_t len = strcspn(name, ":");
+
+        if (dir[0] && snprintf(path, sizeof path, "%s/%.*s", dir, (int) len, name) < (int) sizeof path
+                && (handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)))
+            return handle;
+        if (snprintf(path, sizeof path, "%.*s", (int) len, name) < (int) sizeof path
+                && (handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)))
+            return handle;
+        name += len;
+        if (*name == ':')
+            name++;
+    }
+    if (!quiet)
+        writef(STDERR_FILENO, "blas2cuda: could not load any of %s\n", names);
+    return NULL;
+}
+
+/*
+ * The libraries of a backend that can't be used stay loaded: the runtime
+ * can come up while the process exits (e.g. for an allocation made by an
+ * atexit() handler), and dlclose() would then wait for the lock that
+ * exit() holds.
+ */
+static void backend_reset(void) {
+    for (size_t i = 0; i < sizeof backend_symbols / sizeof backend_symbols[0]; i++)
+        *backend_symbols[i].slot = (void *) backend_missing;
+}
+
+/**
+ * Load {@backend}, with no messages about why it can't be if {@quiet}.
+ */
+static bool backend_load(const struct backend *backend, bool quiet) {
+    void *handles[BACKEND_MAX_LIBS];
+    int num_handles = 0;
+    int num_devices = 0;
+    cudaError_t err;
+
+    for (int l = 0; l < BACKEND_MAX_LIBS && backend->libs[l]; l++) {
+        if (!(handles[num_handles] = backend_open(backend->libs[l], quiet))) {
+            backend_reset();
+            return false;
+        }
+        num_handles++;
+    }
+
+    for (size_t i = 0; i < sizeof backend_symbols / sizeof backend_symbols[0]; i++) {
+        void *func = NULL;
+
+        for (int l = 0; !func && l < num_handles; l++)
+            func = dlsym(handles[l], backend_symbols[i].name);
+        if (!func) {
+            writef(STDERR_FILENO, "blas2cuda: backend %s has no %s\n",
+                    backend->name, backend_symbols[i].name);
+            backend_reset();
+            return false;
+        }
+        *backend_symbols[i].slot = func;
+    }
+
+    if ((err = cudaGetDeviceCount(&num_devices)) != cudaSuccess || num_devices == 0) {
+        if (!quiet)
+            writef(STDERR_FILENO, "blas2cuda: backend %s has no device%s%s\n", backend->name,
+                    err != cudaSuccess ? ": " : "", err != cudaSuccess ? cudaGetErrorString(err) : "");
+        backend_reset();
+        return false;
+    }
+
+    writef(STDOUT_FILENO, "blas2cuda: loaded backend %s\n", backend->name);
+    return true;
+}
+
+bool runtime_backend_load(const char *name) {
+    if (!name) {
+        for (size_t i = 0; i < sizeof backends / sizeof backends[0]; i++)
+            if (backend_load(&backends[i], backends[i].optional))
+                return true;
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof backends / sizeof backends[0]; i++)
+        if (strcmp(name, backends[i].name) == 0)
+            return backend_load(&backends[i], false);
+    writef(STDERR_FILENO, "blas2cuda: unknown backend '%s'\n", name);
+    abort();
+}
@@ -0,0 +1,43 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CUDA builds are not linked against the CUDA runtime or cuBLAS. Every
+ * entry point of theirs that the library uses is a small trampoline in
+ * backend.c that jumps through a slot, and the slots are filled in from a
+ * backend module that is loaded once the device is needed:
+ *
+ *   cuda   libcudart and libcublas from the CUDA toolkit (CUDA builds)
+ *   remote libblas2cuda-remote, which sends large calls to a server over
+ *          TCP when $BLAS2CUDA_REMOTE is set (host builds, see host/remote.h)
+ *   broker libblas2cuda-broker, which sends calls to a daemon that shares
+ *          the device between processes (host builds, see host/broker.h)
+ *   host   libblas2cuda-host, the emulation in host/ (host builds)
+ *
+ * Modules are looked up next to the library first, then on the usual
+ * search path. If no module can be loaded, or it sees no device, the
+ * runtime fails to initialize and calls go to the host BLAS instead (see
+ * b2c_device_usable()).
+ */
+
+/**
+ * Load the backend {@name}, or the first of this build that loads if
+ * {@name} is NULL (the remote or the broker backend when its server or
+ * daemon is running), and check that
+ * it has a device. Aborts if {@name} is not a backend of this build.
+ *
+ * @return true if the backend is ready to use
+ */
+bool runtime_backend_load(const char *name);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,253 @@
+#include "batch.h"
+#include "pending.h"
+#include "scheduler.h"
+#include "common.h"
+#include "lib/obj_tracker.h"
+#include <poll.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_PTR_ARRAYS  4
+
+#define GATHER_MAX_WINDOW   50000   /* ns */
+#define GATHER_MAX_GAP      (4 * GATHER_MAX_WINDOW)
+
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread volatile sig_atomic_t holds_lock;
+size_t b2c_batch_flushes = 0;
+size_t b2c_batch_calls = 0;
+size_t b2c_batch_windows = 0;
+
+static b2c_batch_flush_t flush_func;
+static bool buffered;
+static unsigned long generation;
+static __thread bool flushing;
+
+/* issues buffered calls for the fault handler, which can't issue them itself */
+static pthread_t flusher;
+static sem_t flusher_wake;
+static bool flusher_started;
+
+/* arrivals of calls that can be gathered */
+static struct {
+    pthread_t thread;           /* of the last call */
+    uint64_t last;              /* when it arrived */
+    uint64_t gap;               /* moving average of the time between calls of different threads */
+} arrivals = { .gap = GATHER_MAX_GAP };
+static pthread_mutex_t arrivals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if USE_CUDA
+static struct {
+    void **ptrs;
+    struct b2c_event *event;    /* the last call that used the array */
+} ptr_arrays[NUM_PTR_ARRAYS];
+static unsigned next_ptrs;
+
+static void ptr_arrays_init(void) {
+    runtime_error_t err = RUNTIME_ERROR_SUCCESS;
+
+    obj_tracker_internal_enter();
+    for (unsigned i = 0; i < NUM_PTR_ARRAYS && !runtime_is_error(err); i++)
+        err = runtime_malloc_shared((void **) &ptr_arrays[i].ptrs,
+                3 * B2C_BATCH_MAX * sizeof *ptr_arrays[i].ptrs);
+    obj_tracker_internal_leave();
+    if (runtime_is_error(err)) {
+        writef(STDERR_FILENO, "blas2cuda: failed to allocate pointer arrays for batches: %s\n",
+                runtime_error_string(err));
+        abort();
+    }
+}
+
+void **b2c_batch_ptrs(void) {
+    unsigned i = next_ptrs;
+
+    if (ptr_arrays[i].event) {
+        b2c_event_wait(ptr_arrays[i].event);
+        b2c_event_put(ptr_arrays[i].event);
+        ptr_arrays[i].event = NULL;
+    }
+    return ptr_arrays[i].ptrs;
+}
+
+void b2c_batch_ptrs_issued(void) {
+    ptr_arrays[next_ptrs].event = b2c_event_get(b2c_sched_last());
+    next_ptrs = (next_ptrs + 1) % NUM_PTR_ARRAYS;
+}
+#endif
+
+void b2c_batch_lock(void) {
+    pthread_mutex_lock(&batch_lock);
+    holds_lock = true;
+}
+
+void b2c_batch_unlock(void) {
+    holds_lock = false;
+    pthread_mutex_unlock(&batch_lock);
+}
+
+bool b2c_batch_trylock(void) {
+    if (pthread_mutex_trylock(&batch_lock) != 0)
+        return false;
+    holds_lock = true;
+    return true;
+}
+
+bool b2c_batch_is(b2c_batch_flush_t flush) {
+    return flush_func == flush;
+}
+
+static void *flusher_main(void *arg) {
+    (void) arg;
+    for (;;)
+        if (sem_wait(&flusher_wake) == 0)
+            b2c_batch_flush();
+    return NULL;
+}
+
+/**
+ * Start the flusher thread, with all signals blocked so that the handlers
+ * of the application run on its own threads.
+ */
+static void flusher_start(void) {
+    sigset_t all, old;
+    int err;
+
+    sem_init(&flusher_wake, 0, 0);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    obj_tracker_internal_enter();
+    err = pthread_create(&flusher, NULL, flusher_main, NULL);
+    obj_tracker_internal_leave();
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        writef(STDERR_FILENO, "blas2cuda: failed to start the batch flusher: %s\n", strerror(err));
+        abort();
+    }
+    pthread_detach(flusher);
+    flusher_started = true;
+}
+
+void b2c_batch_start(b2c_batch_flush_t flush) {
+#if USE_CUDA
+    if (!ptr_arrays[0].ptrs)
+        ptr_arrays_init();
+#endif
+    if (!flusher_started)
+        flusher_start();
+    flush_func = flush;
+    __atomic_store_n(&buffered, true, __ATOMIC_RELEASE);
+}
+
+void b2c_batch_flush_locked(void) {
+    if (flushing)
+        return;
+
+    flushing = true;
+    if (flush_func) {
+        size_t calls = flush_func();
+
+        if (calls) {
+            b2c_batch_calls += calls;
+            b2c_batch_flushes++;
+        }
+        flush_func = NULL;
+        __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+    }
+    b2c_pending_unhold();
+    /* only now can threads that wait for the batch find its events */
+    __atomic_store_n(&buffered, false, __ATOMIC_RELEASE);
+    flushing = false;
+}
+
+void b2c_batch_flush(void) {
+    if (!b2c_batch_buffered())
+        return;
+
+    b2c_batch_lock();
+    b2c_batch_flush_locked();
+    b2c_batch_unlock();
+}
+
+bool b2c_batch_flush_fault(void) {
+    const unsigned long gen = b2c_batch_generation();
+    unsigned polls = 0;
+
+    if (!b2c_batch_buffered())
+        return true;
+    /* the calls are being buffered by this thread, which can't flush them now */
+    if (holds_lock)
+        return false;
+
+    sem_post(&flusher_wake);
+    while (b2c_batch_buffered() && b2c_batch_generation() == gen)
+        poll(NULL, 0, polls++ < 100 ? 0 : 1);
+    return true;
+}
+
+bool b2c_batch_buffered(void) {
+    return !flushing && __atomic_load_n(&buffered, __ATOMIC_ACQUIRE);
+}
+
+unsigned long b2c_batch_generation(void) {
+    return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t b2c_batch_gather_window(void) {
+    const uint64_t now = now_ns();
+    uint64_t gap = GATHER_MAX_GAP, window;
+
+    pthread_mutex_lock(&arrivals_lock);
+    /* consecutive calls of one thread count as calls that are far apart */
+    if (arrivals.last && !pthread_equal(arrivals.thread, pthread_self())
+            && now - arrivals.last < GATHER_MAX_GAP)
+        gap = now - arrivals.last;
+    arrivals.gap = (7 * arrivals.gap + gap) / 8;
+    arrivals.thread = pthread_self();
+    arrivals.last = now;
+    window = 2 * arrivals.gap;
+    pthread_mutex_unlock(&arrivals_lock);
+
+    return window <= GATHER_MAX_WINDOW ? window : 0;
+}
+
+void b2c_batch_gather(unsigned long gen, uint64_t window) {
+    const uint64_t start = now_ns();
+
+    /* short enough to spin; other threads keep adding calls meanwhile */
+    while (b2c_batch_generation() == gen && now_ns() - start < window)
+        sched_yield();
+
+    b2c_batch_lock();
+    b2c_batch_windows++;
+    if (generation == gen)
+        b2c_batch_flush_locked();
+    b2c_batch_unlock();
+}
+
+void b2c_batch_fini(void) {
+#if USE_CUDA
+    b2c_batch_lock();
+    for (unsigned i = 0; i < NUM_PTR_ARRAYS; i++) {
+        if (ptr_arrays[i].event) {
+            b2c_event_wait(ptr_arrays[i].event);
+            b2c_event_put(ptr_arrays[i].event);
+            ptr_arrays[i].event = NULL;
+        }
+        if (ptr_arrays[i].ptrs) {
+            runtime_free(ptr_arrays[i].ptrs);
+            ptr_arrays[i].ptrs = NULL;
+        }
+    }
+    b2c_batch_unlock();
+#endif
+}
@@ -0,0 +1,148 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Batching of calls that are too small to offload on their own.
+ *
+ * A routine can buffer such a call instead of issuing it, once the managed
+ * objects the call uses are held (see b2c_pending_hold()), and later issue
+ * all buffered calls as one batched kernel. Buffered calls are flushed
+ * before any other call is issued, when the host touches one of their
+ * operands (by a background thread, since the fault handler can't issue
+ * calls), on b2c_synchronize(), and when the routine that buffered them
+ * can't add a call to the batch.
+ *
+ * Only one routine buffers calls at a time. The functions below that
+ * don't take the lock themselves must be called with it held (see
+ * b2c_batch_lock()).
+ *
+ * Calls that are only worth offloading together with the calls that other
+ * threads make at the same time (e.g. the threads of an OpenMP loop) are
+ * gathered: the thread that starts a batch waits for a short window before
+ * flushing it, while the threads that add calls to it return right away.
+ * The window follows the rate at which such calls arrive from different
+ * threads, and is zero when they don't arrive concurrently, e.g. in a
+ * single thread, so that those calls don't wait for nothing.
+ */
+
+/* calls per batch */
+#define B2C_BATCH_MAX   64
+
+/**
+ * Take and release the batch lock. The owner is recorded for the fault
+ * handler (see pending.h), which must not wait for a lock that the
+ * faulting thread holds.
+ */
+void b2c_batch_lock(void);
+void b2c_batch_unlock(void);
+
+/**
+ * Take the batch lock if nobody holds it.
+ * @return whether it was taken
+ */
+bool b2c_batch_trylock(void);
+
+/** number of batches issued, and number of calls in them */
+extern size_t b2c_batch_flushes, b2c_batch_calls;
+
+/** number of windows waited for calls of other threads */
+extern size_t b2c_batch_windows;
+
+/**
+ * Flushes buffered calls, and returns how many were batched into one
+ * kernel (none for replay plans, see replay.h).
+ */
+typedef size_t (*b2c_batch_flush_t)(void);
+
+/**
+ * Whether the calls that are buffered, if any, are flushed by {@flush}.
+ */
+bool b2c_batch_is(b2c_batch_flush_t flush);
+
+/**
+ * Note that calls are now buffered, to be flushed by {@flush}.
+ */
+void b2c_batch_start(b2c_batch_flush_t flush);
+
+/**
+ * Issue the buffered calls, if any, and release the objects they held.
+ */
+void b2c_batch_flush_locked(void);
+
+/**
+ * Like b2c_batch_flush_locked(), but takes the lock. Does nothing when
+ * called while flushing.
+ */
+void b2c_batch_flush(void);
+
+/**
+ * b2c_batch_flush() for the fault handler, which runs in the middle of
+ * whatever the faulting thread was doing and can't issue calls. Has a
+ * background thread flush the buffered calls, and waits for it, unless
+ * this thread holds the lock.
+ * @return whether the calls that were buffered have been flushed
+ */
+bool b2c_batch_flush_fault(void);
+
+/**
+ * Whether there are buffered calls that this thread should flush.
+ */
+bool b2c_batch_buffered(void);
+
+/**
+ * Number of times buffered calls have been flushed, which tells the
+ * current batch from later ones.
+ */
+unsigned long b2c_batch_generation(void);
+
+/**
+ * Note the arrival of a call that can be gathered with the calls of other
+ * threads. Doesn't need the lock.
+ * @return how long (in ns) the thread that starts a batch with it should
+ * wait for calls of other threads, or 0 if calls don't arrive
+ * concurrently, in which case it isn't worth offloading
+ */
+uint64_t b2c_batch_gather_window(void);
+
+/**
+ * Wait up to {@window} ns for other threads to add calls to the batch of
+ * generation {@gen}, then flush it, unless it has been flushed already.
+ * Takes the lock.
+ */
+void b2c_batch_gather(unsigned long gen, uint64_t window);
+
+#if USE_CUDA
+/**
+ * An array of 3 * B2C_BATCH_MAX pointers in managed memory, for the
+ * pointer arguments of the next batched kernel. The array is not used by
+ * any kernel that is still in flight.
+ */
+void **b2c_batch_ptrs(void);
+
+/**
+ * Note that the last array returned by b2c_batch_ptrs() is used by the
+ * last call issued by this thread.
+ */
+void b2c_batch_ptrs_issued(void);
+#endif
+
+/**
+ * Release the pointer arrays. Buffered calls must have been flushed.
+ */
+void b2c_batch_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -8,68 +8,163 @@ extern "C" {
 #include <complex.h>
 
 /* BLAS Level 1 */
-#define F77_asum(prefix, T)                         \
-void prefix##asum_(const int *n,                    \
+#define F77_asum(prefix, S, T)                      \
+S prefix##asum_(const int *n,                       \
         T *sx, const int *incx)
 
-F77_asum(s, float);
-F77_asum(sc, float _Complex);
-F77_asum(d, double);
-F77_asum(dz, double _Complex);
+F77_asum(s, float, float);
+F77_asum(sc, float, float _Complex);
+F77_asum(d, double, double);
+F77_asum(dz, double, double _Complex);
+
+#define F77_amax(prefix, T)                         \
+int i##prefix##amax_(const int *n,                  \
+        T *sx, const int *incx)
+
+F77_amax(s, float);
+F77_amax(d, double);
+F77_amax(c, float _Complex);
+F77_amax(z, double _Complex);
+
+#define F77_amin(prefix, T)                         \
+int i##prefix##amin_(const int *n,                  \
+        T *sx, const int *incx)
+
+F77_amin(s, float);
+F77_amin(d, double);
+F77_amin(c, float _Complex);
+F77_amin(z, double _Complex);
 
 #define F77_axpy(prefix, T)                         \
 void prefix##axpy_(const int *n,                    \
         const T *sa,                                \
         T *sx,                                      \
-        int *incx,                                  \
+        const int *incx,                            \
         T *sy,                                      \
-        int *incy)
+        const int *incy)
 
 F77_axpy(s, float);
 F77_axpy(d, double);
 F77_axpy(c, float _Complex);
 F77_axpy(z, double _Complex);
 
-#define F77_nrm2(prefix, T)                         \
-void prefix##nrm2_(int *n,                          \
+#define F77_nrm2(prefix, S, T)                      \
+S prefix##nrm2_(const int *n,                       \
         T *x,                                       \
-        int *incx)
+        const int *incx)
+
+F77_nrm2(s, float, float);
+F77_nrm2(sc, float, float _Complex);
+F77_nrm2(d, double, double);
+F77_nrm2(dz, double, double _Complex);
 
 #define F77_copy(prefix, T)                         \
-void prefix##copy_(int *n,                          \
+void prefix##copy_(const int *n,                    \
         T *sx,                                      \
-        int *incx,                                  \
+        const int *incx,                            \
         T *sy,                                      \
-        int *incy)
+        const int *incy)
+
+F77_copy(s, float);
+F77_copy(d, double);
+F77_copy(c, float _Complex);
+F77_copy(z, double _Complex);
 
 #define F77_dot(prefix, T)                          \
-void prefix##dot_(int *n,                           \
-        T *sb,                                      \
+T prefix##dot_(const int *n,                        \
         T *sx,                                      \
-        int *incx,                                  \
+        const int *incx,                            \
         T *sy,                                      \
-        int *incy)
+        const int *incy)
+
+F77_dot(s, float);
+F77_dot(d, double);
+
+#define F77_dotc(prefix, T)                         \
+T prefix##dotc_(const int *n,                       \
+        T *sx,                                      \
+        const int *incx,                            \
+        T *sy,                                      \
+        const int *incy)
+
+F77_dotc(c, float _Complex);
+F77_dotc(z, double _Complex);
+
+#define F77_dotu(prefix, T)                         \
+T prefix##dotu_(const int *n,                       \
+        T *sx,                                      \
+        const int *incx,                            \
+        T *sy,                                      \
+        const int *incy)
+
+F77_dotu(c, float _Complex);
+F77_dotu(z, double _Complex);
 
-#define F77_rot(prefix, T)                          \
-void prefix##rot_(int *n,                           \
-        T *sb,                                      \
+#define F77_rot(prefix, S, T)                       \
+void prefix##rot_(const int *n,                     \
         T *sx,                                      \
-        int *incx,                                  \
+        const int *incx,                            \
         T *sy,                                      \
-        int *incy)
+        const int *incy,                            \
+        S *c, S *s)
+
+F77_rot(s, float, float);
+F77_rot(d, double, double);
+F77_rot(cs, float, float _Complex);
+F77_rot(zd, double, double _Complex);
+
+#define F77_rotg(prefix, S, T)                      \
+void prefix##rotg_(T *sa, T *sb,                    \
+        S *c, T *s)
+
+F77_rotg(s, float, float);
+F77_rotg(d, double, double);
+F77_rotg(c, float, float _Complex);
+F77_rotg(z, double, double _Complex);
+
+#define F77_rotm(prefix, T)                         \
+void prefix##rotm_(const int *n,                    \
+        T *sx,                                      \
+        const int *incx,                            \
+        T *sy,                                      \
+        const int *incy,                            \
+        T *sparam)
+
+F77_rotm(s, float);
+F77_rotm(d, double);
+
+#define F77_rotmg(prefix, T)                        \
+void prefix##rotmg_(T *sd1, T *sd2,                 \
+        T *sx1, T *sy1,                             \
+        T *sparam)
+
+F77_rotmg(s, float);
+F77_rotmg(d, double);
 
 #define F77_scal(prefix, S, T)                      \
-void prefix##scal_(int *n,                          \
+void prefix##scal_(const int *n,                    \
         S *sa,                                      \
         T *sx,                                      \
-        int *incx)
+        const int *incx)
+
+F77_scal(s, float, float);
+F77_scal(d, double, double);
+F77_scal(c, float _Complex, float _Complex);
+F77_scal(z, double _Complex, double _Complex);
+F77_scal(cs, float, float _Complex);
+F77_scal(zd, double, double _Complex);
 
 #define F77_swap(prefix, T)                         \
-void prefix##swap_(int *n,                          \
+void prefix##swap_(const int *n,                    \
         T *sx,                                      \
-        int *incx,                                  \
+        const int *incx,                            \
         T *sy,                                      \
-        int *incy)
+        const int *incy)
+
+F77_swap(s, float);
+F77_swap(d, double);
+F77_swap(c, float _Complex);
+F77_swap(z, double _Complex);
 
 
 /* BLAS Level 2 */
@@ -82,6 +177,11 @@ void prefix##gbmv_(char *trans,                     \
         T *beta,                                    \
         T *y, int *incy)
 
+F77_gbmv(s, float);
+F77_gbmv(d, double);
+F77_gbmv(c, float _Complex);
+F77_gbmv(z, double _Complex);
+
 #define F77_gemv(prefix, T)                         \
 void prefix##gemv_(char *trans,                     \
         int *m, int *n,                             \
@@ -91,6 +191,11 @@ void prefix##gemv_(char *trans,                     \
         T *beta,                                    \
         T *y, int *incy)
 
+F77_gemv(s, float);
+F77_gemv(d, double);
+F77_gemv(c, float _Complex);
+F77_gemv(z, double _Complex);
+
 #define F77_ger(prefix, T)                          \
 void prefix##ger_(int *m, int *n,                   \
         T *alpha,                                   \
@@ -98,6 +203,107 @@ void prefix##ger_(int *m, int *n,                   \
         T *y, int *incy,                            \
         T *a, int *lda)
 
+F77_ger(s, float);
+F77_ger(d, double);
+
+#define F77_gerc(prefix, T)                         \
+void prefix##gerc_(int *m, int *n,                  \
+        T *alpha,                                   \
+        T *x, int *incx,                            \
+        T *y, int *incy,                            \
+        T *a, int *lda)
+
+F77_gerc(c, float _Complex);
+F77_gerc(z, double _Complex);
+
+#define F77_geru(prefix, T)                         \
+void prefix##geru_(int *m, int *n,                  \
+        T *alpha,                                   \
+        T *x, int *incx,                            \
+        T *y, int *incy,                            \
+        T *a, int *lda)
+
+F77_geru(c, float _Complex);
+F77_geru(z, double _Complex);
+
+#define F77_hbmv(prefix, T)                         \
+void prefix##hbmv_(char *uplo,                      \
+        int *n, int *k,                             \
+        T *alpha,                                   \
+        T *a, int *lda,                             \
+        T *x, int *incx,                            \
+        T *beta,                                    \
+        T *y, int *incy)
+
+F77_hbmv(c, float _Complex);
+F77_hbmv(z, double _Complex);
+
+#define F77_hemv(prefix, T)                         \
+void prefix##hemv_(char *uplo,                      \
+        int *n,                                     \
+        T *alpha,                                   \
+        T *a, int *lda,                             \
+        T *x, int *incx,                            \
+        T *beta,                                    \
+        T *y, int *incy)
+
+F77_hemv(c, float _Complex);
+F77_hemv(z, double _Complex);
+
+#define F77_her(prefix, S, T)                       \
+void prefix##her_(char *uplo,                       \
+        int *n,                                     \
+        S *alpha,                                   \
+        T *x, int *incx,                            \
+        T *a, int *lda)
+
+F77_her(c, float, float _Complex);
+F77_her(z, double, double _Complex);
+
+#define F77_her2(prefix, T)                         \
+void prefix##her2_(char *uplo,                      \
+        int *n,                                     \
+        T *alpha,                                   \
+        T *x, int *incx,                            \
+        T *y, int *incy,                            \
+        T *a, int *lda)
+
+F77_her2(c, float _Complex);
+F77_her2(z, double _Complex);
+
+#define F77_hpmv(prefix, T)                         \
+void prefix##hpmv_(char *uplo,                      \
+        int *n,                                     \
+        T *alpha,                                   \
+        T *ap,                                      \
+        T *x, int *incx,                            \
+        T *beta,                                    \
+        T *y, int *incy)
+
+F77_hpmv(c, float _Complex);
+F77_hpmv(z, double _Complex);
+
+#define F77_hpr(prefix, S, T)                       \
+void prefix##hpr_(char *uplo,                       \
+        int *n,                                     \
+        S *alpha,                                   \
+        T *x, int *incx,                            \
+        T *ap)
+
+F77_hpr(c, float, float _Complex);
+F77_hpr(z, double, double _Complex);
+
+#define F77_hpr2(prefix, T)                         \
+void prefix##hpr2_(char *uplo,                      \
+        int *n,                                     \
+        T *alpha,                                   \
+        T *x, int *incx,                            \
+        T *y, int *incy,                            \
+        T *ap)
+
+F77_hpr2(c, float _Complex);
+F77_hpr2(z, double _Complex);
+
 #define F77_sbmv(prefix, T)                         \
 void prefix##sbmv_(char *uplo,                      \
         int *n, int *k,                             \
@@ -107,6 +313,9 @@ void prefix##sbmv_(char *uplo,                      \
         T *beta,                                    \
         T *y, int *incy)
 
+F77_sbmv(s, float);
+F77_sbmv(d, double);
+
 #define F77_spmv(prefix, T)                         \
 void prefix##spmv_(char *uplo,                      \
         int *n,                                     \
@@ -116,6 +325,9 @@ void prefix##spmv_(char *uplo,                      \
         T *beta,                                    \
         T *y, int *incy)
 
+F77_spmv(s, float);
+F77_spmv(d, double);
+
 #define F77_spr(prefix, T)                          \
 void prefix##spr_(char *uplo,                       \
         int *n,                                     \
@@ -123,6 +335,9 @@ void prefix##spr_(char *uplo,                       \
         T *x, int *incx,                            \
         T *ap)
 
+F77_spr(s, float);
+F77_spr(d, double);
+
 #define F77_spr2(prefix, T)                         \
 void prefix##spr2_(char *uplo,                      \
         int *n,                                     \
@@ -131,6 +346,9 @@ void prefix##spr2_(char *uplo,                      \
         T *y, int *incy,                            \
         T *ap)
 
+F77_spr2(s, float);
+F77_spr2(d, double);
+
 #define F77_symv(prefix, T)                         \
 void prefix##symv_(char *uplo,                      \
         int *n,                                     \
@@ -140,6 +358,9 @@ void prefix##symv_(char *uplo,                      \
         T *beta,                                    \
         T *y, int *incy)
 
+F77_symv(s, float);
+F77_symv(d, double);
+
 #define F77_syr(prefix, T)                          \
 void prefix##syr_(char *uplo,                       \
         int *n,                                     \
@@ -147,6 +368,9 @@ void prefix##syr_(char *uplo,                       \
         T *x, int *incx,                            \
         T *a, int *lda)
 
+F77_syr(s, float);
+F77_syr(d, double);
+
 #define F77_syr2(prefix, T)                         \
 void prefix##syr2_(char *uplo,                      \
         int *n,                                     \
@@ -155,6 +379,9 @@ void prefix##syr2_(char *uplo,                      \
         T *y, int *incy,                            \
         T *a, int *lda)
 
+F77_syr2(s, float);
+F77_syr2(d, double);
+
 #define F77_tbmv(prefix, T)                         \
 void prefix##tbmv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -162,6 +389,11 @@ void prefix##tbmv_(char *uplo,                      \
         T *a, int *lda,                             \
         T *x, int *incx)
 
+F77_tbmv(s, float);
+F77_tbmv(d, double);
+F77_tbmv(c, float _Complex);
+F77_tbmv(z, double _Complex);
+
 #define F77_tbsv(prefix, T)                         \
 void prefix##tbsv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -169,6 +401,11 @@ void prefix##tbsv_(char *uplo,                      \
         T *a, int *lda,                             \
         T *x, int *incx)
 
+F77_tbsv(s, float);
+F77_tbsv(d, double);
+F77_tbsv(c, float _Complex);
+F77_tbsv(z, double _Complex);
+
 #define F77_tpmv(prefix, T)                         \
 void prefix##tpmv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -176,6 +413,11 @@ void prefix##tpmv_(char *uplo,                      \
         T *ap,                                      \
         T *x, int *incx)
 
+F77_tpmv(s, float);
+F77_tpmv(d, double);
+F77_tpmv(c, float _Complex);
+F77_tpmv(z, double _Complex);
+
 #define F77_tpsv(prefix, T)                         \
 void prefix##tpsv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -183,6 +425,11 @@ void prefix##tpsv_(char *uplo,                      \
         T *ap,                                      \
         T *x, int *incx)
 
+F77_tpsv(s, float);
+F77_tpsv(d, double);
+F77_tpsv(c, float _Complex);
+F77_tpsv(z, double _Complex);
+
 #define F77_trmv(prefix, T)                         \
 void prefix##trmv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -190,6 +437,11 @@ void prefix##trmv_(char *uplo,                      \
         T *a, int *lda,                             \
         T *x, int *incx)
 
+F77_trmv(s, float);
+F77_trmv(d, double);
+F77_trmv(c, float _Complex);
+F77_trmv(z, double _Complex);
+
 #define F77_trsv(prefix, T)                         \
 void prefix##trsv_(char *uplo,                      \
         char *trans, char *diag,                    \
@@ -197,6 +449,11 @@ void prefix##trsv_(char *uplo,                      \
         T *a, int *lda,                             \
         T *x, int *incx)
 
+F77_trsv(s, float);
+F77_trsv(d, double);
+F77_trsv(c, float _Complex);
+F77_trsv(z, double _Complex);
+
 /* BLAS Level 3 */
 
 #define F77_gemm(prefix, T)                         \
@@ -214,6 +471,59 @@ F77_gemm(d, double);
 F77_gemm(c, float _Complex);
 F77_gemm(z, double _Complex);
 
+/*
+ * Batched gemm, as in MKL: group i has group_size[i] problems that share
+ * the i-th transposes, dimensions, scalars and leading dimensions.
+ */
+#define F77_gemm_batch(prefix, T)                   \
+void prefix##gemm_batch_(const char *transa_array,  \
+        const char *transb_array,                   \
+        const int *m_array, const int *n_array,     \
+        const int *k_array,                         \
+        T *alpha_array,                             \
+        T **a_array, int *lda_array,                \
+        T **b_array, int *ldb_array,                \
+        T *beta_array,                              \
+        T **c_array, int *ldc_array,                \
+        const int *group_count,                     \
+        const int *group_size)
+
+F77_gemm_batch(s, float);
+F77_gemm_batch(d, double);
+F77_gemm_batch(c, float _Complex);
+F77_gemm_batch(z, double _Complex);
+
+/* problem i uses a + i * stridea, b + i * strideb and c + i * stridec */
+#define F77_gemm_batch_strided(prefix, T)           \
+void prefix##gemm_batch_strided_(const char *transa,\
+        const char *transb,                         \
+        const int *m, const int *n, const int *k,   \
+        T *alpha,                                   \
+        T *a, int *lda, int *stridea,               \
+        T *b, int *ldb, int *strideb,               \
+        T *beta,                                    \
+        T *c, int *ldc, int *stridec,               \
+        const int *batch_size)
+
+F77_gemm_batch_strided(s, float);
+F77_gemm_batch_strided(d, double);
+F77_gemm_batch_strided(c, float _Complex);
+F77_gemm_batch_strided(z, double _Complex);
+
+/* complex gemm with three real matrix products instead of four (3M) */
+#define F77_gemm3m(prefix, T)                       \
+void prefix##gemm3m_(const char *transa,            \
+        const char *transb,                         \
+        const int *m, const int *n, const int *k,   \
+        T *alpha,                                   \
+        T *a, int *lda,                             \
+        T *b, int *ldb,                             \
+        T *beta,                                    \
+        T *c, int *ldc)
+
+F77_gemm3m(c, float _Complex);
+F77_gemm3m(z, double _Complex);
+
 #define F77_hemm(prefix, T)                         \
 void prefix##hemm_(char *side, char *uplo,          \
         int *m, int *n,                             \
@@ -273,6 +583,11 @@ void prefix##syrk_(char *uplo, char *trans,         \
         T *beta,                                    \
         T *c, int *ldc)
 
+F77_syrk(s, float);
+F77_syrk(d, double);
+F77_syrk(c, float _Complex);
+F77_syrk(z, double _Complex);
+
 #define F77_syr2k(prefix, T)                        \
 void prefix##syr2k_(char *uplo, char *trans,        \
         int *n, int *k,                             \
@@ -313,6 +628,66 @@ F77_trsm(d, double);
 F77_trsm(c, float _Complex);
 F77_trsm(z, double _Complex);
 
+/* BLAS-like extensions (MKL, OpenBLAS) */
+
+/* y = alpha x + beta y */
+#define F77_axpby(prefix, T)                        \
+void prefix##axpby_(const int *n,                   \
+        const T *alpha,                             \
+        T *x, const int *incx,                      \
+        const T *beta,                              \
+        T *y, const int *incy)
+
+F77_axpby(s, float);
+F77_axpby(d, double);
+F77_axpby(c, float _Complex);
+F77_axpby(z, double _Complex);
+
+/* gemm that only updates the upper or lower triangle of C */
+#define F77_gemmt(prefix, T)                        \
+void prefix##gemmt_(const char *uplo,               \
+        const char *transa,                         \
+        const char *transb,                         \
+        const int *n, const int *k,                 \
+        T *alpha,                                   \
+        T *a, int *lda,                             \
+        T *b, int *ldb,                             \
+        T *beta,                                    \
+        T *c, int *ldc)
+
+F77_gemmt(s, float);
+F77_gemmt(d, double);
+F77_gemmt(c, float _Complex);
+F77_gemmt(z, double _Complex);
+
+/* B = alpha op(A), where order is 'C' or 'R' and trans is 'N', 'T', 'C' or 'R' (conjugate) */
+#define F77_omatcopy(prefix, T)                     \
+void prefix##omatcopy_(const char *order,           \
+        const char *trans,                          \
+        const int *rows, const int *cols,           \
+        const T *alpha,                             \
+        const T *a, const int *lda,                 \
+        T *b, const int *ldb)
+
+F77_omatcopy(s, float);
+F77_omatcopy(d, double);
+F77_omatcopy(c, float _Complex);
+F77_omatcopy(z, double _Complex);
+
+/* A = alpha op(A) in place, with leading dimension lda before and ldb after */
+#define F77_imatcopy(prefix, T)                     \
+void prefix##imatcopy_(const char *order,           \
+        const char *trans,                          \
+        const int *rows, const int *cols,           \
+        const T *alpha,                             \
+        T *a, const int *lda,                       \
+        const int *ldb)
+
+F77_imatcopy(s, float);
+F77_imatcopy(d, double);
+F77_imatcopy(c, float _Complex);
+F77_imatcopy(z, double _Complex);
+
 void _b2c_xerbla(const char *routine, int arg_pos);
 
 #ifdef __cplusplus
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +8,9 @@
 #include <errno.h>
 #include <assert.h>
 #include <signal.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #include "blas2cuda.h"
 #include "runtime.h"
@@ -16,6 +20,14 @@
 
 #include "lib/oracle.h"
 #include "runtime-blas.h"
+#include "callsite.h"
+#include "scalars.h"
+#include "pending.h"
+#include "scheduler.h"
+#include "batch.h"
+#include "replay.h"
+#include "kernels.h"
+#include "svm.h"
 
 static bool runtime_blas_initialized = false;
 
@@ -24,15 +36,29 @@ static void *calloc_managed(size_t nmemb, size_t size);
 static void *realloc_managed(void *managed_ptr, size_t request);
 static void free_managed(void *managed_ptr);
 static size_t get_size_managed(void *managed_ptr);
+static void release_managed(void *managed_ptr, void *data);
 
 static bool b2c_initialized = false;
 
+/* set once the device runtime is up; see b2c_runtime_init() */
+bool b2c_runtime_ready = false;
+/* set instead if the runtime failed to come up; see b2c_device_usable() */
+bool b2c_passthrough = false;
+static pthread_once_t runtime_once = PTHREAD_ONCE_INIT;
+static bool runtime_started = false;
+/* set in a child forked once the runtime was started; see fork_child() */
+static bool forked = false;
+static bool fork_quiesced = false;
+static pthread_t warmup_thread;
+static bool warming_up = false;
+
 struct objmngr blas2cuda_manager = {
     .ctor = alloc_managed,
     .cctor = calloc_managed,
     .realloc = realloc_managed,
     .dtor = free_managed,
-    .get_size = get_size_managed
+    .get_size = get_size_managed,
+    .release = release_managed
 };
 
 size_t b2c_hits = 0;
@@ -41,7 +67,11 @@ static size_t total_managed_mem = 0;    /* in bytes */
 
 bool b2c_must_synchronize = false;
 
-struct b2c_options b2c_options = { false, false, false };
+struct b2c_options b2c_options = {
+    .small_gemm = true,
+    .streams = 4,
+    .batch_gemm = true
+};
 
 void b2c_print_help(void) {
     writef(STDERR_FILENO, 
@@ -51,6 +81,47 @@ void b2c_print_help(void) {
             "   debug_execfail  -- debug kernel failures\n"
             "   debug_exec      -- debug kernel invocations\n"
             "   trace_copy      -- trace copies between CPU and GPU\n"
+            "   no_small_gemm   -- forward small gemm calls to the host BLAS\n"
+            "                      instead of using our own small kernels\n"
+            "   device_scalars  -- have reductions (dot, nrm2, asum) write their\n"
+            "                      results to device memory, and copy back all\n"
+            "                      pending results at once\n"
+            "   async           -- return as soon as a call is enqueued, and wait\n"
+            "                      for it when the host touches one of its\n"
+            "                      operands, instead of after every call\n"
+            "   streams=<n>     -- issue independent calls on up to <n> streams\n"
+            "                      (default: 4)\n"
+            "   no_batch_gemm   -- issue small gemm calls on managed objects one\n"
+            "                      at a time, instead of batching them (with async)\n"
+            "   gemm3m          -- run cgemm and zgemm calls on the device with\n"
+            "                      the 3M algorithm (3 real products instead of 4)\n"
+            "   replay          -- capture sequences of calls that repeat into\n"
+            "                      CUDA graphs, and launch each as a single call\n"
+            "                      (with async)\n"
+            "   warmup          -- initialize the device runtime on a background\n"
+            "                      thread at startup, instead of on the first\n"
+            "                      call or allocation that needs it\n");
+    writef(STDERR_FILENO,
+            "   prebuild        -- on OpenCL, build (or load from the kernel\n"
+            "                      cache) the kernels of common routines on a\n"
+            "                      background thread once the runtime is up\n"
+            "   backend=<name>  -- the device backend to load: 'cuda', or 'remote',\n"
+            "                      'broker' or 'host', depending on the build, or\n"
+            "                      'none' to pass all calls through to the host BLAS\n"
+            "                      (default: the first of the build that has a\n"
+            "                      device, or none)\n"
+            "   opencl_device=<p>:<d>\n"
+            "   opencl_device=<name>\n"
+            "                   -- on OpenCL, use device <d> of platform <p>, or\n"
+            "                      the first device whose name contains <name>,\n"
+            "                      instead of the best one (see README.md)\n"
+            "   link_bandwidth=<GB/s>\n"
+            "   link_latency=<us>\n"
+            "                   -- with the host backend, make copies between the\n"
+            "                      host and the device pay for a link of this\n"
+            "                      bandwidth and latency (default: none); with the\n"
+            "                      remote backend, assume a network of this\n"
+            "                      bandwidth and latency (default: measured)\n"
             "   heuristic=<val> -- one of: 'random', 'true', 'false', or:\n"
             "                      'oracle:<filename>', where <filename> is\n"
             "                      the name of an object trace\n");
@@ -80,6 +151,51 @@ static void set_options(void) {
             b2c_options.debug_exec = true;
         else if (strcmp(option, "trace_copy") == 0)
             b2c_options.trace_copy = true;
+        else if (strcmp(option, "no_small_gemm") == 0)
+            b2c_options.small_gemm = false;
+        else if (strcmp(option, "device_scalars") == 0)
+            b2c_options.device_scalars = true;
+        else if (strcmp(option, "no_batch_gemm") == 0)
+            b2c_options.batch_gemm = false;
+        else if (strcmp(option, "gemm3m") == 0)
+            b2c_options.gemm3m = true;
+        else if (strcmp(option, "replay") == 0)
+            b2c_options.replay = true;
+        else if (strcmp(option, "warmup") == 0)
+            b2c_options.warmup = true;
+        else if (strcmp(option, "prebuild") == 0)
+            b2c_options.prebuild = true;
+        else if (strcmp(option, "async") == 0)
+            b2c_options.async = true;
+        else if (strncmp(option, "backend=", 8) == 0)
+            b2c_options.backend = option + 8;
+        else if (strncmp(option, "opencl_device=", 14) == 0)
+            b2c_options.opencl_device = option + 14;
+        else if (strncmp(option, "streams=", 8) == 0) {
+            char *end;
+            unsigned long num = strtoul(option + 8, &end, 10);
+
+            if (*end || num < 1) {
+                writef(STDERR_FILENO, "blas2cuda: invalid number of streams '%s'\n", option + 8);
+                abort();
+            }
+            b2c_options.streams = num;
+        }
+        else if (strncmp(option, "link_bandwidth=", 15) == 0
+                || strncmp(option, "link_latency=", 13) == 0) {
+            char *value = strchr(option, '=') + 1;
+            char *end;
+            double num = strtod(value, &end);
+
+            if (end == value || *end || num < 0) {
+                writef(STDERR_FILENO, "blas2cuda: invalid value for '%s'\n", option);
+                abort();
+            }
+            if (option[5] == 'b')
+                b2c_options.link_bandwidth = num;
+            else
+                b2c_options.link_latency = num;
+        }
         else if (strncmp(option, "heuristic=", 10) == 0) {
             char *hnum = strchr(option, '=');
             if (hnum) {
@@ -130,9 +246,18 @@ static void *alloc_managed(size_t request)
     void *ptr;
 
     obj_tracker_internal_enter();
+    b2c_runtime_ensure();
+    if (b2c_passthrough) {
+        /* the object that brought up the runtime, which failed */
+        if (!(ptr = internal_malloc(sizeof(size_t) + request))) {
+            obj_tracker_internal_leave();
+            return NULL;
+        }
+        *((size_t *)ptr) = request;
+        obj_tracker_internal_leave();
+        return ptr + sizeof(size_t);
+    }
     err = runtime_malloc_shared(&ptr, sizeof(size_t) + request);
-    if (!runtime_is_error(err))
-        err = runtime_svm_map(ptr + sizeof(size_t), request);
     if (runtime_is_error(err)) {
         writef(STDERR_FILENO, "blas2cuda: %s @ %s, line %d: failed to allocate %zu B: %s - %s\n", 
                 __func__, __FILE__, __LINE__, sizeof(size_t) + request, 
@@ -140,6 +265,11 @@ static void *alloc_managed(size_t request)
         obj_tracker_internal_leave();
         abort();
     }
+    if (b2c_svm_track(ptr, sizeof(size_t) + request) < 0) {
+        writef(STDERR_FILENO, "blas2cuda: %s: failed to track the mappings of %p\n", __func__, ptr);
+        obj_tracker_internal_leave();
+        abort();
+    }
 
     total_managed_mem += sizeof(size_t) + request;
     *((size_t *)ptr) = request;
@@ -166,76 +296,237 @@ static void *realloc_managed(void *managed_ptr, size_t request)
 }
 
 static void free_managed(void *managed_ptr) {
+    /* an object of the parent, which the runtime of the child can't free */
+    if (forked)
+        return;
+    if (b2c_passthrough) {
+        internal_free(managed_ptr - sizeof(size_t));
+        return;
+    }
+    b2c_pending_wait(managed_ptr);
     total_managed_mem -= sizeof(size_t) + get_size_managed(managed_ptr);
+    b2c_svm_untrack(managed_ptr - sizeof(size_t));
     runtime_free(managed_ptr - sizeof(size_t));
 }
 
 static size_t get_size_managed(void *managed_ptr) {
     return *(size_t *)(managed_ptr - sizeof(size_t));
 }
+
+/**
+ * Release the buffer that wraps a managed object on OpenCL (see gpuptr),
+ * once the object is untracked.
+ */
+static void release_managed(void *managed_ptr, void *data) {
+#if USE_OPENCL
+    if (!forked)
+        clReleaseMemObject((cl_mem) data);
+#endif
+}
 /* memory management */
 
-__attribute__((constructor))
-void blas2cuda_init(void)
+/**
+ * Bring up the device runtime, the BLAS runtime and the scheduler. This is
+ * the expensive part of initialization, so it only runs once something
+ * needs the device. Allocations made in here (e.g. by the driver) are not
+ * tracked.
+ */
+static void runtime_init_once(void)
 {
-    static bool inside = false;
     pid_t tid;
     runtime_error_t rerr;
     runtime_init_info_t init_info = RUNTIME_INIT_INFO_DEFAULT;
     runtime_blas_error_t berr;
 
-    if (!b2c_initialized && !inside) {
-        inside = true;
-        tid = syscall(SYS_gettid);
-        writef(STDOUT_FILENO, "blas2cuda: initializing on thread %d\n", tid);
-        rerr = runtime_init(init_info);
-        if (runtime_is_error(rerr)) {
-            writef(STDERR_FILENO, "blas2cuda: failed to initialize runtime\n");
-            abort();
-        }
+    obj_tracker_internal_enter();
+    runtime_started = true;
+#if USE_HOST
+    init_info.link_bandwidth = b2c_options.link_bandwidth;
+    init_info.link_latency = b2c_options.link_latency;
+#endif
+#if USE_CUDA
+    init_info.backend = b2c_options.backend;
+#else
+    init_info.device = b2c_options.opencl_device;
+#endif
+    tid = syscall(SYS_gettid);
+    writef(STDOUT_FILENO, "blas2cuda: initializing runtime on thread %d\n", tid);
+    rerr = runtime_init(init_info);
+    if (runtime_is_error(rerr)) {
+        /*
+         * Without a device, stop tracking objects and pass every call
+         * through to the host BLAS. Objects that are already tracked
+         * live in host memory (see alloc_managed()).
+         */
+        writef(STDERR_FILENO, "blas2cuda: no device backend; passing calls through to the host BLAS\n");
+        obj_tracker_set_tracking(false);
+        __atomic_store_n(&b2c_passthrough, true, __ATOMIC_RELEASE);
+        obj_tracker_internal_leave();
+        return;
+    }
 
-        if ((berr = runtime_blas_init()) != RUNTIME_BLAS_ERROR_SUCCESS) {
-            writef(STDERR_FILENO, "blas2cuda: failed to initialize BLAS runtime: %s\n",
-                    runtime_blas_error_msg(berr));
-        } else
-            writef(STDOUT_FILENO, "blas2cuda: initialized BLAS runtime\n");
+    if ((berr = runtime_blas_init()) != RUNTIME_BLAS_ERROR_SUCCESS) {
+        writef(STDERR_FILENO, "blas2cuda: failed to initialize BLAS runtime: %s\n",
+                runtime_blas_error_msg(berr));
+    } else
+        writef(STDOUT_FILENO, "blas2cuda: initialized BLAS runtime\n");
 
 #if USE_CUDA
 
-        /* get device properties */
-        int num_devices;
-        cudaGetDeviceCount(&num_devices);
-        for (int i=0; i < num_devices; i++) {
-            struct cudaDeviceProp prop;
-            cudaGetDeviceProperties(&prop, i);
-            writef(STDOUT_FILENO, "CUDA device #%d {\n", i+1);
-            writef(STDOUT_FILENO, "  name: %s\n", prop.name);
-            writef(STDOUT_FILENO, "  total global memory: %zu\n", prop.totalGlobalMem);
-            writef(STDOUT_FILENO, "  supports managed memory?: %s\n", prop.managedMemory ? "true" : "false");
-            writef(STDOUT_FILENO, "  concurrent managed access?: %s\n", prop.concurrentManagedAccess ? "true" : "false");
-            writef(STDOUT_FILENO, "}\n");
-
-            b2c_must_synchronize |= !prop.concurrentManagedAccess;
-        }
+    /* get device properties */
+    int num_devices;
+    cudaGetDeviceCount(&num_devices);
+    for (int i=0; i < num_devices; i++) {
+        struct cudaDeviceProp prop;
+        cudaGetDeviceProperties(&prop, i);
+        writef(STDOUT_FILENO, "CUDA device #%d {\n", i+1);
+        writef(STDOUT_FILENO, "  name: %s\n", prop.name);
+        writef(STDOUT_FILENO, "  total global memory: %zu\n", prop.totalGlobalMem);
+        writef(STDOUT_FILENO, "  supports managed memory?: %s\n", prop.managedMemory ? "true" : "false");
+        writef(STDOUT_FILENO, "  concurrent managed access?: %s\n", prop.concurrentManagedAccess ? "true" : "false");
+        writef(STDOUT_FILENO, "}\n");
+
+        b2c_must_synchronize |= !prop.concurrentManagedAccess;
+    }
 
 #else
-        b2c_must_synchronize = true;
+    /*
+     * Buffers that wrap fine-grained SVM use it as their storage, so the
+     * host sees results as soon as the call completes. Coarse-grained
+     * SVM has to be mapped after every call. CPU devices run kernels on
+     * host threads, which would fault on the pages of pending objects.
+     */
+    extern bool opencl_finegrained;
+    extern cl_device_type opencl_device_type;
+    b2c_must_synchronize = !opencl_finegrained || (opencl_device_type & CL_DEVICE_TYPE_CPU);
 #endif
 
-        /* initialize object tracker */
-        obj_tracker_init(false);
-        set_options();
-        obj_tracker_set_tracking(true);
+    if (b2c_sched_init(b2c_options.streams) < 0) {
+        writef(STDERR_FILENO, "blas2cuda: failed to initialize scheduler\n");
+        abort();
+    }
+    b2c_must_synchronize |= !b2c_options.async;
+    if (!b2c_must_synchronize && b2c_pending_init() < 0) {
+        writef(STDERR_FILENO, "blas2cuda: can't track pending objects: %m. Synchronizing after every call.\n");
+        b2c_must_synchronize = true;
+    }
 
-        /* add excluded regions */
+    /* add excluded regions (the driver libraries are loaded by now) */
 #if USE_CUDA
-        if (obj_tracker_find_excluded_regions("libcuda", "nvidia", NULL) < 0)
+    if (obj_tracker_find_excluded_regions("libcuda", "nvidia", NULL) < 0)
 #elif USE_OPENCL
-        if (obj_tracker_find_excluded_regions("libOpenCL", NULL) < 0)
+    if (obj_tracker_find_excluded_regions("libOpenCL", NULL) < 0)
+#endif
+        writef(STDERR_FILENO, "blas2cuda: error while finding excluded regions: %m\n");
+
+    writef(STDOUT_FILENO, "blas2cuda: initialized runtime on thread %d\n", tid);
+    __atomic_store_n(&b2c_runtime_ready, true, __ATOMIC_RELEASE);
+    b2c_kernels_prebuild();
+    obj_tracker_internal_leave();
+}
+
+void b2c_runtime_init(void) {
+    pthread_once(&runtime_once, runtime_init_once);
+}
+
+static void *warmup(void *arg) {
+    b2c_runtime_init();
+    return NULL;
+}
+
+/*
+ * fork() once the runtime has started: the child only has the thread that
+ * called fork(), so none of the streams, and a device context that is not
+ * its own (CUDA does not support using one in a forked child). The parent
+ * waits for the work in flight first; the child passes every call through
+ * to the host BLAS, and leaves the objects of the parent alone when they
+ * are freed. A child forked before the runtime started brings up its own,
+ * if it needs one.
+ */
+static void fork_prepare(void) {
+    if (__atomic_load_n(&b2c_runtime_ready, __ATOMIC_ACQUIRE) && !b2c_passthrough) {
+        b2c_scalars_flush();
+        b2c_pending_fork_prepare();
+        fork_quiesced = true;
+    }
+}
+
+static void fork_parent(void) {
+    if (fork_quiesced) {
+        fork_quiesced = false;
+        b2c_pending_fork_parent();
+    }
+}
+
+#if USE_HOST
+/**
+ * Give the child a copy of the managed object {@info} of its own. The host
+ * backends map managed memory from a memfd, which the child would share
+ * with the parent (and the broker). Each object is a mapping of its own.
+ */
+static void make_private(const struct objinfo *info) {
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = ((uintptr_t) info->ptr - sizeof(size_t)) & ~(page - 1);
+    const size_t len = ((uintptr_t) info->ptr + info->size - start + page - 1) & ~(page - 1);
+    void *copy;
+
+    if ((copy = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        writef(STDERR_FILENO, "blas2cuda: failed to copy %p in child: %m\n", info->ptr);
+        return;
+    }
+    memcpy(copy, (void *) start, len);
+    if (mremap(copy, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, (void *) start) == MAP_FAILED) {
+        writef(STDERR_FILENO, "blas2cuda: failed to copy %p in child: %m\n", info->ptr);
+        munmap(copy, len);
+    }
+}
 #endif
-            writef(STDERR_FILENO, "blas2cuda: error while finding excluded regions: %m\n");
 
-        writef(STDOUT_FILENO, "blas2cuda: initialized on thread %d\n", tid);
+static void fork_child(void) {
+    fork_quiesced = false;
+    warming_up = false;
+    if (b2c_passthrough || !runtime_started)
+        return;
+    b2c_pending_fork_child();
+    forked = true;
+    obj_tracker_set_tracking(false);
+    __atomic_store_n(&b2c_passthrough, true, __ATOMIC_RELEASE);
+#if USE_HOST
+    obj_tracker_foreach(make_private);
+#endif
+}
+
+/*
+ * Only the object tracker and the options are set up before main(), so that
+ * programs that never use the device don't pay for the runtime. With the
+ * warmup option, the runtime comes up on a thread of its own meanwhile.
+ * With backend=none, objects are not tracked at all.
+ */
+__attribute__((constructor))
+void blas2cuda_init(void)
+{
+    static bool inside = false;
+    int err;
+
+    if (!b2c_initialized && !inside) {
+        inside = true;
+
+        /* initialize object tracker */
+        obj_tracker_init(false);
+        /* after the tracker's, so that ours prepare before it locks up */
+        pthread_atfork(fork_prepare, fork_parent, fork_child);
+        set_options();
+        if (b2c_options.backend && strcmp(b2c_options.backend, "none") == 0)
+            b2c_passthrough = true;
+        else if (b2c_options.warmup) {
+            if ((err = pthread_create(&warmup_thread, NULL, warmup, NULL)) == 0)
+                warming_up = true;
+            else
+                writef(STDERR_FILENO, "blas2cuda: failed to start warmup thread: %s\n", strerror(err));
+        }
+        obj_tracker_set_tracking(!b2c_passthrough);
+
         b2c_initialized = true;
         inside = false;
     }
@@ -251,18 +542,33 @@ void blas2cuda_fini(void)
 
     if (!inside && b2c_initialized) {
         inside = true;
-        if (runtime_blas_initialized && (berr = runtime_blas_init()) != RUNTIME_BLAS_ERROR_SUCCESS)
-            writef(STDERR_FILENO, "blas2cuda: failed to destroy BLAS context: %s\n", 
-                    runtime_blas_error_msg(berr));
-        rerr = runtime_fini();
-        if (runtime_is_error(rerr))
-            writef(STDERR_FILENO, "blas2cuda: WARNING: failed to finalize runtime\n");
+        if (warming_up)
+            pthread_join(warmup_thread, NULL);
+        if (b2c_runtime_ready && !forked) {
+            b2c_kernels_fini();
+            b2c_batch_flush();
+            b2c_pending_fini();
+            b2c_scalars_fini();
+            b2c_batch_fini();
+            b2c_replay_fini();
+            b2c_sched_fini();
+            if (runtime_blas_initialized && (berr = runtime_blas_init()) != RUNTIME_BLAS_ERROR_SUCCESS)
+                writef(STDERR_FILENO, "blas2cuda: failed to destroy BLAS context: %s\n", 
+                        runtime_blas_error_msg(berr));
+            rerr = runtime_fini();
+            if (runtime_is_error(rerr))
+                writef(STDERR_FILENO, "blas2cuda: WARNING: failed to finalize runtime\n");
+        }
 
         tid = syscall(SYS_gettid);
         obj_tracker_fini();
         inside = false;
         b2c_initialized = false;
 
+        /* the statistics are the parent's */
+        if (forked)
+            return;
+
         int fd = open("statistics.csv", O_RDWR | O_CREAT, 0644);
         if (fd > -1) {
             writef(fd, "Hits, Misses\n");
@@ -272,6 +578,43 @@ void blas2cuda_fini(void)
             writef(STDERR_FILENO, "blas2cuda: failed to write to statistics file: %s\n", strerror(errno));
         }
 
+        if (b2c_callsite_dump("callsites.csv") < 0)
+            writef(STDERR_FILENO, "blas2cuda: failed to write to call site statistics file: %s\n", strerror(errno));
+
+        if (b2c_scalars_flushes)
+            writef(STDOUT_FILENO, "blas2cuda: returned %zu scalar results in %zu transfers\n",
+                    b2c_scalars_results, b2c_scalars_flushes);
+
+        if (b2c_batch_flushes)
+            writef(STDOUT_FILENO, "blas2cuda: batched %zu calls into %zu kernels\n",
+                    b2c_batch_calls, b2c_batch_flushes);
+
+        if (b2c_batch_windows)
+            writef(STDOUT_FILENO, "blas2cuda: waited %zu times for calls of other threads\n",
+                    b2c_batch_windows);
+
+        if (b2c_replay_launches || b2c_replay_cut)
+            writef(STDOUT_FILENO, "blas2cuda: replayed %zu calls in %zu graph launches; "
+                    "%zu plans cut short\n",
+                    b2c_replay_calls, b2c_replay_launches, b2c_replay_cut);
+
+        if (b2c_kernels_built || b2c_kernels_loaded)
+            writef(STDOUT_FILENO, "blas2cuda: built %zu OpenCL programs in %.1f ms; "
+                    "loaded %zu from the kernel cache in %.1f ms\n",
+                    b2c_kernels_built, b2c_kernels_build_ms,
+                    b2c_kernels_loaded, b2c_kernels_load_ms);
+
+        if (b2c_svm_unmapped)
+            writef(STDOUT_FILENO, "blas2cuda: unmapped %zu SVM chunks (%zu B) for calls; "
+                    "mapped %zu back\n",
+                    b2c_svm_unmapped, b2c_svm_unmapped_bytes, b2c_svm_mapped);
+
+        if (b2c_sched_calls)
+            writef(STDOUT_FILENO, "blas2cuda: issued %zu calls, %zu after earlier calls; "
+                    "up to %zu (%.2f on average) in flight\n",
+                    b2c_sched_calls, b2c_sched_dependent,
+                    b2c_sched_peak, (double) b2c_sched_inflight / b2c_sched_calls);
+
         writef(STDOUT_FILENO, "blas2cuda: decommissioned on thread %d\n", tid);
     }
 }
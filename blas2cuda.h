@@ -10,9 +10,60 @@ struct b2c_options {
     bool debug_execfail;
     bool debug_exec;
     bool trace_copy;
+    bool small_gemm;
+    bool device_scalars;
+    bool async;
+    unsigned streams;
+    bool batch_gemm;
+    bool gemm3m;
+    bool replay;
+    bool warmup;
+    bool prebuild;
+    double link_bandwidth;      /* GB/s, host and remote backends only */
+    double link_latency;        /* us, host and remote backends only */
+    const char *backend;        /* NULL for the default (see backend.h) */
+    const char *opencl_device;  /* NULL to rank the devices (see runtime.h) */
 };
 
 extern struct b2c_options b2c_options;
 extern bool b2c_must_synchronize;
+extern bool b2c_runtime_ready;
+extern bool b2c_passthrough;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initialize the device runtime, the BLAS runtime and the scheduler, if
+ * that hasn't been done yet. Only the first caller does the work; others
+ * wait for it to finish.
+ */
+void b2c_runtime_init(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+/**
+ * Make sure the device runtime is up before using it.
+ */
+static inline void b2c_runtime_ensure(void) {
+    if (!__atomic_load_n(&b2c_runtime_ready, __ATOMIC_ACQUIRE))
+        b2c_runtime_init();
+}
+
+/**
+ * Whether calls can run on the device. If the runtime failed to come up
+ * (e.g. there is no device, or BLAS2CUDA_OPTIONS=backend=none), every call
+ * is passed through to the host BLAS. Like b2c_runtime_ensure(), this
+ * brings up the runtime, so only use it where the device would be used.
+ */
+static inline bool b2c_device_usable(void) {
+    if (__atomic_load_n(&b2c_passthrough, __ATOMIC_ACQUIRE))
+        return false;
+    b2c_runtime_ensure();
+    return !__atomic_load_n(&b2c_passthrough, __ATOMIC_ACQUIRE);
+}
 
 #endif
@@ -1,56 +1,129 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-
-template <typename T, typename R>
-static void _cblas_i_amax(const int n,
-        const T *x,
-        const int incx,
-        R *result,
-        cublasStatus_t amax_func(cublasHandle_t, int, 
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T>
+#if USE_CUDA
+using amax_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
             const T *, int,
-            R *))
+            int *);
+#else
+using amax_t = clblasStatus (*)(size_t N,
+        cl_mem iMax, size_t offiMax,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_amax(const int n,
+        const T *x, const int incx,
+        int *result,
+        amax_t<T> amax_func)
 {
-    const T *gpu_x;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *x_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+#if USE_CUDA
+    call_kernel(
+        amax_func(b2c_cublas_handle, n, gpu_x, incx, result)
+    );
+#else
+    cl_uint index = 0;
+    {
+        gpuptr<cl_uint> gpu_index(&index, sizeof index);
+        gpuptr<T> scratch(NULL, 2 * n * sizeof *x);
+
+        call_kernel(
+            amax_func(n, gpu_index, gpu_index.offset(),
+                gpu_x, gpu_x.offset(), incx,
+                scratch,
+                b2c_queue_args())
+        );
+    }
+    *result = index;
+#endif
+}
+
+#define amax_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0, (sx), n, sx, incx)
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
+F77_amax(s, float) {
+    int result = 0;
+    amax_check(isamax_);
+    _b2c_amax(*n, sx, *incx, &result,
+#if USE_CUDA
+            &cublasIsamax
+#else
+            &clblasiSamax
+#endif
+            );
+    return result;
+}
 
-    call_kernel(amax_func(b2c_handle, n, gpu_x, incx, result));
+F77_amax(d, double) {
+    int result = 0;
+    amax_check(idamax_);
+    _b2c_amax(*n, sx, *incx, &result,
+#if USE_CUDA
+            &cublasIdamax
+#else
+            &clblasiDamax
+#endif
+            );
+    return result;
+}
 
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_amax(c, float _Complex) {
+    int result = 0;
+    amax_check(icamax_);
+    _b2c_amax(*n, cmplx_ptr(sx), *incx, &result,
+#if USE_CUDA
+            &cublasIcamax
+#else
+            &clblasiCamax
+#endif
+            );
+    return result;
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_amax(z, double _Complex) {
+    int result = 0;
+    amax_check(izamax_);
+    _b2c_amax(*n, cmplx_ptr(sx), *incx, &result,
+#if USE_CUDA
+            &cublasIzamax
+#else
+            &clblasiZamax
+#endif
+            );
+    return result;
 }
 
+// CBLAS wrappers
+
 DECLARE_CBLAS_I_AMAX(s, float) {
-    CBLAS_INDEX idx;
-    _cblas_i_amax(n, x, incx, &idx, &cublasIsamax);
-    return idx;
+    return cblas_index(isamax_(&n, (float *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMAX(d, double) {
-    CBLAS_INDEX idx;
-    _cblas_i_amax(n, x, incx, &idx, &cublasIdamax);
-    return idx;
-
+    return cblas_index(idamax_(&n, (double *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMAX(c, float _Complex) {
-    CBLAS_INDEX idx;
-    _cblas_i_amax(n, (cuComplex *) x, incx, &idx, &cublasIcamax);
-    return idx;
+    return cblas_index(icamax_(&n, (float _Complex *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMAX(z, double _Complex) {
-    CBLAS_INDEX idx;
-    _cblas_i_amax(n, (cuDoubleComplex *) x, incx, &idx, &cublasIzamax);
-    return idx;
+    return cblas_index(izamax_(&n, (double _Complex *) x, &incx));
 }
-
@@ -1,56 +1,95 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-
-template <typename T, typename R>
-static void _cblas_i_amin(const int n,
-        const T *x,
-        const int incx,
-        R *result,
-        cublasStatus_t amin_func(cublasHandle_t, int, 
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+#if USE_CUDA
+template <typename T>
+using amin_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
             const T *, int,
-            R *))
+            int *);
+
+template <typename T>
+void _b2c_amin(const int n,
+        const T *x, const int incx,
+        int *result,
+        amin_t<T> amin_func)
 {
-    const T *gpu_x;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *x_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
+    call_kernel(
+        amin_func(b2c_cublas_handle, n, gpu_x, incx, result)
+    );
+}
 
-    call_kernel(amin_func(b2c_handle, n, gpu_x, incx, result));
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define amin_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0, (sx), n, sx, incx)
+#else
+/* clBLAS has no i?amin, so always use the next BLAS library */
+#define amin_check(fname)\
+    return runtime_blas_next(fname)(n, sx, incx)
+#endif
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_amin(s, float) {
+    int result = 0;
+    amin_check(isamin_);
+#if USE_CUDA
+    _b2c_amin(*n, sx, *incx, &result, &cublasIsamin);
+#endif
+    return result;
 }
 
+F77_amin(d, double) {
+    int result = 0;
+    amin_check(idamin_);
+#if USE_CUDA
+    _b2c_amin(*n, sx, *incx, &result, &cublasIdamin);
+#endif
+    return result;
+}
+
+F77_amin(c, float _Complex) {
+    int result = 0;
+    amin_check(icamin_);
+#if USE_CUDA
+    _b2c_amin(*n, cmplx_ptr(sx), *incx, &result, &cublasIcamin);
+#endif
+    return result;
+}
+
+F77_amin(z, double _Complex) {
+    int result = 0;
+    amin_check(izamin_);
+#if USE_CUDA
+    _b2c_amin(*n, cmplx_ptr(sx), *incx, &result, &cublasIzamin);
+#endif
+    return result;
+}
+
+// CBLAS wrappers
+
 DECLARE_CBLAS_I_AMIN(s, float) {
-    CBLAS_INDEX idx;
-    _cblas_i_amin(n, x, incx, &idx, &cublasIsamin);
-    return idx;
+    return cblas_index(isamin_(&n, (float *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMIN(d, double) {
-    CBLAS_INDEX idx;
-    _cblas_i_amin(n, x, incx, &idx, &cublasIdamin);
-    return idx;
-
+    return cblas_index(idamin_(&n, (double *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMIN(c, float _Complex) {
-    CBLAS_INDEX idx;
-    _cblas_i_amin(n, (cuComplex *) x, incx, &idx, &cublasIcamin);
-    return idx;
+    return cblas_index(icamin_(&n, (float _Complex *) x, &incx));
 }
 
 DECLARE_CBLAS_I_AMIN(z, double _Complex) {
-    CBLAS_INDEX idx;
-    _cblas_i_amin(n, (cuDoubleComplex *) x, incx, &idx, &cublasIzamin);
-    return idx;
+    return cblas_index(izamin_(&n, (double _Complex *) x, &incx));
 }
-
@@ -1,57 +1,173 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-
-template <typename T, typename R>
-static void _cblas_asum (const int n,
-        const T *x, 
-        const int incx, 
-        R *result,
-        cublasStatus_t asum_func(cublasHandle_t, const int, const T *, const int, R *))
-{
-    const T *gpu_x;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *x_info;
-    extern cublasHandle_t b2c_handle;
+#include "../deferred.h"
+#include "../runtime-mem.hpp"
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-    call_kernel(asum_func(b2c_handle, n, gpu_x, incx, result));
+template <typename T, typename S>
+#if USE_CUDA
+using asum_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            S *);
+#else
+using asum_t = clblasStatus (*)(size_t N,
+        cl_mem asum, size_t offasum,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+template <typename T, typename S>
+void _b2c_asum(const int n,
+        const T *x, const int incx,
+        S *result, bool deferred,
+        asum_t<T,S> asum_func)
+{
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    devscalar<S> gpu_result(result, deferred);
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, n * sizeof *x);
+#endif
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+    call_kernel(
+#if USE_CUDA
+        asum_func(gpu_result.handle(), n, gpu_x, incx, gpu_result)
+#else
+        asum_func(n, gpu_result, gpu_result.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            scratch,
+            b2c_queue_args())
+#endif
+    );
 }
 
-DECLARE_CBLAS__ASUM(s, float) {
-    float result;
+#define asum_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0, (sx), n, sx, incx)
+
+#define asum_deferred_check(fname)\
+    resident_or_compute(fname, result, *n > 0 && *incx > 0, (sx), n, sx, incx)
 
-    _cblas_asum(n, x, incx, &result, &cublasSasum);
+F77_asum(s, float, float) {
+    float result;
+    asum_check(sasum_);
+    _b2c_asum(*n, sx, *incx, &result, false,
+#if USE_CUDA
+            &cublasSasum
+#else
+            &clblasSasum
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__ASUM(sc, float _Complex) {
+F77_asum(sc, float, float _Complex) {
     float result;
-
-    _cblas_asum(n, (cuComplex *) x, incx, &result, &cublasScasum);
+    asum_check(scasum_);
+    _b2c_asum(*n, cmplx_ptr(sx), *incx, &result, false,
+#if USE_CUDA
+            &cublasScasum
+#else
+            &clblasScasum
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__ASUM(d, double) {
+F77_asum(d, double, double) {
     double result;
-
-    _cblas_asum(n, x, incx, &result, &cublasDasum);
+    asum_check(dasum_);
+    _b2c_asum(*n, sx, *incx, &result, false,
+#if USE_CUDA
+            &cublasDasum
+#else
+            &clblasDasum
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__ASUM(dz, double _Complex) {
+F77_asum(dz, double, double _Complex) {
     double result;
-
-    _cblas_asum(n, (cuDoubleComplex *) x, incx, &result, &cublasDzasum);
+    asum_check(dzasum_);
+    _b2c_asum(*n, cmplx_ptr(sx), *incx, &result, false,
+#if USE_CUDA
+            &cublasDzasum
+#else
+            &clblasDzasum
+#endif
+            );
     return result;
 }
+
+DEFERRED_asum(s, float, float) {
+    asum_deferred_check(sasum_);
+    _b2c_asum(*n, sx, *incx, result, true,
+#if USE_CUDA
+            &cublasSasum
+#else
+            &clblasSasum
+#endif
+            );
+}
+
+DEFERRED_asum(sc, float, float _Complex) {
+    asum_deferred_check(scasum_);
+    _b2c_asum(*n, cmplx_ptr(sx), *incx, result, true,
+#if USE_CUDA
+            &cublasScasum
+#else
+            &clblasScasum
+#endif
+            );
+}
+
+DEFERRED_asum(d, double, double) {
+    asum_deferred_check(dasum_);
+    _b2c_asum(*n, sx, *incx, result, true,
+#if USE_CUDA
+            &cublasDasum
+#else
+            &clblasDasum
+#endif
+            );
+}
+
+DEFERRED_asum(dz, double, double _Complex) {
+    asum_deferred_check(dzasum_);
+    _b2c_asum(*n, cmplx_ptr(sx), *incx, result, true,
+#if USE_CUDA
+            &cublasDzasum
+#else
+            &clblasDzasum
+#endif
+            );
+}
+
+// CBLAS wrappers
+
+DECLARE_CBLAS__ASUM(s, float, float) {
+    return sasum_(&n, (float *) x, &incx);
+}
+
+DECLARE_CBLAS__ASUM(sc, float, float _Complex) {
+    return scasum_(&n, (float _Complex *) x, &incx);
+}
+
+DECLARE_CBLAS__ASUM(d, double, double) {
+    return dasum_(&n, (double *) x, &incx);
+}
+
+DECLARE_CBLAS__ASUM(dz, double, double _Complex) {
+    return dzasum_(&n, (double _Complex *) x, &incx);
+}
@@ -0,0 +1,189 @@
+#if USE_CUDA
+#include <cublas_v2.h>
+#endif
+#include "../common.h"
+#include "../cblas.h"
+#include "../blas.h"
+#include "../conversions.h"
+#include "level1.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+/*
+ * y = alpha x + beta y, from the copy, scal and axpy routines of the
+ * device library, which has no axpby.
+ */
+
+template <typename T, typename S>
+#if USE_CUDA
+using copy_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            T *, int);
+
+template <typename T, typename S>
+using scal_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const S *,
+            T *, int);
+
+template <typename T, typename S>
+using axpy_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const S *,
+            const T *, int,
+            T *, int);
+#else
+using copy_t = clblasStatus (*)(size_t N,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+
+template <typename T, typename S>
+using scal_t = clblasStatus (*)(size_t N,
+        S alpha,
+        cl_mem X, size_t offx, int incx,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+
+template <typename T, typename S>
+using axpy_t = clblasStatus (*)(size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+/**
+ * If {@beta} is zero ({@beta_zero}), y is overwritten with alpha x, as in
+ * the host libraries, so that NaNs in y don't propagate. Scaling by one
+ * ({@alpha_one} and {@beta_one}) and adding zero ({@alpha_zero}) are
+ * skipped.
+ */
+template <typename T, typename S>
+void _b2c_axpby(const int n,
+        const S alpha, bool alpha_zero, bool alpha_one,
+        const T *x, const int incx,
+        const S beta, bool beta_zero, bool beta_one,
+        T *y, const int incy,
+        copy_t<T,S> copy_func, scal_t<T,S> scal_func, axpy_t<T,S> axpy_func)
+{
+    const size_t size_x = size(1, n - 1, incx, sizeof *x);
+    const size_t size_y = size(1, n - 1, incy, sizeof *y);
+    gpuptr<const T> gpu_x(x, size_x);
+    gpuptr<T> gpu_y(y, size_y);
+    bool first = true;
+
+    /* calls after the first declare their operands again (see scheduler.h) */
+#define axpby_call(expr)\
+    do {\
+        if (!first) {\
+            b2c_sched_operand(x, size_x, false);\
+            b2c_sched_operand(y, size_y, true);\
+        }\
+        call_kernel(expr);\
+        first = false;\
+    } while (0)
+
+    if (beta_zero) {
+#if USE_CUDA
+        axpby_call(copy_func(b2c_cublas_handle, n, gpu_x, incx, gpu_y, incy));
+        if (!alpha_one)
+            axpby_call(scal_func(b2c_cublas_handle, n, &alpha, gpu_y, incy));
+#else
+        axpby_call(copy_func(n, gpu_x, gpu_x.offset(), incx,
+                    gpu_y, gpu_y.offset(), incy, b2c_queue_args()));
+        if (!alpha_one)
+            axpby_call(scal_func(n, alpha, gpu_y, gpu_y.offset(), incy, b2c_queue_args()));
+#endif
+        return;
+    }
+
+#if USE_CUDA
+    if (!beta_one)
+        axpby_call(scal_func(b2c_cublas_handle, n, &beta, gpu_y, incy));
+    if (!alpha_zero)
+        axpby_call(axpy_func(b2c_cublas_handle, n, &alpha, gpu_x, incx, gpu_y, incy));
+#else
+    if (!beta_one)
+        axpby_call(scal_func(n, beta, gpu_y, gpu_y.offset(), incy, b2c_queue_args()));
+    if (!alpha_zero)
+        axpby_call(axpy_func(n, alpha, gpu_x, gpu_x.offset(), incx,
+                    gpu_y, gpu_y.offset(), incy, b2c_queue_args()));
+#endif
+#undef axpby_call
+}
+
+#define axpby_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0\
+            && !(*alpha == 0 && *beta == 1),\
+            (x, y), n, alpha, x, incx, beta, y, incy)
+
+#if USE_CUDA
+#define axpby_kernels(P) &cublas##P##copy, &cublas##P##scal, &cublas##P##axpy
+#else
+#define axpby_kernels(P) &clblas##P##copy, &clblas##P##scal, &clblas##P##axpy
+#endif
+
+F77_axpby(s, float) {
+    axpby_check(saxpby_);
+    _b2c_axpby(*n,
+            *alpha, *alpha == 0, *alpha == 1,
+            x, *incx,
+            *beta, *beta == 0, *beta == 1,
+            y, *incy,
+            axpby_kernels(S));
+}
+
+F77_axpby(d, double) {
+    axpby_check(daxpby_);
+    _b2c_axpby(*n,
+            *alpha, *alpha == 0, *alpha == 1,
+            x, *incx,
+            *beta, *beta == 0, *beta == 1,
+            y, *incy,
+            axpby_kernels(D));
+}
+
+F77_axpby(c, float _Complex) {
+    axpby_check(caxpby_);
+    _b2c_axpby(*n,
+            cu(*alpha), *alpha == 0, *alpha == 1,
+            cmplx_ptr(x), *incx,
+            cu(*beta), *beta == 0, *beta == 1,
+            cmplx_ptr(y), *incy,
+            axpby_kernels(C));
+}
+
+F77_axpby(z, double _Complex) {
+    axpby_check(zaxpby_);
+    _b2c_axpby(*n,
+            cu(*alpha), *alpha == 0, *alpha == 1,
+            cmplx_ptr(x), *incx,
+            cu(*beta), *beta == 0, *beta == 1,
+            cmplx_ptr(y), *incy,
+            axpby_kernels(Z));
+}
+
+// CBLAS wrappers
+
+DECLARE_CBLAS__AXPBY(s, float, const float) {
+    saxpby_(&n, &alpha, (float *) x, &incx, &beta, y, &incy);
+}
+
+DECLARE_CBLAS__AXPBY(d, double, const double) {
+    daxpby_(&n, &alpha, (double *) x, &incx, &beta, y, &incy);
+}
+
+DECLARE_CBLAS__AXPBY(c, float _Complex, const float _Complex *) {
+    caxpby_(&n, alpha, (float _Complex *) x, &incx, beta, y, &incy);
+}
+
+DECLARE_CBLAS__AXPBY(z, double _Complex, const double _Complex *) {
+    zaxpby_(&n, alpha, (double _Complex *) x, &incx, beta, y, &incy);
+}
@@ -1,59 +1,121 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-#include <cuComplex.h>
+#include "../runtime-mem.hpp"
 
-template <typename T>
-static void _cblas_axpy (const int n,
-        const T a,
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T, typename S>
+#if USE_CUDA
+using axpy_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const S *,
+            const T *, int,
+            T *, int);
+#else
+using axpy_t = clblasStatus (*)(size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_axpy(const int n,
+        const S alpha,
         const T *x, const int incx,
         T *y, const int incy,
-        cublasStatus_t axpy_func(cublasHandle_t, int,
-            const T *,
-            const T *, int,
-            T *, int))
+        axpy_t<T,S> axpy_func)
 {
-    const T *gpu_x;
-    T *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+
+    call_kernel(
+#if USE_CUDA
+        axpy_func(b2c_cublas_handle, n,
+                &alpha,
+                gpu_x, incx,
+                gpu_y, incy)
+#else
+        axpy_func(n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
+    );
+}
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu(NULL, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+#define axpy_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0 && *sa != 0,\
+            (sx, sy), n, sa, sx, incx, sy, incy)
 
-    call_kernel(axpy_func(b2c_handle, n, &a, gpu_x, incx, gpu_y, incy));
+F77_axpy(s, float) {
+    axpy_check(saxpy_);
+    _b2c_axpy(*n, *sa, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasSaxpy
+#else
+            &clblasSaxpy
+#endif
+            );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_axpy(d, double) {
+    axpy_check(daxpy_);
+    _b2c_axpy(*n, *sa, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasDaxpy
+#else
+            &clblasDaxpy
+#endif
+            );
+}
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_axpy(c, float _Complex) {
+    axpy_check(caxpy_);
+    _b2c_axpy(*n, cu(*sa), cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasCaxpy
+#else
+            &clblasCaxpy
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_axpy(z, double _Complex) {
+    axpy_check(zaxpy_);
+    _b2c_axpy(*n, cu(*sa), cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasZaxpy
+#else
+            &clblasZaxpy
+#endif
+            );
 }
 
-DECLARE_CBLAS__AXPY(s, float) {
-    _cblas_axpy(n, a, x, incx, y, incy, &cublasSaxpy);
+// CBLAS wrappers
+
+DECLARE_CBLAS__AXPY(s, float, const float) {
+    saxpy_(&n, &a, (float *) x, &incx, y, &incy);
 }
 
-DECLARE_CBLAS__AXPY(d, double) {
-    _cblas_axpy(n, a, x, incx, y, incy, &cublasDaxpy);
+DECLARE_CBLAS__AXPY(d, double, const double) {
+    daxpy_(&n, &a, (double *) x, &incx, y, &incy);
 }
 
-DECLARE_CBLAS__AXPY(c, float _Complex) {
-    _cblas_axpy(n, cu(a), (const cuComplex *) x, incx, (cuComplex *) y, incy, &cublasCaxpy);
+DECLARE_CBLAS__AXPY(c, float _Complex, const float _Complex *) {
+    caxpy_(&n, a, (float _Complex *) x, &incx, y, &incy);
 }
 
-DECLARE_CBLAS__AXPY(z, double _Complex) {
-    _cblas_axpy(n, cu(a), (const cuDoubleComplex *) x, incx,
-            (cuDoubleComplex *) y, incy, &cublasZaxpy);
+DECLARE_CBLAS__AXPY(z, double _Complex, const double _Complex *) {
+    zaxpy_(&n, a, (double _Complex *) x, &incx, y, &incy);
 }
@@ -1,55 +1,116 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T>
+#if USE_CUDA
+using copy_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            T *, int);
+#else
+using copy_t = clblasStatus (*)(size_t N,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
 template <typename T>
-static void _cblas_copy (const int n,
-        const T *x,
-        const int incx, 
-        T *y, 
-        const int incy,
-        cublasStatus_t copy_func(cublasHandle_t, int, const T *, int, T *, int))
+void _b2c_copy(const int n,
+        const T *x, const int incx,
+        T *y, const int incy,
+        copy_t<T> copy_func)
 {
-    const T *gpu_x;
-    T *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu(NULL, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+    call_kernel(
+#if USE_CUDA
+        copy_func(b2c_cublas_handle, n,
+                gpu_x, incx,
+                gpu_y, incy)
+#else
+        copy_func(n,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
+    );
+}
 
-    call_kernel(copy_func(b2c_handle, n, gpu_x, incx, gpu_y, incy));
+#define copy_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_copy(s, float) {
+    copy_check(scopy_);
+    _b2c_copy(*n, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasScopy
+#else
+            &clblasScopy
+#endif
+            );
+}
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_copy(d, double) {
+    copy_check(dcopy_);
+    _b2c_copy(*n, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasDcopy
+#else
+            &clblasDcopy
+#endif
+            );
+}
+
+F77_copy(c, float _Complex) {
+    copy_check(ccopy_);
+    _b2c_copy(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasCcopy
+#else
+            &clblasCcopy
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_copy(z, double _Complex) {
+    copy_check(zcopy_);
+    _b2c_copy(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasZcopy
+#else
+            &clblasZcopy
+#endif
+            );
 }
 
+// CBLAS wrappers
+
 DECLARE_CBLAS__COPY(s, float) {
-    _cblas_copy(n, x, incx, y, incy, &cublasScopy);
+    scopy_(&n, (float *) x, &incx, y, &incy);
 }
 
 DECLARE_CBLAS__COPY(d, double) {
-    _cblas_copy(n, x, incx, y, incy, &cublasDcopy);
+    dcopy_(&n, (double *) x, &incx, y, &incy);
 }
 
 DECLARE_CBLAS__COPY(c, float _Complex) {
-    _cblas_copy(n, (const cuComplex *) x, incx, (cuComplex *) y, incy, &cublasCcopy);
+    ccopy_(&n, (float _Complex *) x, &incx, y, &incy);
 }
 
 DECLARE_CBLAS__COPY(z, double _Complex) {
-    _cblas_copy(n, (const cuDoubleComplex *) x, incx, (cuDoubleComplex *) y, incy, &cublasZcopy);
+    zcopy_(&n, (double _Complex *) x, &incx, y, &incy);
 }
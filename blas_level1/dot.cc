@@ -1,48 +1,127 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../deferred.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
 template <typename T>
-static void _cblas_dot (const int n,
-        const T *x,
-        const int incx,
-        const T *y,
-        const int incy,
-        T *result,
-        cublasStatus_t dot_func(cublasHandle_t, int, const T *, int, const T *, int, T *))
-{
-    const T *gpu_x, *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+using dot_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            const T *, int,
+            T *);
+#else
+using dot_t = clblasStatus (*)(size_t N,
+        cl_mem dotProduct, size_t offDP,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (const T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+template <typename T>
+void _b2c_dot(const int n,
+        const T *x, const int incx,
+        const T *y, const int incy,
+        T *result, bool deferred,
+        dot_t<T> dot_func)
+{
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    devscalar<T> gpu_result(result, deferred);
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, n * sizeof *x);
+#endif
 
-    call_kernel(dot_func(b2c_handle, n, gpu_x, incx, gpu_y, incy, result));
+    call_kernel(
+#if USE_CUDA
+        dot_func(gpu_result.handle(), n,
+                gpu_x, incx,
+                gpu_y, incy,
+                gpu_result)
+#else
+        dot_func(n, gpu_result, gpu_result.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            scratch,
+            b2c_queue_args())
+#endif
+    );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define dot_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
-}
+#define dot_deferred_check(fname)\
+    resident_or_compute(fname, result, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-DECLARE_CBLAS__DOT(s, float) {
+F77_dot(s, float) {
     float result;
-    _cblas_dot(n, x, incx, y, incy, &result, &cublasSdot);
+    dot_check(sdot_);
+    _b2c_dot(*n, sx, *incx, sy, *incy, &result, false,
+#if USE_CUDA
+            &cublasSdot
+#else
+            &clblasSdot
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__DOT(d, double) {
+F77_dot(d, double) {
     double result;
-    _cblas_dot(n, x, incx, y, incy, &result, &cublasDdot);
+    dot_check(ddot_);
+    _b2c_dot(*n, sx, *incx, sy, *incy, &result, false,
+#if USE_CUDA
+            &cublasDdot
+#else
+            &clblasDdot
+#endif
+            );
     return result;
 }
+
+DEFERRED_dot(s, float) {
+    dot_deferred_check(sdot_);
+    _b2c_dot(*n, sx, *incx, sy, *incy, result, true,
+#if USE_CUDA
+            &cublasSdot
+#else
+            &clblasSdot
+#endif
+            );
+}
+
+DEFERRED_dot(d, double) {
+    dot_deferred_check(ddot_);
+    _b2c_dot(*n, sx, *incx, sy, *incy, result, true,
+#if USE_CUDA
+            &cublasDdot
+#else
+            &clblasDdot
+#endif
+            );
+}
+
+// CBLAS wrappers
+
+DECLARE_CBLAS__DOT(s, float) {
+    return sdot_(&n, (float *) x, &incx, (float *) y, &incy);
+}
+
+DECLARE_CBLAS__DOT(d, double) {
+    return ddot_(&n, (double *) x, &incx, (double *) y, &incy);
+}
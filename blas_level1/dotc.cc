@@ -1,48 +1,127 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../deferred.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T>
+#if USE_CUDA
+using dotc_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            const T *, int,
+            T *);
+#else
+using dotc_t = clblasStatus (*)(size_t N,
+        cl_mem dotProduct, size_t offDP,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
 template <typename T>
-static void _cblas_dotc_sub(const int n,
-        const T *x,
-        const int incx,
-        const T *y,
-        const int incy,
-        T *dotc,
-        cublasStatus_t dotc_func(cublasHandle_t, int, const T *, int, const T *, int, T *))
+void _b2c_dotc(const int n,
+        const T *x, const int incx,
+        const T *y, const int incy,
+        T *result, bool deferred,
+        dotc_t<T> dotc_func)
 {
-    const T *gpu_x, *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    devscalar<T> gpu_result(result, deferred);
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, n * sizeof *x);
+#endif
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+    call_kernel(
+#if USE_CUDA
+        dotc_func(gpu_result.handle(), n,
+                gpu_x, incx,
+                gpu_y, incy,
+                gpu_result)
+#else
+        dotc_func(n, gpu_result, gpu_result.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            scratch,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define dotc_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    call_kernel(dotc_func(b2c_handle, n, gpu_x, incx, gpu_y, incy, dotc));
+#define dotc_deferred_check(fname)\
+    resident_or_compute(fname, result, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_dotc(c, float _Complex) {
+    float _Complex result;
+    dotc_check(cdotc_);
+    _b2c_dotc(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(&result), false,
+#if USE_CUDA
+            &cublasCdotc
+#else
+            &clblasCdotc
+#endif
+            );
+    return result;
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_dotc(z, double _Complex) {
+    double _Complex result;
+    dotc_check(zdotc_);
+    _b2c_dotc(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(&result), false,
+#if USE_CUDA
+            &cublasZdotc
+#else
+            &clblasZdotc
+#endif
+            );
+    return result;
 }
 
+DEFERRED_dotc(c, float _Complex) {
+    dotc_deferred_check(cdotc_);
+    _b2c_dotc(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(result), true,
+#if USE_CUDA
+            &cublasCdotc
+#else
+            &clblasCdotc
+#endif
+            );
+}
+
+DEFERRED_dotc(z, double _Complex) {
+    dotc_deferred_check(zdotc_);
+    _b2c_dotc(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(result), true,
+#if USE_CUDA
+            &cublasZdotc
+#else
+            &clblasZdotc
+#endif
+            );
+}
+
+// CBLAS wrappers
+
 DECLARE_CBLAS__DOTC(c, float _Complex) {
-    _cblas_dotc_sub(n, (const cuComplex *) x, incx,
-            (const cuComplex *) y, incy, (cuComplex *) dotc,
-            &cublasCdotc);
+    *dotc = cdotc_(&n, (float _Complex *) x, &incx, (float _Complex *) y, &incy);
 }
 
 DECLARE_CBLAS__DOTC(z, double _Complex) {
-    _cblas_dotc_sub(n, (const cuDoubleComplex *) x, incx,
-            (const cuDoubleComplex *) y, incy, (cuDoubleComplex *) dotc,
-            &cublasZdotc);
+    *dotc = zdotc_(&n, (double _Complex *) x, &incx, (double _Complex *) y, &incy);
 }
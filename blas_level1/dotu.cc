@@ -1,48 +1,127 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../deferred.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T>
+#if USE_CUDA
+using dotu_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            const T *, int,
+            T *);
+#else
+using dotu_t = clblasStatus (*)(size_t N,
+        cl_mem dotProduct, size_t offDP,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
 template <typename T>
-static void _cblas_dotu_sub(const int n,
-        const T *x,
-        const int incx,
-        const T *y,
-        const int incy,
-        T *dotu,
-        cublasStatus_t dotu_func(cublasHandle_t, int, const T *, int, const T *, int, T *))
+void _b2c_dotu(const int n,
+        const T *x, const int incx,
+        const T *y, const int incy,
+        T *result, bool deferred,
+        dotu_t<T> dotu_func)
 {
-    const T *gpu_x, *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    devscalar<T> gpu_result(result, deferred);
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, n * sizeof *x);
+#endif
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+    call_kernel(
+#if USE_CUDA
+        dotu_func(gpu_result.handle(), n,
+                gpu_x, incx,
+                gpu_y, incy,
+                gpu_result)
+#else
+        dotu_func(n, gpu_result, gpu_result.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            scratch,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define dotu_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    call_kernel(dotu_func(b2c_handle, n, gpu_x, incx, gpu_y, incy, dotu));
+#define dotu_deferred_check(fname)\
+    resident_or_compute(fname, result, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_dotu(c, float _Complex) {
+    float _Complex result;
+    dotu_check(cdotu_);
+    _b2c_dotu(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(&result), false,
+#if USE_CUDA
+            &cublasCdotu
+#else
+            &clblasCdotu
+#endif
+            );
+    return result;
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_dotu(z, double _Complex) {
+    double _Complex result;
+    dotu_check(zdotu_);
+    _b2c_dotu(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(&result), false,
+#if USE_CUDA
+            &cublasZdotu
+#else
+            &clblasZdotu
+#endif
+            );
+    return result;
 }
 
+DEFERRED_dotu(c, float _Complex) {
+    dotu_deferred_check(cdotu_);
+    _b2c_dotu(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(result), true,
+#if USE_CUDA
+            &cublasCdotu
+#else
+            &clblasCdotu
+#endif
+            );
+}
+
+DEFERRED_dotu(z, double _Complex) {
+    dotu_deferred_check(zdotu_);
+    _b2c_dotu(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, cmplx_ptr(result), true,
+#if USE_CUDA
+            &cublasZdotu
+#else
+            &clblasZdotu
+#endif
+            );
+}
+
+// CBLAS wrappers
+
 DECLARE_CBLAS__DOTU(c, float _Complex) {
-    _cblas_dotu_sub(n, (const cuComplex *) x, incx,
-            (const cuComplex *) y, incy, (cuComplex *) dotu,
-            &cublasCdotu);
+    *dotu = cdotu_(&n, (float _Complex *) x, &incx, (float _Complex *) y, &incy);
 }
 
 DECLARE_CBLAS__DOTU(z, double _Complex) {
-    _cblas_dotu_sub(n, (const cuDoubleComplex *) x, incx,
-            (const cuDoubleComplex *) y, incy, (cuDoubleComplex *) dotu,
-            &cublasZdotu);
+    *dotu = zdotu_(&n, (double _Complex *) x, &incx, (double _Complex *) y, &incy);
 }
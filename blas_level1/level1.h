@@ -1,9 +1,16 @@
 #ifndef BLAS2CUDA_LEVEL1_H
 #define BLAS2CUDA_LEVEL1_H
 
-#include <ccomplex>
-#include "../blas2cuda.h"
-#include "../cblas.h"   /* this should come after the above */
-#include "../conversions.h"
+#include <complex.h>
+#include "../cblas.h"
+#include "../runtime-blas.h"
+
+/**
+ * The 0-based CBLAS index of the 1-based index {@i} returned by i?amax and
+ * i?amin, which return 0 for empty vectors.
+ */
+static inline CBLAS_INDEX cblas_index(const int i) {
+    return i > 0 ? i - 1 : 0;
+}
 
 #endif
@@ -1,54 +1,173 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-
-template <typename T, typename R>
-static void _cblas_nrm2(const int n,
-        const T *x,
-        const int incx,
-        R *result,
-        cublasStatus_t nrm2_func(cublasHandle_t, int, const T *, int, R *))
-{
-    const T *gpu_x;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *x_info;
-    extern cublasHandle_t b2c_handle;
+#include "../deferred.h"
+#include "../runtime-mem.hpp"
 
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-    call_kernel(nrm2_func(b2c_handle, n, gpu_x, incx, result));
+template <typename T, typename S>
+#if USE_CUDA
+using nrm2_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const T *, int,
+            S *);
+#else
+using nrm2_t = clblasStatus (*)(size_t N,
+        cl_mem NRM2, size_t offNRM2,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+template <typename T, typename S>
+void _b2c_nrm2(const int n,
+        const T *x, const int incx,
+        S *result, bool deferred,
+        nrm2_t<T,S> nrm2_func)
+{
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    devscalar<S> gpu_result(result, deferred);
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, 2 * n * sizeof *x);
+#endif
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+    call_kernel(
+#if USE_CUDA
+        nrm2_func(gpu_result.handle(), n, gpu_x, incx, gpu_result)
+#else
+        nrm2_func(n, gpu_result, gpu_result.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            scratch,
+            b2c_queue_args())
+#endif
+    );
 }
 
-DECLARE_CBLAS__NRM2(s, float) {
+#define nrm2_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0, (x), n, x, incx)
+
+#define nrm2_deferred_check(fname)\
+    resident_or_compute(fname, result, *n > 0 && *incx > 0, (x), n, x, incx)
+
+F77_nrm2(s, float, float) {
     float result;
-    _cblas_nrm2(n, x, incx, &result, &cublasSnrm2);
+    nrm2_check(snrm2_);
+    _b2c_nrm2(*n, x, *incx, &result, false,
+#if USE_CUDA
+            &cublasSnrm2
+#else
+            &clblasSnrm2
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__NRM2(d, double) {
-    double result;
-    _cblas_nrm2(n, x, incx, &result, &cublasDnrm2);
+F77_nrm2(sc, float, float _Complex) {
+    float result;
+    nrm2_check(scnrm2_);
+    _b2c_nrm2(*n, cmplx_ptr(x), *incx, &result, false,
+#if USE_CUDA
+            &cublasScnrm2
+#else
+            &clblasScnrm2
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__NRM2(sc, float _Complex) {
-    float result;
-    _cblas_nrm2(n, (const cuComplex *) x, incx, &result, &cublasScnrm2);
+F77_nrm2(d, double, double) {
+    double result;
+    nrm2_check(dnrm2_);
+    _b2c_nrm2(*n, x, *incx, &result, false,
+#if USE_CUDA
+            &cublasDnrm2
+#else
+            &clblasDnrm2
+#endif
+            );
     return result;
 }
 
-DECLARE_CBLAS__NRM2(dz, double _Complex) {
+F77_nrm2(dz, double, double _Complex) {
     double result;
-    _cblas_nrm2(n, (const cuDoubleComplex *) x, incx, &result, &cublasDznrm2);
+    nrm2_check(dznrm2_);
+    _b2c_nrm2(*n, cmplx_ptr(x), *incx, &result, false,
+#if USE_CUDA
+            &cublasDznrm2
+#else
+            &clblasDznrm2
+#endif
+            );
     return result;
 }
 
+DEFERRED_nrm2(s, float, float) {
+    nrm2_deferred_check(snrm2_);
+    _b2c_nrm2(*n, x, *incx, result, true,
+#if USE_CUDA
+            &cublasSnrm2
+#else
+            &clblasSnrm2
+#endif
+            );
+}
+
+DEFERRED_nrm2(sc, float, float _Complex) {
+    nrm2_deferred_check(scnrm2_);
+    _b2c_nrm2(*n, cmplx_ptr(x), *incx, result, true,
+#if USE_CUDA
+            &cublasScnrm2
+#else
+            &clblasScnrm2
+#endif
+            );
+}
+
+DEFERRED_nrm2(d, double, double) {
+    nrm2_deferred_check(dnrm2_);
+    _b2c_nrm2(*n, x, *incx, result, true,
+#if USE_CUDA
+            &cublasDnrm2
+#else
+            &clblasDnrm2
+#endif
+            );
+}
+
+DEFERRED_nrm2(dz, double, double _Complex) {
+    nrm2_deferred_check(dznrm2_);
+    _b2c_nrm2(*n, cmplx_ptr(x), *incx, result, true,
+#if USE_CUDA
+            &cublasDznrm2
+#else
+            &clblasDznrm2
+#endif
+            );
+}
+
+// CBLAS wrappers
+
+DECLARE_CBLAS__NRM2(s, float, float) {
+    return snrm2_(&n, (float *) x, &incx);
+}
+
+DECLARE_CBLAS__NRM2(d, double, double) {
+    return dnrm2_(&n, (double *) x, &incx);
+}
+
+DECLARE_CBLAS__NRM2(sc, float, float _Complex) {
+    return scnrm2_(&n, (float _Complex *) x, &incx);
+}
+
+DECLARE_CBLAS__NRM2(dz, double, double _Complex) {
+    return dznrm2_(&n, (double _Complex *) x, &incx);
+}
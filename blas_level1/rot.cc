@@ -1,61 +1,121 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-template <typename T, typename T2>
-static void _cblas_rot (const int n,
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T, typename S>
+#if USE_CUDA
+using rot_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            T *, int,
+            T *, int,
+            const S *, const S *);
+#else
+using rot_t = clblasStatus (*)(size_t N,
+        cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        S C, S S_,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_rot(const int n,
         T *x, const int incx,
         T *y, const int incy,
-        const T2 *c, const T2 *s,
-        cublasStatus_t rot_func(cublasHandle_t, int, 
-            T *, int, 
-            T *, int, 
-            const T2 *, const T2 *))
+        const S c, const S s,
+        rot_t<T,S> rot_func)
 {
-    T *gpu_x, *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
-    extern cublasHandle_t b2c_handle;
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+    call_kernel(
+#if USE_CUDA
+        rot_func(b2c_cublas_handle, n,
+                gpu_x, incx,
+                gpu_y, incy,
+                &c, &s)
+#else
+        rot_func(n,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            c, s,
+            b2c_queue_args())
+#endif
+    );
+}
 
-    call_kernel(rot_func(b2c_handle, n, gpu_x, incx, gpu_y, incy, c, s));
+#define rot_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy, c, s)
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_rot(s, float, float) {
+    rot_check(srot_);
+    _b2c_rot(*n, sx, *incx, sy, *incy, *c, *s,
+#if USE_CUDA
+            &cublasSrot
+#else
+            &clblasSrot
+#endif
+            );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_rot(d, double, double) {
+    rot_check(drot_);
+    _b2c_rot(*n, sx, *incx, sy, *incy, *c, *s,
+#if USE_CUDA
+            &cublasDrot
+#else
+            &clblasDrot
+#endif
+            );
+}
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_rot(cs, float, float _Complex) {
+    rot_check(csrot_);
+    _b2c_rot(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, *c, *s,
+#if USE_CUDA
+            &cublasCsrot
+#else
+            &clblasCsrot
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_rot(zd, double, double _Complex) {
+    rot_check(zdrot_);
+    _b2c_rot(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy, *c, *s,
+#if USE_CUDA
+            &cublasZdrot
+#else
+            &clblasZdrot
+#endif
+            );
 }
 
+// CBLAS wrappers
+
 DECLARE_CBLAS__ROT(s, float, float) {
-    _cblas_rot(n, x, incx, y, incy, &c, &s, &cublasSrot);
+    srot_(&n, x, &incx, y, &incy, (float *) &c, (float *) &s);
 }
 
 DECLARE_CBLAS__ROT(d, double, double) {
-    _cblas_rot(n, x, incx, y, incy, &c, &s, &cublasDrot);
+    drot_(&n, x, &incx, y, &incy, (double *) &c, (double *) &s);
 }
 
 DECLARE_CBLAS__ROT(cs, float _Complex, float) {
-    _cblas_rot(n, (cuComplex *) x, incx, (cuComplex *) y, incy, &c, &s,
-            &cublasCsrot);
+    csrot_(&n, x, &incx, y, &incy, (float *) &c, (float *) &s);
 }
 
 DECLARE_CBLAS__ROT(zd, double _Complex, double) {
-    _cblas_rot(n, (cuDoubleComplex *) x, incx, (cuDoubleComplex *) y, incy, &c, &s,
-            &cublasZdrot);
+    zdrot_(&n, x, &incx, y, &incy, (double *) &c, (double *) &s);
 }
@@ -1,36 +1,116 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-void cblas_srotg (float *a, float *b, float *c, float *s) {
-    call_kernel(cublasSrotg(b2c_handle, a, b, c, s));
+template <typename T, typename S>
+#if USE_CUDA
+using rotg_t = cublasStatus_t (*)(cublasHandle_t,
+            T *, T *,
+            S *, T *);
+#else
+using rotg_t = clblasStatus (*)(cl_mem SA, size_t offSA,
+        cl_mem SB, size_t offSB,
+        cl_mem C, size_t offC,
+        cl_mem S_, size_t offS,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_rotg(T *a, T *b, S *c, T *s,
+        rotg_t<T,S> rotg_func)
+{
+    gpuptr<T> gpu_a(a, sizeof *a);
+    gpuptr<T> gpu_b(b, sizeof *b);
+    gpuptr<S> gpu_c(c, sizeof *c);
+    gpuptr<T> gpu_s(s, sizeof *s);
+
+    call_kernel(
+#if USE_CUDA
+        rotg_func(b2c_cublas_handle, gpu_a, gpu_b, gpu_c, gpu_s)
+#else
+        rotg_func(gpu_a, gpu_a.offset(), gpu_b, gpu_b.offset(),
+            gpu_c, gpu_c.offset(), gpu_s, gpu_s.offset(),
+            b2c_queue_args())
+#endif
+    );
 }
 
-void cblas_drotg (double *a, double *b, double *c, double *s) {
-    call_kernel(cublasDrotg(b2c_handle, a, b, c, s));
+/*
+ * This is scalar work, so it is only worth running on the device if the
+ * operands are there already (e.g. inside a vector of Givens rotations).
+ */
+#define rotg_check(fname)\
+    resident_or_forward(fname, true, (sa, sb, c, s), sa, sb, c, s)
+
+F77_rotg(s, float, float) {
+    rotg_check(srotg_);
+    _b2c_rotg(sa, sb, c, s,
+#if USE_CUDA
+            &cublasSrotg
+#else
+            &clblasSrotg
+#endif
+            );
 }
 
-void cblas_crotg (float _Complex *a,
-        const float _Complex *b, 
-        float *c, float _Complex *s) {
-    cuComplex b_tmp = cu(*b);
-    call_kernel(cublasCrotg(b2c_handle, (cuComplex *) a, &b_tmp, c, (cuComplex *) s));
+F77_rotg(d, double, double) {
+    rotg_check(drotg_);
+    _b2c_rotg(sa, sb, c, s,
+#if USE_CUDA
+            &cublasDrotg
+#else
+            &clblasDrotg
+#endif
+            );
 }
 
-void cblas_zrotg (double _Complex *a, 
-        const double _Complex *b, 
-        double *c,
-        double _Complex *s) {
-    cuDoubleComplex b_tmp = cu(*b);
-    call_kernel(
-        cublasZrotg(b2c_handle, (cuDoubleComplex *) a, &b_tmp, c,
-                (cuDoubleComplex *) s)
-    );
+F77_rotg(c, float, float _Complex) {
+    rotg_check(crotg_);
+    _b2c_rotg(cmplx_ptr(sa), cmplx_ptr(sb), c, cmplx_ptr(s),
+#if USE_CUDA
+            &cublasCrotg
+#else
+            &clblasCrotg
+#endif
+            );
+}
+
+F77_rotg(z, double, double _Complex) {
+    rotg_check(zrotg_);
+    _b2c_rotg(cmplx_ptr(sa), cmplx_ptr(sb), c, cmplx_ptr(s),
+#if USE_CUDA
+            &cublasZrotg
+#else
+            &clblasZrotg
+#endif
+            );
 }
 
+// CBLAS wrappers
+
+void cblas_srotg(float *a, float *b, float *c, float *s) {
+    srotg_(a, b, c, s);
+}
+
+void cblas_drotg(double *a, double *b, double *c, double *s) {
+    drotg_(a, b, c, s);
+}
+
+void cblas_crotg(float _Complex *a, const float _Complex *b, float *c, float _Complex *s) {
+    crotg_(a, (float _Complex *) b, c, s);
+}
+
+void cblas_zrotg(double _Complex *a, const double _Complex *b, double *c, double _Complex *s) {
+    zrotg_(a, (double _Complex *) b, c, s);
+}
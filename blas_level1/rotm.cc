@@ -1,56 +1,101 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T>
+#if USE_CUDA
+using rotm_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            T *, int,
+            T *, int,
+            const T *);
+#else
+using rotm_t = clblasStatus (*)(size_t N,
+        cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        const cl_mem SPARAM, size_t offSparam,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
 template <typename T>
-static void _cblas_rotm (const int n,
+void _b2c_rotm(const int n,
         T *x, const int incx,
         T *y, const int incy,
         const T *param,
-        cublasStatus_t rotm_func(cublasHandle_t, int, T *, int, T *, int, const T *))
+        rotm_t<T> rotm_func)
 {
-    T *gpu_x, *gpu_y;
-    const struct objinfo *x_info, *y_info;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    extern cublasHandle_t b2c_handle;
-
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
-
-    call_kernel(rotm_func(b2c_handle, n, gpu_x, incx, gpu_y, incy, param));
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+#if USE_OPENCL
+    gpuptr<const T> gpu_param(param, 5 * sizeof *param);
+#endif
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+    call_kernel(
+#if USE_CUDA
+        rotm_func(b2c_cublas_handle, n,
+                gpu_x, incx,
+                gpu_y, incy,
+                param)
+#else
+        rotm_func(n,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_param, gpu_param.offset(),
+            b2c_queue_args())
+#endif
+    );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+/* a flag of -2 means H is the identity */
+#define rotm_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0 && sparam[0] != -2,\
+            (sx, sy), n, sx, incx, sy, incy, sparam)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_rotm(s, float) {
+    rotm_check(srotm_);
+    _b2c_rotm(*n, sx, *incx, sy, *incy, sparam,
+#if USE_CUDA
+            &cublasSrotm
+#else
+            &clblasSrotm
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_rotm(d, double) {
+    rotm_check(drotm_);
+    _b2c_rotm(*n, sx, *incx, sy, *incy, sparam,
+#if USE_CUDA
+            &cublasDrotm
+#else
+            &clblasDrotm
+#endif
+            );
 }
 
-void cblas_srotm (const int n,
-        float *x, const int incx, 
-        float *y, const int incy, 
-        const float *param)
-{
-    _cblas_rotm(n, x, incx, y, incy, param, &cublasSrotm);
+// CBLAS wrappers
+
+void cblas_srotm(const int n,
+        float *x, const int incx,
+        float *y, const int incy,
+        const float *param) {
+    srotm_(&n, x, &incx, y, &incy, (float *) param);
 }
 
-void cblas_drotm (const int n, 
-        double *x, const int incx, 
-        double *y, const int incy, 
-        const double *param)
-{
-    _cblas_rotm(n, x, incx, y, incy, param, &cublasDrotm);
+void cblas_drotm(const int n,
+        double *x, const int incx,
+        double *y, const int incy,
+        const double *param) {
+    drotm_(&n, x, &incx, y, &incy, (double *) param);
 }
@@ -1,28 +1,88 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-void cblas_srotmg (float *d1, 
-        float *d2, 
-        float *x1, 
-        const float y1, 
-        float *param)
+template <typename T>
+#if USE_CUDA
+using rotmg_t = cublasStatus_t (*)(cublasHandle_t,
+            T *, T *,
+            T *, const T *,
+            T *);
+#else
+using rotmg_t = clblasStatus (*)(cl_mem SD1, size_t offSD1,
+        cl_mem SD2, size_t offSD2,
+        cl_mem SX1, size_t offSX1,
+        const cl_mem SY1, size_t offSY1,
+        cl_mem SPARAM, size_t offSparam,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_rotmg(T *d1, T *d2, T *x1, const T *y1, T *param,
+        rotmg_t<T> rotmg_func)
 {
-    call_kernel(cublasSrotmg(b2c_handle, d1, d2, x1, &y1, param));
+    gpuptr<T> gpu_d1(d1, sizeof *d1);
+    gpuptr<T> gpu_d2(d2, sizeof *d2);
+    gpuptr<T> gpu_x1(x1, sizeof *x1);
+    gpuptr<const T> gpu_y1(y1, sizeof *y1);
+    gpuptr<T> gpu_param(param, 5 * sizeof *param);
+
+    call_kernel(
+#if USE_CUDA
+        rotmg_func(b2c_cublas_handle, gpu_d1, gpu_d2, gpu_x1, gpu_y1, gpu_param)
+#else
+        rotmg_func(gpu_d1, gpu_d1.offset(), gpu_d2, gpu_d2.offset(),
+            gpu_x1, gpu_x1.offset(), gpu_y1, gpu_y1.offset(),
+            gpu_param, gpu_param.offset(),
+            b2c_queue_args())
+#endif
+    );
 }
 
-void cblas_drotmg (double *d1, 
-        double *d2, 
-        double *x1, 
-        const double y1, 
-        double *param)
-{
-    call_kernel(cublasDrotmg(b2c_handle, d1, d2, x1, &y1, param));
+/* see rotg.cc */
+#define rotmg_check(fname)\
+    resident_or_forward(fname, true, (sd1, sd2, sx1, sy1, sparam),\
+            sd1, sd2, sx1, sy1, sparam)
+
+F77_rotmg(s, float) {
+    rotmg_check(srotmg_);
+    _b2c_rotmg(sd1, sd2, sx1, sy1, sparam,
+#if USE_CUDA
+            &cublasSrotmg
+#else
+            &clblasSrotmg
+#endif
+            );
+}
+
+F77_rotmg(d, double) {
+    rotmg_check(drotmg_);
+    _b2c_rotmg(sd1, sd2, sx1, sy1, sparam,
+#if USE_CUDA
+            &cublasDrotmg
+#else
+            &clblasDrotmg
+#endif
+            );
 }
 
+// CBLAS wrappers
+
+void cblas_srotmg(float *d1, float *d2, float *x1, const float y1, float *param) {
+    srotmg_(d1, d2, x1, (float *) &y1, param);
+}
+
+void cblas_drotmg(double *d1, double *d2, double *x1, const double y1, double *param) {
+    drotmg_(d1, d2, x1, (double *) &y1, param);
+}
@@ -1,60 +1,144 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
-
-extern cublasHandle_t b2c_handle;
-
-template <typename A, typename V>
-void _cblas_scal (const int n,
-        const A a,
-        V *x,
-        const int incx,
-        cublasStatus_t scal_func(cublasHandle_t, int, 
-            const A *, 
-            V *, int))
+#include "../runtime-mem.hpp"
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
+
+template <typename T, typename S>
+#if USE_CUDA
+using scal_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            const S *,
+            T *, int);
+#else
+using scal_t = clblasStatus (*)(size_t N,
+        S alpha,
+        cl_mem X, size_t offx, int incx,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_scal(const int n,
+        const S alpha,
+        T *x, const int incx,
+        scal_t<T,S> scal_func)
 {
-    V *gpu_x;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *x_info;
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+
+    call_kernel(
+#if USE_CUDA
+        scal_func(b2c_cublas_handle, n,
+                &alpha,
+                gpu_x, incx)
+#else
+        scal_func(n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define scal_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0, (sx), n, sa, sx, incx)
 
-    gpu_x = (V *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
+F77_scal(s, float, float) {
+    scal_check(sscal_);
+    _b2c_scal(*n, *sa, sx, *incx,
+#if USE_CUDA
+            &cublasSscal
+#else
+            &clblasSscal
+#endif
+            );
+}
 
-    call_kernel(scal_func(b2c_handle, n, &a, gpu_x, incx));
+F77_scal(d, double, double) {
+    scal_check(dscal_);
+    _b2c_scal(*n, *sa, sx, *incx,
+#if USE_CUDA
+            &cublasDscal
+#else
+            &clblasDscal
+#endif
+            );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_scal(c, float _Complex, float _Complex) {
+    scal_check(cscal_);
+    _b2c_scal(*n, cu(*sa), cmplx_ptr(sx), *incx,
+#if USE_CUDA
+            &cublasCscal
+#else
+            &clblasCscal
+#endif
+            );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_scal(z, double _Complex, double _Complex) {
+    scal_check(zscal_);
+    _b2c_scal(*n, cu(*sa), cmplx_ptr(sx), *incx,
+#if USE_CUDA
+            &cublasZscal
+#else
+            &clblasZscal
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_scal(cs, float, float _Complex) {
+    scal_check(csscal_);
+    _b2c_scal(*n, *sa, cmplx_ptr(sx), *incx,
+#if USE_CUDA
+            &cublasCsscal
+#else
+            &clblasCsscal
+#endif
+            );
 }
 
-DECLARE_CBLAS__SCAL(s, float, float) {
-    _cblas_scal(n, a, x, incx, &cublasSscal);
+F77_scal(zd, double, double _Complex) {
+    scal_check(zdscal_);
+    _b2c_scal(*n, *sa, cmplx_ptr(sx), *incx,
+#if USE_CUDA
+            &cublasZdscal
+#else
+            &clblasZdscal
+#endif
+            );
 }
 
-DECLARE_CBLAS__SCAL(d, double, double) {
-    _cblas_scal(n, a, x, incx, &cublasDscal);
+// CBLAS wrappers
+
+DECLARE_CBLAS__SCAL(s, float, const float) {
+    sscal_(&n, (float *) &a, x, &incx);
 }
 
-DECLARE_CBLAS__SCAL(c, float _Complex, float _Complex) {
-    _cblas_scal(n, cu(a), (cuComplex *) x, incx, &cublasCscal);
+DECLARE_CBLAS__SCAL(d, double, const double) {
+    dscal_(&n, (double *) &a, x, &incx);
 }
 
-DECLARE_CBLAS__SCAL(z, double _Complex, double _Complex) {
-    _cblas_scal(n, cu(a), (cuDoubleComplex *) x, incx, &cublasZscal);
+DECLARE_CBLAS__SCAL(c, float _Complex, const float _Complex *) {
+    cscal_(&n, (float _Complex *) a, x, &incx);
 }
 
-DECLARE_CBLAS__SCAL(cs, float _Complex, float) {
-    _cblas_scal(n, a, (cuComplex *)x, incx, &cublasCsscal);
+DECLARE_CBLAS__SCAL(z, double _Complex, const double _Complex *) {
+    zscal_(&n, (double _Complex *) a, x, &incx);
 }
 
-DECLARE_CBLAS__SCAL(zd, double _Complex, double) {
-    _cblas_scal(n, a, (cuDoubleComplex *) x, incx, &cublasZdscal);
+DECLARE_CBLAS__SCAL(cs, float _Complex, const float) {
+    csscal_(&n, (float *) &a, x, &incx);
 }
 
+DECLARE_CBLAS__SCAL(zd, double _Complex, const double) {
+    zdscal_(&n, (double *) &a, x, &incx);
+}
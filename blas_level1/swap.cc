@@ -1,42 +1,116 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level1.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
 template <typename T>
-static void _cblas_swap (const int n,
+#if USE_CUDA
+using swap_t = cublasStatus_t (*)(cublasHandle_t,
+            int,
+            T *, int,
+            T *, int);
+#else
+using swap_t = clblasStatus (*)(size_t N,
+        cl_mem X, size_t offx, int incx,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_swap(const int n,
         T *x, const int incx,
         T *y, const int incy,
-        cublasStatus_t swap_func(cublasHandle_t, int,
-            T *, int,
-            T *, int))
+        swap_t<T> swap_func)
 {
-    T *gpu_x, *gpu_y;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info;
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info, NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info, 
-            (void *) gpu_x, x_info,
-            NULL);
+    call_kernel(
+#if USE_CUDA
+        swap_func(b2c_cublas_handle, n,
+                gpu_x, incx,
+                gpu_y, incy)
+#else
+        swap_func(n,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
+    );
+}
 
-    call_kernel(swap_func(b2c_handle, n, gpu_x, incx, gpu_y, incy));
+#define swap_check(fname)\
+    resident_or_forward(fname, *n > 0 && *incx > 0 && *incy > 0,\
+            (sx, sy), n, sx, incx, sy, incy)
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_swap(s, float) {
+    swap_check(sswap_);
+    _b2c_swap(*n, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasSswap
+#else
+            &clblasSswap
+#endif
+            );
+}
+
+F77_swap(d, double) {
+    swap_check(dswap_);
+    _b2c_swap(*n, sx, *incx, sy, *incy,
+#if USE_CUDA
+            &cublasDswap
+#else
+            &clblasDswap
+#endif
+            );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_swap(c, float _Complex) {
+    swap_check(cswap_);
+    _b2c_swap(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasCswap
+#else
+            &clblasCswap
+#endif
+            );
+}
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_swap(z, double _Complex) {
+    swap_check(zswap_);
+    _b2c_swap(*n, cmplx_ptr(sx), *incx, cmplx_ptr(sy), *incy,
+#if USE_CUDA
+            &cublasZswap
+#else
+            &clblasZswap
+#endif
+            );
+}
+
+// CBLAS wrappers
+
+DECLARE_CBLAS__SWAP(s, float) {
+    sswap_(&n, x, &incx, y, &incy);
+}
+
+DECLARE_CBLAS__SWAP(d, double) {
+    dswap_(&n, x, &incx, y, &incy);
+}
+
+DECLARE_CBLAS__SWAP(c, float _Complex) {
+    cswap_(&n, x, &incx, y, &incy);
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+DECLARE_CBLAS__SWAP(z, double _Complex) {
+    zswap_(&n, x, &incx, y, &incy);
 }
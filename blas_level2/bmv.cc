@@ -1,125 +1,249 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-static void _cblas_hbmv(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+template <typename T, typename S>
+#if USE_CUDA
+using hbmv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int, int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            const S *,
+            T *, int);
+#else
+using hbmv_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N, size_t K,
+        S alpha,
+        const cl_mem A, size_t offa, size_t lda,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_hbmv(const CBLAS_UPLO uplo,
         const int n, const int k,
-        const T alpha,
+        const S alpha,
         const T *a, const int lda,
         const T *x, const int incx,
-        const T beta,
+        const S beta,
         T *y, const int incy,
-        cublasStatus_t hbmv_func(cublasHandle_t,
+        hbmv_t<T,S> hbmv_func)
+{
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+
+    call_kernel(
+#if USE_CUDA
+        hbmv_func(b2c_cublas_handle, cu(uplo),
+                n, k,
+                &alpha,
+                gpu_a, lda,
+                gpu_x, incx,
+                &beta,
+                gpu_y, incy)
+#else
+        hbmv_func(clblasColumnMajor, clb(uplo),
+            n, k,
+            alpha,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define hbmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *k >= 0 && *lda >= *k + 1\
+            && *incx > 0 && *incy > 0 && !(*alpha == 0 && *beta == 1),\
+            (a, x, y),\
+            uplo, n, k, alpha, a, lda, x, incx, beta, y, incy)
+
+F77_hbmv(c, float _Complex) {
+    hbmv_check(chbmv_);
+    _b2c_hbmv(c_uplo(*uplo),
+            *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasChbmv
+#else
+            &clblasChbmv
+#endif
+            );
+}
+
+F77_hbmv(z, double _Complex) {
+    hbmv_check(zhbmv_);
+    _b2c_hbmv(c_uplo(*uplo),
+            *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasZhbmv
+#else
+            &clblasZhbmv
+#endif
+            );
+}
+
+template <typename T, typename S>
+#if USE_CUDA
+using sbmv_t = cublasStatus_t (*)(cublasHandle_t,
             cublasFillMode_t,
             int, int,
-            const T *,
+            const S *,
             const T *, int,
             const T *, int,
-            const T *,
-            T *, int),
-        geam_t<T> geam_func)
+            const S *,
+            T *, int);
+#else
+using sbmv_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N, size_t K,
+        S alpha,
+        const cl_mem A, size_t offa, size_t lda,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_sbmv(const CBLAS_UPLO uplo,
+        const int n, const int k,
+        const S alpha,
+        const T *a, const int lda,
+        const T *x, const int incx,
+        const S beta,
+        T *y, const int incy,
+        sbmv_t<T,S> sbmv_func)
 {
-    const cublasFillMode_t fillmode = cu(uplo); 
-    const T *gpu_a, *gpu_x;
-    T *gpu_y;
-    const int size_a = size(1, n - 1, lda, sizeof(*a));
-    const int size_x = size(1, n - 1, incx, sizeof(*x));
-    const int size_y = size(1, n - 1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info, *a_info;
-    int rows_a, cols_a;
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, lda, geam_func);
-    } else {
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
     call_kernel(
-        hbmv_func(b2c_handle, fillmode,
+#if USE_CUDA
+        sbmv_func(b2c_cublas_handle, cu(uplo),
                 n, k,
                 &alpha,
                 gpu_a, lda,
                 gpu_x, incx,
                 &beta,
                 gpu_y, incy)
+#else
+        sbmv_func(clblasColumnMajor, clb(uplo),
+            n, k,
+            alpha,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
     );
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+}
+
+#define sbmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *k >= 0 && *lda >= *k + 1\
+            && *incx > 0 && *incy > 0 && !(*alpha == 0 && *beta == 1),\
+            (a, x, y),\
+            uplo, n, k, alpha, a, lda, x, incx, beta, y, incy)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_sbmv(s, float) {
+    sbmv_check(ssbmv_);
+    _b2c_sbmv(c_uplo(*uplo),
+            *n, *k,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasSsbmv
+#else
+            &clblasSsbmv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_sbmv(d, double) {
+    sbmv_check(dsbmv_);
+    _b2c_sbmv(c_uplo(*uplo),
+            *n, *k,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasDsbmv
+#else
+            &clblasDsbmv
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_hbmv(fname, cblas_fname, T)\
+do {\
+    char ul = f77_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (int *) &k, (T *) alpha, (T *) a, (int *) &lda,\
+            (T *) x, (int *) &incx, (T *) beta, y, (int *) &incy),\
+        runtime_blas_next(cblas_fname)(Layout, uplo, n, k, alpha, a, lda,\
+            x, incx, beta, y, incy));\
+} while (0)
+
 DECLARE_CBLAS__HBMV(c, float _Complex) {
-    _cblas_hbmv(Layout, uplo,
-            n, k,
-            *(cuComplex *) alpha,
-            (cuComplex *) a, lda,
-            (cuComplex *) x, incx,
-            *(cuComplex *) beta,
-            (cuComplex *) y, incy,
-            &cublasChbmv,
-            &cublasCgeam);
+    cblas_hbmv(chbmv_, cblas_chbmv, float _Complex);
 }
 
 DECLARE_CBLAS__HBMV(z, double _Complex) {
-    _cblas_hbmv(Layout, uplo,
-            n, k,
-            *(cuDoubleComplex *) alpha,
-            (cuDoubleComplex *) a, lda,
-            (cuDoubleComplex *) x, incx,
-            *(cuDoubleComplex *) beta,
-            (cuDoubleComplex *) y, incy,
-            &cublasZhbmv,
-            &cublasZgeam);
+    cblas_hbmv(zhbmv_, cblas_zhbmv, double _Complex);
 }
 
+#define cblas_sbmv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (int *) &k, (T *) &alpha, (T *) a, (int *) &lda,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy),\
+        fname(&rul, (int *) &n, (int *) &k, (T *) &alpha, (T *) a, (int *) &lda,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy));\
+} while (0)
 
 DECLARE_CBLAS__SBMV(s, float) {
-    _cblas_hbmv(Layout, uplo,
-            n, k,
-            alpha,
-            a, lda,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasSsbmv,
-            &cublasSgeam);
+    cblas_sbmv(ssbmv_, float);
 }
 
-
 DECLARE_CBLAS__SBMV(d, double) {
-    _cblas_hbmv(Layout, uplo,
-            n, k,
-            alpha,
-            a, lda,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasDsbmv,
-            &cublasDgeam);
-
+    cblas_sbmv(dsbmv_, double);
 }
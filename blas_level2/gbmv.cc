@@ -1,122 +1,182 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-void _cblas_gbmv (const CBLAS_LAYOUT Layout,
-        CBLAS_TRANSPOSE trans,
-        const int m, const int n,
-        const int kl, const int ku,
-        const T alpha,
-        const T *A, const int lda,
-        const T *x, const int incx,
-        const T beta,
-        T *y, const int incy,
-        cublasStatus_t gbmv_func(cublasHandle_t,
+template <typename T, typename S>
+#if USE_CUDA
+using gbmv_t = cublasStatus_t (*)(cublasHandle_t,
             cublasOperation_t,
             int, int, int, int,
-            const T *,
+            const S *,
             const T *, int,
             const T *, int,
-            const T *,
-            T *, int),
-        geam_t<T> geam_func)
-{
-    const T *gpu_A, *gpu_x;
-    T *gpu_y;
-    const int size_A = size(0, n, lda, sizeof(*A));
-    const int size_x = size(1, (trans == CblasNoTrans ? n : m) - 1, incx, sizeof(*x));
-    const int size_y = size(1, (trans == CblasNoTrans ? n : m) - 1, incy, sizeof(*y));
-    const struct objinfo *A_info, *x_info, *y_info;
-    int rows_A, cols_A;
-    cublasOperation_t op = cu(trans);
-
-    if (Layout == CblasRowMajor) {
-        /* create a new buffer that is the transpose matrix of A*/
+            const S *,
+            T *, int);
+#else
+using gbmv_t = clblasStatus (*)(clblasOrder order, clblasTranspose trans,
+        size_t M, size_t N, size_t KL, size_t KU,
+        S alpha,
+        const cl_mem A, size_t offa, size_t lda,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
-        A_info = NULL;
-        rows_A = m;
-        cols_A = n;
-
-        gpu_A = transpose(A, size_A, &rows_A, &cols_A, rows_A, geam_func);
-    } else {
-        gpu_A = (const T *) b2c_place_on_gpu((void *) A, size_A, &A_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_A, A_info,
-            NULL);
-    gpu_y = (T *) b2c_place_on_gpu(NULL, size_y, &y_info,
-            (void *) gpu_A, A_info,
-            (void *) gpu_x, x_info,
-            NULL);
+template <typename T, typename S>
+void _b2c_gbmv(const CBLAS_TRANSPOSE trans,
+        const int m, const int n,
+        const int kl, const int ku,
+        const S alpha,
+        const T *a, const int lda,
+        const T *x, const int incx,
+        const S beta,
+        T *y, const int incy,
+        gbmv_t<T,S> gbmv_func)
+{
+    const int lenx = trans == CblasNoTrans ? n : m;
+    const int leny = trans == CblasNoTrans ? m : n;
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<const T> gpu_x(x, size(1, lenx - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, leny - 1, incy, sizeof *y));
 
     call_kernel(
-        gbmv_func(b2c_handle, op,
-                m, n, kl, ku, 
-                &alpha, 
-                gpu_A, lda,
+#if USE_CUDA
+        gbmv_func(b2c_cublas_handle, cu(trans),
+                m, n, kl, ku,
+                &alpha,
+                gpu_a, lda,
                 gpu_x, incx,
                 &beta,
                 gpu_y, incy)
+#else
+        gbmv_func(clblasColumnMajor, clb(trans),
+            m, n, kl, ku,
+            alpha,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define gbmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_trans(trans) && *m > 0 && *n > 0 && *kl >= 0 && *ku >= 0\
+            && *lda >= *kl + *ku + 1 && *incx > 0 && *incy > 0\
+            && !(*alpha == 0 && *beta == 1),\
+            (a, x, y),\
+            trans, m, n, kl, ku, alpha, a, lda, x, incx, beta, y, incy)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_gbmv(s, float) {
+    gbmv_check(sgbmv_);
+    _b2c_gbmv(c_trans(*trans),
+            *m, *n, *kl, *ku,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasSgbmv
+#else
+            &clblasSgbmv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_A, A_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_gbmv(d, double) {
+    gbmv_check(dgbmv_);
+    _b2c_gbmv(c_trans(*trans),
+            *m, *n, *kl, *ku,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasDgbmv
+#else
+            &clblasDgbmv
+#endif
+            );
 }
 
-DECLARE_CBLAS__GBMV(s, float) {
-    _cblas_gbmv(Layout, trans, 
-            m, n, kl, ku, 
-            alpha, 
-            A, lda,
-            x, incx,
-            beta,
-            y, incy, &cublasSgbmv, &cublasSgeam);
+F77_gbmv(c, float _Complex) {
+    gbmv_check(cgbmv_);
+    _b2c_gbmv(c_trans(*trans),
+            *m, *n, *kl, *ku,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasCgbmv
+#else
+            &clblasCgbmv
+#endif
+            );
 }
 
-DECLARE_CBLAS__GBMV(d, double) {
-    _cblas_gbmv(Layout, trans, 
-            m, n, kl, ku, 
-            alpha, 
-            A, lda,
-            x, incx,
-            beta,
-            y, incy, &cublasDgbmv, &cublasDgeam);
+F77_gbmv(z, double _Complex) {
+    gbmv_check(zgbmv_);
+    _b2c_gbmv(c_trans(*trans),
+            *m, *n, *kl, *ku,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasZgbmv
+#else
+            &clblasZgbmv
+#endif
+            );
 }
 
-DECLARE_CBLAS__GBMV(c, float _Complex) {
-    _cblas_gbmv(Layout, trans, 
-            m, n, kl, ku, 
-            cu(alpha), 
-            (cuComplex *) A, lda,
-            (cuComplex *) x, incx,
-            cu(beta),
-            (cuComplex *) y, incy,
-            &cublasCgbmv, &cublasCgeam);
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_gbmv(fname, T, alpha_p, beta_p)\
+do {\
+    char t = f77_trans(trans), rt = f77_row_trans(trans);\
+    cblas_layout_dispatch(Layout,\
+        fname(&t, (int *) &m, (int *) &n, (int *) &kl, (int *) &ku, (T *) alpha_p,\
+            (T *) A, (int *) &lda, (T *) x, (int *) &incx, (T *) beta_p, y, (int *) &incy),\
+        fname(&rt, (int *) &n, (int *) &m, (int *) &ku, (int *) &kl, (T *) alpha_p,\
+            (T *) A, (int *) &lda, (T *) x, (int *) &incx, (T *) beta_p, y, (int *) &incy));\
+} while (0)
+
+DECLARE_CBLAS__GBMV(s, float, const float) {
+    cblas_gbmv(sgbmv_, float, &alpha, &beta);
 }
 
-DECLARE_CBLAS__GBMV(z, double _Complex) {
-    _cblas_gbmv(Layout, trans, 
-            m, n, kl, ku, 
-            cu(alpha), 
-            (cuDoubleComplex *) A, lda,
-            (cuDoubleComplex *) x, incx,
-            cu(beta),
-            (cuDoubleComplex *) y, incy, 
-            &cublasZgbmv, &cublasZgeam);
+DECLARE_CBLAS__GBMV(d, double, const double) {
+    cblas_gbmv(dgbmv_, double, &alpha, &beta);
 }
 
+DECLARE_CBLAS__GBMV(c, float _Complex, const float _Complex *) {
+    cblas_forward_rowmajor(cblas_cgbmv, trans == CblasConjTrans,
+            trans, m, n, kl, ku, alpha, A, lda, x, incx, beta, y, incy);
+    cblas_gbmv(cgbmv_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__GBMV(z, double _Complex, const double _Complex *) {
+    cblas_forward_rowmajor(cblas_zgbmv, trans == CblasConjTrans,
+            trans, m, n, kl, ku, alpha, A, lda, x, incx, beta, y, incy);
+    cblas_gbmv(zgbmv_, double _Complex, alpha, beta);
+}
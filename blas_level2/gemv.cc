@@ -1,118 +1,180 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-void _cblas_gemv (const CBLAS_LAYOUT Layout,
-        CBLAS_TRANSPOSE trans,
-        const int m, const int n,
-        const T alpha,
-        const T *A, const int lda,
-        const T *x, const int incx,
-        const T beta,
-        T *y, const int incy,
-        cublasStatus_t gemv_func(cublasHandle_t,
+template <typename T, typename S>
+#if USE_CUDA
+using gemv_t = cublasStatus_t (*)(cublasHandle_t,
             cublasOperation_t,
-            int, int, 
-            const T *,
+            int, int,
+            const S *,
             const T *, int,
             const T *, int,
-            const T *,
-            T *, int),
-        geam_t<T> geam_func)
-{
-    const T *gpu_A, *gpu_x;
-    T *gpu_y;
-    const int size_A = size(0, n, lda, sizeof(*A));
-    const int size_x = size(1, (trans == CblasNoTrans ? n : m) - 1, incx, sizeof(*x));
-    const int size_y = size(1, (trans == CblasNoTrans ? n : m) - 1, incy, sizeof(*y));
-    const struct objinfo *A_info, *x_info, *y_info;
-    int rows_A, cols_A;
-    cublasOperation_t op = cu(trans);
-
-    if (Layout == CblasRowMajor && trans == CblasConjTrans) {
-        /* create a new buffer that is the transpose matrix of A*/
-        A_info = NULL;
-        rows_A = m;
-        cols_A = n;
+            const S *,
+            T *, int);
+#else
+using gemv_t = clblasStatus (*)(clblasOrder order, clblasTranspose transA,
+        size_t M, size_t N,
+        S alpha,
+        const cl_mem A, size_t offA, size_t lda,
+        const cl_mem x, size_t offx, int incx,
+        S beta,
+        cl_mem y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
 
-        gpu_A = transpose(A, size_A, &rows_A, &cols_A, rows_A, geam_func);
-    } else {
-        gpu_A = (const T *) b2c_place_on_gpu((void *) A, size_A, &A_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_A, A_info,
-            NULL);
-    gpu_y = (T *) b2c_place_on_gpu(NULL, size_y, &y_info,
-            (void *) gpu_A, A_info,
-            (void *) gpu_x, x_info,
-            NULL);
+template <typename T, typename S>
+void _b2c_gemv(const CBLAS_TRANSPOSE trans,
+        const int m, const int n,
+        const S alpha,
+        const T *a, const int lda,
+        const T *x, const int incx,
+        const S beta,
+        T *y, const int incy,
+        gemv_t<T,S> gemv_func)
+{
+    const int lenx = trans == CblasNoTrans ? n : m;
+    const int leny = trans == CblasNoTrans ? m : n;
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<const T> gpu_x(x, size(1, lenx - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, leny - 1, incy, sizeof *y));
 
     call_kernel(
-        gemv_func(b2c_handle, op,
+#if USE_CUDA
+        gemv_func(b2c_cublas_handle, cu(trans),
                 m, n,
-                &alpha, 
-                gpu_A, lda,
+                &alpha,
+                gpu_a, lda,
                 gpu_x, incx,
                 &beta,
                 gpu_y, incy)
+#else
+        gemv_func(clblasColumnMajor, clb(trans),
+            m, n,
+            alpha,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define gemv_check(fname)\
+    resident_or_forward(fname,\
+            valid_trans(trans) && *m > 0 && *n > 0 && *lda >= std::max(1, *m)\
+            && *incx > 0 && *incy > 0 && !(*alpha == 0 && *beta == 1),\
+            (a, x, y),\
+            trans, m, n, alpha, a, lda, x, incx, beta, y, incy)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_gemv(s, float) {
+    gemv_check(sgemv_);
+    _b2c_gemv(c_trans(*trans),
+            *m, *n,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasSgemv
+#else
+            &clblasSgemv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_A, A_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_gemv(d, double) {
+    gemv_check(dgemv_);
+    _b2c_gemv(c_trans(*trans),
+            *m, *n,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasDgemv
+#else
+            &clblasDgemv
+#endif
+            );
+}
 
+F77_gemv(c, float _Complex) {
+    gemv_check(cgemv_);
+    _b2c_gemv(c_trans(*trans),
+            *m, *n,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasCgemv
+#else
+            &clblasCgemv
+#endif
+            );
 }
 
-DECLARE_CBLAS__GEMV(s, float) {
-    _cblas_gemv(Layout, trans, 
-            m, n, 
-            alpha, 
-            A, lda,
-            x, incx,
-            beta,
-            y, incy, &cublasSgemv, &cublasSgeam);
+F77_gemv(z, double _Complex) {
+    gemv_check(zgemv_);
+    _b2c_gemv(c_trans(*trans),
+            *m, *n,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasZgemv
+#else
+            &clblasZgemv
+#endif
+            );
 }
 
-DECLARE_CBLAS__GEMV(d, double) {
-    _cblas_gemv(Layout, trans, 
-            m, n, 
-            alpha, 
-            A, lda,
-            x, incx,
-            beta,
-            y, incy, &cublasDgemv, &cublasDgeam);
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_gemv(fname, T, alpha_p, beta_p)\
+do {\
+    char t = f77_trans(trans), rt = f77_row_trans(trans);\
+    cblas_layout_dispatch(Layout,\
+        fname(&t, (int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) A, (int *) &lda, (T *) x, (int *) &incx, (T *) beta_p, y, (int *) &incy),\
+        fname(&rt, (int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) A, (int *) &lda, (T *) x, (int *) &incx, (T *) beta_p, y, (int *) &incy));\
+} while (0)
+
+DECLARE_CBLAS__GEMV(s, float, const float) {
+    cblas_gemv(sgemv_, float, &alpha, &beta);
+}
+
+DECLARE_CBLAS__GEMV(d, double, const double) {
+    cblas_gemv(dgemv_, double, &alpha, &beta);
 }
 
-DECLARE_CBLAS__GEMV(c, float _Complex) {
-    _cblas_gemv(Layout, trans, 
-            m, n, 
-            cu(alpha), 
-            (cuComplex *) A, lda,
-            (cuComplex *) x, incx,
-            cu(beta),
-            (cuComplex *) y, incy, &cublasCgemv, &cublasCgeam);
+DECLARE_CBLAS__GEMV(c, float _Complex, const float _Complex *) {
+    cblas_forward_rowmajor(cblas_cgemv, trans == CblasConjTrans,
+            trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+    cblas_gemv(cgemv_, float _Complex, alpha, beta);
 }
 
-DECLARE_CBLAS__GEMV(z, double _Complex) {
-    _cblas_gemv(Layout, trans, 
-            m, n, 
-            cu(alpha), 
-            (cuDoubleComplex *) A, lda,
-            (cuDoubleComplex *) x, incx,
-            cu(beta),
-            (cuDoubleComplex *) y, incy, &cublasZgemv, &cublasZgeam);
+DECLARE_CBLAS__GEMV(z, double _Complex, const double _Complex *) {
+    cblas_forward_rowmajor(cblas_zgemv, trans == CblasConjTrans,
+            trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+    cblas_gemv(zgemv_, double _Complex, alpha, beta);
 }
@@ -1,134 +1,312 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-static void _cblas_ger(const CBLAS_LAYOUT Layout,
-        const int m, const int n,
-        const T alpha,
+template <typename T, typename S>
+#if USE_CUDA
+using ger_t = cublasStatus_t (*)(cublasHandle_t,
+            int, int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            T *, int);
+#else
+using ger_t = clblasStatus (*)(clblasOrder order,
+        size_t M, size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem A, size_t offa, size_t lda,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_ger(const int m, const int n,
+        const S alpha,
+        const T *x, const int incx,
+        const T *y, const int incy,
+        T *a, const int lda,
+        ger_t<T,S> ger_func)
+{
+    gpuptr<const T> gpu_x(x, size(1, m - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    gpuptr<T> gpu_a(a, size(0, lda, n, sizeof *a));
+
+    call_kernel(
+#if USE_CUDA
+        ger_func(b2c_cublas_handle,
+                m, n,
+                &alpha,
+                gpu_x, incx,
+                gpu_y, incy,
+                gpu_a, lda)
+#else
+        ger_func(clblasColumnMajor,
+            m, n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_a, gpu_a.offset(), lda,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define ger_check(fname)\
+    resident_or_forward(fname,\
+            *m > 0 && *n > 0 && *lda >= std::max(1, *m)\
+            && *incx > 0 && *incy > 0 && *alpha != 0,\
+            (a, x, y),\
+            m, n, alpha, x, incx, y, incy, a, lda)
+
+F77_ger(s, float) {
+    ger_check(sger_);
+    _b2c_ger(*m, *n,
+            *alpha,
+            x, *incx,
+            y, *incy,
+            a, *lda,
+#if USE_CUDA
+            &cublasSger
+#else
+            &clblasSger
+#endif
+            );
+}
+
+F77_ger(d, double) {
+    ger_check(dger_);
+    _b2c_ger(*m, *n,
+            *alpha,
+            x, *incx,
+            y, *incy,
+            a, *lda,
+#if USE_CUDA
+            &cublasDger
+#else
+            &clblasDger
+#endif
+            );
+}
+
+template <typename T, typename S>
+#if USE_CUDA
+using gerc_t = cublasStatus_t (*)(cublasHandle_t,
+            int, int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            T *, int);
+#else
+using gerc_t = clblasStatus (*)(clblasOrder order,
+        size_t M, size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem A, size_t offa, size_t lda,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_gerc(const int m, const int n,
+        const S alpha,
         const T *x, const int incx,
         const T *y, const int incy,
         T *a, const int lda,
-        cublasStatus_t ger_func(cublasHandle_t,
+        gerc_t<T,S> gerc_func)
+{
+    gpuptr<const T> gpu_x(x, size(1, m - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    gpuptr<T> gpu_a(a, size(0, lda, n, sizeof *a));
+
+    call_kernel(
+#if USE_CUDA
+        gerc_func(b2c_cublas_handle,
+                m, n,
+                &alpha,
+                gpu_x, incx,
+                gpu_y, incy,
+                gpu_a, lda)
+#else
+        gerc_func(clblasColumnMajor,
+            m, n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_a, gpu_a.offset(), lda,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define gerc_check(fname)\
+    resident_or_forward(fname,\
+            *m > 0 && *n > 0 && *lda >= std::max(1, *m)\
+            && *incx > 0 && *incy > 0 && *alpha != 0,\
+            (a, x, y),\
+            m, n, alpha, x, incx, y, incy, a, lda)
+
+F77_gerc(c, float _Complex) {
+    gerc_check(cgerc_);
+    _b2c_gerc(*m, *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasCgerc
+#else
+            &clblasCgerc
+#endif
+            );
+}
+
+F77_gerc(z, double _Complex) {
+    gerc_check(zgerc_);
+    _b2c_gerc(*m, *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasZgerc
+#else
+            &clblasZgerc
+#endif
+            );
+}
+
+template <typename T, typename S>
+#if USE_CUDA
+using geru_t = cublasStatus_t (*)(cublasHandle_t,
             int, int,
-            const T *,
+            const S *,
             const T *, int,
             const T *, int,
-            T *, int),
-        geam_t<T> geam_func)
+            T *, int);
+#else
+using geru_t = clblasStatus (*)(clblasOrder order,
+        size_t M, size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem A, size_t offa, size_t lda,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_geru(const int m, const int n,
+        const S alpha,
+        const T *x, const int incx,
+        const T *y, const int incy,
+        T *a, const int lda,
+        geru_t<T,S> geru_func)
 {
-    const T *gpu_x, *gpu_y;
-    T *gpu_a;
-    const int size_x = size(1, m - 1, incx, sizeof(*x));
-    const int size_y = size(1, m - 1, incy, sizeof(*y));
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const struct objinfo *x_info, *y_info, *a_info;
-    int rows_a, cols_a;
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = m;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = m;
-        cols_a = n;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-    gpu_y = (const T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
+    gpuptr<const T> gpu_x(x, size(1, m - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    gpuptr<T> gpu_a(a, size(0, lda, n, sizeof *a));
 
     call_kernel(
-        ger_func(b2c_handle, m, n,
-                &alpha, 
+#if USE_CUDA
+        geru_func(b2c_cublas_handle,
+                m, n,
+                &alpha,
                 gpu_x, incx,
                 gpu_y, incy,
                 gpu_a, lda)
+#else
+        geru_func(clblasColumnMajor,
+            m, n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_a, gpu_a.offset(), lda,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define geru_check(fname)\
+    resident_or_forward(fname,\
+            *m > 0 && *n > 0 && *lda >= std::max(1, *m)\
+            && *incx > 0 && *incy > 0 && *alpha != 0,\
+            (a, x, y),\
+            m, n, alpha, x, incx, y, incy, a, lda)
 
-    if (!a_info) {
-        if (Layout == CblasRowMajor)
-            transpose(gpu_a, size_a, &rows_a, &cols_a, lda, geam_func);
-        b2c_copy_from_gpu(a, gpu_a, size_a);
-    }
+F77_geru(c, float _Complex) {
+    geru_check(cgeru_);
+    _b2c_geru(*m, *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasCgeru
+#else
+            &clblasCgeru
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_geru(z, double _Complex) {
+    geru_check(zgeru_);
+    _b2c_geru(*m, *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasZgeru
+#else
+            &clblasZgeru
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_ger(fname, T, alpha_p)\
+    cblas_layout_dispatch(Layout,\
+        fname((int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) x, (int *) &incx, (T *) y, (int *) &incy, a, (int *) &lda),\
+        fname((int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) y, (int *) &incy, (T *) x, (int *) &incx, a, (int *) &lda))
+
 DECLARE_CBLAS__GER(s, float) {
-    _cblas_ger(Layout, m, n,
-            alpha,
-            x, incx,
-            y, incy,
-            a, lda,
-            &cublasSger,
-            &cublasSgeam);
+    cblas_ger(sger_, float, &alpha);
 }
 
 DECLARE_CBLAS__GER(d, double) {
-    _cblas_ger(Layout, m, n,
-            alpha,
-            x, incx,
-            y, incy,
-            a, lda,
-            &cublasDger,
-            &cublasDgeam);
+    cblas_ger(dger_, double, &alpha);
 }
 
 DECLARE_CBLAS__GERC(c, float _Complex) {
-    _cblas_ger(Layout, m, n,
-            *(cuComplex *) alpha,
-            (cuComplex *) x, incx,
-            (cuComplex *) y, incy,
-            (cuComplex *) a, lda,
-            &cublasCgerc,
-            &cublasCgeam);
+    cblas_forward_rowmajor(cblas_cgerc, true, m, n, alpha, x, incx, y, incy, a, lda);
+    cblas_ger(cgerc_, float _Complex, alpha);
 }
 
 DECLARE_CBLAS__GERC(z, double _Complex) {
-    _cblas_ger(Layout, m, n,
-            *(cuDoubleComplex *) alpha,
-            (cuDoubleComplex *) x, incx,
-            (cuDoubleComplex *) y, incy,
-            (cuDoubleComplex *) a, lda,
-            &cublasZgerc,
-            &cublasZgeam);
+    cblas_forward_rowmajor(cblas_zgerc, true, m, n, alpha, x, incx, y, incy, a, lda);
+    cblas_ger(zgerc_, double _Complex, alpha);
 }
 
 DECLARE_CBLAS__GERU(c, float _Complex) {
-    _cblas_ger(Layout, m, n,
-            *(cuComplex *) alpha,
-            (cuComplex *) x, incx,
-            (cuComplex *) y, incy,
-            (cuComplex *) a, lda,
-            &cublasCgeru,
-            &cublasCgeam);
+    cblas_ger(cgeru_, float _Complex, alpha);
 }
 
 DECLARE_CBLAS__GERU(z, double _Complex) {
-    _cblas_ger(Layout, m, n,
-            *(cuDoubleComplex *) alpha,
-            (cuDoubleComplex *) x, incx,
-            (cuDoubleComplex *) y, incy,
-            (cuDoubleComplex *) a, lda,
-            &cublasZgeru,
-            &cublasZgeam);
+    cblas_ger(zgeru_, double _Complex, alpha);
 }
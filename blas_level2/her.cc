@@ -1,91 +1,115 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename S, typename T>
-static void _cblas_her(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+template <typename T, typename S>
+#if USE_CUDA
+using her_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
+            const T *, int,
+            T *, int);
+#else
+using her_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        cl_mem A, size_t offa, size_t lda,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_her(const CBLAS_UPLO uplo,
         const int n,
         const S alpha,
         const T *x, const int incx,
         T *a, const int lda,
-        cublasStatus_t her_func(cublasHandle_t,
-            cublasFillMode_t,
-            int, const S *,
-            const T *, int,
-            T *, int),
-        geam_t<T> geam_func, T geam_alpha, T geam_beta)
+        her_t<T,S> her_func)
 {
-    T *gpu_a;
-    const T *gpu_x;
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *a_info, *x_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = lda;
-        cols_a = n;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_a(a, size(0, lda, n, sizeof *a));
 
     call_kernel(
-        her_func(b2c_handle, fillmode, 
-                n, &alpha,
+#if USE_CUDA
+        her_func(b2c_cublas_handle, cu(uplo),
+                n,
+                &alpha,
                 gpu_x, incx,
                 gpu_a, lda)
+#else
+        her_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_a, gpu_a.offset(), lda,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define her_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *lda >= std::max(1, *n)\
+            && *incx > 0 && *alpha != 0,\
+            (a, x),\
+            uplo, n, alpha, x, incx, a, lda)
 
-    if (!a_info) {
-        if (Layout == CblasRowMajor)
-            transpose(gpu_a, size_a, &rows_a, &cols_a, lda, geam_func);
-        b2c_copy_from_gpu(a, gpu_a, size_a);
-    }
+F77_her(c, float, float _Complex) {
+    her_check(cher_);
+    _b2c_her(c_uplo(*uplo),
+            *n,
+            *alpha,
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasCher
+#else
+            &clblasCher
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_her(z, double, double _Complex) {
+    her_check(zher_);
+    _b2c_her(c_uplo(*uplo),
+            *n,
+            *alpha,
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasZher
+#else
+            &clblasZher
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_her(fname, cblas_fname, S, T)\
+do {\
+    char ul = f77_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (S *) &alpha, (T *) x, (int *) &incx, a, (int *) &lda),\
+        runtime_blas_next(cblas_fname)(Layout, uplo, n, alpha, x, incx, a, lda));\
+} while (0)
+
 DECLARE_CBLAS__HER(c, float, float _Complex) {
-    float _Complex _alpha = 1.0;
-    float _Complex _beta = 0.0;
-    _cblas_her(Layout, uplo,
-            n, alpha,
-            (cuComplex *) x, incx,
-            (cuComplex *) a, lda,
-            &cublasCher,
-            &cublasCgeam,
-            cu(_alpha), cu(_beta));
+    cblas_her(cher_, cblas_cher, float, float _Complex);
 }
 
 DECLARE_CBLAS__HER(z, double, double _Complex) {
-    double _Complex _alpha = 1.0;
-    double _Complex _beta = 0.0;
-    _cblas_her(Layout, uplo,
-            n, alpha,
-            (cuDoubleComplex *) x, incx,
-            (cuDoubleComplex *) a, lda,
-            &cublasZher,
-            &cublasZgeam,
-            cu(_alpha), cu(_beta));
+    cblas_her(zher_, cblas_zher, double, double _Complex);
 }
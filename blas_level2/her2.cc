@@ -1,104 +1,124 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-static void _cblas_her2(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+template <typename T, typename S>
+#if USE_CUDA
+using her2_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            T *, int);
+#else
+using her2_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem A, size_t offa, size_t lda,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_her2(const CBLAS_UPLO uplo,
         const int n,
-        const T alpha,
+        const S alpha,
         const T *x, const int incx,
         const T *y, const int incy,
         T *a, const int lda,
-        cublasStatus_t her2_func(cublasHandle_t,
-            cublasFillMode_t,
-            int, const T *,
-            const T *, int,
-            const T *, int,
-            T *, int),
-        geam_t<T> geam_func, T geam_alpha, T geam_beta)
+        her2_t<T,S> her2_func)
 {
-    T *gpu_a;
-    const T *gpu_x, *gpu_y;
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *a_info, *x_info, *y_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = lda;
-        cols_a = n;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-
-    gpu_y = (const T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
-
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    gpuptr<T> gpu_a(a, size(0, lda, n, sizeof *a));
 
     call_kernel(
-        her2_func(b2c_handle, fillmode, 
-                n, &alpha,
+#if USE_CUDA
+        her2_func(b2c_cublas_handle, cu(uplo),
+                n,
+                &alpha,
                 gpu_x, incx,
                 gpu_y, incy,
                 gpu_a, lda)
+#else
+        her2_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_a, gpu_a.offset(), lda,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define her2_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *lda >= std::max(1, *n)\
+            && *incx > 0 && *incy > 0 && *alpha != 0,\
+            (a, x, y),\
+            uplo, n, alpha, x, incx, y, incy, a, lda)
 
-    if (!a_info) {
-        if (Layout == CblasRowMajor)
-            transpose(gpu_a, size_a, &rows_a, &cols_a, lda, geam_func);
-        b2c_copy_from_gpu(a, gpu_a, size_a);
-    }
+F77_her2(c, float _Complex) {
+    her2_check(cher2_);
+    _b2c_her2(c_uplo(*uplo),
+            *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasCher2
+#else
+            &clblasCher2
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_her2(z, double _Complex) {
+    her2_check(zher2_);
+    _b2c_her2(c_uplo(*uplo),
+            *n,
+            cu(*alpha),
+            cmplx_ptr(x), *incx,
+            cmplx_ptr(y), *incy,
+            cmplx_ptr(a), *lda,
+#if USE_CUDA
+            &cublasZher2
+#else
+            &clblasZher2
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_her2(fname, cblas_fname, T)\
+do {\
+    char ul = f77_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (T *) alpha,\
+            (T *) x, (int *) &incx, (T *) y, (int *) &incy, a, (int *) &lda),\
+        runtime_blas_next(cblas_fname)(Layout, uplo, n, alpha, x, incx, y, incy, a, lda));\
+} while (0)
+
 DECLARE_CBLAS__HER2(c, float _Complex) {
-    float _Complex _alpha = 1.0;
-    float _Complex _beta = 0.0;
-    _cblas_her2(Layout, uplo,
-            n, cu(alpha),
-            (cuComplex *) x, incx,
-            (cuComplex *) y, incy,
-            (cuComplex *) a, lda,
-            &cublasCher2,
-            &cublasCgeam,
-            cu(_alpha), cu(_beta));
+    cblas_her2(cher2_, cblas_cher2, float _Complex);
 }
 
 DECLARE_CBLAS__HER2(z, double _Complex) {
-    double _Complex _alpha = 1.0;
-    double _Complex _beta = 0.0;
-    _cblas_her2(Layout, uplo,
-            n, cu(alpha),
-            (cuDoubleComplex *) x, incx,
-            (cuDoubleComplex *) y, incy,
-            (cuDoubleComplex *) a, lda,
-            &cublasZher2,
-            &cublasZgeam,
-            cu(_alpha), cu(_beta));
+    cblas_her2(zher2_, cblas_zher2, double _Complex);
 }
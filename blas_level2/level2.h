@@ -2,8 +2,71 @@
 #define BLAS2CUDA_LEVEL2_H
 
 #include <complex.h>
-#include "../blas2cuda.h"
-#include "../cblas.h"
-#include "../conversions.h"
+#include "../runtime-blas.h"
+
+/* argument checks; invalid arguments are reported by the next BLAS library */
+
+#define valid_trans(trans)\
+    (runtime_blas_lsame(trans, "N") || runtime_blas_lsame(trans, "T") || runtime_blas_lsame(trans, "C"))
+
+#define valid_uplo(uplo)\
+    (runtime_blas_lsame(uplo, "U") || runtime_blas_lsame(uplo, "L"))
+
+#define valid_diag(diag)\
+    (runtime_blas_lsame(diag, "U") || runtime_blas_lsame(diag, "N"))
+
+/**
+ * Size of a packed triangular matrix of order {@n}.
+ */
+static inline size_t packed_size(size_t n, size_t sz) {
+    return n * (n + 1) / 2 * sz;
+}
+
+/*
+ * CBLAS entry points call the F77 routines. As for Level 3 (see level3.h),
+ * a row-major call runs the column-major routine on the transpose of the
+ * matrix: m and n (and kl and ku) are swapped, uplo is flipped, trans goes
+ * N <-> T, and ger swaps x and y. For complex routines that conjugate the
+ * matrix (ConjTrans, Hermitian matrices and gerc), the transposed equation
+ * conjugates the vectors instead, which the F77 routines cannot do, so
+ * these row-major calls go to the CBLAS entry point of the next library.
+ */
+
+/**
+ * {@trans} of a row-major call, for the column-major routine. ConjTrans is
+ * Trans for real types; complex ConjTrans calls are forwarded instead.
+ */
+static inline char f77_row_trans(const CBLAS_TRANSPOSE trans) {
+    switch (trans) {
+        case CblasNoTrans:
+            return 'T';
+        case CblasTrans:
+        case CblasConjTrans:
+            return 'N';
+        default:
+            return '?';
+    }
+}
+
+/**
+ * Run {@colmajor} or {@rowmajor} depending on {@layout}.
+ */
+#define cblas_layout_dispatch(layout, colmajor, rowmajor)\
+do {\
+    if ((layout) == CblasColMajor)\
+        colmajor;\
+    else if ((layout) == CblasRowMajor)\
+        rowmajor;\
+    else\
+        runtime_blas_xerbla(__func__, 1);\
+} while (0)
+
+/**
+ * If {@cond} and the call is row-major, call {@fname}, a CBLAS entry point,
+ * in the next library with the remaining arguments and return.
+ */
+#define cblas_forward_rowmajor(fname, cond, ...)\
+    if (Layout == CblasRowMajor && (cond))\
+        return runtime_blas_next(fname)(Layout, __VA_ARGS__);
 
 #endif
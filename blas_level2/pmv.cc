@@ -1,120 +1,249 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-static void _cblas_hpmv(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
-        const int n, 
-        const T alpha,
-        const T *a,
+template <typename T, typename S>
+#if USE_CUDA
+using hpmv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
+            const T *,
+            const T *, int,
+            const S *,
+            T *, int);
+#else
+using hpmv_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem AP, size_t offa,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_hpmv(const CBLAS_UPLO uplo,
+        const int n,
+        const S alpha,
+        const T *ap,
         const T *x, const int incx,
-        const T beta,
+        const S beta,
         T *y, const int incy,
-        cublasStatus_t hpmv_func(cublasHandle_t, cublasFillMode_t,
-            int, const T *,
+        hpmv_t<T,S> hpmv_func)
+{
+    gpuptr<const T> gpu_a(ap, packed_size(n, sizeof *ap));
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+
+    call_kernel(
+#if USE_CUDA
+        hpmv_func(b2c_cublas_handle, cu(uplo),
+                n,
+                &alpha,
+                gpu_a,
+                gpu_x, incx,
+                &beta,
+                gpu_y, incy)
+#else
+        hpmv_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_a, gpu_a.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
+    );
+}
+
+#define hpmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *incx > 0 && *incy > 0\
+            && !(*alpha == 0 && *beta == 1),\
+            (ap, x, y),\
+            uplo, n, alpha, ap, x, incx, beta, y, incy)
+
+F77_hpmv(c, float _Complex) {
+    hpmv_check(chpmv_);
+    _b2c_hpmv(c_uplo(*uplo),
+            *n,
+            cu(*alpha),
+            cmplx_ptr(ap),
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasChpmv
+#else
+            &clblasChpmv
+#endif
+            );
+}
+
+F77_hpmv(z, double _Complex) {
+    hpmv_check(zhpmv_);
+    _b2c_hpmv(c_uplo(*uplo),
+            *n,
+            cu(*alpha),
+            cmplx_ptr(ap),
+            cmplx_ptr(x), *incx,
+            cu(*beta),
+            cmplx_ptr(y), *incy,
+#if USE_CUDA
+            &cublasZhpmv
+#else
+            &clblasZhpmv
+#endif
+            );
+}
+
+template <typename T, typename S>
+#if USE_CUDA
+using spmv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
             const T *,
             const T *, int,
-            const T *,
-            T *, int),
-        geam_t<T> geam_func)
+            const S *,
+            T *, int);
+#else
+using spmv_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem AP, size_t offa,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_spmv(const CBLAS_UPLO uplo,
+        const int n,
+        const S alpha,
+        const T *ap,
+        const T *x, const int incx,
+        const S beta,
+        T *y, const int incy,
+        spmv_t<T,S> spmv_func)
 {
-    const cublasFillMode_t fillmode = cu(uplo);
-    const T *gpu_a, *gpu_x;
-    T *gpu_y;
-    const int size_a = size(0, n, n+1, sizeof(*a))/2;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *x_info, *y_info, *a_info;
-    int rows_a, cols_a;
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = n;
-        cols_a = (n+1)/2;
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = n;
-        cols_a = (n+1)/2;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
+    gpuptr<const T> gpu_a(ap, packed_size(n, sizeof *ap));
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
     call_kernel(
-        hpmv_func(b2c_handle, fillmode,
+#if USE_CUDA
+        spmv_func(b2c_cublas_handle, cu(uplo),
                 n,
                 &alpha,
-                gpu_a, 
+                gpu_a,
                 gpu_x, incx,
                 &beta,
                 gpu_y, incy)
+#else
+        spmv_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_a, gpu_a.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define spmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *incx > 0 && *incy > 0\
+            && !(*alpha == 0 && *beta == 1),\
+            (ap, x, y),\
+            uplo, n, alpha, ap, x, incx, beta, y, incy)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_spmv(s, float) {
+    spmv_check(sspmv_);
+    _b2c_spmv(c_uplo(*uplo),
+            *n,
+            *alpha,
+            ap,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasSspmv
+#else
+            &clblasSspmv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_spmv(d, double) {
+    spmv_check(dspmv_);
+    _b2c_spmv(c_uplo(*uplo),
+            *n,
+            *alpha,
+            ap,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasDspmv
+#else
+            &clblasDspmv
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_hpmv(fname, cblas_fname, T)\
+do {\
+    char ul = f77_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (T *) alpha, (T *) ap,\
+            (T *) x, (int *) &incx, (T *) beta, y, (int *) &incy),\
+        runtime_blas_next(cblas_fname)(Layout, uplo, n, alpha, ap,\
+            x, incx, beta, y, incy));\
+} while (0)
+
 DECLARE_CBLAS__HPMV(c, float _Complex) {
-    _cblas_hpmv(Layout, uplo, n,
-            *(cuComplex *) alpha,
-            (cuComplex *) ap,
-            (cuComplex *) x, incx,
-            *(cuComplex *) beta,
-            (cuComplex *) y, incy,
-            &cublasChpmv,
-            &cublasCgeam);
+    cblas_hpmv(chpmv_, cblas_chpmv, float _Complex);
 }
 
-DECLARE_CBLAS__HPMV(z, float _Complex) {
-    _cblas_hpmv(Layout, uplo, n,
-            *(cuDoubleComplex *) alpha,
-            (cuDoubleComplex *) ap,
-            (cuDoubleComplex *) x, incx,
-            *(cuDoubleComplex *) beta,
-            (cuDoubleComplex *) y, incy,
-            &cublasZhpmv,
-            &cublasZgeam);
+DECLARE_CBLAS__HPMV(z, double _Complex) {
+    cblas_hpmv(zhpmv_, cblas_zhpmv, double _Complex);
 }
 
+#define cblas_spmv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (T *) &alpha, (T *) ap,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy),\
+        fname(&rul, (int *) &n, (T *) &alpha, (T *) ap,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy));\
+} while (0)
+
 DECLARE_CBLAS__SPMV(s, float) {
-    _cblas_hpmv(Layout, uplo, n,
-            alpha,
-            ap,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasSspmv,
-            &cublasSgeam);
+    cblas_spmv(sspmv_, float);
 }
 
 DECLARE_CBLAS__SPMV(d, double) {
-    _cblas_hpmv(Layout, uplo, n,
-            alpha,
-            ap,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasDspmv,
-            &cublasDgeam);
+    cblas_spmv(dspmv_, double);
 }
-
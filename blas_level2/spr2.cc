@@ -1,99 +1,124 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-void _cblas_spr2(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+template <typename T, typename S>
+#if USE_CUDA
+using spr2_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            T *);
+#else
+using spr2_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem X, size_t offx, int incx,
+        const cl_mem Y, size_t offy, int incy,
+        cl_mem AP, size_t offa,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_spr2(const CBLAS_UPLO uplo,
         const int n,
-        const T alpha,
+        const S alpha,
         const T *x, const int incx,
         const T *y, const int incy,
-        T *a,
-        cublasStatus_t spr2_func(cublasHandle_t,
-            cublasFillMode_t,
-            int, const T *,
-            const T*, int,
-            const T*, int,
-            T *),
-        geam_t<T> geam_func,
-        T geam_alpha = 1.0, T geam_beta = 0.0)
+        T *ap,
+        spr2_t<T,S> spr2_func)
 {
-    T *gpu_a;
-    const T *gpu_x, *gpu_y;
-    const int size_a = size(0, n, n+1, sizeof(*a))/2;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *a_info, *x_info, *y_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = n;
-        cols_a = (n+1)/2;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        cols_a = (n+1)/2;
-        rows_a = n;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-
-    gpu_y = (const T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
-
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<const T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
+    gpuptr<T> gpu_a(ap, packed_size(n, sizeof *ap));
 
     call_kernel(
-        spr2_func(b2c_handle, fillmode, 
-                n, &alpha,
+#if USE_CUDA
+        spr2_func(b2c_cublas_handle, cu(uplo),
+                n,
+                &alpha,
                 gpu_x, incx,
                 gpu_y, incy,
                 gpu_a)
+#else
+        spr2_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_x, gpu_x.offset(), incx,
+            gpu_y, gpu_y.offset(), incy,
+            gpu_a, gpu_a.offset(),
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define spr2_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *incx > 0 && *incy > 0 && *alpha != 0,\
+            (ap, x, y),\
+            uplo, n, alpha, x, incx, y, incy, ap)
 
-    if (!a_info) {
-        if (Layout == CblasRowMajor)
-            transpose(gpu_a, size_a, &rows_a, &cols_a, n, geam_func);
-        b2c_copy_from_gpu(a, gpu_a, size_a);
-    }
+F77_spr2(s, float) {
+    spr2_check(sspr2_);
+    _b2c_spr2(c_uplo(*uplo),
+            *n,
+            *alpha,
+            x, *incx,
+            y, *incy,
+            ap,
+#if USE_CUDA
+            &cublasSspr2
+#else
+            &clblasSspr2
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_spr2(d, double) {
+    spr2_check(dspr2_);
+    _b2c_spr2(c_uplo(*uplo),
+            *n,
+            *alpha,
+            x, *incx,
+            y, *incy,
+            ap,
+#if USE_CUDA
+            &cublasDspr2
+#else
+            &clblasDspr2
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_spr2(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (T *) &alpha,\
+            (T *) x, (int *) &incx, (T *) y, (int *) &incy, ap),\
+        fname(&rul, (int *) &n, (T *) &alpha,\
+            (T *) x, (int *) &incx, (T *) y, (int *) &incy, ap));\
+} while (0)
+
 DECLARE_CBLAS__SPR2(s, float) {
-    _cblas_spr2(Layout, uplo,
-            n, alpha, 
-            x, incx,
-            y, incy,
-            ap,
-            &cublasSspr2,
-            &cublasSgeam);
+    cblas_spr2(sspr2_, float);
 }
 
 DECLARE_CBLAS__SPR2(d, double) {
-    _cblas_spr2(Layout, uplo,
-            n, alpha, 
-            x, incx,
-            y, incy,
-            ap,
-            &cublasDspr2,
-            &cublasDgeam);
+    cblas_spr2(dspr2_, double);
 }
@@ -1,97 +1,132 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
-template <typename T>
-void _cblas_symv (const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+template <typename T, typename S>
+#if USE_CUDA
+using symv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            int,
+            const S *,
+            const T *, int,
+            const T *, int,
+            const S *,
+            T *, int);
+#else
+using symv_t = clblasStatus (*)(clblasOrder order, clblasUplo uplo,
+        size_t N,
+        S alpha,
+        const cl_mem A, size_t offa, size_t lda,
+        const cl_mem X, size_t offx, int incx,
+        S beta,
+        cl_mem Y, size_t offy, int incy,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T, typename S>
+void _b2c_symv(const CBLAS_UPLO uplo,
         const int n,
-        const T alpha,
+        const S alpha,
         const T *a, const int lda,
         const T *x, const int incx,
-        const T beta,
+        const S beta,
         T *y, const int incy,
-        cublasStatus_t symv_func(cublasHandle_t,
-            cublasFillMode_t,
-            int, const T *,
-            const T *, int,
-            const T *, int, const T *,
-            T *, int),
-        geam_t<T> geam_func)
+        symv_t<T,S> symv_func)
 {
-    const T *gpu_a, *gpu_x;
-    T *gpu_y;
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const int size_y = size(1, n-1, incy, sizeof(*y));
-    const struct objinfo *a_info, *x_info, *y_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = lda;
-        cols_a = n;
-        gpu_a = (T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (const T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
-    gpu_y = (T *) b2c_place_on_gpu((void *) y, size_y, &y_info,
-            (void *) gpu_a, a_info,
-            (void *) gpu_x, x_info,
-            NULL);
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<const T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+    gpuptr<T> gpu_y(y, size(1, n - 1, incy, sizeof *y));
 
     call_kernel(
-        symv_func(b2c_handle, fillmode,
-                cols_a, &alpha,
-                gpu_a, rows_a,
+#if USE_CUDA
+        symv_func(b2c_cublas_handle, cu(uplo),
+                n,
+                &alpha,
+                gpu_a, lda,
                 gpu_x, incx,
                 &beta,
                 gpu_y, incy)
+#else
+        symv_func(clblasColumnMajor, clb(uplo),
+            n,
+            alpha,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            beta,
+            gpu_y, gpu_y.offset(), incy,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define symv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && *n > 0 && *lda >= std::max(1, *n)\
+            && *incx > 0 && *incy > 0 && !(*alpha == 0 && *beta == 1),\
+            (a, x, y),\
+            uplo, n, alpha, a, lda, x, incx, beta, y, incy)
 
-    if (!y_info)
-        b2c_copy_from_gpu(y, gpu_y, size_y);
+F77_symv(s, float) {
+    symv_check(ssymv_);
+    _b2c_symv(c_uplo(*uplo),
+            *n,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasSsymv
+#else
+            &clblasSsymv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_y, y_info);
+F77_symv(d, double) {
+    symv_check(dsymv_);
+    _b2c_symv(c_uplo(*uplo),
+            *n,
+            *alpha,
+            a, *lda,
+            x, *incx,
+            *beta,
+            y, *incy,
+#if USE_CUDA
+            &cublasDsymv
+#else
+            &clblasDsymv
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_symv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, (int *) &n, (T *) &alpha, (T *) a, (int *) &lda,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy),\
+        fname(&rul, (int *) &n, (T *) &alpha, (T *) a, (int *) &lda,\
+            (T *) x, (int *) &incx, (T *) &beta, y, (int *) &incy));\
+} while (0)
+
 DECLARE_CBLAS__SYMV(s, float) {
-    _cblas_symv(Layout, uplo, n,
-            alpha,
-            a, lda,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasSsymv,
-            &cublasSgeam);
+    cblas_symv(ssymv_, float);
 }
 
 DECLARE_CBLAS__SYMV(d, double) {
-    _cblas_symv(Layout, uplo, n,
-            alpha,
-            a, lda,
-            x, incx,
-            beta,
-            y, incy,
-            &cublasDsymv,
-            &cublasDgeam);
+    cblas_symv(dsymv_, double);
 }
@@ -1,115 +1,154 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
 template <typename T>
-void _cblas_tbsv(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+#if USE_CUDA
+using tbsv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t, cublasOperation_t, cublasDiagType_t,
+            int, int,
+            const T *, int,
+            T *, int);
+#else
+using tbsv_t = clblasStatus (*)(clblasOrder order,
+        clblasUplo uplo, clblasTranspose trans, clblasDiag diag,
+        size_t N, size_t K,
+        const cl_mem A, size_t offa, size_t lda,
+        cl_mem X, size_t offx, int incx,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_tbsv(const CBLAS_UPLO uplo,
         const CBLAS_TRANSPOSE trans,
         const CBLAS_DIAG diag,
         const int n, const int k,
         const T *a, const int lda,
         T *x, const int incx,
-        cublasStatus_t tbsv_func(cublasHandle_t,
-            cublasFillMode_t, cublasOperation_t,
-            cublasDiagType_t,
-            int, int,
-            const T *, int,
-            T *, int),
-        geam_t<T> geam_func,
-        T geam_alpha = 1.0, T geam_beta = 0.0)
+        tbsv_t<T> tbsv_func)
 {
-    const T *gpu_a;
-    T *gpu_x;
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *a_info, *x_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-    const cublasOperation_t op = cu(trans);
-    const cublasDiagType_t cdiag = cu(diag);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = lda;
-        cols_a = n;
-        gpu_a = (const T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
 
     call_kernel(
-        tbsv_func(b2c_handle, fillmode,
-                op, cdiag,
-                cols_a, k,
-                gpu_a, rows_a,
+#if USE_CUDA
+        tbsv_func(b2c_cublas_handle,
+                cu(uplo), cu(trans), cu(diag),
+                n, k,
+                gpu_a, lda,
                 gpu_x, incx)
+#else
+        tbsv_func(clblasColumnMajor,
+            clb(uplo), clb(trans), clb(diag),
+            n, k,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define tbsv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && valid_trans(trans) && valid_diag(diag)\
+            && *n > 0 && *k >= 0 && *lda >= *k + 1 && *incx > 0,\
+            (a, x),\
+            uplo, trans, diag, n, k, a, lda, x, incx)
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_tbsv(s, float) {
+    tbsv_check(stbsv_);
+    _b2c_tbsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n, *k,
+            a, *lda,
+            x, *incx,
+#if USE_CUDA
+            &cublasStbsv
+#else
+            &clblasStbsv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_tbsv(d, double) {
+    tbsv_check(dtbsv_);
+    _b2c_tbsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n, *k,
+            a, *lda,
+            x, *incx,
+#if USE_CUDA
+            &cublasDtbsv
+#else
+            &clblasDtbsv
+#endif
+            );
+}
 
+F77_tbsv(c, float _Complex) {
+    tbsv_check(ctbsv_);
+    _b2c_tbsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n, *k,
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasCtbsv
+#else
+            &clblasCtbsv
+#endif
+            );
 }
 
+F77_tbsv(z, double _Complex) {
+    tbsv_check(ztbsv_);
+    _b2c_tbsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n, *k,
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasZtbsv
+#else
+            &clblasZtbsv
+#endif
+            );
+}
+
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_tbsv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    char t = f77_trans(trans), rt = f77_row_trans(trans), dg = f77_diag(diag);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, &t, &dg, (int *) &n, (int *) &k, (T *) a, (int *) &lda, x, (int *) &incx),\
+        fname(&rul, &rt, &dg, (int *) &n, (int *) &k, (T *) a, (int *) &lda, x, (int *) &incx));\
+} while (0)
+
 DECLARE_CBLAS__TBSV(s, float) {
-    _cblas_tbsv(Layout, uplo, trans, diag,
-            n, k,
-            a, lda,
-            x, incx,
-            &cublasStbsv,
-            &cublasSgeam);
+    cblas_tbsv(stbsv_, float);
 }
 
 DECLARE_CBLAS__TBSV(d, double) {
-    _cblas_tbsv(Layout, uplo, trans, diag,
-            n, k,
-            a, lda,
-            x, incx,
-            &cublasDtbsv,
-            &cublasDgeam);
+    cblas_tbsv(dtbsv_, double);
 }
 
 DECLARE_CBLAS__TBSV(c, float _Complex) {
-    float _Complex _alpha = 1.0;
-    float _Complex _beta = 0.0;
-    _cblas_tbsv(Layout, uplo, trans, diag,
-            n, k,
-            (cuComplex *) a, lda,
-            (cuComplex *) x, incx,
-            &cublasCtbsv,
-            &cublasCgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ctbsv, trans == CblasConjTrans,
+            uplo, trans, diag, n, k, a, lda, x, incx);
+    cblas_tbsv(ctbsv_, float _Complex);
 }
 
 DECLARE_CBLAS__TBSV(z, double _Complex) {
-    double _Complex _alpha = 1.0;
-    double _Complex _beta = 0.0;
-    _cblas_tbsv(Layout, uplo, trans, diag,
-            n, k,
-            (cuDoubleComplex *) a, lda,
-            (cuDoubleComplex *) x, incx,
-            &cublasZtbsv,
-            &cublasZgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ztbsv, trans == CblasConjTrans,
+            uplo, trans, diag, n, k, a, lda, x, incx);
+    cblas_tbsv(ztbsv_, double _Complex);
 }
@@ -1,115 +1,154 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
 template <typename T>
-void _cblas_tpsv(const CBLAS_LAYOUT Layout,
-        const CBLAS_UPLO uplo,
+#if USE_CUDA
+using tpsv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t, cublasOperation_t, cublasDiagType_t,
+            int,
+            const T *,
+            T *, int);
+#else
+using tpsv_t = clblasStatus (*)(clblasOrder order,
+        clblasUplo uplo, clblasTranspose trans, clblasDiag diag,
+        size_t N,
+        const cl_mem A, size_t offa,
+        cl_mem X, size_t offx, int incx,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_tpsv(const CBLAS_UPLO uplo,
         const CBLAS_TRANSPOSE trans,
         const CBLAS_DIAG diag,
         const int n,
-        const T *a,
+        const T *ap,
         T *x, const int incx,
-        cublasStatus_t tpsv_func(cublasHandle_t,
-            cublasFillMode_t,
-            cublasOperation_t, cublasDiagType_t,
-            int, const T *,
-            T *, int),
-        geam_t<T> geam_func,
-        T geam_alpha = 1.0, T geam_beta = 0.0)
+        tpsv_t<T> tpsv_func)
 {
-    const T *gpu_a;
-    T *gpu_x;
-    const int size_a = size(0, n, n+1, sizeof(*a))/2;
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *a_info, *x_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-    const cublasOperation_t op = cu(trans);
-    const cublasDiagType_t cdiag = cu(diag);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = n;
-        cols_a = (n+1)/2;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = n;
-        cols_a = (n+1)/2;
-
-        gpu_a = (const T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
+    gpuptr<const T> gpu_a(ap, packed_size(n, sizeof *ap));
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
 
     call_kernel(
-        tpsv_func(b2c_handle, fillmode,
-                op, cdiag,
+#if USE_CUDA
+        tpsv_func(b2c_cublas_handle,
+                cu(uplo), cu(trans), cu(diag),
                 n,
                 gpu_a,
                 gpu_x, incx)
+#else
+        tpsv_func(clblasColumnMajor,
+            clb(uplo), clb(trans), clb(diag),
+            n,
+            gpu_a, gpu_a.offset(),
+            gpu_x, gpu_x.offset(), incx,
+            b2c_queue_args())
+#endif
     );
+}
+
+#define tpsv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && valid_trans(trans) && valid_diag(diag)\
+            && *n > 0 && *incx > 0,\
+            (ap, x),\
+            uplo, trans, diag, n, ap, x, incx)
+
+F77_tpsv(s, float) {
+    tpsv_check(stpsv_);
+    _b2c_tpsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            ap,
+            x, *incx,
+#if USE_CUDA
+            &cublasStpsv
+#else
+            &clblasStpsv
+#endif
+            );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+F77_tpsv(d, double) {
+    tpsv_check(dtpsv_);
+    _b2c_tpsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            ap,
+            x, *incx,
+#if USE_CUDA
+            &cublasDtpsv
+#else
+            &clblasDtpsv
+#endif
+            );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_tpsv(c, float _Complex) {
+    tpsv_check(ctpsv_);
+    _b2c_tpsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            cmplx_ptr(ap),
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasCtpsv
+#else
+            &clblasCtpsv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_tpsv(z, double _Complex) {
+    tpsv_check(ztpsv_);
+    _b2c_tpsv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            cmplx_ptr(ap),
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasZtpsv
+#else
+            &clblasZtpsv
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_tpsv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    char t = f77_trans(trans), rt = f77_row_trans(trans), dg = f77_diag(diag);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, &t, &dg, (int *) &n, (T *) ap, x, (int *) &incx),\
+        fname(&rul, &rt, &dg, (int *) &n, (T *) ap, x, (int *) &incx));\
+} while (0)
 
 DECLARE_CBLAS__TPSV(s, float) {
-    _cblas_tpsv(Layout, uplo, trans, diag,
-            n,
-            ap,
-            x, incx,
-            &cublasStpsv,
-            &cublasSgeam);
+    cblas_tpsv(stpsv_, float);
 }
 
 DECLARE_CBLAS__TPSV(d, double) {
-    _cblas_tpsv(Layout, uplo, trans, diag,
-            n,
-            ap,
-            x, incx,
-            &cublasDtpsv,
-            &cublasDgeam);
+    cblas_tpsv(dtpsv_, double);
 }
 
 DECLARE_CBLAS__TPSV(c, float _Complex) {
-    float _Complex _alpha = 1.0;
-    float _Complex _beta = 0.0;
-    _cblas_tpsv(Layout, uplo, trans, diag,
-            n,
-            (cuComplex *) ap,
-            (cuComplex *) x, incx,
-            &cublasCtpsv,
-            &cublasCgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ctpsv, trans == CblasConjTrans,
+            uplo, trans, diag, n, ap, x, incx);
+    cblas_tpsv(ctpsv_, float _Complex);
 }
 
 DECLARE_CBLAS__TPSV(z, double _Complex) {
-    double _Complex _alpha = 1.0;
-    double _Complex _beta = 0.0;
-    _cblas_tpsv(Layout, uplo, trans, diag,
-            n,
-            (cuDoubleComplex *) ap,
-            (cuDoubleComplex *) x, incx,
-            &cublasZtpsv,
-            &cublasZgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ztpsv, trans == CblasConjTrans,
+            uplo, trans, diag, n, ap, x, incx);
+    cblas_tpsv(ztpsv_, double _Complex);
 }
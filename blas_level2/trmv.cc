@@ -1,119 +1,159 @@
+#if USE_CUDA
 #include <cublas_v2.h>
+#endif
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level2.h"
-#include "../blas2cuda.h"
+#include "../runtime-mem.hpp"
 
-extern cublasHandle_t b2c_handle;
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+#endif
 
 template <typename T>
-void _cblas_trmv(const CBLAS_LAYOUT Layout, const CBLAS_UPLO uplo,
+#if USE_CUDA
+using trmv_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t, cublasOperation_t, cublasDiagType_t,
+            int,
+            const T *, int,
+            T *, int);
+#else
+using trmv_t = clblasStatus (*)(clblasOrder order,
+        clblasUplo uplo, clblasTranspose trans, clblasDiag diag,
+        size_t N,
+        const cl_mem A, size_t offa, size_t lda,
+        cl_mem X, size_t offx, int incx,
+        cl_mem scratchBuff,
+        cl_uint numCommandQueues, cl_command_queue *commandQueues,
+        cl_uint numEventsInWaitList, const cl_event *eventWaitList, cl_event *events);
+#endif
+
+template <typename T>
+void _b2c_trmv(const CBLAS_UPLO uplo,
         const CBLAS_TRANSPOSE trans,
         const CBLAS_DIAG diag,
         const int n,
         const T *a, const int lda,
         T *x, const int incx,
-        cublasStatus_t trmv_func(cublasHandle_t,
-            cublasFillMode_t,
-            cublasOperation_t, cublasDiagType_t,
-            int, const T *, int,
-            T *, int),
-        geam_t<T> geam_func,
-        T geam_alpha = 1.0, T geam_beta = 0.0)
+        trmv_t<T> trmv_func)
 {
-    const T *gpu_a;
-    T *gpu_x;
-    const int size_a = size(0, n, lda, sizeof(*a));
-    const int size_x = size(1, n-1, incx, sizeof(*x));
-    const struct objinfo *a_info, *x_info;
-    int rows_a, cols_a;
-    const cublasFillMode_t fillmode = cu(uplo);
-    const cublasOperation_t op = cu(trans);
-    const cublasDiagType_t cdiag = cu(diag);
-
-    if (Layout == CblasRowMajor) {
-        a_info = NULL;
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = transpose(a, size_a, &rows_a, &cols_a, rows_a, geam_func);
-    } else {
-        rows_a = lda;
-        cols_a = n;
-
-        gpu_a = (const T *) b2c_place_on_gpu((void *) a, size_a, &a_info, NULL);
-    }
-
-    gpu_x = (T *) b2c_place_on_gpu((void *) x, size_x, &x_info,
-            (void *) gpu_a, a_info,
-            NULL);
+    gpuptr<const T> gpu_a(a, size(0, lda, n, sizeof *a));
+    gpuptr<T> gpu_x(x, size(1, n - 1, incx, sizeof *x));
+#if USE_OPENCL
+    gpuptr<T> scratch(NULL, size(1, n - 1, incx, sizeof *x));
+#endif
 
     call_kernel(
-        trmv_func(b2c_handle, fillmode,
-                op, cdiag,
-                cols_a,
-                gpu_a, rows_a,
+#if USE_CUDA
+        trmv_func(b2c_cublas_handle,
+                cu(uplo), cu(trans), cu(diag),
+                n,
+                gpu_a, lda,
                 gpu_x, incx)
+#else
+        trmv_func(clblasColumnMajor,
+            clb(uplo), clb(trans), clb(diag),
+            n,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_x, gpu_x.offset(), incx,
+            scratch,
+            b2c_queue_args())
+#endif
     );
+}
 
-    
-    runtime_fatal_errmsg(cudaGetLastError(), __func__);
+#define trmv_check(fname)\
+    resident_or_forward(fname,\
+            valid_uplo(uplo) && valid_trans(trans) && valid_diag(diag)\
+            && *n > 0 && *lda >= std::max(1, *n) && *incx > 0,\
+            (a, x),\
+            uplo, trans, diag, n, a, lda, x, incx)
+
+F77_trmv(s, float) {
+    trmv_check(strmv_);
+    _b2c_trmv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            a, *lda,
+            x, *incx,
+#if USE_CUDA
+            &cublasStrmv
+#else
+            &clblasStrmv
+#endif
+            );
+}
+
+F77_trmv(d, double) {
+    trmv_check(dtrmv_);
+    _b2c_trmv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            a, *lda,
+            x, *incx,
+#if USE_CUDA
+            &cublasDtrmv
+#else
+            &clblasDtrmv
+#endif
+            );
+}
 
-    if (!x_info)
-        b2c_copy_from_gpu(x, gpu_x, size_x);
+F77_trmv(c, float _Complex) {
+    trmv_check(ctrmv_);
+    _b2c_trmv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasCtrmv
+#else
+            &clblasCtrmv
+#endif
+            );
+}
 
-    b2c_cleanup_gpu_ptr((void *) gpu_a, a_info);
-    b2c_cleanup_gpu_ptr((void *) gpu_x, x_info);
+F77_trmv(z, double _Complex) {
+    trmv_check(ztrmv_);
+    _b2c_trmv(c_uplo(*uplo), c_trans(*trans), c_diag(*diag),
+            *n,
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(x), *incx,
+#if USE_CUDA
+            &cublasZtrmv
+#else
+            &clblasZtrmv
+#endif
+            );
 }
 
+// CBLAS wrappers (see level2.h for the row-major mapping)
+
+#define cblas_trmv(fname, T)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    char t = f77_trans(trans), rt = f77_row_trans(trans), dg = f77_diag(diag);\
+    cblas_layout_dispatch(Layout,\
+        fname(&ul, &t, &dg, (int *) &n, (T *) a, (int *) &lda, x, (int *) &incx),\
+        fname(&rul, &rt, &dg, (int *) &n, (T *) a, (int *) &lda, x, (int *) &incx));\
+} while (0)
 
 DECLARE_CBLAS__TRMV(s, float) {
-    _cblas_trmv(Layout, uplo, trans, diag,
-            n,
-            a, lda,
-            x, incx,
-            &cublasStrmv,
-            &cublasSgeam);
+    cblas_trmv(strmv_, float);
 }
 
-
 DECLARE_CBLAS__TRMV(d, double) {
-    _cblas_trmv(Layout, uplo, trans, diag,
-            n,
-            a, lda,
-            x, incx,
-            &cublasDtrmv,
-            &cublasDgeam);
+    cblas_trmv(dtrmv_, double);
 }
 
-
 DECLARE_CBLAS__TRMV(c, float _Complex) {
-    float _Complex _alpha = 1.0;
-    float _Complex _beta = 0.0;
-
-    _cblas_trmv(Layout, uplo, trans, diag,
-            n,
-            (cuComplex *) a, lda,
-            (cuComplex *) x, incx,
-            &cublasCtrmv,
-            &cublasCgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ctrmv, trans == CblasConjTrans,
+            uplo, trans, diag, n, a, lda, x, incx);
+    cblas_trmv(ctrmv_, float _Complex);
 }
 
-
 DECLARE_CBLAS__TRMV(z, double _Complex) {
-    double _Complex _alpha = 1.0;
-    double _Complex _beta = 0.0;
-
-    _cblas_trmv(Layout, uplo, trans, diag,
-            n,
-            (cuDoubleComplex *) a, lda,
-            (cuDoubleComplex *) x, incx,
-            &cublasZtrmv,
-            &cublasZgeam,
-            cu(_alpha),
-            cu(_beta));
+    cblas_forward_rowmajor(cblas_ztrmv, trans == CblasConjTrans,
+            uplo, trans, diag, n, a, lda, x, incx);
+    cblas_trmv(ztrmv_, double _Complex);
 }
@@ -1,18 +1,22 @@
 #if USE_CUDA
 #include <cublas_v2.h>
 #endif
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
 #include "../common.h"
 #include "../cblas.h"
 #include "../blas.h"
 #include "../conversions.h"
 #include "level3.h"
+#include "gemm_small.h"
+#include "../blas2cuda.h"
 #include "../runtime-blas.h"
 #include "../runtime-mem.hpp"
+#include "../batch.h"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T, typename S>
@@ -52,8 +56,306 @@ void _b2c_gemm(const CBLAS_TRANSPOSE transa,
         const T *b, const int ldb,
         const S beta,
         T *c, const int ldc,
+        gemm_t<T,S> gemm_func,
+        bool batch = false,
+        uint64_t window = 0);
+
+#if USE_CUDA
+template <typename T>
+struct gemm_batched_kernels;
+
+template <>
+struct gemm_batched_kernels<float> {
+    static constexpr auto batched = &cublasSgemmBatched;
+    static constexpr auto strided = &cublasSgemmStridedBatched;
+};
+
+template <>
+struct gemm_batched_kernels<double> {
+    static constexpr auto batched = &cublasDgemmBatched;
+    static constexpr auto strided = &cublasDgemmStridedBatched;
+};
+
+template <>
+struct gemm_batched_kernels<cuComplex> {
+    static constexpr auto batched = &cublasCgemmBatched;
+    static constexpr auto strided = &cublasCgemmStridedBatched;
+};
+
+template <>
+struct gemm_batched_kernels<cuDoubleComplex> {
+    static constexpr auto batched = &cublasZgemmBatched;
+    static constexpr auto strided = &cublasZgemmStridedBatched;
+};
+
+/**
+ * Whether {@ptrs} are {@stride} elements apart, in order.
+ */
+template <typename T>
+static bool gemm_batch_strided(T *const ptrs[], const int count, long long *stride)
+{
+    const ptrdiff_t bytes = (uintptr_t) ptrs[1] - (uintptr_t) ptrs[0];
+
+    if (bytes < 0 || bytes % sizeof(T) != 0)
+        return false;
+    for (int i = 2; i < count; i++)
+        if ((ptrdiff_t) ((uintptr_t) ptrs[i] - (uintptr_t) ptrs[i - 1]) != bytes)
+            return false;
+    *stride = bytes / sizeof(T);
+    return true;
+}
+
+/**
+ * Declare that the next call uses the {@size} bytes at each of {@ptrs},
+ * as one range, so that a batch takes up one operand of the scheduler.
+ */
+template <typename T>
+static void gemm_batch_operand(T *const ptrs[], const int count, const size_t size, bool writes)
+{
+    uintptr_t start = UINTPTR_MAX, end = 0;
+
+    for (int i = 0; i < count; i++) {
+        start = std::min(start, (uintptr_t) ptrs[i]);
+        end = std::max(end, (uintptr_t) ptrs[i] + size);
+    }
+    b2c_sched_operand((const void *) start, end - start, writes);
+}
+
+template <typename T>
+static void gemm_batch_pending(T *const ptrs[], const int count, bool writes)
+{
+    objtracker_guard guard;
+
+    for (int i = 0; i < count; i++)
+        b2c_pending_add(obj_tracker_objinfo_subptr((void *) ptrs[i]), writes);
+}
+#endif
+
+/**
+ * Run {@count} gemm calls that share their shape and scalars, on the
+ * operands a[i], b[i] and c[i], which must be managed objects. On CUDA,
+ * these are issued as one batched kernel (strided if the operands are
+ * evenly spaced), which needs the batch lock held. On OpenCL, where
+ * clBLAS has no batched gemm, they are issued one after the other.
+ */
+template <typename T, typename S>
+void _b2c_gemm_batched(const CBLAS_TRANSPOSE transa,
+        const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const S alpha,
+        const T *const a[], const int lda,
+        const T *const b[], const int ldb,
+        const S beta,
+        T *const c[], const int ldc,
+        const int count,
         gemm_t<T,S> gemm_func)
 {
+#if USE_CUDA
+    long long stride_a, stride_b, stride_c;
+
+    if (count == 1) {
+        _b2c_gemm(transa, transb, m, n, k, alpha, a[0], lda, b[0], ldb, beta, c[0], ldc, gemm_func);
+        return;
+    }
+
+    gemm_batch_operand(a, count, compute_size(transa, a[0], lda, k, m), false);
+    gemm_batch_operand(b, count, compute_size(transb, b[0], ldb, n, k), false);
+    gemm_batch_operand(c, count, size(0, ldc, n, sizeof(T)), true);
+
+    if (gemm_batch_strided(a, count, &stride_a)
+            && gemm_batch_strided(b, count, &stride_b)
+            && gemm_batch_strided(c, count, &stride_c)) {
+        call_kernel(
+            gemm_batched_kernels<T>::strided(b2c_cublas_handle,
+                cu(transa), cu(transb),
+                m, n, k,
+                &alpha,
+                a[0], lda, stride_a,
+                b[0], ldb, stride_b,
+                &beta,
+                c[0], ldc, stride_c,
+                count)
+        );
+    } else {
+        void **ptrs = b2c_batch_ptrs();
+
+        memcpy(&ptrs[0], a, count * sizeof *a);
+        memcpy(&ptrs[B2C_BATCH_MAX], b, count * sizeof *b);
+        memcpy(&ptrs[2 * B2C_BATCH_MAX], c, count * sizeof *c);
+        call_kernel(
+            gemm_batched_kernels<T>::batched(b2c_cublas_handle,
+                cu(transa), cu(transb),
+                m, n, k,
+                &alpha,
+                (const T *const *) &ptrs[0], lda,
+                (const T *const *) &ptrs[B2C_BATCH_MAX], ldb,
+                &beta,
+                (T *const *) &ptrs[2 * B2C_BATCH_MAX], ldc,
+                count)
+        );
+        b2c_batch_ptrs_issued();
+    }
+
+    if (!b2c_must_synchronize) {
+        gemm_batch_pending(a, count, false);
+        gemm_batch_pending(b, count, false);
+        gemm_batch_pending(c, count, true);
+    }
+#else
+    for (int i = 0; i < count; i++)
+        _b2c_gemm(transa, transb, m, n, k, alpha, a[i], lda, b[i], ldb, beta, c[i], ldc, gemm_func);
+#endif
+}
+
+/*
+ * Small gemm calls with the same shape and scalars, buffered to be issued
+ * together by _b2c_gemm_batched() (see batch.h). Protected by the batch lock.
+ */
+template <typename T, typename S>
+struct gemm_batch {
+    CBLAS_TRANSPOSE transa, transb;
+    int m, n, k;
+    S alpha, beta;
+    int lda, ldb, ldc;
+    gemm_t<T,S> gemm_func;
+    const T *a[B2C_BATCH_MAX];
+    const T *b[B2C_BATCH_MAX];
+    T *c[B2C_BATCH_MAX];
+    int count;
+};
+
+template <typename T, typename S>
+static gemm_batch<T,S> gemm_batch_buf;
+
+template <typename T, typename S>
+static size_t gemm_batch_flush(void)
+{
+    gemm_batch<T,S> &batch = gemm_batch_buf<T,S>;
+    const int count = batch.count;
+
+    batch.count = 0;
+    _b2c_gemm_batched(batch.transa, batch.transb,
+            batch.m, batch.n, batch.k,
+            batch.alpha,
+            batch.a, batch.lda,
+            batch.b, batch.ldb,
+            batch.beta,
+            batch.c, batch.ldc,
+            count, batch.gemm_func);
+    return count;
+}
+
+static inline bool overlaps(const void *p, size_t p_size, const void *q, size_t q_size)
+{
+    return (uintptr_t) p < (uintptr_t) q + q_size && (uintptr_t) q < (uintptr_t) p + p_size;
+}
+
+/**
+ * Buffer a gemm call, to be issued with the calls of the same shape that
+ * follow it. Calls of another shape, and calls that read what a buffered
+ * call writes or write what it uses, flush the batch first. If {@window}
+ * is set and the call starts a batch, wait that long for the calls of
+ * other threads, then issue the batch.
+ * @return false if the call could not be buffered, and must be issued now
+ */
+template <typename T, typename S>
+static bool gemm_batch_add(const CBLAS_TRANSPOSE transa,
+        const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const S alpha,
+        const T *a, const int lda,
+        const T *b, const int ldb,
+        const S beta,
+        T *c, const int ldc,
+        gemm_t<T,S> gemm_func,
+        uint64_t window)
+{
+    gemm_batch<T,S> &batch = gemm_batch_buf<T,S>;
+    const size_t size_a = compute_size(transa, a, lda, k, m);
+    const size_t size_b = compute_size(transb, b, ldb, n, k);
+    const size_t size_c = size(0, ldc, n, sizeof(*c));
+    const struct objinfo *info_a, *info_b, *info_c;
+    bool added = false, started = false;
+    unsigned long gen = 0;
+    objtracker_guard guard;
+
+    if (!(info_a = obj_tracker_objinfo_subptr((void *) a))
+            || !(info_b = obj_tracker_objinfo_subptr((void *) b))
+            || !(info_c = obj_tracker_objinfo_subptr((void *) c)))
+        return false;
+
+    b2c_batch_lock();
+    if (!b2c_batch_is(&gemm_batch_flush<T,S>)
+            || batch.count == B2C_BATCH_MAX
+            || batch.transa != transa || batch.transb != transb
+            || batch.m != m || batch.n != n || batch.k != k
+            || batch.lda != lda || batch.ldb != ldb || batch.ldc != ldc
+            || memcmp(&batch.alpha, &alpha, sizeof alpha) != 0
+            || memcmp(&batch.beta, &beta, sizeof beta) != 0
+            || batch.gemm_func != gemm_func)
+        b2c_batch_flush_locked();
+    else
+        for (int i = 0; i < batch.count; i++)
+            if (overlaps(c, size_c, batch.a[i], size_a)
+                    || overlaps(c, size_c, batch.b[i], size_b)
+                    || overlaps(c, size_c, batch.c[i], size_c)
+                    || overlaps(a, size_a, batch.c[i], size_c)
+                    || overlaps(b, size_b, batch.c[i], size_c)) {
+                b2c_batch_flush_locked();
+                break;
+            }
+
+    if (b2c_pending_hold(info_a, false)
+            && b2c_pending_hold(info_b, false)
+            && b2c_pending_hold(info_c, true)) {
+        if (batch.count == 0) {
+            batch.transa = transa;
+            batch.transb = transb;
+            batch.m = m;
+            batch.n = n;
+            batch.k = k;
+            batch.alpha = alpha;
+            batch.beta = beta;
+            batch.lda = lda;
+            batch.ldb = ldb;
+            batch.ldc = ldc;
+            batch.gemm_func = gemm_func;
+            b2c_batch_start(&gemm_batch_flush<T,S>);
+            started = true;
+            gen = b2c_batch_generation();
+        }
+        batch.a[batch.count] = a;
+        batch.b[batch.count] = b;
+        batch.c[batch.count] = c;
+        batch.count++;
+        added = true;
+    } else
+        /* releases what was held */
+        b2c_batch_flush_locked();
+    b2c_batch_unlock();
+
+    if (started && window)
+        b2c_batch_gather(gen, window);
+    return added;
+}
+
+template <typename T, typename S>
+void _b2c_gemm(const CBLAS_TRANSPOSE transa,
+        const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const S alpha,
+        const T *a, const int lda,
+        const T *b, const int ldb,
+        const S beta,
+        T *c, const int ldc,
+        gemm_t<T,S> gemm_func,
+        bool batch,
+        uint64_t window)
+{
+    if (batch && gemm_batch_add(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc,
+                gemm_func, window))
+        return;
+
     gpuptr<const T> gpu_a(a, compute_size(transa, a, lda, k, m));
     gpuptr<const T> gpu_b(b, compute_size(transb, b, ldb, n, k));
     gpuptr<T> gpu_c(c, size(0, ldc, n, sizeof(*c)));
@@ -73,11 +375,11 @@ void _b2c_gemm(const CBLAS_TRANSPOSE transa,
         gemm_func(clblasColumnMajor, clb(transa), clb(transb),
             m, n, k,
             alpha,
-            gpu_a, 0, lda,
-            gpu_b, 0, ldb,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_b, gpu_b.offset(), ldb,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -126,19 +428,82 @@ do {\
     }\
 } while (0)
 
+/* the largest m, n, or k of calls that are batched */
+#define GEMM_BATCH_MAX_DIM 128
+
+/*
+ * Small calls whose operands are all managed objects are batched, since
+ * the operands don't have to be copied. This needs asynchronous calls, so
+ * that the host doesn't wait for each call.
+ */
+#define gemm_can_batch()\
+    (b2c_options.batch_gemm && !b2c_must_synchronize\
+     && std::max({*m, *n, *k}) <= GEMM_BATCH_MAX_DIM\
+     && b2c_resident(a, b, c))
+
+/* the largest m, n, or k of calls that are gathered across threads */
+#define GEMM_GATHER_MAX_DIM 512
+
+/*
+ * Medium calls don't beat the host on their own, but those that several
+ * threads make at the same time can be gathered into one batched kernel.
+ * clBLAS has no batched gemm, so on OpenCL they stay on the host.
+ */
+#if USE_CUDA
+#define gemm_can_gather()\
+    (b2c_options.batch_gemm && !b2c_must_synchronize\
+     && std::max({*m, *n, *k}) <= GEMM_GATHER_MAX_DIM\
+     && b2c_resident(a, b, c))
+#else
+#define gemm_can_gather() false
+#endif
+
+#define gemm_decide_small()\
+    ((b2c_options.small_gemm && std::max({*m, *n, *k}) <= GEMM_SMALL_MAX) ? B2C_DECIDE_SMALL :\
+     B2C_DECIDE_HOST)
+
 #ifndef USE_GPU_ALWAYS
+#define gemm_decide()\
+    ((*lda >= 512 && *ldb >= 512 && *ldc >= 512) ? B2C_DECIDE_DEVICE :\
+     gemm_can_batch() ? B2C_DECIDE_BATCH :\
+     gemm_can_gather() ? B2C_DECIDE_GATHER :\
+     gemm_decide_small())
+#else
+#define gemm_decide() B2C_DECIDE_DEVICE
+#endif
+
+/*
+ * Batched call sites may pass operands that are not managed objects on
+ * later calls, which are run like calls of the same shape that are not
+ * batched. Calls that are gathered only go to the device while other
+ * threads make calls like them.
+ */
 #define gemm_perf_check(fname)\
-do {\
-    typeof(fname) *f = (typeof(fname) *) runtime_blas_func(__func__);\
-\
-    if (*m == 0 || *n == 0 || *k == 0 || *lda < 512 || *ldb < 512 || *ldc < 512){\
-        (*f)(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);\
+    callsite_dispatch(fname,\
+            b2c_shape(*transa, *transb, *m, *n, *k, *lda, *ldb, *ldc),\
+            gemm_decide(),\
+            transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc)\
+    enum b2c_decision decision = b2c_callsite_decision(cs_timer.site);\
+    uint64_t gather_window = 0;\
+    if ((decision == B2C_DECIDE_BATCH || decision == B2C_DECIDE_GATHER) && !b2c_resident(a, b, c))\
+        decision = gemm_decide_small();\
+    else if (decision == B2C_DECIDE_GATHER && !(gather_window = b2c_batch_gather_window()))\
+        decision = gemm_decide_small();\
+    if (decision == B2C_DECIDE_HOST) {\
+        runtime_blas_next(fname)(transa, transb, m, n, k,\
+                alpha, a, lda, b, ldb, beta, c, ldc);\
         return;\
     }\
-} while (0)
-#else
-#define gemm_perf_check(fname) ;
-#endif
+    if (decision == B2C_DECIDE_SMALL) {\
+        gemm_small(c_trans(*transa), c_trans(*transb),\
+                *m, *n, *k,\
+                *alpha,\
+                a, *lda,\
+                b, *ldb,\
+                *beta,\
+                c, *ldc);\
+        return;\
+    }
 
 F77_gemm(s, float) {
     gemm_check();
@@ -152,11 +517,11 @@ F77_gemm(s, float) {
             *beta,
             c, *ldc,
 #if USE_CUDA
-            &cublasSgemm
+            &cublasSgemm,
 #else
-            &clblasSgemm
+            &clblasSgemm,
 #endif
-            );
+            decision != B2C_DECIDE_DEVICE, gather_window);
 }
 
 F77_gemm(d, double) {
@@ -171,13 +536,33 @@ F77_gemm(d, double) {
             *beta,
             c, *ldc,
 #if USE_CUDA
-            &cublasDgemm
+            &cublasDgemm,
 #else
-            &clblasDgemm
+            &clblasDgemm,
 #endif
-            );
+            decision != B2C_DECIDE_DEVICE, gather_window);
 }
 
+/*
+ * The 3M (Gauss) algorithm computes a complex product with three real
+ * matrix products instead of four, which saves about 25% of the flops at
+ * a small cost in accuracy. ?gemm3m always uses it on the device (except
+ * in batches, which use the usual batched kernels), and ?gemm uses it for
+ * calls that run on the device if the gemm3m option is set.
+ */
+#if USE_CUDA
+#define gemm_kernel(prefix, P) &cublas##P##gemm
+#define gemm3m_kernel(prefix, P) &cublas##P##gemm3m
+#else
+#define gemm_kernel(prefix, P) &clblas##P##gemm
+/* clBLAS has no 3M kernels */
+#define gemm3m_kernel(prefix, P) &clblas##P##gemm
+#endif
+
+#define gemm_complex_kernel(prefix, P)\
+    (b2c_options.gemm3m && decision == B2C_DECIDE_DEVICE ?\
+     gemm3m_kernel(prefix, P) : gemm_kernel(prefix, P))
+
 F77_gemm(c, float _Complex) {
     gemm_check();
     gemm_perf_check(cgemm_);
@@ -189,12 +574,8 @@ F77_gemm(c, float _Complex) {
             cmplx_ptr(b), *ldb,
             cu(*beta),
             cmplx_ptr(c), *ldc,
-#if USE_CUDA
-            &cublasCgemm
-#else
-            &clblasCgemm
-#endif
-            );
+            gemm_complex_kernel(c, C),
+            decision != B2C_DECIDE_DEVICE, gather_window);
 }
 
 F77_gemm(z, double _Complex) {
@@ -208,10 +589,384 @@ F77_gemm(z, double _Complex) {
             cmplx_ptr(b), *ldb,
             cu(*beta),
             cmplx_ptr(c), *ldc,
-#if USE_CUDA
-            &cublasZgemm
-#else
-            &clblasZgemm
-#endif
-            );
+            gemm_complex_kernel(z, Z),
+            decision != B2C_DECIDE_DEVICE, gather_window);
+}
+
+F77_gemm3m(c, float _Complex) {
+    gemm_check();
+    gemm_perf_check(cgemm3m_);
+    _b2c_gemm(c_trans(*transa),
+            c_trans(*transb),
+            *m, *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(b), *ldb,
+            cu(*beta),
+            cmplx_ptr(c), *ldc,
+            gemm3m_kernel(c, C),
+            decision != B2C_DECIDE_DEVICE, gather_window);
+}
+
+F77_gemm3m(z, double _Complex) {
+    gemm_check();
+    gemm_perf_check(zgemm3m_);
+    _b2c_gemm(c_trans(*transa),
+            c_trans(*transb),
+            *m, *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(b), *ldb,
+            cu(*beta),
+            cmplx_ptr(c), *ldc,
+            gemm3m_kernel(z, Z),
+            decision != B2C_DECIDE_DEVICE, gather_window);
+}
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_gemm(fname, T, alpha_p, beta_p)\
+do {\
+    char ta = f77_trans(transa), tb = f77_trans(transb);\
+    cblas_dispatch(Layout,\
+        fname(&ta, &tb, &m, &n, &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc),\
+        fname(&tb, &ta, &n, &m, &k, (T *) alpha_p,\
+            (T *) b, (int *) &ldb, (T *) a, (int *) &lda, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__GEMM(s, float, const float) {
+    cblas_gemm(sgemm_, float, &alpha, &beta);
+}
+
+DECLARE_CBLAS__GEMM(d, double, const double) {
+    cblas_gemm(dgemm_, double, &alpha, &beta);
+}
+
+DECLARE_CBLAS__GEMM(c, float _Complex, const float _Complex *) {
+    cblas_gemm(cgemm_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__GEMM(z, double _Complex, const double _Complex *) {
+    cblas_gemm(zgemm_, double _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__GEMM3M(c, float _Complex, const float _Complex *) {
+    cblas_gemm(cgemm3m_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__GEMM3M(z, double _Complex, const double _Complex *) {
+    cblas_gemm(zgemm3m_, double _Complex, alpha, beta);
+}
+
+// Batched interfaces (as in MKL)
+
+/* groups of fewer problems than this, all small, are run one by one */
+#define GEMM_BATCH_MIN_GROUP 4
+
+template <typename H>
+using f77_gemm_t = void (*)(const char *, const char *,
+            const int *, const int *, const int *,
+            H *,
+            H *, int *,
+            H *, int *,
+            H *,
+            H *, int *);
+
+/*
+ * The element and scalar types of the device routines, for the element
+ * type H of the F77 routines.
+ */
+static inline float dev_scalar(float x) { return x; }
+static inline double dev_scalar(double x) { return x; }
+static inline auto dev_scalar(float _Complex x) { return cu(x); }
+static inline auto dev_scalar(double _Complex x) { return cu(x); }
+
+template <typename H>
+struct dev_elem { typedef H type; };
+
+template <>
+struct dev_elem<float _Complex> {
+    typedef std::remove_pointer<decltype(cmplx_ptr((float _Complex *) 0))>::type type;
+};
+
+template <>
+struct dev_elem<double _Complex> {
+    typedef std::remove_pointer<decltype(cmplx_ptr((double _Complex *) 0))>::type type;
+};
+
+#define gemm_batch_template\
+    template <typename H,\
+             typename T = typename dev_elem<H>::type,\
+             typename S = decltype(dev_scalar(H()))>
+
+static bool gemm_batch_valid(const char transa, const char transb,
+        const int m, const int n, const int k,
+        const int lda, const int ldb, const int ldc)
+{
+    bool nota = runtime_blas_lsame(&transa, "N");
+    bool notb = runtime_blas_lsame(&transb, "N");
+
+    return (nota || runtime_blas_lsame(&transa, "C") || runtime_blas_lsame(&transa, "T"))
+        && (notb || runtime_blas_lsame(&transb, "C") || runtime_blas_lsame(&transb, "T"))
+        && m > 0 && n > 0 && k > 0
+        && lda >= std::max(1, nota ? m : k)
+        && ldb >= std::max(1, notb ? k : n)
+        && ldc >= std::max(1, m);
+}
+
+/**
+ * Run a group of {@count} gemm problems that share all of their arguments
+ * except for the matrices a[i], b[i] and c[i]. If all of the matrices are
+ * managed objects, the problems are issued as batched kernels of up to
+ * B2C_BATCH_MAX problems each. Otherwise, and for small groups of small
+ * problems or invalid arguments, each problem is passed to the F77 routine
+ * {@f77_gemm}, which checks it and decides where to run it.
+ */
+gemm_batch_template
+static void gemm_batch_group(const char transa, const char transb,
+        const int m, const int n, const int k,
+        H *alpha,
+        H *const a[], int lda,
+        H *const b[], int ldb,
+        H *beta,
+        H *const c[], int ldc,
+        const int count,
+        gemm_t<T,S> gemm_func,
+        f77_gemm_t<H> f77_gemm)
+{
+    bool device = gemm_batch_valid(transa, transb, m, n, k, lda, ldb, ldc)
+        && (count >= GEMM_BATCH_MIN_GROUP || std::max({m, n, k}) > GEMM_SMALL_MAX);
+
+    for (int i = 0; i < count && device; i++)
+        device = b2c_resident(a[i], b[i], c[i]);
+
+    if (!device) {
+        for (int i = 0; i < count; i++)
+            f77_gemm(&transa, &transb, &m, &n, &k, alpha, a[i], &lda, b[i], &ldb, beta, c[i], &ldc);
+        return;
+    }
+
+    b2c_batch_lock();
+    /* calls buffered before this one are issued first */
+    b2c_batch_flush_locked();
+    for (int i = 0; i < count; i += B2C_BATCH_MAX)
+        _b2c_gemm_batched(c_trans(transa), c_trans(transb),
+                m, n, k,
+                dev_scalar(*alpha),
+                (const T *const *) &a[i], lda,
+                (const T *const *) &b[i], ldb,
+                dev_scalar(*beta),
+                (T *const *) &c[i], ldc,
+                std::min(count - i, B2C_BATCH_MAX),
+                gemm_func);
+    b2c_batch_unlock();
+}
+
+gemm_batch_template
+static void gemm_batch_strided(const char transa, const char transb,
+        const int m, const int n, const int k,
+        H *alpha,
+        H *a, int lda, const ptrdiff_t stridea,
+        H *b, int ldb, const ptrdiff_t strideb,
+        H *beta,
+        H *c, int ldc, const ptrdiff_t stridec,
+        const int batch_size,
+        gemm_t<T,S> gemm_func,
+        f77_gemm_t<H> f77_gemm)
+{
+    H *as[B2C_BATCH_MAX], *bs[B2C_BATCH_MAX], *cs[B2C_BATCH_MAX];
+
+    for (int i = 0; i < batch_size; i += B2C_BATCH_MAX) {
+        const int count = std::min(batch_size - i, B2C_BATCH_MAX);
+
+        for (int j = 0; j < count; j++) {
+            as[j] = a + (i + j) * stridea;
+            bs[j] = b + (i + j) * strideb;
+            cs[j] = c + (i + j) * stridec;
+        }
+        gemm_batch_group(transa, transb, m, n, k,
+                alpha, as, lda, bs, ldb, beta, cs, ldc,
+                count, gemm_func, f77_gemm);
+    }
+}
+
+/**
+ * The CBLAS routines map row-major groups onto column-major ones like
+ * cblas_?gemm (see level3.h).
+ */
+gemm_batch_template
+static void cblas_gemm_batch_groups(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE *transa_array,
+        const CBLAS_TRANSPOSE *transb_array,
+        const int *m_array, const int *n_array, const int *k_array,
+        const H *alpha_array,
+        const H **a_array, const int *lda_array,
+        const H **b_array, const int *ldb_array,
+        const H *beta_array,
+        H **c_array, const int *ldc_array,
+        const int group_count, const int *group_size,
+        gemm_t<T,S> gemm_func,
+        f77_gemm_t<H> f77_gemm)
+{
+    H *const *a = (H *const *) a_array, *const *b = (H *const *) b_array;
+
+    for (int g = 0; g < group_count; a += group_size[g], b += group_size[g], c_array += group_size[g], g++) {
+        H *alpha = (H *) &alpha_array[g], *beta = (H *) &beta_array[g];
+
+        if (Layout == CblasColMajor)
+            gemm_batch_group(f77_trans(transa_array[g]), f77_trans(transb_array[g]),
+                    m_array[g], n_array[g], k_array[g],
+                    alpha, a, lda_array[g], b, ldb_array[g], beta, c_array, ldc_array[g],
+                    group_size[g], gemm_func, f77_gemm);
+        else
+            gemm_batch_group(f77_trans(transb_array[g]), f77_trans(transa_array[g]),
+                    n_array[g], m_array[g], k_array[g],
+                    alpha, b, ldb_array[g], a, lda_array[g], beta, c_array, ldc_array[g],
+                    group_size[g], gemm_func, f77_gemm);
+    }
+}
+
+#define gemm_batch_check(group_count, group_count_arg)\
+do {\
+    if ((group_count) < 0) {\
+        runtime_blas_xerbla(__func__, group_count_arg);\
+        return;\
+    }\
+    for (int g = 0; g < (group_count); ++g)\
+        if (group_size[g] < 0) {\
+            runtime_blas_xerbla(__func__, group_count_arg + 1);\
+            return;\
+        }\
+} while (0)
+
+#define f77_gemm_batch(gemm_func, f77_gemm)\
+do {\
+    b2c_callsite_outer outer(__builtin_return_address(0));\
+    int first = 0;\
+\
+    gemm_batch_check(*group_count, 14);\
+    for (int g = 0; g < *group_count; first += group_size[g++])\
+        gemm_batch_group(transa_array[g], transb_array[g],\
+                m_array[g], n_array[g], k_array[g],\
+                &alpha_array[g],\
+                &a_array[first], lda_array[g],\
+                &b_array[first], ldb_array[g],\
+                &beta_array[g],\
+                &c_array[first], ldc_array[g],\
+                group_size[g], gemm_func, f77_gemm);\
+} while (0)
+
+#define f77_gemm_batch_strided(gemm_func, f77_gemm)\
+do {\
+    b2c_callsite_outer outer(__builtin_return_address(0));\
+\
+    if (*batch_size < 0) {\
+        runtime_blas_xerbla(__func__, 17);\
+        return;\
+    }\
+    gemm_batch_strided(*transa, *transb, *m, *n, *k,\
+            alpha, a, *lda, *stridea, b, *ldb, *strideb, beta, c, *ldc, *stridec,\
+            *batch_size, gemm_func, f77_gemm);\
+} while (0)
+
+F77_gemm_batch(s, float) {
+    f77_gemm_batch(gemm_kernel(s, S), &sgemm_);
+}
+
+F77_gemm_batch(d, double) {
+    f77_gemm_batch(gemm_kernel(d, D), &dgemm_);
+}
+
+F77_gemm_batch(c, float _Complex) {
+    f77_gemm_batch(gemm_kernel(c, C), &cgemm_);
+}
+
+F77_gemm_batch(z, double _Complex) {
+    f77_gemm_batch(gemm_kernel(z, Z), &zgemm_);
+}
+
+F77_gemm_batch_strided(s, float) {
+    f77_gemm_batch_strided(gemm_kernel(s, S), &sgemm_);
+}
+
+F77_gemm_batch_strided(d, double) {
+    f77_gemm_batch_strided(gemm_kernel(d, D), &dgemm_);
+}
+
+F77_gemm_batch_strided(c, float _Complex) {
+    f77_gemm_batch_strided(gemm_kernel(c, C), &cgemm_);
+}
+
+F77_gemm_batch_strided(z, double _Complex) {
+    f77_gemm_batch_strided(gemm_kernel(z, Z), &zgemm_);
+}
+
+#define cblas_gemm_batch(gemm_func, f77_gemm)\
+do {\
+    b2c_callsite_outer outer(__builtin_return_address(0));\
+\
+    if (Layout != CblasColMajor && Layout != CblasRowMajor) {\
+        runtime_blas_xerbla(__func__, 1);\
+        return;\
+    }\
+    gemm_batch_check(group_count, 15);\
+    cblas_gemm_batch_groups(Layout, transa_array, transb_array,\
+            m_array, n_array, k_array, alpha_array,\
+            a_array, lda_array, b_array, ldb_array, beta_array, c_array, ldc_array,\
+            group_count, group_size, gemm_func, f77_gemm);\
+} while (0)
+
+#define cblas_gemm_batch_strided(T, alpha_p, beta_p, gemm_func, f77_gemm)\
+do {\
+    b2c_callsite_outer outer(__builtin_return_address(0));\
+\
+    if (batch_size < 0) {\
+        runtime_blas_xerbla(__func__, 18);\
+        return;\
+    }\
+    if (Layout == CblasColMajor)\
+        gemm_batch_strided(f77_trans(transa), f77_trans(transb), m, n, k,\
+                (T *) alpha_p, (T *) a, lda, stridea, (T *) b, ldb, strideb,\
+                (T *) beta_p, c, ldc, stridec,\
+                batch_size, gemm_func, f77_gemm);\
+    else if (Layout == CblasRowMajor)\
+        gemm_batch_strided(f77_trans(transb), f77_trans(transa), n, m, k,\
+                (T *) alpha_p, (T *) b, ldb, strideb, (T *) a, lda, stridea,\
+                (T *) beta_p, c, ldc, stridec,\
+                batch_size, gemm_func, f77_gemm);\
+    else\
+        runtime_blas_xerbla(__func__, 1);\
+} while (0)
+
+DECLARE_CBLAS__GEMM_BATCH(s, float) {
+    cblas_gemm_batch(gemm_kernel(s, S), &sgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH(d, double) {
+    cblas_gemm_batch(gemm_kernel(d, D), &dgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH(c, float _Complex) {
+    cblas_gemm_batch(gemm_kernel(c, C), &cgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH(z, double _Complex) {
+    cblas_gemm_batch(gemm_kernel(z, Z), &zgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(s, float, const float) {
+    cblas_gemm_batch_strided(float, &alpha, &beta, gemm_kernel(s, S), &sgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(d, double, const double) {
+    cblas_gemm_batch_strided(double, &alpha, &beta, gemm_kernel(d, D), &dgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(c, float _Complex, const float _Complex *) {
+    cblas_gemm_batch_strided(float _Complex, alpha, beta, gemm_kernel(c, C), &cgemm_);
+}
+
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(z, double _Complex, const double _Complex *) {
+    cblas_gemm_batch_strided(double _Complex, alpha, beta, gemm_kernel(z, Z), &zgemm_);
 }
@@ -0,0 +1,339 @@
+#ifndef BLAS2CUDA_GEMM_SMALL_H
+#define BLAS2CUDA_GEMM_SMALL_H
+
+/*
+ * Host micro-kernels for small gemm calls.
+ *
+ * Calls that are too small to offload also lose to the call overhead of a
+ * generic host BLAS (threading, blocking for large caches, argument
+ * checking). For these, op(A) and op(B) are packed into contiguous
+ * panels and multiplied by register-blocked kernels that are specialized
+ * at compile time on the precision, the vector width (AVX-512, AVX2 or
+ * SSE2, selected at runtime) and the common inner dimensions.
+ */
+
+#include <complex.h>
+#include <string.h>
+#include "../cblas.h"
+#include "../lib/obj_tracker.h"
+
+/* the largest m, n, or k handled by the small kernels */
+#define GEMM_SMALL_MAX 128
+
+/* number of columns of C computed at once */
+#define GEMM_SMALL_NR 4
+
+template <typename T>
+struct gemm_small_traits {
+    typedef T real;
+    static constexpr bool complex = false;
+};
+
+template <>
+struct gemm_small_traits<float _Complex> {
+    typedef float real;
+    static constexpr bool complex = true;
+};
+
+template <>
+struct gemm_small_traits<double _Complex> {
+    typedef double real;
+    static constexpr bool complex = true;
+};
+
+template <typename R, int W>
+struct gemm_small_vec {
+    typedef R type __attribute__((vector_size(W)));
+    static constexpr int lanes = W / sizeof(R);
+};
+
+/**
+ * Per-thread packing buffers, big enough for GEMM_SMALL_MAX in all
+ * dimensions and the widest precision.
+ */
+struct gemm_small_buffers {
+    static constexpr size_t panel_size = GEMM_SMALL_MAX * GEMM_SMALL_MAX * sizeof(double);
+    char *mem;
+
+    gemm_small_buffers() : mem(nullptr) {}
+    ~gemm_small_buffers() { internal_free(mem); }
+
+    /* Ar, Ai, Br, Bi, Cr, Ci */
+    template <typename R>
+    R *panel(int i) {
+        if (!mem)
+            mem = (char *) internal_malloc(6 * panel_size);
+        return (R *)(mem + i * panel_size);
+    }
+};
+
+static inline gemm_small_buffers& gemm_small_get_buffers() {
+    static thread_local gemm_small_buffers buffers;
+    return buffers;
+}
+
+template <typename T>
+static inline T gemm_small_conj(T v, bool conj) {
+    if constexpr (gemm_small_traits<T>::complex)
+        if (conj)
+            __imag__ v = -__imag__ v;
+    return v;
+}
+
+/**
+ * Pack op(A) (m x k) into column-major panels with leading dimension mp,
+ * zero-padding rows m..mp.
+ */
+template <typename T, CBLAS_TRANSPOSE trans>
+static void gemm_small_pack_a(int m, int mp, int k,
+        const T *a, int lda,
+        typename gemm_small_traits<T>::real *ar,
+        typename gemm_small_traits<T>::real *ai)
+{
+    for (int p = 0; p < k; p++) {
+        int i = 0;
+        for (; i < m; i++) {
+            const T v = gemm_small_conj(trans == CblasNoTrans ? a[i + p*lda] : a[p + i*lda],
+                    trans == CblasConjTrans);
+            ar[i + p*mp] = __real__ v;
+            if constexpr (gemm_small_traits<T>::complex)
+                ai[i + p*mp] = __imag__ v;
+        }
+        for (; i < mp; i++) {
+            ar[i + p*mp] = 0;
+            if constexpr (gemm_small_traits<T>::complex)
+                ai[i + p*mp] = 0;
+        }
+    }
+}
+
+/**
+ * Pack op(B) (k x n) into column-major panels with leading dimension k.
+ */
+template <typename T, CBLAS_TRANSPOSE trans>
+static void gemm_small_pack_b(int k, int n,
+        const T *b, int ldb,
+        typename gemm_small_traits<T>::real *br,
+        typename gemm_small_traits<T>::real *bi)
+{
+    for (int j = 0; j < n; j++)
+        for (int p = 0; p < k; p++) {
+            const T v = gemm_small_conj(trans == CblasNoTrans ? b[p + j*ldb] : b[j + p*ldb],
+                    trans == CblasConjTrans);
+            br[p + j*k] = __real__ v;
+            if constexpr (gemm_small_traits<T>::complex)
+                bi[p + j*k] = __imag__ v;
+        }
+}
+
+/**
+ * Compute MV vectors of rows times NR columns of C = A*B.
+ * K is the inner dimension if known at compile time, or 0.
+ */
+template <typename R, bool CPLX, int K, int W, int MV, int NR>
+static inline __attribute__((always_inline))
+void gemm_small_block(int i, int j, int mp, int kk,
+        const R *ar, const R *ai,
+        const R *br, const R *bi,
+        R *cr, R *ci)
+{
+    typedef typename gemm_small_vec<R,W>::type vec;
+    const int lanes = gemm_small_vec<R,W>::lanes;
+    const int k = K ? K : kk;
+    vec accr[MV][NR] = {}, acci[MV][NR] = {};
+
+    for (int p = 0; p < k; p++) {
+        vec va[MV], vai[MV] = {};
+
+        for (int v = 0; v < MV; v++) {
+            memcpy(&va[v], &ar[i + v*lanes + p*mp], sizeof va[v]);
+            if (CPLX)
+                memcpy(&vai[v], &ai[i + v*lanes + p*mp], sizeof vai[v]);
+        }
+        for (int jj = 0; jj < NR; jj++) {
+            const R vbr = br[p + (j+jj)*k];
+            const R vbi = CPLX ? bi[p + (j+jj)*k] : 0;
+
+            for (int v = 0; v < MV; v++) {
+                accr[v][jj] += va[v] * vbr;
+                if (CPLX) {
+                    accr[v][jj] -= vai[v] * vbi;
+                    acci[v][jj] += va[v] * vbi + vai[v] * vbr;
+                }
+            }
+        }
+    }
+
+    for (int jj = 0; jj < NR; jj++)
+        for (int v = 0; v < MV; v++) {
+            memcpy(&cr[i + v*lanes + (j+jj)*mp], &accr[v][jj], sizeof accr[v][jj]);
+            if (CPLX)
+                memcpy(&ci[i + v*lanes + (j+jj)*mp], &acci[v][jj], sizeof acci[v][jj]);
+        }
+}
+
+/**
+ * Compute the mp x n panel of C = A*B. mp is a multiple of the vector
+ * length; rows are computed two vectors at a time where possible.
+ */
+template <typename R, bool CPLX, int K, int W>
+static inline __attribute__((always_inline))
+void gemm_small_panel(int mp, int n, int k,
+        const R *ar, const R *ai,
+        const R *br, const R *bi,
+        R *cr, R *ci)
+{
+    const int lanes = gemm_small_vec<R,W>::lanes;
+    int j = 0;
+
+    for (; j + GEMM_SMALL_NR <= n; j += GEMM_SMALL_NR) {
+        int i = 0;
+        for (; i + 2*lanes <= mp; i += 2*lanes)
+            gemm_small_block<R,CPLX,K,W,2,GEMM_SMALL_NR>(i, j, mp, k, ar, ai, br, bi, cr, ci);
+        for (; i < mp; i += lanes)
+            gemm_small_block<R,CPLX,K,W,1,GEMM_SMALL_NR>(i, j, mp, k, ar, ai, br, bi, cr, ci);
+    }
+    for (; j < n; j++) {
+        int i = 0;
+        for (; i + 2*lanes <= mp; i += 2*lanes)
+            gemm_small_block<R,CPLX,K,W,2,1>(i, j, mp, k, ar, ai, br, bi, cr, ci);
+        for (; i < mp; i += lanes)
+            gemm_small_block<R,CPLX,K,W,1,1>(i, j, mp, k, ar, ai, br, bi, cr, ci);
+    }
+}
+
+/* instantiations of the panel kernel for each vector width */
+
+typedef void (*gemm_small_kernel_t)(int, int, int,
+        const void *, const void *,
+        const void *, const void *,
+        void *, void *);
+
+#if defined(__x86_64__)
+template <typename R, bool CPLX, int K>
+__attribute__((target("avx512f")))
+static void gemm_small_avx512(int mp, int n, int k,
+        const void *ar, const void *ai, const void *br, const void *bi, void *cr, void *ci)
+{
+    gemm_small_panel<R,CPLX,K,64>(mp, n, k, (const R *) ar, (const R *) ai,
+            (const R *) br, (const R *) bi, (R *) cr, (R *) ci);
+}
+
+template <typename R, bool CPLX, int K>
+__attribute__((target("avx2,fma")))
+static void gemm_small_avx2(int mp, int n, int k,
+        const void *ar, const void *ai, const void *br, const void *bi, void *cr, void *ci)
+{
+    gemm_small_panel<R,CPLX,K,32>(mp, n, k, (const R *) ar, (const R *) ai,
+            (const R *) br, (const R *) bi, (R *) cr, (R *) ci);
+}
+#endif
+
+template <typename R, bool CPLX, int K>
+static void gemm_small_generic(int mp, int n, int k,
+        const void *ar, const void *ai, const void *br, const void *bi, void *cr, void *ci)
+{
+    gemm_small_panel<R,CPLX,K,16>(mp, n, k, (const R *) ar, (const R *) ai,
+            (const R *) br, (const R *) bi, (R *) cr, (R *) ci);
+}
+
+/**
+ * Select the kernel for the widest vector width the CPU supports.
+ * Returns the kernel and its vector width in bytes.
+ */
+template <typename R, bool CPLX, int K>
+static gemm_small_kernel_t gemm_small_select(int *width) {
+#if defined(__x86_64__)
+    static const bool have_avx512 = __builtin_cpu_supports("avx512f");
+    static const bool have_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    if (have_avx512) {
+        *width = 64;
+        return &gemm_small_avx512<R,CPLX,K>;
+    }
+    if (have_avx2) {
+        *width = 32;
+        return &gemm_small_avx2<R,CPLX,K>;
+    }
+#endif
+    *width = 16;
+    return &gemm_small_generic<R,CPLX,K>;
+}
+
+template <typename R, bool CPLX>
+static gemm_small_kernel_t gemm_small_kernel(int k, int *width) {
+    switch (k) {
+        case 16:
+            return gemm_small_select<R,CPLX,16>(width);
+        case 32:
+            return gemm_small_select<R,CPLX,32>(width);
+        case 64:
+            return gemm_small_select<R,CPLX,64>(width);
+        default:
+            return gemm_small_select<R,CPLX,0>(width);
+    }
+}
+
+/**
+ * C = alpha*op(A)*op(B) + beta*C on the host, for m, n, k <= GEMM_SMALL_MAX.
+ */
+template <typename T>
+void gemm_small(const CBLAS_TRANSPOSE transa,
+        const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const T alpha,
+        const T *a, const int lda,
+        const T *b, const int ldb,
+        const T beta,
+        T *c, const int ldc)
+{
+    typedef typename gemm_small_traits<T>::real R;
+    constexpr bool cplx = gemm_small_traits<T>::complex;
+    gemm_small_buffers& bufs = gemm_small_get_buffers();
+    R *ar = bufs.panel<R>(0), *ai = bufs.panel<R>(1);
+    R *br = bufs.panel<R>(2), *bi = bufs.panel<R>(3);
+    R *cr = bufs.panel<R>(4), *ci = bufs.panel<R>(5);
+    int width;
+    const gemm_small_kernel_t kernel = gemm_small_kernel<R,cplx>(k, &width);
+    const int lanes = width / sizeof(R);
+    const int mp = (m + lanes - 1) / lanes * lanes;
+
+    switch (transa) {
+        case CblasNoTrans:
+            gemm_small_pack_a<T,CblasNoTrans>(m, mp, k, a, lda, ar, ai);
+            break;
+        case CblasTrans:
+            gemm_small_pack_a<T,CblasTrans>(m, mp, k, a, lda, ar, ai);
+            break;
+        default:
+            gemm_small_pack_a<T,CblasConjTrans>(m, mp, k, a, lda, ar, ai);
+            break;
+    }
+
+    switch (transb) {
+        case CblasNoTrans:
+            gemm_small_pack_b<T,CblasNoTrans>(k, n, b, ldb, br, bi);
+            break;
+        case CblasTrans:
+            gemm_small_pack_b<T,CblasTrans>(k, n, b, ldb, br, bi);
+            break;
+        default:
+            gemm_small_pack_b<T,CblasConjTrans>(k, n, b, ldb, br, bi);
+            break;
+    }
+
+    kernel(mp, n, k, ar, ai, br, bi, cr, ci);
+
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++) {
+            T v = cr[i + j*mp];
+            if constexpr (cplx)
+                __imag__ v = ci[i + j*mp];
+            if (beta == (T) 0)
+                c[i + j*ldc] = alpha * v;
+            else
+                c[i + j*ldc] = alpha * v + beta * c[i + j*ldc];
+        }
+}
+
+#endif
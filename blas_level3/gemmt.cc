@@ -0,0 +1,318 @@
+#include "../common.h"
+#include "../cblas.h"
+#include "../blas.h"
+#include "../conversions.h"
+#include "level3.h"
+#include "../runtime-blas.h"
+#include "../runtime-mem.hpp"
+
+/* columns of C that the host fallback updates at a time */
+#define GEMMT_HOST_BLOCK 32
+
+/*
+ * gemmt on the host, for next BLAS libraries that don't have it (e.g.
+ * OpenBLAS). C is updated a block of columns at a time with the next
+ * library's {@gemm}: the part of the block that is off the diagonal in
+ * place, and the diagonal block through a copy, from which only the uplo
+ * triangle is copied back.
+ */
+template <typename H>
+static void gemmt_host(const char *uplo, const char *transa, const char *transb,
+        const int *n, const int *k,
+        H *alpha,
+        H *a, int *lda,
+        H *b, int *ldb,
+        H *beta,
+        H *c, int *ldc,
+        void (*gemm)(const char *, const char *, const int *, const int *, const int *,
+            H *, H *, int *, H *, int *, H *, H *, int *),
+        const char *fname)
+{
+    const bool upper = runtime_blas_lsame(uplo, "U");
+    const bool nota = runtime_blas_lsame(transa, "N");
+    const bool notb = runtime_blas_lsame(transb, "N");
+    int nb = GEMMT_HOST_BLOCK, info = 0;
+    H diag[GEMMT_HOST_BLOCK * GEMMT_HOST_BLOCK];
+
+    if (!upper && !runtime_blas_lsame(uplo, "L"))
+        info = 1;
+    else if (!nota && !runtime_blas_lsame(transa, "T") && !runtime_blas_lsame(transa, "C"))
+        info = 2;
+    else if (!notb && !runtime_blas_lsame(transb, "T") && !runtime_blas_lsame(transb, "C"))
+        info = 3;
+    else if (*n < 0)
+        info = 4;
+    else if (*k < 0)
+        info = 5;
+    else if (*lda < std::max(1, nota ? *n : *k))
+        info = 8;
+    else if (*ldb < std::max(1, notb ? *k : *n))
+        info = 10;
+    else if (*ldc < std::max(1, *n))
+        info = 13;
+    if (info) {
+        runtime_blas_xerbla(fname, info);
+        return;
+    }
+
+    for (int j = 0; j < *n; j += nb) {
+        int w = std::min(nb, *n - j);
+        int r0 = upper ? 0 : j + w, rows = upper ? j : *n - j - w;
+        H *a_j = nota ? a + j : a + (size_t) j * *lda;
+        H *b_j = notb ? b + (size_t) j * *ldb : b + j;
+
+        if (rows > 0)
+            gemm(transa, transb, &rows, &w, k, alpha,
+                    nota ? a + r0 : a + (size_t) r0 * *lda, lda,
+                    b_j, ldb,
+                    beta, c + r0 + (size_t) j * *ldc, ldc);
+
+        for (int jj = 0; jj < w; ++jj)
+            for (int ii = 0; ii < w; ++ii)
+                diag[ii + jj * nb] = (upper ? ii <= jj : ii >= jj)
+                    ? c[j + ii + (size_t) (j + jj) * *ldc] : H();
+        gemm(transa, transb, &w, &w, k, alpha, a_j, lda, b_j, ldb, beta, diag, &nb);
+        for (int jj = 0; jj < w; ++jj)
+            for (int ii = upper ? 0 : jj; ii <= (upper ? jj : w - 1); ++ii)
+                c[j + ii + (size_t) (j + jj) * *ldc] = diag[ii + jj * nb];
+    }
+}
+
+#define DEF_gemmt_host(p, T)\
+static void p##gemmt_host(const char *uplo, const char *transa, const char *transb,\
+        const int *n, const int *k, T *alpha, T *a, int *lda, T *b, int *ldb,\
+        T *beta, T *c, int *ldc)\
+{\
+    gemmt_host<T>(uplo, transa, transb, n, k, alpha, a, lda, b, ldb, beta, c, ldc,\
+            runtime_blas_next(p##gemm_), #p "gemmt_");\
+}
+
+DEF_gemmt_host(s, float)
+DEF_gemmt_host(d, double)
+DEF_gemmt_host(c, float _Complex)
+DEF_gemmt_host(z, double _Complex)
+
+/* the next BLAS library's ?gemmt_, or the host fallback */
+#define gemmt_next(p) runtime_blas_next_or(p##gemmt_, &p##gemmt_host)
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+
+/*
+ * gemmt has no device routine of its own. syrkx computes
+ *   C = alpha op(A) op(B)^T + beta C
+ * for one triangle of C, with the same op for A and B, so gemmt calls
+ * where op(B) is the transpose of what syrkx reads (transa == transb)
+ * first transpose B into a temporary matrix with geam.
+ */
+
+template <typename T>
+using syrkx_t = cublasStatus_t (*)(cublasHandle_t,
+            cublasFillMode_t,
+            cublasOperation_t,
+            int, int,
+            const T *,
+            const T *, int,
+            const T *, int,
+            const T *,
+            T *, int);
+
+template <typename T>
+void _b2c_gemmt(const CBLAS_UPLO uplo,
+        const CBLAS_TRANSPOSE transa,
+        const CBLAS_TRANSPOSE transb,
+        const int n, const int k,
+        const T alpha,
+        const T *a, const int lda,
+        const T *b, const int ldb,
+        const T beta,
+        T *c, const int ldc,
+        const T one,
+        syrkx_t<T> syrkx_func,
+        geam_t<T> geam_func)
+{
+    const size_t size_b = size(0, ldb, transb == CblasNoTrans ? n : k, sizeof *b);
+    gpuptr<const T> gpu_a(a, size(0, lda, transa == CblasNoTrans ? k : n, sizeof *a));
+    gpuptr<const T> gpu_b(b, size_b);
+    gpuptr<T> gpu_c(c, size(0, ldc, n, sizeof *c));
+    const T zero{};
+
+    if (transa != transb) {
+        call_kernel(
+            syrkx_func(b2c_cublas_handle,
+                    cu(uplo), cu(transa),
+                    n, k,
+                    &alpha,
+                    gpu_a, lda,
+                    gpu_b, ldb,
+                    &beta,
+                    gpu_c, ldc)
+        );
+        return;
+    }
+
+    /* B^T, in the shape of op(A) */
+    const int tmp_rows = transa == CblasNoTrans ? n : k;
+    const int tmp_cols = transa == CblasNoTrans ? k : n;
+    gpuptr<T> gpu_tmp(NULL, size(0, tmp_rows, tmp_cols, sizeof *c));
+
+    call_kernel(
+        geam_func(b2c_cublas_handle,
+                CUBLAS_OP_T, CUBLAS_OP_N,
+                tmp_rows, tmp_cols,
+                &one,
+                gpu_b, ldb,
+                &zero,
+                gpu_tmp, tmp_rows,
+                gpu_tmp, tmp_rows)
+    );
+
+    /*
+     * the second call reads B through the temporary (see scheduler.h),
+     * which is gone by the time a replay plan would launch it
+     */
+    b2c_sched_private();
+    b2c_sched_operand(a, size(0, lda, tmp_cols, sizeof *a), false);
+    b2c_sched_operand(b, size_b, false);
+    b2c_sched_operand(c, size(0, ldc, n, sizeof *c), true);
+    call_kernel(
+        syrkx_func(b2c_cublas_handle,
+                cu(uplo), cu(transa),
+                n, k,
+                &alpha,
+                gpu_a, lda,
+                gpu_tmp, tmp_rows,
+                &beta,
+                gpu_c, ldc)
+    );
+}
+
+/*
+ * Invalid arguments and quick returns are left to the next BLAS library
+ * (or to gemmt_host()), and so are calls too small for the device (see
+ * level3_decide()). syrkx
+ * has no conjugate transpose, so complex calls that conjugate A or B are
+ * forwarded too; real ones treat 'C' as 'T'.
+ */
+#define gemmt_check(p, is_complex)\
+do {\
+    const int nrowa = runtime_blas_lsame(transa, "N") ? *n : *k;\
+    const int nrowb = runtime_blas_lsame(transb, "N") ? *k : *n;\
+    const bool valid_op =\
+        (runtime_blas_lsame(transa, "N") || runtime_blas_lsame(transa, "T")\
+         || (!(is_complex) && runtime_blas_lsame(transa, "C")))\
+        && (runtime_blas_lsame(transb, "N") || runtime_blas_lsame(transb, "T")\
+         || (!(is_complex) && runtime_blas_lsame(transb, "C")));\
+    if (!(runtime_blas_lsame(uplo, "U") || runtime_blas_lsame(uplo, "L")) || !valid_op\
+            || *n <= 0 || *k <= 0 || *alpha == 0\
+            || *lda < std::max(1, nrowa) || *ldb < std::max(1, nrowb)\
+            || *ldc < std::max(1, *n) || !b2c_device_usable())\
+        return gemmt_next(p)(uplo, transa, transb, n, k,\
+                alpha, a, lda, b, ldb, beta, c, ldc);\
+} while (0);\
+callsite_dispatch_to(p##gemmt_, gemmt_next(p),\
+        b2c_shape(*uplo, *transa, *transb, *n, *k, *lda, *ldb, *ldc),\
+        level3_decide((double) *n * *n * *k),\
+        uplo, transa, transb, n, k, alpha, a, lda, b, ldb, beta, c, ldc)
+
+/* real routines treat ConjTrans as Trans */
+static inline CBLAS_TRANSPOSE gemmt_trans(const char *trans) {
+    return runtime_blas_lsame(trans, "N") ? CblasNoTrans : CblasTrans;
+}
+
+#define gemmt_kernels(P) &cublas##P##syrkx, &cublas##P##geam
+#else
+/* clBLAS has no syrkx or geam, so always use the next BLAS library */
+#define gemmt_check(p, is_complex)\
+    return gemmt_next(p)(uplo, transa, transb, n, k,\
+            alpha, a, lda, b, ldb, beta, c, ldc)
+#endif
+
+F77_gemmt(s, float) {
+    gemmt_check(s, false);
+#if USE_CUDA
+    _b2c_gemmt(c_uplo(*uplo), gemmt_trans(transa), gemmt_trans(transb),
+            *n, *k,
+            *alpha,
+            a, *lda,
+            b, *ldb,
+            *beta,
+            c, *ldc,
+            1.0f,
+            gemmt_kernels(S));
+#endif
+}
+
+F77_gemmt(d, double) {
+    gemmt_check(d, false);
+#if USE_CUDA
+    _b2c_gemmt(c_uplo(*uplo), gemmt_trans(transa), gemmt_trans(transb),
+            *n, *k,
+            *alpha,
+            a, *lda,
+            b, *ldb,
+            *beta,
+            c, *ldc,
+            1.0,
+            gemmt_kernels(D));
+#endif
+}
+
+F77_gemmt(c, float _Complex) {
+    gemmt_check(c, true);
+#if USE_CUDA
+    _b2c_gemmt(c_uplo(*uplo), c_trans(*transa), c_trans(*transb),
+            *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(b), *ldb,
+            cu(*beta),
+            cmplx_ptr(c), *ldc,
+            cu(1.0f, 0.0f),
+            gemmt_kernels(C));
+#endif
+}
+
+F77_gemmt(z, double _Complex) {
+    gemmt_check(z, true);
+#if USE_CUDA
+    _b2c_gemmt(c_uplo(*uplo), c_trans(*transa), c_trans(*transb),
+            *n, *k,
+            cu(*alpha),
+            cmplx_ptr(a), *lda,
+            cmplx_ptr(b), *ldb,
+            cu(*beta),
+            cmplx_ptr(c), *ldc,
+            cu(1.0, 0.0),
+            gemmt_kernels(Z));
+#endif
+}
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_gemmt(fname, T, alpha_p, beta_p)\
+do {\
+    char ul = f77_uplo(uplo), rul = f77_flip_uplo(uplo);\
+    char ta = f77_trans(transa), tb = f77_trans(transb);\
+    cblas_dispatch(Layout,\
+        fname(&ul, &ta, &tb, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc),\
+        fname(&rul, &tb, &ta, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) b, (int *) &ldb, (T *) a, (int *) &lda, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__GEMMT(s, float, const float) {
+    cblas_gemmt(sgemmt_, float, &alpha, &beta);
+}
+
+DECLARE_CBLAS__GEMMT(d, double, const double) {
+    cblas_gemmt(dgemmt_, double, &alpha, &beta);
+}
+
+DECLARE_CBLAS__GEMMT(c, float _Complex, const float _Complex *) {
+    cblas_gemmt(cgemmt_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__GEMMT(z, double _Complex, const double _Complex *) {
+    cblas_gemmt(zgemmt_, double _Complex, alpha, beta);
+}
@@ -10,9 +10,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T>
@@ -68,11 +66,11 @@ void _b2c_hemm(const CBLAS_SIDE side,
         hemm_func(clblasColumnMajor, clb(side), clb(uplo),
             m, n,
             alpha,
-            gpu_a, 0, lda,
-            gpu_b, 0, ldb,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_b, gpu_b.offset(), ldb,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -117,7 +115,15 @@ do {\
 
 
 
+/* calls too small for the device go to the host, decided once per call site */
+#define hemm_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*side, *uplo, *m, *n, *lda, *ldb, *ldc),\
+            level3_decide(2.0 * *m * *n * (runtime_blas_lsame(side, "L") ? *m : *n)),\
+            side, uplo, m, n, alpha, a, lda, b, ldb, beta, c, ldc)
+
 F77_hemm(c, float _Complex) {
+    hemm_perf_check(chemm_);
     hemm_check();
     _b2c_hemm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -135,6 +141,7 @@ F77_hemm(c, float _Complex) {
 }
 
 F77_hemm(z, double _Complex) {
+    hemm_perf_check(zhemm_);
     hemm_check();
     _b2c_hemm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -150,3 +157,24 @@ F77_hemm(z, double _Complex) {
 #endif
     );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_hemm(fname, T, alpha_p, beta_p)\
+do {\
+    char s = f77_side(side), ul = f77_uplo(uplo);\
+    char rs = f77_flip_side(side), rul = f77_flip_uplo(uplo);\
+    cblas_dispatch(Layout,\
+        fname(&s, &ul, (int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc),\
+        fname(&rs, &rul, (int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__HEMM(c, float _Complex) {
+    cblas_hemm(chemm_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__HEMM(z, double _Complex) {
+    cblas_hemm(zhemm_, double _Complex, alpha, beta);
+}
@@ -10,9 +10,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T, typename S>
@@ -70,11 +68,11 @@ void _b2c_her2k(const CBLAS_UPLO uplo,
         her2k_func(clblasColumnMajor, clb(uplo), clb(trans),
             n, k,
             alpha,
-            gpu_a, 0, lda,
-            gpu_b, 0, ldb,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_b, gpu_b.offset(), ldb,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -138,7 +136,15 @@ do {\
     }\
 } while (0)
 
+/* calls too small for the device go to the host, decided once per call site */
+#define her2k_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*uplo, *trans, *n, *k, *lda, *ldb, *ldc),\
+            level3_decide(2.0 * *n * *n * *k),\
+            uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc)
+
 F77_her2k(c, float, float _Complex) {
+    her2k_perf_check(cher2k_);
     her2k_check();
     _b2c_her2k(c_uplo(*uplo), c_trans(*trans),
             *n, *k,
@@ -160,6 +166,7 @@ F77_her2k(c, float, float _Complex) {
 }
 
 F77_her2k(z, double, double _Complex) {
+    her2k_perf_check(zher2k_);
     her2k_check();
     _b2c_her2k(c_uplo(*uplo), c_trans(*trans),
             *n, *k,
@@ -179,3 +186,25 @@ F77_her2k(z, double, double _Complex) {
 #endif
             );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_her2k(fname, S, T, conj)\
+do {\
+    char ul = f77_uplo(uplo), tr = f77_trans(trans);\
+    char rul = f77_flip_uplo(uplo), rtr = f77_flip_trans(trans, 'C');\
+    T alpha_conj = conj(*alpha);\
+    cblas_dispatch(Layout,\
+        fname(&ul, &tr, (int *) &n, (int *) &k, (T *) alpha,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (S *) &beta, c, (int *) &ldc),\
+        fname(&rul, &rtr, (int *) &n, (int *) &k, &alpha_conj,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (S *) &beta, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__HER2K(c, float, float _Complex) {
+    cblas_her2k(cher2k_, float, float _Complex, __builtin_conjf);
+}
+
+DECLARE_CBLAS__HER2K(z, double, double _Complex) {
+    cblas_her2k(zher2k_, double, double _Complex, __builtin_conj);
+}
@@ -10,9 +10,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 
@@ -64,10 +62,10 @@ void _b2c_herk(const CBLAS_UPLO uplo,
             clb(uplo), clb(trans),
             n, k,
             alpha,
-            gpu_a, 0, lda,
+            gpu_a, gpu_a.offset(), lda,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -128,7 +126,15 @@ do {\
     }\
 } while (0)
 
+/* calls too small for the device go to the host, decided once per call site */
+#define herk_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*uplo, *trans, *n, *k, *lda, *ldc),\
+            level3_decide((double) *n * *n * *k),\
+            uplo, trans, n, k, alpha, a, lda, beta, c, ldc)
+
 F77_herk(c, float, float _Complex) {
+    herk_perf_check(cherk_);
     herk_check();
     _b2c_herk(c_uplo(*uplo), c_trans(*trans),
             *n, *k,
@@ -145,6 +151,7 @@ F77_herk(c, float, float _Complex) {
 }
 
 F77_herk(z, double, double _Complex) {
+    herk_perf_check(zherk_);
     herk_check();
     _b2c_herk(c_uplo(*uplo), c_trans(*trans),
             *n, *k,
@@ -159,3 +166,24 @@ F77_herk(z, double, double _Complex) {
 #endif
             );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_herk(fname, S, T)\
+do {\
+    char ul = f77_uplo(uplo), tr = f77_trans(trans);\
+    char rul = f77_flip_uplo(uplo), rtr = f77_flip_trans(trans, 'C');\
+    cblas_dispatch(Layout,\
+        fname(&ul, &tr, (int *) &n, (int *) &k, (S *) &alpha,\
+            (T *) a, (int *) &lda, (S *) &beta, c, (int *) &ldc),\
+        fname(&rul, &rtr, (int *) &n, (int *) &k, (S *) &alpha,\
+            (T *) a, (int *) &lda, (S *) &beta, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__HERK(c, float, float _Complex) {
+    cblas_herk(cherk_, float, float _Complex);
+}
+
+DECLARE_CBLAS__HERK(z, double, double _Complex) {
+    cblas_herk(zherk_, double, double _Complex);
+}
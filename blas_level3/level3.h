@@ -1,6 +1,9 @@
 #ifndef BLAS2CUDA_LEVEL3_H
 #define BLAS2CUDA_LEVEL3_H
 #include <complex.h>
+#include "../blas2cuda.h"
+#include "../callsite.h"
+#include "../runtime-blas.h"
 
 static inline void assign_dims(const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE trans,
         int& rows_ref, int& cols_ref,
@@ -25,4 +28,110 @@ static inline void assign_dims(const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE
     }
 }
 
+/**
+ * {@decision}, or B2C_DECIDE_HOST if it needs the device and there is no
+ * device to use.
+ */
+static inline enum b2c_decision b2c_device_decision(enum b2c_decision decision) {
+    if (decision == B2C_DECIDE_HOST || decision == B2C_DECIDE_SMALL)
+        return decision;
+    return b2c_device_usable() ? decision : B2C_DECIDE_HOST;
+}
+
+/**
+ * Look up the cached decision for the caller of the current BLAS wrapper.
+ * The cost model {@decide}, an expression that evaluates to an enum
+ * b2c_decision, is only evaluated on the first call from each (call site,
+ * shape) pair, and calls that would need the device go to the host when
+ * there is none. If the call should run on the host, the next BLAS library
+ * is called with the remaining arguments and the wrapper returns. The
+ * routine is only looked up in the next library for call sites that use
+ * it.
+ */
+#define callsite_dispatch(fname, shape, decide, ...)\
+    callsite_dispatch_to(fname, runtime_blas_func(__func__), shape, decide, __VA_ARGS__)
+
+/**
+ * callsite_dispatch(), but calls that run on the host go to {@host}, which
+ * is only evaluated for call sites that use it.
+ */
+#define callsite_dispatch_to(fname, host, shape, decide, ...)\
+    b2c_callsite_timer cs_timer(__func__, b2c_caller(), shape);\
+    if (b2c_callsite_decision(cs_timer.site) == B2C_DECIDE_UNKNOWN) {\
+        const enum b2c_decision cs_decision = b2c_device_decision(decide);\
+        b2c_callsite_decide(cs_timer.site, cs_decision,\
+                cs_decision == B2C_DECIDE_HOST ? (void *) (host) : NULL);\
+    }\
+    if (b2c_callsite_decision(cs_timer.site) == B2C_DECIDE_HOST) {\
+        (*(typeof(fname) *) cs_timer.site->host_func)(__VA_ARGS__);\
+        return;\
+    }
+
+/* the fewest flops for which level 3 calls other than gemm go to the device */
+#define LEVEL3_DEVICE_MIN_FLOPS (2.0 * 64 * 64 * 64)
+
+/**
+ * The cost model of level 3 routines other than gemm, for a call of
+ * {@flops}: below a few hundred thousand flops, the call costs less on the
+ * host than launching it on the device.
+ */
+#ifndef USE_GPU_ALWAYS
+#define level3_decide(flops)\
+    ((flops) >= LEVEL3_DEVICE_MIN_FLOPS ? B2C_DECIDE_DEVICE : B2C_DECIDE_HOST)
+#else
+#define level3_decide(flops) B2C_DECIDE_DEVICE
+#endif
+
+/*
+ * CBLAS entry points call the F77 routines. A row-major matrix is the
+ * transpose of the same memory read in column-major order, so row-major
+ * calls are mapped onto column-major ones by transposing the whole
+ * equation (e.g. C^T = B^T A^T for gemm). This swaps operands and
+ * dimensions and flips side, uplo and trans; no data is moved or copied.
+ *
+ *   routine     row-major                     column-major
+ *   gemm        ta, tb, m, n, A, B            tb, ta, n, m, B, A
+ *   gemmt       uplo, ta, tb, A, B            uplo', tb, ta, B, A
+ *   symm, hemm  side, uplo, m, n              side', uplo', n, m
+ *   syrk        uplo, trans                   uplo', trans' (N <-> T)
+ *   herk        uplo, trans                   uplo', trans' (N <-> C)
+ *   syr2k       uplo, trans, alpha            uplo', trans' (N <-> T), alpha
+ *   her2k       uplo, trans, alpha            uplo', trans' (N <-> C), conj(alpha)
+ *   trmm, trsm  side, uplo, ta, diag, m, n    side', uplo', ta, diag, n, m
+ *
+ * where side' and uplo' are flipped (Left <-> Right, Upper <-> Lower).
+ */
+static inline char f77_flip_side(const CBLAS_SIDE side) {
+    return side == CblasLeft ? 'R' : side == CblasRight ? 'L' : '?';
+}
+
+/**
+ * {@trans} of a row-major rank-k update, for the column-major routine.
+ * {@transposed} is 'T' for symmetric updates and 'C' for Hermitian ones.
+ * Other ops are passed through, to be rejected by the F77 routine.
+ */
+static inline char f77_flip_trans(const CBLAS_TRANSPOSE trans, const char transposed) {
+    if (trans == CblasNoTrans)
+        return transposed;
+    if (f77_trans(trans) == transposed)
+        return 'N';
+    return f77_trans(trans);
+}
+
+/**
+ * Run {@colmajor} or {@rowmajor}, calls to an F77 routine, depending on
+ * {@layout}. Decisions made by the F77 routine are cached for the caller
+ * of the CBLAS entry point.
+ */
+#define cblas_dispatch(layout, colmajor, rowmajor)\
+do {\
+    b2c_callsite_outer outer(__builtin_return_address(0));\
+    if ((layout) == CblasColMajor)\
+        colmajor;\
+    else if ((layout) == CblasRowMajor)\
+        rowmajor;\
+    else\
+        runtime_blas_xerbla(__func__, 1);\
+} while (0)
+
 #endif
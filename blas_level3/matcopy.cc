@@ -0,0 +1,238 @@
+#include "../common.h"
+#include "../cblas.h"
+#include "../blas.h"
+#include "../conversions.h"
+#include "level3.h"
+#include "../runtime-blas.h"
+#include "../runtime-mem.hpp"
+#include <limits.h>
+
+/*
+ * Scaled matrix copies and transpositions, as in MKL and OpenBLAS. They
+ * move as much data as they compute, so like Level 1 and 2 routines, they
+ * only run on the device (with geam) when their matrices are already
+ * shared with it. Each entry point forwards to its own symbol otherwise.
+ */
+
+#if USE_CUDA
+extern __thread cublasHandle_t b2c_cublas_handle;
+
+/**
+ * A call's matrix in column-major order: op(A) is rows x cols, and is
+ * stored in B as rows_b x cols_b.
+ */
+struct matcopy_shape {
+    CBLAS_TRANSPOSE op;
+    int rows, cols;
+    int rows_b, cols_b;
+};
+
+/**
+ * Whether {@order}, {@trans} and the dimensions are valid and can be run
+ * with geam, which can't conjugate without transposing ('R' for complex
+ * types). Real routines treat 'C' as 'T' and 'R' as 'N'. Empty matrices
+ * are left to the next library too.
+ */
+static bool matcopy_shape_of(char order, char trans,
+        size_t rows, size_t cols, size_t lda, size_t ldb,
+        bool is_complex, struct matcopy_shape *shape)
+{
+    bool row_major;
+
+    switch (order) {
+        case 'C': case 'c': row_major = false; break;
+        case 'R': case 'r': row_major = true; break;
+        default: return false;
+    }
+    switch (trans) {
+        case 'N': case 'n': shape->op = CblasNoTrans; break;
+        case 'T': case 't': shape->op = CblasTrans; break;
+        case 'C': case 'c': shape->op = is_complex ? CblasConjTrans : CblasTrans; break;
+        case 'R': case 'r':
+            if (is_complex)
+                return false;
+            shape->op = CblasNoTrans;
+            break;
+        default: return false;
+    }
+    if (rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX)
+        return false;
+
+    /* a row-major matrix is its transpose in column-major order */
+    shape->rows = row_major ? cols : rows;
+    shape->cols = row_major ? rows : cols;
+    shape->rows_b = shape->op == CblasNoTrans ? shape->rows : shape->cols;
+    shape->cols_b = shape->op == CblasNoTrans ? shape->cols : shape->rows;
+
+    return lda <= INT_MAX && ldb <= INT_MAX
+        && lda >= (size_t) shape->rows && ldb >= (size_t) shape->rows_b;
+}
+
+template <typename T>
+void _b2c_omatcopy(const struct matcopy_shape &shape,
+        const T alpha,
+        const T *a, const int lda,
+        T *b, const int ldb,
+        geam_t<T> geam_func)
+{
+    gpuptr<const T> gpu_a(a, size(0, lda, shape.cols, sizeof *a));
+    gpuptr<T> gpu_b(b, size(0, ldb, shape.cols_b, sizeof *b));
+    const T zero{};
+
+    call_kernel(
+        geam_func(b2c_cublas_handle,
+                cu(shape.op), CUBLAS_OP_N,
+                shape.rows_b, shape.cols_b,
+                &alpha,
+                gpu_a, lda,
+                &zero,
+                gpu_b, ldb,
+                gpu_b, ldb)
+    );
+}
+
+/**
+ * geam can scale A in place, but not transpose it or change its leading
+ * dimension, so those go through a temporary matrix.
+ */
+template <typename T>
+void _b2c_imatcopy(const struct matcopy_shape &shape,
+        const T alpha,
+        T *a, const int lda, const int ldb,
+        const T one,
+        geam_t<T> geam_func)
+{
+    const size_t size_a = std::max(size(0, lda, shape.cols, sizeof *a),
+            size(0, ldb, shape.cols_b, sizeof *a));
+    gpuptr<T> gpu_a(a, size_a);
+    const T zero{};
+
+    if (shape.op == CblasNoTrans && lda == ldb) {
+        call_kernel(
+            geam_func(b2c_cublas_handle,
+                    CUBLAS_OP_N, CUBLAS_OP_N,
+                    shape.rows, shape.cols,
+                    &alpha,
+                    gpu_a, lda,
+                    &zero,
+                    gpu_a, lda,
+                    gpu_a, lda)
+        );
+        return;
+    }
+
+    gpuptr<T> gpu_tmp(NULL, size(0, shape.rows_b, shape.cols_b, sizeof *a));
+
+    call_kernel(
+        geam_func(b2c_cublas_handle,
+                cu(shape.op), CUBLAS_OP_N,
+                shape.rows_b, shape.cols_b,
+                &alpha,
+                gpu_a, lda,
+                &zero,
+                gpu_tmp, shape.rows_b,
+                gpu_tmp, shape.rows_b)
+    );
+
+    /* the second call writes A back from the temporary (see scheduler.h) */
+    b2c_sched_private();
+    b2c_sched_operand(a, size_a, true);
+    call_kernel(
+        geam_func(b2c_cublas_handle,
+                CUBLAS_OP_N, CUBLAS_OP_N,
+                shape.rows_b, shape.cols_b,
+                &one,
+                gpu_tmp, shape.rows_b,
+                &zero,
+                gpu_tmp, shape.rows_b,
+                gpu_a, ldb)
+    );
+}
+
+#define omatcopy_device(P, is_complex, order, trans, rows, cols, alpha, a, lda, b, ldb, one)\
+    ({\
+        struct matcopy_shape shape;\
+        bool ok = matcopy_shape_of(order, trans, rows, cols, lda, ldb, is_complex, &shape)\
+            && b2c_resident(a, b);\
+        if (ok)\
+            _b2c_omatcopy(shape, alpha, a, lda, b, ldb, &cublas##P##geam);\
+        ok;\
+    })
+
+#define imatcopy_device(P, is_complex, order, trans, rows, cols, alpha, a, lda, ldb, one)\
+    ({\
+        struct matcopy_shape shape;\
+        bool ok = matcopy_shape_of(order, trans, rows, cols, lda, ldb, is_complex, &shape)\
+            && b2c_resident(a);\
+        if (ok)\
+            _b2c_imatcopy(shape, alpha, a, lda, ldb, one, &cublas##P##geam);\
+        ok;\
+    })
+#else
+/* clBLAS has no geam, so always use the next BLAS library */
+#define omatcopy_device(...)    false
+#define imatcopy_device(...)    false
+#endif
+
+/*
+ * Entry points for the host type H. dev() and dev_ptr() convert scalars
+ * and pointers to the device types, and sc_val() gets the value of a CBLAS
+ * scalar argument.
+ */
+#define matcopy_entry_points(p, P, H, is_complex, dev, dev_ptr, one, SC, sc_val)\
+F77_omatcopy(p, H) {\
+    if (!omatcopy_device(P, is_complex, *order, *trans, *rows, *cols,\
+                dev(*alpha), dev_ptr((H *) a), *lda, dev_ptr(b), *ldb, one))\
+        runtime_blas_next(p##omatcopy_)(order, trans, rows, cols, alpha, a, lda, b, ldb);\
+}\
+\
+F77_imatcopy(p, H) {\
+    if (!imatcopy_device(P, is_complex, *order, *trans, *rows, *cols,\
+                dev(*alpha), dev_ptr(a), *lda, *ldb, one))\
+        runtime_blas_next(p##imatcopy_)(order, trans, rows, cols, alpha, a, lda, ldb);\
+}\
+\
+DECLARE_CBLAS__OMATCOPY(p, H, SC) {\
+    if (!omatcopy_device(P, is_complex, cblas_matcopy_order(Layout),\
+                cblas_matcopy_trans(trans), rows, cols,\
+                dev(sc_val(alpha)), dev_ptr((H *) a), lda, dev_ptr(b), ldb, one))\
+        runtime_blas_next(cblas_##p##omatcopy)(Layout, trans, rows, cols, alpha, a, lda, b, ldb);\
+}\
+\
+DECLARE_CBLAS__IMATCOPY(p, H, SC) {\
+    if (!imatcopy_device(P, is_complex, cblas_matcopy_order(Layout),\
+                cblas_matcopy_trans(trans), rows, cols,\
+                dev(sc_val(alpha)), dev_ptr(a), lda, ldb, one))\
+        runtime_blas_next(cblas_##p##imatcopy)(Layout, trans, rows, cols, alpha, a, lda, ldb);\
+}\
+\
+DECLARE_MKL__OMATCOPY(p, H) {\
+    if (!omatcopy_device(P, is_complex, ordering, trans, rows, cols,\
+                dev(alpha), dev_ptr((H *) a), lda, dev_ptr(b), ldb, one))\
+        runtime_blas_next(mkl_##p##omatcopy)(ordering, trans, rows, cols, alpha, a, lda, b, ldb);\
+}\
+\
+DECLARE_MKL__IMATCOPY(p, H) {\
+    if (!imatcopy_device(P, is_complex, ordering, trans, rows, cols,\
+                dev(alpha), dev_ptr(ab), lda, ldb, one))\
+        runtime_blas_next(mkl_##p##imatcopy)(ordering, trans, rows, cols, alpha, ab, lda, ldb);\
+}
+
+static inline char cblas_matcopy_order(const CBLAS_LAYOUT layout) {
+    return layout == CblasColMajor ? 'C' : layout == CblasRowMajor ? 'R' : '?';
+}
+
+/* CblasConjNoTrans (114) is an OpenBLAS extension */
+static inline char cblas_matcopy_trans(const CBLAS_TRANSPOSE trans) {
+    return (int) trans == 114 ? 'R' : f77_trans(trans);
+}
+
+#define matcopy_real(x)     (x)
+#define matcopy_deref(x)    (*(x))
+
+matcopy_entry_points(s, S, float, false, matcopy_real, matcopy_real, 1.0f, const float, matcopy_real)
+matcopy_entry_points(d, D, double, false, matcopy_real, matcopy_real, 1.0, const double, matcopy_real)
+matcopy_entry_points(c, C, float _Complex, true, cu, cmplx_ptr, cu(1.0f, 0.0f),
+        const float _Complex *, matcopy_deref)
+matcopy_entry_points(z, Z, double _Complex, true, cu, cmplx_ptr, cu(1.0, 0.0),
+        const double _Complex *, matcopy_deref)
@@ -10,9 +10,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T, typename S>
@@ -69,11 +67,11 @@ void _b2c_symm(const CBLAS_SIDE side,
         symm_func(clblasColumnMajor, clb(side), clb(uplo),
             m, n,
             alpha,
-            gpu_a, 0, lda,
-            gpu_b, 0, ldb,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_b, gpu_b.offset(), ldb,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -121,7 +119,15 @@ do {\
     }\
 } while (0)
 
+/* calls too small for the device go to the host, decided once per call site */
+#define symm_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*side, *uplo, *m, *n, *lda, *ldb, *ldc),\
+            level3_decide(2.0 * *m * *n * (runtime_blas_lsame(side, "L") ? *m : *n)),\
+            side, uplo, m, n, alpha, a, lda, b, ldb, beta, c, ldc)
+
 F77_symm(s, float) {
+    symm_perf_check(ssymm_);
     symm_check();
     _b2c_symm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -139,6 +145,7 @@ F77_symm(s, float) {
 }
 
 F77_symm(d, double) {
+    symm_perf_check(dsymm_);
     symm_check();
     _b2c_symm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -156,6 +163,7 @@ F77_symm(d, double) {
 }
 
 F77_symm(c, float _Complex) {
+    symm_perf_check(csymm_);
     symm_check();
     _b2c_symm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -181,6 +189,7 @@ F77_symm(c, float _Complex) {
 }
 
 F77_symm(z, double _Complex) {
+    symm_perf_check(zsymm_);
     symm_check();
     _b2c_symm(c_side(*side), c_uplo(*uplo),
             *m, *n, 
@@ -196,3 +205,32 @@ F77_symm(z, double _Complex) {
 #endif
             );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_symm(fname, T, alpha_p, beta_p)\
+do {\
+    char s = f77_side(side), ul = f77_uplo(uplo);\
+    char rs = f77_flip_side(side), rul = f77_flip_uplo(uplo);\
+    cblas_dispatch(Layout,\
+        fname(&s, &ul, (int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc),\
+        fname(&rs, &rul, (int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__SYMM(s, float, const float) {
+    cblas_symm(ssymm_, float, &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYMM(d, double, const double) {
+    cblas_symm(dsymm_, double, &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYMM(c, float _Complex, const float _Complex *) {
+    cblas_symm(csymm_, float _Complex, alpha, beta);
+}
+
+DECLARE_CBLAS__SYMM(z, double _Complex, const double _Complex *) {
+    cblas_symm(zsymm_, double _Complex, alpha, beta);
+}
@@ -7,9 +7,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T, typename S>
@@ -67,11 +65,11 @@ void _b2c_syr2k(const CBLAS_UPLO uplo,
             clb(uplo), clb(trans),
             n, k,
             alpha,
-            gpu_a, 0, lda,
-            gpu_b, 0, ldb,
+            gpu_a, gpu_a.offset(), lda,
+            gpu_b, gpu_b.offset(), ldb,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -143,7 +141,15 @@ bool syr2k_check(const char *func_name,
     return true;
 }
 
+/* calls too small for the device go to the host, decided once per call site */
+#define syr2k_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*uplo, *trans, *n, *k, *lda, *ldb, *ldc),\
+            level3_decide(2.0 * *n * *n * *k),\
+            uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc)
+
 F77_syr2k(s, float) {
+    syr2k_perf_check(ssyr2k_);
     if (!syr2k_check(__func__, uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc))
         return;
     _b2c_syr2k(c_uplo(*uplo), c_trans(*trans),
@@ -162,6 +168,7 @@ F77_syr2k(s, float) {
 }
 
 F77_syr2k(d, double) {
+    syr2k_perf_check(dsyr2k_);
     if (!syr2k_check(__func__, uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc))
         return;
     _b2c_syr2k(c_uplo(*uplo), c_trans(*trans),
@@ -180,6 +187,7 @@ F77_syr2k(d, double) {
 }
 
 F77_syr2k(c, float _Complex) {
+    syr2k_perf_check(csyr2k_);
     if (!syr2k_check(__func__, uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc))
         return;
     _b2c_syr2k(c_uplo(*uplo), c_trans(*trans),
@@ -198,6 +206,7 @@ F77_syr2k(c, float _Complex) {
 }
 
 F77_syr2k(z, double _Complex) {
+    syr2k_perf_check(zsyr2k_);
     if (!syr2k_check(__func__, uplo, trans, n, k, alpha, a, lda, b, ldb, beta, c, ldc))
         return;
     _b2c_syr2k(c_uplo(*uplo), c_trans(*trans),
@@ -214,3 +223,33 @@ F77_syr2k(z, double _Complex) {
 #endif
             );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+// Real routines treat ConjTrans as Trans.
+
+#define cblas_syr2k(fname, T, op, alpha_p, beta_p)\
+do {\
+    char ul = f77_uplo(uplo), tr = f77_trans(trans);\
+    char rul = f77_flip_uplo(uplo), rtr = f77_flip_trans(op, 'T');\
+    cblas_dispatch(Layout,\
+        fname(&ul, &tr, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc),\
+        fname(&rul, &rtr, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) b, (int *) &ldb, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__SYR2K(s, float, const float) {
+    cblas_syr2k(ssyr2k_, float, (trans == CblasConjTrans ? CblasTrans : trans), &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYR2K(d, double, const double) {
+    cblas_syr2k(dsyr2k_, double, (trans == CblasConjTrans ? CblasTrans : trans), &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYR2K(c, float _Complex, const float _Complex *) {
+    cblas_syr2k(csyr2k_, float _Complex, trans, alpha, beta);
+}
+
+DECLARE_CBLAS__SYR2K(z, double _Complex, const double _Complex *) {
+    cblas_syr2k(zsyr2k_, double _Complex, trans, alpha, beta);
+}
@@ -7,20 +7,12 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
-#endif
-
-#if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename T>
 #if USE_CUDA
-using syr2k_t = cublasStatus_t (*)(cublasHandle_t,
+using syrk_t = cublasStatus_t (*)(cublasHandle_t,
             cublasFillMode_t, cublasOperation_t,
             int, int,
             const T *,
@@ -55,8 +47,8 @@ void _b2c_syrk(const CBLAS_UPLO uplo,
 
     call_kernel(
 #if USE_CUDA
-        syrk_func(b2c_handle,
-                cuplo, ctrans,
+        syrk_func(b2c_cublas_handle,
+                cu(uplo), cu(trans),
                 n, k,
                 &alpha,
                 gpu_a, lda,
@@ -67,10 +59,10 @@ void _b2c_syrk(const CBLAS_UPLO uplo,
             clb(uplo), clb(trans),
             n, k,
             alpha,
-            gpu_a, 0, lda,
+            gpu_a, gpu_a.offset(), lda,
             beta,
-            gpu_c, 0, ldc,
-            1, &opencl_cmd_queue, 0, NULL, NULL)
+            gpu_c, gpu_c.offset(), ldc,
+            b2c_queue_args())
 #endif
     );
 }
@@ -145,7 +137,15 @@ bool syrk_check(const char *func_name,
     return true;
 }
 
+/* calls too small for the device go to the host, decided once per call site */
+#define syrk_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*uplo, *trans, *n, *k, *lda, *ldc),\
+            level3_decide((double) *n * *n * *k),\
+            uplo, trans, n, k, alpha, a, lda, beta, c, ldc)
+
 F77_syrk(s, float) {
+    syrk_perf_check(ssyrk_);
     if (!syrk_check(__func__, uplo, trans, n, k, alpha, a, lda, beta, c, ldc))
         return;
     _b2c_syrk(c_uplo(*uplo), c_trans(*trans),
@@ -163,6 +163,7 @@ F77_syrk(s, float) {
 }
 
 F77_syrk(d, double) {
+    syrk_perf_check(dsyrk_);
     if (!syrk_check(__func__, uplo, trans, n, k, alpha, a, lda, beta, c, ldc))
         return;
     _b2c_syrk(c_uplo(*uplo), c_trans(*trans),
@@ -180,6 +181,7 @@ F77_syrk(d, double) {
 }
 
 F77_syrk(c, float _Complex) {
+    syrk_perf_check(csyrk_);
     if (!syrk_check(__func__, uplo, trans, n, k, alpha, a, lda, beta, c, ldc))
         return;
     _b2c_syrk(c_uplo(*uplo), c_trans(*trans),
@@ -197,6 +199,7 @@ F77_syrk(c, float _Complex) {
 }
 
 F77_syrk(z, double _Complex) {
+    syrk_perf_check(zsyrk_);
     if (!syrk_check(__func__, uplo, trans, n, k, alpha, a, lda, beta, c, ldc))
         return;
     _b2c_syrk(c_uplo(*uplo), c_trans(*trans),
@@ -212,3 +215,33 @@ F77_syrk(z, double _Complex) {
 #endif
     );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+// Real routines treat ConjTrans as Trans.
+
+#define cblas_syrk(fname, T, op, alpha_p, beta_p)\
+do {\
+    char ul = f77_uplo(uplo), tr = f77_trans(trans);\
+    char rul = f77_flip_uplo(uplo), rtr = f77_flip_trans(op, 'T');\
+    cblas_dispatch(Layout,\
+        fname(&ul, &tr, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) beta_p, c, (int *) &ldc),\
+        fname(&rul, &rtr, (int *) &n, (int *) &k, (T *) alpha_p,\
+            (T *) a, (int *) &lda, (T *) beta_p, c, (int *) &ldc));\
+} while (0)
+
+DECLARE_CBLAS__SYRK(s, float, const float) {
+    cblas_syrk(ssyrk_, float, (trans == CblasConjTrans ? CblasTrans : trans), &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYRK(d, double, const double) {
+    cblas_syrk(dsyrk_, double, (trans == CblasConjTrans ? CblasTrans : trans), &alpha, &beta);
+}
+
+DECLARE_CBLAS__SYRK(c, float _Complex, const float _Complex *) {
+    cblas_syrk(csyrk_, float _Complex, trans, alpha, beta);
+}
+
+DECLARE_CBLAS__SYRK(z, double _Complex, const double _Complex *) {
+    cblas_syrk(zsyrk_, double _Complex, trans, alpha, beta);
+}
@@ -7,7 +7,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
+extern __thread cublasHandle_t b2c_cublas_handle;
 
 template <typename T>
 using trmm_t = cublasStatus_t (*)(cublasHandle_t,
@@ -21,8 +21,6 @@ using trmm_t = cublasStatus_t (*)(cublasHandle_t,
             const T *, int,
             T *, int);
 #else
-extern cl_command_queue opencl_cmd_queue;
-
 template <typename T>
 using trmm_t = clblasStatus (*)(clblasOrder order, 
                                 clblasSide side,
@@ -55,7 +53,7 @@ void _b2c_trmm(const CBLAS_SIDE side,
 
     call_kernel(
 #if USE_CUDA
-        trmm_func(b2c_handle,
+        trmm_func(b2c_cublas_handle,
                 cu(side), cu(uplo),
                 cu(transa), cu(diag),
                 m, n,
@@ -69,11 +67,9 @@ void _b2c_trmm(const CBLAS_SIDE side,
                   clb(transa), clb(diag),
                   m, n,
                   alpha,
-                  gpu_a, 0, lda,
-                  gpu_b, 0, ldb,
-                  1, &opencl_cmd_queue,
-                  0, NULL,
-                  NULL)
+                  gpu_a, gpu_a.offset(), lda,
+                  gpu_b, gpu_b.offset(), ldb,
+                  b2c_queue_args())
 #endif
     );
 }
@@ -136,7 +132,15 @@ bool trmm_check(const char *func_name,
     return true;
 }
 
+/* calls too small for the device go to the host, decided once per call site */
+#define trmm_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*side, *uplo, *transa, *diag, *m, *n, *lda, *ldb),\
+            level3_decide((double) *m * *n * (runtime_blas_lsame(side, "L") ? *m : *n)),\
+            side, uplo, transa, diag, m, n, alpha, a, lda, b, ldb)
+
 F77_trmm(s, float) {
+    trmm_perf_check(strmm_);
     if (!trmm_check(__func__, 
                     side, uplo, transa, diag, 
                     m, n, alpha, a, lda, b, ldb))
@@ -156,6 +160,7 @@ F77_trmm(s, float) {
 }
 
 F77_trmm(d, double) {
+    trmm_perf_check(dtrmm_);
     if (!trmm_check(__func__, 
                     side, uplo, transa, diag, 
                     m, n, alpha, a, lda, b, ldb))
@@ -175,6 +180,7 @@ F77_trmm(d, double) {
 }
 
 F77_trmm(c, float _Complex) {
+    trmm_perf_check(ctrmm_);
     if (!trmm_check(__func__, 
                     side, uplo, transa, diag, 
                     m, n, alpha, a, lda, b, ldb))
@@ -194,6 +200,7 @@ F77_trmm(c, float _Complex) {
 }
 
 F77_trmm(z, double _Complex) {
+    trmm_perf_check(ztrmm_);
     if (!trmm_check(__func__, 
                     side, uplo, transa, diag, 
                     m, n, alpha, a, lda, b, ldb))
@@ -211,3 +218,32 @@ F77_trmm(z, double _Complex) {
 #endif
     );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_trmm(fname, T, alpha_p)\
+do {\
+    char s = f77_side(side), ul = f77_uplo(uplo), ta = f77_trans(transa), dg = f77_diag(diag);\
+    char rs = f77_flip_side(side), rul = f77_flip_uplo(uplo);\
+    cblas_dispatch(Layout,\
+        fname(&s, &ul, &ta, &dg, (int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) a, (int *) &lda, b, (int *) &ldb),\
+        fname(&rs, &rul, &ta, &dg, (int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) a, (int *) &lda, b, (int *) &ldb));\
+} while (0)
+
+DECLARE_CBLAS__TRMM(s, float, const float) {
+    cblas_trmm(strmm_, float, &alpha);
+}
+
+DECLARE_CBLAS__TRMM(d, double, const double) {
+    cblas_trmm(dtrmm_, double, &alpha);
+}
+
+DECLARE_CBLAS__TRMM(c, float _Complex, const float _Complex *) {
+    cblas_trmm(ctrmm_, float _Complex, alpha);
+}
+
+DECLARE_CBLAS__TRMM(z, double _Complex, const double _Complex *) {
+    cblas_trmm(ztrmm_, double _Complex, alpha);
+}
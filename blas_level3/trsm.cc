@@ -8,9 +8,7 @@
 #include "../runtime-mem.hpp"
 
 #if USE_CUDA
-extern cublasHandle_t b2c_cublas_handle;
-#else
-extern cl_command_queue opencl_cmd_queue;
+extern __thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 template <typename S, typename T>
@@ -52,7 +50,7 @@ void _b2c_trsm(const CBLAS_SIDE side,
     gpuptr<T> gpu_b(b, size(0, ldb, n, sizeof *b));
     call_kernel(
 #if USE_CUDA
-        trsm_func(b2c_handle,
+        trsm_func(b2c_cublas_handle,
                 cu(side), cu(uplo),
                 cu(transa), cu(diag),
                 m, n,
@@ -65,9 +63,9 @@ void _b2c_trsm(const CBLAS_SIDE side,
                   clb(transa), clb(diag),
                   m, n,
                   alpha,
-                  gpu_a, 0, lda,
-                  gpu_b, 0, ldb,
-                  1, &opencl_cmd_queue, 0, NULL, NULL)
+                  gpu_a, gpu_a.offset(), lda,
+                  gpu_b, gpu_b.offset(), ldb,
+                  b2c_queue_args())
 #endif
     );
 }
@@ -131,7 +129,15 @@ bool trsm_check(const char *func_name,
     return true;
 }
 
+/* calls too small for the device go to the host, decided once per call site */
+#define trsm_perf_check(fname)\
+    callsite_dispatch(fname,\
+            b2c_shape(*side, *uplo, *transa, *diag, *m, *n, *lda, *ldb),\
+            level3_decide((double) *m * *n * (runtime_blas_lsame(side, "L") ? *m : *n)),\
+            side, uplo, transa, diag, m, n, alpha, a, lda, b, ldb)
+
 F77_trsm(s, float) {
+    trsm_perf_check(strsm_);
     if (!trsm_check(__func__,
                     side, uplo, transa, diag,
                     m, n, alpha,
@@ -152,6 +158,7 @@ F77_trsm(s, float) {
 }
 
 F77_trsm(d, double) {
+    trsm_perf_check(dtrsm_);
     if (!trsm_check(__func__,
                     side, uplo, transa, diag,
                     m, n, alpha,
@@ -173,6 +180,7 @@ F77_trsm(d, double) {
 
 
 F77_trsm(c, float _Complex) {
+    trsm_perf_check(ctrsm_);
     if (!trsm_check(__func__,
                     side, uplo, transa, diag,
                     m, n, alpha,
@@ -193,6 +201,7 @@ F77_trsm(c, float _Complex) {
 }
 
 F77_trsm(z, double _Complex) {
+    trsm_perf_check(ztrsm_);
     if (!trsm_check(__func__,
                     side, uplo, transa, diag,
                     m, n, alpha,
@@ -211,3 +220,32 @@ F77_trsm(z, double _Complex) {
 #endif
     );
 }
+
+// CBLAS wrappers (see level3.h for the row-major mapping)
+
+#define cblas_trsm(fname, T, alpha_p)\
+do {\
+    char s = f77_side(side), ul = f77_uplo(uplo), ta = f77_trans(transa), dg = f77_diag(diag);\
+    char rs = f77_flip_side(side), rul = f77_flip_uplo(uplo);\
+    cblas_dispatch(Layout,\
+        fname(&s, &ul, &ta, &dg, (int *) &m, (int *) &n, (T *) alpha_p,\
+            (T *) a, (int *) &lda, b, (int *) &ldb),\
+        fname(&rs, &rul, &ta, &dg, (int *) &n, (int *) &m, (T *) alpha_p,\
+            (T *) a, (int *) &lda, b, (int *) &ldb));\
+} while (0)
+
+DECLARE_CBLAS__TRSM(s, float, const float) {
+    cblas_trsm(strsm_, float, &alpha);
+}
+
+DECLARE_CBLAS__TRSM(d, double, const double) {
+    cblas_trsm(dtrsm_, double, &alpha);
+}
+
+DECLARE_CBLAS__TRSM(c, float _Complex, const float _Complex *) {
+    cblas_trsm(ctrsm_, float _Complex, alpha);
+}
+
+DECLARE_CBLAS__TRSM(z, double _Complex, const double _Complex *) {
+    cblas_trsm(ztrsm_, double _Complex, alpha);
+}
@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+#include "callsite.h"
+#include "common.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define CALLSITE_TABLE_SIZE 4096   /* must be a power of two */
+
+/*
+ * Open-addressed table of call sites. Entries are never removed, so
+ * lookups can probe without locking; only insertions take the lock. An
+ * entry is published by the release store to its used flag, after its key
+ * is written, and its decision by a release store of its own (see
+ * b2c_callsite_decide()), so lookups read both with acquire loads.
+ */
+static struct b2c_callsite callsites[CALLSITE_TABLE_SIZE];
+static unsigned num_callsites;
+static pthread_mutex_t callsites_lock = PTHREAD_MUTEX_INITIALIZER;
+
+__thread const void *b2c_callsite_caller;
+
+static inline uint64_t callsite_hash(const void *ret_addr, uint64_t shape) {
+    return b2c_shape_hash(shape, (int64_t)(uintptr_t) ret_addr);
+}
+
+static inline bool callsite_matches(const struct b2c_callsite *site,
+                                    const char *func,
+                                    const void *ret_addr,
+                                    uint64_t shape) {
+    return site->ret_addr == ret_addr && site->shape == shape && site->func == func;
+}
+
+static struct b2c_callsite *callsite_find(const char *func, const void *ret_addr, uint64_t shape, unsigned *slot) {
+    unsigned i = callsite_hash(ret_addr, shape) & (CALLSITE_TABLE_SIZE - 1);
+
+    for (unsigned n = 0; n < CALLSITE_TABLE_SIZE; n++, i = (i + 1) & (CALLSITE_TABLE_SIZE - 1)) {
+        struct b2c_callsite *site = &callsites[i];
+
+        if (!__atomic_load_n(&site->used, __ATOMIC_ACQUIRE)) {
+            *slot = i;
+            return NULL;
+        }
+        if (callsite_matches(site, func, ret_addr, shape))
+            return site;
+    }
+
+    *slot = CALLSITE_TABLE_SIZE;
+    return NULL;
+}
+
+struct b2c_callsite *b2c_callsite_get(const char *func, const void *ret_addr, uint64_t shape) {
+    struct b2c_callsite *site;
+    unsigned slot;
+
+    if ((site = callsite_find(func, ret_addr, shape, &slot)))
+        return site;
+
+    pthread_mutex_lock(&callsites_lock);
+    /* another thread may have inserted this entry in the meantime */
+    if (!(site = callsite_find(func, ret_addr, shape, &slot))
+            && slot < CALLSITE_TABLE_SIZE
+            && num_callsites < CALLSITE_TABLE_SIZE / 2) {
+        site = &callsites[slot];
+        site->func = func;
+        site->ret_addr = ret_addr;
+        site->shape = shape;
+        site->decision = B2C_DECIDE_UNKNOWN;
+        __atomic_store_n(&site->used, true, __ATOMIC_RELEASE);
+        num_callsites++;
+    }
+    pthread_mutex_unlock(&callsites_lock);
+
+    return site;
+}
+
+void b2c_callsite_decide(struct b2c_callsite *site, enum b2c_decision decision, void *host_func) {
+    site->host_func = host_func;
+    __atomic_store_n(&site->decision, decision, __ATOMIC_RELEASE);
+}
+
+void b2c_callsite_record(struct b2c_callsite *site, const struct timespec *start) {
+    struct timespec end;
+    int64_t elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+    elapsed = (end.tv_sec - start->tv_sec) * 1000000000L + (end.tv_nsec - start->tv_nsec);
+
+    __sync_fetch_and_add(&site->count, 1);
+    __sync_fetch_and_add(&site->total_ns, elapsed > 0 ? elapsed : 0);
+}
+
+int b2c_callsite_dump(const char *filename) {
+    int fd;
+    int nsites = 0;
+
+    if (!num_callsites)
+        return 0;
+
+    if ((fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return -1;
+
+    writef(fd, "Function, Caller, Symbol, Shape, Decision, Calls, Total time (ns)\n");
+    for (unsigned i = 0; i < CALLSITE_TABLE_SIZE; i++) {
+        const struct b2c_callsite *site = &callsites[i];
+        Dl_info info;
+        const char *sym = "??";
+        uintptr_t offset = 0;
+
+        if (!__atomic_load_n(&site->used, __ATOMIC_ACQUIRE))
+            continue;
+
+        if (dladdr(site->ret_addr, &info) && info.dli_sname) {
+            sym = info.dli_sname;
+            offset = (uintptr_t) site->ret_addr - (uintptr_t) info.dli_saddr;
+        }
+
+        writef(fd, "%s, %p, %s+%#" PRIxPTR ", %016" PRIx64 ", %s, %" PRIu64 ", %" PRIu64 "\n",
+                site->func, site->ret_addr, sym, offset, site->shape,
+                b2c_decision_tostr(b2c_callsite_decision(site)), site->count, site->total_ns);
+        nsites++;
+    }
+    close(fd);
+
+    return nsites;
+}
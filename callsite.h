@@ -0,0 +1,175 @@
+#ifndef CALLSITE_H
+#define CALLSITE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Where a call from a particular call site is executed.
+ */
+enum b2c_decision {
+    B2C_DECIDE_UNKNOWN,     /* the cost model has not been consulted yet */
+    B2C_DECIDE_HOST,        /* forward to the next BLAS library */
+    B2C_DECIDE_SMALL,       /* run on our own host kernels for small shapes */
+    B2C_DECIDE_DEVICE,      /* run on the device */
+    B2C_DECIDE_BATCH,       /* run on the device, batched with similar calls */
+    B2C_DECIDE_GATHER       /* like BATCH, with similar calls of other threads, or on the host */
+};
+
+static inline const char *b2c_decision_tostr(enum b2c_decision decision) {
+    switch (decision) {
+        case B2C_DECIDE_HOST:
+            return "host";
+        case B2C_DECIDE_SMALL:
+            return "small";
+        case B2C_DECIDE_DEVICE:
+            return "device";
+        case B2C_DECIDE_BATCH:
+            return "batch";
+        case B2C_DECIDE_GATHER:
+            return "gather";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * A cached offload decision for a (caller, shape) pair.
+ * Large applications call BLAS from a few call sites, each with stable
+ * shapes, so the decision made by the cost model on the first call is
+ * reused for later calls.
+ */
+struct b2c_callsite {
+    const char *func;           /* name of the intercepted routine */
+    const void *ret_addr;       /* return address of the caller */
+    uint64_t shape;             /* hash of the arguments the cost model depends on */
+    enum b2c_decision decision;
+    void *host_func;            /* the routine in the next BLAS library */
+    uint64_t count;             /* number of calls */
+    uint64_t total_ns;          /* total time spent in calls */
+    bool used;
+};
+
+/**
+ * The caller of the outermost wrapper on this thread, when a wrapper calls
+ * another wrapper (e.g. CBLAS entry points call the F77 routines), so that
+ * decisions are cached per call site in the application. NULL otherwise.
+ */
+extern __thread const void *b2c_callsite_caller;
+
+/**
+ * Hashes a list of shape arguments (dimensions, leading dimensions,
+ * transpose/uplo/side characters).
+ */
+static inline uint64_t b2c_shape_hash(uint64_t hash, int64_t value) {
+    /* FNV-1a */
+    for (unsigned i = 0; i < sizeof value; i++) {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define B2C_SHAPE_HASH_INIT 0xcbf29ce484222325ULL
+
+/**
+ * Find the cached entry for this call site, or create a new one with an
+ * unknown decision. If the table is full, returns NULL.
+ */
+struct b2c_callsite *b2c_callsite_get(const char *func, const void *ret_addr, uint64_t shape);
+
+/**
+ * Record the decision of the cost model for this call site, along with
+ * the host function to call when the decision is B2C_DECIDE_HOST.
+ */
+void b2c_callsite_decide(struct b2c_callsite *site, enum b2c_decision decision, void *host_func);
+
+/**
+ * The decision recorded for this call site, once b2c_callsite_decide()
+ * has published it, or B2C_DECIDE_UNKNOWN. The host function is valid once
+ * the decision is known.
+ */
+static inline enum b2c_decision b2c_callsite_decision(const struct b2c_callsite *site) {
+    return __atomic_load_n(&site->decision, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Account for a call from this call site that started at {@start}.
+ */
+void b2c_callsite_record(struct b2c_callsite *site, const struct timespec *start);
+
+/**
+ * Write per-callsite statistics as CSV to {@filename}.
+ * @return the number of call sites written, or < 0 on error
+ */
+int b2c_callsite_dump(const char *filename);
+
+#ifdef __cplusplus
+};
+
+/**
+ * Hash all shape arguments of a call.
+ */
+template <typename... Args>
+static inline uint64_t b2c_shape(Args... args) {
+    uint64_t hash = B2C_SHAPE_HASH_INIT;
+    ((hash = b2c_shape_hash(hash, (int64_t) args)), ...);
+    return hash;
+}
+
+/**
+ * RAII for wrappers that call other wrappers.
+ */
+struct b2c_callsite_outer {
+    const void *saved;
+
+    b2c_callsite_outer(const void *ret_addr) : saved(b2c_callsite_caller) {
+        if (!saved)
+            b2c_callsite_caller = ret_addr;
+    }
+
+    ~b2c_callsite_outer() {
+        b2c_callsite_caller = saved;
+    }
+};
+
+/**
+ * The return address of the caller of the outermost wrapper.
+ */
+#define b2c_caller() \
+    (b2c_callsite_caller ? b2c_callsite_caller : __builtin_return_address(0))
+
+/**
+ * RAII for call site lookup and timing.
+ * If the table is full, a temporary entry is used so that the cost model
+ * is consulted on every call.
+ */
+struct b2c_callsite_timer {
+    struct b2c_callsite *site;
+    struct b2c_callsite local;
+    struct timespec start;
+
+    b2c_callsite_timer(const char *func, const void *ret_addr, uint64_t shape) : local() {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+        if (!(site = b2c_callsite_get(func, ret_addr, shape))) {
+            local.func = func;
+            local.ret_addr = ret_addr;
+            local.shape = shape;
+            site = &local;
+        }
+    }
+
+    ~b2c_callsite_timer() {
+        if (site != &local)
+            b2c_callsite_record(site, &start);
+    }
+};
+#endif
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef CBLAS_H
 #define CBLAS_H
 
-/* simply define DECLARE_CBLAS 1 before including this file */
+/* the CBLAS entry points implemented in blas_level1, blas_level2 and blas_level3 */
 
 #include <stdlib.h>
 
@@ -42,32 +42,34 @@ static inline int get_lda(CBLAS_LAYOUT layout, int rows, int cols) {
 
 /* BLAS Level 1 routines */
 
+/*
+ * The Level 1 and 2 entry points are implemented in blas_level1 and
+ * blas_level2 and are always declared. As for Level 3, complex scalars are
+ * passed by pointer and real ones (e.g. alpha of ?her) by value.
+ */
+
 /* cblas_?asum - sum of vector magnitudes (functions) */
-#define DECLARE_CBLAS__ASUM(prefix, type)    \
-type cblas_##prefix##asum (const int n, const type *x, const int incx)
-
-#if DECLARE_CBLAS
-DECLARE_CBLAS__ASUM(s, float);
-DECLARE_CBLAS__ASUM(sc, float _Complex);
-DECLARE_CBLAS__ASUM(d, double);
-DECLARE_CBLAS__ASUM(dz, double _Complex);
-#endif
+#define DECLARE_CBLAS__ASUM(prefix, S, T)   \
+S cblas_##prefix##asum (const int n, const T *x, const int incx)
+
+DECLARE_CBLAS__ASUM(s, float, float);
+DECLARE_CBLAS__ASUM(sc, float, float _Complex);
+DECLARE_CBLAS__ASUM(d, double, double);
+DECLARE_CBLAS__ASUM(dz, double, double _Complex);
 
 /* cblas_?axpy - scalar-vector product (routines) */
-#define DECLARE_CBLAS__AXPY(prefix, type)   \
+#define DECLARE_CBLAS__AXPY(prefix, type, SC)\
 void cblas_##prefix##axpy (const int n,     \
-        const type a,                       \
+        SC a,                               \
         const type *x,                      \
         const int incx,                     \
         type *y,                            \
         const int incy)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__AXPY(s, float);
-DECLARE_CBLAS__AXPY(d, double);
-DECLARE_CBLAS__AXPY(c, float _Complex);
-DECLARE_CBLAS__AXPY(z, double _Complex);
-#endif
+DECLARE_CBLAS__AXPY(s, float, const float);
+DECLARE_CBLAS__AXPY(d, double, const double);
+DECLARE_CBLAS__AXPY(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__AXPY(z, double _Complex, const double _Complex *);
 
 /* cblas_?copy - copy vector (routines) */
 #define DECLARE_CBLAS__COPY(prefix, type)   \
@@ -77,12 +79,10 @@ void cblas_##prefix##copy (const int n,     \
         type *y,                            \
         const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__COPY(s, float);
 DECLARE_CBLAS__COPY(d, double);
 DECLARE_CBLAS__COPY(c, float _Complex);
 DECLARE_CBLAS__COPY(z, double _Complex);
-#endif
 
 /* cblas_?dot - vector-vector dot product */
 #define DECLARE_CBLAS__DOT(prefix, type)    \
@@ -92,10 +92,8 @@ type cblas_##prefix##dot (const int n,      \
         const type *y,                      \
         const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__DOT(s, float);
 DECLARE_CBLAS__DOT(d, double);
-#endif
 
 /* cblas_?sdot - vector-vector dot product with double precision */
 /* (not implemented by cuBLAS)
@@ -122,10 +120,8 @@ void cblas_##prefix##dotc_sub (const int n, \
         const int incy,                     \
         type *dotc)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__DOTC(c, float _Complex);
 DECLARE_CBLAS__DOTC(z, double _Complex);
-#endif
 
 /* cblas_?dotu - vector-vector dot product */
 #define DECLARE_CBLAS__DOTU(prefix, type)   \
@@ -136,23 +132,19 @@ void cblas_##prefix##dotu_sub (const int n, \
         const int incy,                     \
         type *dotu)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__DOTU(c, float _Complex);
 DECLARE_CBLAS__DOTU(z, double _Complex);
-#endif
 
 /* cblas_?nrm2 - Euclidean norm of a vector */
-#define DECLARE_CBLAS__NRM2(prefix, type)   \
-type cblas_##prefix##_nrm2 (const int n,    \
-        const type *x,                      \
+#define DECLARE_CBLAS__NRM2(prefix, S, T)   \
+S cblas_##prefix##nrm2 (const int n,        \
+        const T *x,                         \
         const int incx)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__NRM2(s, float);
-DECLARE_CBLAS__NRM2(d, double);
-DECLARE_CBLAS__NRM2(sc, float _Complex);
-DECLARE_CBLAS__NRM2(dz, double _Complex);
-#endif
+DECLARE_CBLAS__NRM2(s, float, float);
+DECLARE_CBLAS__NRM2(d, double, double);
+DECLARE_CBLAS__NRM2(sc, float, float _Complex);
+DECLARE_CBLAS__NRM2(dz, double, double _Complex);
 
 /* cblas_?rot - performs rotation of points in the plane */
 #define DECLARE_CBLAS__ROT(prefix, type, type2)    \
@@ -164,12 +156,10 @@ void cblas_##prefix##rot (const int n,              \
         const type2 c,                              \
         const type2 s)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__ROT(s, float, float);
 DECLARE_CBLAS__ROT(d, double, double);
 DECLARE_CBLAS__ROT(cs, float _Complex, float);
 DECLARE_CBLAS__ROT(zd, double _Complex, double);
-#endif
 
 /* cblas_?rotg - computes the parameters for a Givens rotation */
 void cblas_srotg (float *a, float *b, float *c, float *s);
@@ -202,18 +192,16 @@ void cblas_drotmg (double *d1,
 /* cblas_?scal - computes the product of a vector by a scalar */
 #define DECLARE_CBLAS__SCAL(prefix, vtype, stype)   \
 void cblas_##prefix##scal (const int n,             \
-        const stype a,                              \
+        stype a,                                    \
         vtype *x,                                   \
         const int incx)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__SCAL(s, float, float);
-DECLARE_CBLAS__SCAL(d, double, double);
-DECLARE_CBLAS__SCAL(c, float _Complex, float _Complex);
-DECLARE_CBLAS__SCAL(z, double _Complex, double _Complex);
-DECLARE_CBLAS__SCAL(cs, float _Complex, float);
-DECLARE_CBLAS__SCAL(zd, double _Complex, double);
-#endif
+DECLARE_CBLAS__SCAL(s, float, const float);
+DECLARE_CBLAS__SCAL(d, double, const double);
+DECLARE_CBLAS__SCAL(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__SCAL(z, double _Complex, const double _Complex *);
+DECLARE_CBLAS__SCAL(cs, float _Complex, const float);
+DECLARE_CBLAS__SCAL(zd, double _Complex, const double);
 
 /* cblas_?swap - swaps a vector with another vector */
 #define DECLARE_CBLAS__SWAP(prefix, type)           \
@@ -223,12 +211,10 @@ void cblas_##prefix##swap (const int n,             \
         type *y,                                    \
         const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SWAP(s, float);
 DECLARE_CBLAS__SWAP(d, double);
 DECLARE_CBLAS__SWAP(c, float _Complex);
 DECLARE_CBLAS__SWAP(z, double _Complex);
-#endif
 
 /* cblas_i?amax - finds the index of the element with maximum value */
 #define DECLARE_CBLAS_I_AMAX(prefix, type)          \
@@ -236,12 +222,10 @@ CBLAS_INDEX cblas_i##prefix##amax (const int n,     \
         const type *x,                              \
         const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS_I_AMAX(s, float);
 DECLARE_CBLAS_I_AMAX(d, double);
 DECLARE_CBLAS_I_AMAX(c, float _Complex);
 DECLARE_CBLAS_I_AMAX(z, double _Complex);
-#endif
 
 /* cblas_i?amin - finds the index of the element with the smallest absolute
  * value */
@@ -250,52 +234,46 @@ CBLAS_INDEX cblas_i##prefix##amin (const int n,     \
         const type *x,                              \
         const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS_I_AMIN(s, float);
 DECLARE_CBLAS_I_AMIN(d, double);
 DECLARE_CBLAS_I_AMIN(c, float _Complex);
 DECLARE_CBLAS_I_AMIN(z, double _Complex);
-#endif
 
 
 /* BLAS Level 2 routines */
 
 /* cblas_?gbmv - Matrix-vector product using a general band matrix */
-#define DECLARE_CBLAS__GBMV(prefix, type)                \
+#define DECLARE_CBLAS__GBMV(prefix, type, SC)           \
 void cblas_##prefix##gbmv (const CBLAS_LAYOUT Layout,   \
         CBLAS_TRANSPOSE trans,                          \
         const int m, const int n,                       \
         const int kl, const int ku,                     \
-        const type alpha,                               \
+        SC alpha,                                       \
         const type *A, const int lda,                   \
         const type *x, const int incx,                  \
-        const type beta,                                \
+        SC beta,                                        \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__GBMV(s, float);
-DECLARE_CBLAS__GBMV(d, double);
-DECLARE_CBLAS__GBMV(c, float _Complex);
-DECLARE_CBLAS__GBMV(z, double _Complex);
-#endif
+DECLARE_CBLAS__GBMV(s, float, const float);
+DECLARE_CBLAS__GBMV(d, double, const double);
+DECLARE_CBLAS__GBMV(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GBMV(z, double _Complex, const double _Complex *);
 
 /* cblas_?gemv - matrix-vector product using a general matrix */
-#define DECLARE_CBLAS__GEMV(prefix, type)               \
+#define DECLARE_CBLAS__GEMV(prefix, type, SC)           \
 void cblas_##prefix##gemv(const CBLAS_LAYOUT Layout,    \
         const CBLAS_TRANSPOSE trans,                    \
         const int m, const int n,                       \
-        const type alpha,                               \
+        SC alpha,                                       \
         const type *A, const int lda,                   \
         const type *x, const int incx,                  \
-        const type beta,                                \
+        SC beta,                                        \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__GEMV(s, float);
-DECLARE_CBLAS__GEMV(d, double);
-DECLARE_CBLAS__GEMV(c, float _Complex);
-DECLARE_CBLAS__GEMV(z, double _Complex);
-#endif
+DECLARE_CBLAS__GEMV(s, float, const float);
+DECLARE_CBLAS__GEMV(d, double, const double);
+DECLARE_CBLAS__GEMV(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GEMV(z, double _Complex, const double _Complex *);
 
 
 /* cblas_?ger - rank-1 update of a general matrix */
@@ -307,10 +285,8 @@ void cblas_##prefix##ger(const CBLAS_LAYOUT Layout,     \
         const type *y, const int incy,                  \
         type *a, const int lda)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__GER(s, float);
 DECLARE_CBLAS__GER(d, double);
-#endif
 
 #define DECLARE_CBLAS__GERC(prefix, type)               \
 void cblas_##prefix##gerc(const CBLAS_LAYOUT Layout,    \
@@ -331,10 +307,8 @@ void cblas_##prefix##geru(const CBLAS_LAYOUT Layout,    \
         const type *y, const int incy,                  \
         type *a, const int lda)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__GERU(c, float _Complex);
 DECLARE_CBLAS__GERU(z, double _Complex);
-#endif
 
 /* ?hbmv - matrix-vector product using Hermitian band matrix */
 #define DECLARE_CBLAS__HBMV(prefix, type)               \
@@ -347,10 +321,8 @@ void cblas_##prefix##hbmv(const CBLAS_LAYOUT Layout,    \
         const type *beta,                               \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HBMV(c, float _Complex);
 DECLARE_CBLAS__HBMV(z, double _Complex);
-#endif
 
 /* ?hemv - matrix-vector product using Hermitian matrix */
 #define DECLARE_CBLAS__HEMV(prefix, type)               \
@@ -363,10 +335,8 @@ void cblas_##prefix##hemv(const CBLAS_LAYOUT Layout,    \
         const type *beta,                               \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HEMV(c, float _Complex);
 DECLARE_CBLAS__HEMV(z, double _Complex);
-#endif
 
 /* ?her - rank-1 update of Hermitian matrix */
 #define DECLARE_CBLAS__HER(prefix, rtype, type)         \
@@ -377,25 +347,21 @@ void cblas_##prefix##her(const CBLAS_LAYOUT Layout,     \
         const type *x, const int incx,                  \
         type *a, const int lda)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HER(c, float, float _Complex);
 DECLARE_CBLAS__HER(z, double, double _Complex);
-#endif
 
 /* ?her2 - rank-2 update of Hermitian matrix */
 #define DECLARE_CBLAS__HER2(prefix, type)               \
 void cblas_##prefix##her2(const CBLAS_LAYOUT Layout,    \
         const CBLAS_UPLO uplo,                          \
         const int n,                                    \
-        const type alpha,                               \
+        const type *alpha,                              \
         const type *x, const int incx,                  \
         const type *y, const int incy,                  \
         type *a, const int lda)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HER2(c, float _Complex);
 DECLARE_CBLAS__HER2(z, double _Complex);
-#endif
 
 /* ?hpmv - matrix-vector product using Hermitian packed matrix */
 #define DECLARE_CBLAS__HPMV(prefix, type)               \
@@ -408,10 +374,8 @@ void cblas_##prefix##hpmv(const CBLAS_LAYOUT Layout,    \
         const type *beta,                               \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HPMV(c, float _Complex);
 DECLARE_CBLAS__HPMV(z, double _Complex);
-#endif
 
 /* ?hpr - rank-1 update of a Hermitian packed matrix */
 #define DECLARE_CBLAS__HPR(prefix, stype, type)         \
@@ -422,25 +386,21 @@ void cblas_##prefix##hpr(const CBLAS_LAYOUT Layout,     \
         const type *x, const int incx,                  \
         type *ap)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HPR(c, float, float _Complex);
 DECLARE_CBLAS__HPR(z, double, double _Complex);
-#endif
 
 /* ?hpr2 - rank-2 update of a Hermitian packed matrix */
 #define DECLARE_CBLAS__HPR2(prefix, type)               \
 void cblas_##prefix##hpr2(const CBLAS_LAYOUT Layout,    \
         const CBLAS_UPLO uplo,                          \
         const int n,                                    \
-        const type alpha,                               \
+        const type *alpha,                              \
         const type *x, const int incx,                  \
         const type *y, const int incy,                  \
         type *ap)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HPR2(c, float _Complex);
 DECLARE_CBLAS__HPR2(z, double _Complex);
-#endif
 
 /* ?sbmv - matrix-vector product using a symmetric band matrix */
 #define DECLARE_CBLAS__SBMV(prefix, type)               \
@@ -453,10 +413,8 @@ void cblas_##prefix##sbmv(const CBLAS_LAYOUT Layout,    \
         const type beta,                                \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SBMV(s, float);
 DECLARE_CBLAS__SBMV(d, double);
-#endif
 
 /* ?spmv - matrix-vector product using a symmetric packed matrix */
 #define DECLARE_CBLAS__SPMV(prefix, type)               \
@@ -469,10 +427,8 @@ void cblas_##prefix##spmv(const CBLAS_LAYOUT Layout,    \
         const type beta,                                \
         type *y, const int incy)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SPMV(s, float);
 DECLARE_CBLAS__SPMV(d, double);
-#endif
 
 /* ?spr - rank-1 update of a symmetric packed matrix */
 #define DECLARE_CBLAS__SPR(prefix, type)                \
@@ -483,10 +439,8 @@ void cblas_##prefix##spr(const CBLAS_LAYOUT Layout,     \
         const type *x, const int incx,                  \
         type *ap)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SPR(s, float);
 DECLARE_CBLAS__SPR(d, double);
-#endif
 
 /* ?spr2 - rank-2 update of a symmetric packed matrix */
 #define DECLARE_CBLAS__SPR2(prefix, type)               \
@@ -498,10 +452,8 @@ void cblas_##prefix##spr2(const CBLAS_LAYOUT Layout,    \
         const type *y, const int incy,                  \
         type *ap)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SPR2(s, float);
 DECLARE_CBLAS__SPR2(d, double);
-#endif
 
 /* ?symv - matrix-vector product for symmetric matrix */
 #define DECLARE_CBLAS__SYMV(prefix, type)               \
@@ -515,10 +467,8 @@ void cblas_##prefix##symv(const CBLAS_LAYOUT Layout,    \
         type *y, const int incy)
 
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SYMV(s, float);
 DECLARE_CBLAS__SYMV(d, double);
-#endif
 
 /* ?syr - rank-1 update of a symmetric matrix */
 #define DECLARE_CBLAS__SYR(prefix, type)                \
@@ -530,10 +480,8 @@ void cblas_##prefix##syr (const CBLAS_LAYOUT Layout,    \
         type *a, const int lda)
 
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SYR(s, float);
 DECLARE_CBLAS__SYR(d, double);
-#endif
 
 /* ?syr2 - rank-2 update of symmetric matrix */
 #define DECLARE_CBLAS__SYR2(prefix, type)               \
@@ -545,10 +493,8 @@ void cblas_##prefix##syr2 (const CBLAS_LAYOUT Layout,   \
         const type *y, const int incy,                  \
         type *a, const int lda)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__SYR2(s, float);
 DECLARE_CBLAS__SYR2(d, double);
-#endif
 
 /* ?tbmv - matrix-vector product using a triangular band matrix */
 #define DECLARE_CBLAS__TBMV(prefix, type)               \
@@ -560,12 +506,10 @@ void cblas_##prefix##tbmv (const CBLAS_LAYOUT Layout,   \
         const type *a, const int lda,                   \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TBMV(s, float);
 DECLARE_CBLAS__TBMV(d, double);
 DECLARE_CBLAS__TBMV(c, float _Complex);
 DECLARE_CBLAS__TBMV(z, double _Complex);
-#endif
 
 /* ?tbsv - solve a system of linear equations whose coefficients are in a
  * triangular band matrix */
@@ -578,12 +522,10 @@ void cblas_##prefix##tbsv(const CBLAS_LAYOUT Layout,    \
         const type *a, const int lda,                   \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TBSV(s, float);
 DECLARE_CBLAS__TBSV(d, double);
 DECLARE_CBLAS__TBSV(c, float _Complex);
 DECLARE_CBLAS__TBSV(z, double _Complex);
-#endif
 
 /* ?tpmv - matrix-vector product using a triangular band matrix */
 #define DECLARE_CBLAS__TPMV(prefix, type)               \
@@ -591,16 +533,14 @@ void cblas_##prefix##tpmv (const CBLAS_LAYOUT Layout,   \
         const CBLAS_UPLO uplo,                          \
         const CBLAS_TRANSPOSE trans,                    \
         const CBLAS_DIAG diag,                          \
-        const int n, const int k,                       \
+        const int n,                                    \
         const type *ap,                                 \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TPMV(s, float);
 DECLARE_CBLAS__TPMV(d, double);
 DECLARE_CBLAS__TPMV(c, float _Complex);
 DECLARE_CBLAS__TPMV(z, double _Complex);
-#endif
 
 /* ?tpsv - solves a system of linear equations whose coefficients are in a
  * triangular packed matrix */
@@ -613,12 +553,10 @@ void cblas_##prefix##tpsv(const CBLAS_LAYOUT Layout,    \
         const type *ap,                                 \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TPSV(s, float);
 DECLARE_CBLAS__TPSV(d, double);
 DECLARE_CBLAS__TPSV(c, float _Complex);
 DECLARE_CBLAS__TPSV(z, double _Complex);
-#endif
 
 /* ?trmv - compute  a matrix-vector product using a triangular matrix */
 #define DECLARE_CBLAS__TRMV(prefix, type)               \
@@ -630,12 +568,10 @@ void cblas_##prefix##trmv(const CBLAS_LAYOUT Layout,    \
         const type *a, const int lda,                   \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TRMV(s, float);
 DECLARE_CBLAS__TRMV(d, double);
 DECLARE_CBLAS__TRMV(c, float _Complex);
 DECLARE_CBLAS__TRMV(z, double _Complex);
-#endif
 
 /* ?trsv - solve a system of linear equations whose coefficients are in a
  * triangular matrix */
@@ -648,34 +584,88 @@ void cblas_##prefix##trsv(const CBLAS_LAYOUT Layout,    \
         const type *a, const int lda,                   \
         type *x, const int incx)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__TRSV(s, float);
 DECLARE_CBLAS__TRSV(d, double);
 DECLARE_CBLAS__TRSV(c, float _Complex);
 DECLARE_CBLAS__TRSV(z, double _Complex);
-#endif
 
 
 /* Level 3 BLAS Routines */
 
+/*
+ * These are implemented in blas_level3 and are always declared. Complex
+ * scalars are passed by pointer to const, as in the reference CBLAS
+ * (which uses const void *).
+ */
+
 /* ?gemm - matrix-matrix product with general matrices */
-#define DECLARE_CBLAS__GEMM(prefix, T)                  \
+#define DECLARE_CBLAS__GEMM(prefix, T, SC)              \
 void cblas_##prefix##gemm(const CBLAS_LAYOUT Layout,    \
         const CBLAS_TRANSPOSE transa,                   \
         const CBLAS_TRANSPOSE transb,                   \
         const int m, const int n, const int k,          \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
         const T *b, const int ldb,                      \
-        const T beta,                                   \
+        SC beta,                                        \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__GEMM(s, float);
-DECLARE_CBLAS__GEMM(d, double);
-DECLARE_CBLAS__GEMM(c, float _Complex);
-DECLARE_CBLAS__GEMM(z, double _Complex);
-#endif
+DECLARE_CBLAS__GEMM(s, float, const float);
+DECLARE_CBLAS__GEMM(d, double, const double);
+DECLARE_CBLAS__GEMM(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GEMM(z, double _Complex, const double _Complex *);
+
+/* ?gemm_batch - groups of matrix-matrix products (as in MKL) */
+#define DECLARE_CBLAS__GEMM_BATCH(prefix, T)            \
+void cblas_##prefix##gemm_batch(const CBLAS_LAYOUT Layout,\
+        const CBLAS_TRANSPOSE *transa_array,            \
+        const CBLAS_TRANSPOSE *transb_array,            \
+        const int *m_array, const int *n_array,         \
+        const int *k_array,                             \
+        const T *alpha_array,                           \
+        const T **a_array, const int *lda_array,        \
+        const T **b_array, const int *ldb_array,        \
+        const T *beta_array,                            \
+        T **c_array, const int *ldc_array,              \
+        const int group_count, const int *group_size)
+
+DECLARE_CBLAS__GEMM_BATCH(s, float);
+DECLARE_CBLAS__GEMM_BATCH(d, double);
+DECLARE_CBLAS__GEMM_BATCH(c, float _Complex);
+DECLARE_CBLAS__GEMM_BATCH(z, double _Complex);
+
+/* ?gemm_batch_strided - matrix-matrix products on evenly spaced matrices */
+#define DECLARE_CBLAS__GEMM_BATCH_STRIDED(prefix, T, SC)\
+void cblas_##prefix##gemm_batch_strided(const CBLAS_LAYOUT Layout,\
+        const CBLAS_TRANSPOSE transa,                   \
+        const CBLAS_TRANSPOSE transb,                   \
+        const int m, const int n, const int k,          \
+        SC alpha,                                       \
+        const T *a, const int lda, const int stridea,   \
+        const T *b, const int ldb, const int strideb,   \
+        SC beta,                                        \
+        T *c, const int ldc, const int stridec,         \
+        const int batch_size)
+
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(s, float, const float);
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(d, double, const double);
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GEMM_BATCH_STRIDED(z, double _Complex, const double _Complex *);
+
+/* ?gemm3m - complex matrix-matrix product with the 3M algorithm */
+#define DECLARE_CBLAS__GEMM3M(prefix, T, SC)            \
+void cblas_##prefix##gemm3m(const CBLAS_LAYOUT Layout,  \
+        const CBLAS_TRANSPOSE transa,                   \
+        const CBLAS_TRANSPOSE transb,                   \
+        const int m, const int n, const int k,          \
+        SC alpha,                                       \
+        const T *a, const int lda,                      \
+        const T *b, const int ldb,                      \
+        SC beta,                                        \
+        T *c, const int ldc)
+
+DECLARE_CBLAS__GEMM3M(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GEMM3M(z, double _Complex, const double _Complex *);
 
 
 /* ?hemm - matrix-matrix product with general matrices */
@@ -690,10 +680,8 @@ void cblas_##prefix##hemm(const CBLAS_LAYOUT Layout,    \
         const T *beta,                                  \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HEMM(c, float _Complex);
 DECLARE_CBLAS__HEMM(z, double _Complex);
-#endif
 
 /* ?herk - Hermitian rank-k update */
 #define DECLARE_CBLAS__HERK(prefix, S, T)               \
@@ -706,10 +694,8 @@ void cblas_##prefix##herk(const CBLAS_LAYOUT Layout,    \
         const S beta,                                   \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HERK(c, float, float _Complex);
 DECLARE_CBLAS__HERK(z, double, double _Complex);
-#endif
 
 /* ?her2k */
 #define DECLARE_CBLAS__HER2K(prefix, S, T)              \
@@ -723,104 +709,180 @@ void cblas_##prefix##her2k(const CBLAS_LAYOUT Layout,   \
         const S beta,                                   \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
 DECLARE_CBLAS__HER2K(c, float, float _Complex);
 DECLARE_CBLAS__HER2K(z, double, double _Complex);
-#endif
 
 /* ?symm - matrix-matrix product where one input is symmetric */
-#define DECLARE_CBLAS__SYMM(prefix, T)                  \
+#define DECLARE_CBLAS__SYMM(prefix, T, SC)              \
 void cblas_##prefix##symm(const CBLAS_LAYOUT Layout,    \
         const CBLAS_SIDE side,                          \
         const CBLAS_UPLO uplo,                          \
         const int m, const int n,                       \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
         const T *b, const int ldb,                      \
-        const T beta,                                   \
+        SC beta,                                        \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__SYMM(s, float);
-DECLARE_CBLAS__SYMM(d, double);
-DECLARE_CBLAS__SYMM(c, float _Complex);
-DECLARE_CBLAS__SYMM(z, double _Complex);
-#endif
+DECLARE_CBLAS__SYMM(s, float, const float);
+DECLARE_CBLAS__SYMM(d, double, const double);
+DECLARE_CBLAS__SYMM(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__SYMM(z, double _Complex, const double _Complex *);
 
 /* ?syrk - symmetric rank-k update */
-#define DECLARE_CBLAS__SYRK(prefix, T)                  \
+#define DECLARE_CBLAS__SYRK(prefix, T, SC)              \
 void cblas_##prefix##syrk(const CBLAS_LAYOUT Layout,    \
         const CBLAS_UPLO uplo,                          \
         const CBLAS_TRANSPOSE trans,                    \
         const int n, const int k,                       \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
-        const T beta,                                   \
+        SC beta,                                        \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__SYRK(s, float);
-DECLARE_CBLAS__SYRK(d, double);
-DECLARE_CBLAS__SYRK(c, float _Complex);
-DECLARE_CBLAS__SYRK(z, double _Complex);
-#endif
+DECLARE_CBLAS__SYRK(s, float, const float);
+DECLARE_CBLAS__SYRK(d, double, const double);
+DECLARE_CBLAS__SYRK(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__SYRK(z, double _Complex, const double _Complex *);
 
 /* ?syr2k - symmetric rank-2k update */
-#define DECLARE_CBLAS__SYR2K(prefix, T)                 \
+#define DECLARE_CBLAS__SYR2K(prefix, T, SC)             \
 void cblas_##prefix##syr2k(const CBLAS_LAYOUT Layout,   \
         const CBLAS_UPLO uplo,                          \
         const CBLAS_TRANSPOSE trans,                    \
         const int n, const int k,                       \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
         const T *b, const int ldb,                      \
-        const T beta,                                   \
+        SC beta,                                        \
         T *c, const int ldc)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__SYR2K(s, float);
-DECLARE_CBLAS__SYR2K(d, double);
-DECLARE_CBLAS__SYR2K(c, float _Complex);
-DECLARE_CBLAS__SYR2K(z, double _Complex);
-#endif
+DECLARE_CBLAS__SYR2K(s, float, const float);
+DECLARE_CBLAS__SYR2K(d, double, const double);
+DECLARE_CBLAS__SYR2K(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__SYR2K(z, double _Complex, const double _Complex *);
 
 /* ?trmm - matrix-matrix product where one input matrix is triangular */
-#define DECLARE_CBLAS__TRMM(prefix, T)                  \
+#define DECLARE_CBLAS__TRMM(prefix, T, SC)              \
 void cblas_##prefix##trmm(const CBLAS_LAYOUT Layout,    \
         const CBLAS_SIDE side,                          \
         const CBLAS_UPLO uplo,                          \
         const CBLAS_TRANSPOSE transa,                   \
         const CBLAS_DIAG diag,                          \
         const int m, const int n,                       \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
         T *b, const int ldb)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__TRMM(s, float);
-DECLARE_CBLAS__TRMM(d, double);
-DECLARE_CBLAS__TRMM(c, float _Complex);
-DECLARE_CBLAS__TRMM(z, double _Complex);
-#endif
+DECLARE_CBLAS__TRMM(s, float, const float);
+DECLARE_CBLAS__TRMM(d, double, const double);
+DECLARE_CBLAS__TRMM(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__TRMM(z, double _Complex, const double _Complex *);
 
 /* ?trsm - solves a triangular matrix equation */
-#define DECLARE_CBLAS__TRSM(prefix, T)                  \
+#define DECLARE_CBLAS__TRSM(prefix, T, SC)              \
 void cblas_##prefix##trsm(const CBLAS_LAYOUT Layout,    \
         const CBLAS_SIDE side,                          \
         const CBLAS_UPLO uplo,                          \
         const CBLAS_TRANSPOSE transa,                   \
         const CBLAS_DIAG diag,                          \
         const int m, const int n,                       \
-        const T alpha,                                  \
+        SC alpha,                                       \
         const T *a, const int lda,                      \
         T *b, const int ldb)
 
-#if DECLARE_CBLAS
-DECLARE_CBLAS__TRSM(s, float);
-DECLARE_CBLAS__TRSM(d, double);
-DECLARE_CBLAS__TRSM(c, float _Complex);
-DECLARE_CBLAS__TRSM(z, double _Complex);
-#endif
+DECLARE_CBLAS__TRSM(s, float, const float);
+DECLARE_CBLAS__TRSM(d, double, const double);
+DECLARE_CBLAS__TRSM(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__TRSM(z, double _Complex, const double _Complex *);
+
+
+/* BLAS-like extensions (MKL, OpenBLAS), also implemented and always declared */
+
+/* ?axpby - y = alpha x + beta y */
+#define DECLARE_CBLAS__AXPBY(prefix, T, SC)             \
+void cblas_##prefix##axpby(const int n,                 \
+        SC alpha,                                       \
+        const T *x, const int incx,                     \
+        SC beta,                                        \
+        T *y, const int incy)
+
+DECLARE_CBLAS__AXPBY(s, float, const float);
+DECLARE_CBLAS__AXPBY(d, double, const double);
+DECLARE_CBLAS__AXPBY(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__AXPBY(z, double _Complex, const double _Complex *);
+
+/* ?gemmt - matrix-matrix product that only updates a triangle of C */
+#define DECLARE_CBLAS__GEMMT(prefix, T, SC)             \
+void cblas_##prefix##gemmt(const CBLAS_LAYOUT Layout,   \
+        const CBLAS_UPLO uplo,                          \
+        const CBLAS_TRANSPOSE transa,                   \
+        const CBLAS_TRANSPOSE transb,                   \
+        const int n, const int k,                       \
+        SC alpha,                                       \
+        const T *a, const int lda,                      \
+        const T *b, const int ldb,                      \
+        SC beta,                                        \
+        T *c, const int ldc)
+
+DECLARE_CBLAS__GEMMT(s, float, const float);
+DECLARE_CBLAS__GEMMT(d, double, const double);
+DECLARE_CBLAS__GEMMT(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__GEMMT(z, double _Complex, const double _Complex *);
+
+/*
+ * ?omatcopy, ?imatcopy - scaled matrix copy and transposition, out of
+ * place and in place. OpenBLAS passes complex scalars by pointer, and
+ * uses CblasConjNoTrans (114) for conjugation without transposition.
+ */
+#define DECLARE_CBLAS__OMATCOPY(prefix, T, SC)          \
+void cblas_##prefix##omatcopy(const CBLAS_LAYOUT Layout,\
+        const CBLAS_TRANSPOSE trans,                    \
+        const int rows, const int cols,                 \
+        SC alpha,                                       \
+        const T *a, const int lda,                      \
+        T *b, const int ldb)
+
+DECLARE_CBLAS__OMATCOPY(s, float, const float);
+DECLARE_CBLAS__OMATCOPY(d, double, const double);
+DECLARE_CBLAS__OMATCOPY(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__OMATCOPY(z, double _Complex, const double _Complex *);
+
+#define DECLARE_CBLAS__IMATCOPY(prefix, T, SC)          \
+void cblas_##prefix##imatcopy(const CBLAS_LAYOUT Layout,\
+        const CBLAS_TRANSPOSE trans,                    \
+        const int rows, const int cols,                 \
+        SC alpha,                                       \
+        T *a, const int lda, const int ldb)
+
+DECLARE_CBLAS__IMATCOPY(s, float, const float);
+DECLARE_CBLAS__IMATCOPY(d, double, const double);
+DECLARE_CBLAS__IMATCOPY(c, float _Complex, const float _Complex *);
+DECLARE_CBLAS__IMATCOPY(z, double _Complex, const double _Complex *);
+
+/* MKL's versions, with characters for the layout and transposition */
+#define DECLARE_MKL__OMATCOPY(prefix, T)                \
+void mkl_##prefix##omatcopy(char ordering, char trans,  \
+        size_t rows, size_t cols,                       \
+        const T alpha,                                  \
+        const T *a, size_t lda,                         \
+        T *b, size_t ldb)
+
+DECLARE_MKL__OMATCOPY(s, float);
+DECLARE_MKL__OMATCOPY(d, double);
+DECLARE_MKL__OMATCOPY(c, float _Complex);
+DECLARE_MKL__OMATCOPY(z, double _Complex);
+
+#define DECLARE_MKL__IMATCOPY(prefix, T)                \
+void mkl_##prefix##imatcopy(char ordering, char trans,  \
+        size_t rows, size_t cols,                       \
+        const T alpha,                                  \
+        T *ab, size_t lda, size_t ldb)
+
+DECLARE_MKL__IMATCOPY(s, float);
+DECLARE_MKL__IMATCOPY(d, double);
+DECLARE_MKL__IMATCOPY(c, float _Complex);
+DECLARE_MKL__IMATCOPY(z, double _Complex);
 
 
 #ifdef __cplusplus
@@ -79,6 +79,69 @@ static inline CBLAS_DIAG c_diag(char c) {
     }
 }
 
+/*
+ * The reverse conversions, for CBLAS entry points that call the F77
+ * routines. Invalid values are mapped to a character that the argument
+ * checks of the F77 routines reject.
+ */
+static inline char f77_trans(CBLAS_TRANSPOSE trans) {
+    switch (trans) {
+        case CblasNoTrans:
+            return 'N';
+        case CblasTrans:
+            return 'T';
+        case CblasConjTrans:
+            return 'C';
+        default:
+            return '?';
+    }
+}
+
+static inline char f77_side(CBLAS_SIDE side) {
+    switch (side) {
+        case CblasLeft:
+            return 'L';
+        case CblasRight:
+            return 'R';
+        default:
+            return '?';
+    }
+}
+
+static inline char f77_uplo(CBLAS_UPLO uplo) {
+    switch (uplo) {
+        case CblasUpper:
+            return 'U';
+        case CblasLower:
+            return 'L';
+        default:
+            return '?';
+    }
+}
+
+/* {@uplo} of the transposed matrix */
+static inline char f77_flip_uplo(CBLAS_UPLO uplo) {
+    switch (uplo) {
+        case CblasUpper:
+            return 'L';
+        case CblasLower:
+            return 'U';
+        default:
+            return '?';
+    }
+}
+
+static inline char f77_diag(CBLAS_DIAG diag) {
+    switch (diag) {
+        case CblasUnit:
+            return 'U';
+        case CblasNonUnit:
+            return 'N';
+        default:
+            return '?';
+    }
+}
+
 #ifdef __cplusplus
 };      // extern "C"
 #endif
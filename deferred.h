@@ -0,0 +1,71 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <complex.h>
+
+/*
+ * Deferred reductions (an extension to BLAS).
+ *
+ * These take the same arguments as the corresponding F77 routines, plus
+ * a pointer to the result. The result is only guaranteed to be written
+ * after b2c_scalars_sync() or after any reduction that returns its result
+ * normally, so a sequence of reductions costs a single round trip to the
+ * device. If a reduction cannot run on the device, its result is computed
+ * by the next BLAS library and is available immediately.
+ */
+#define DEFERRED_asum(prefix, S, T)                 \
+void b2c_##prefix##asum_deferred(const int *n,      \
+        T *sx, const int *incx, S *result)
+
+DEFERRED_asum(s, float, float);
+DEFERRED_asum(sc, float, float _Complex);
+DEFERRED_asum(d, double, double);
+DEFERRED_asum(dz, double, double _Complex);
+
+#define DEFERRED_nrm2(prefix, S, T)                 \
+void b2c_##prefix##nrm2_deferred(const int *n,      \
+        T *x, const int *incx, S *result)
+
+DEFERRED_nrm2(s, float, float);
+DEFERRED_nrm2(sc, float, float _Complex);
+DEFERRED_nrm2(d, double, double);
+DEFERRED_nrm2(dz, double, double _Complex);
+
+#define DEFERRED_dot(prefix, T)                     \
+void b2c_##prefix##dot_deferred(const int *n,       \
+        T *sx, const int *incx,                     \
+        T *sy, const int *incy, T *result)
+
+DEFERRED_dot(s, float);
+DEFERRED_dot(d, double);
+
+#define DEFERRED_dotc(prefix, T)                    \
+void b2c_##prefix##dotc_deferred(const int *n,      \
+        T *sx, const int *incx,                     \
+        T *sy, const int *incy, T *result)
+
+DEFERRED_dotc(c, float _Complex);
+DEFERRED_dotc(z, double _Complex);
+
+#define DEFERRED_dotu(prefix, T)                    \
+void b2c_##prefix##dotu_deferred(const int *n,      \
+        T *sx, const int *incx,                     \
+        T *sy, const int *incy, T *result)
+
+DEFERRED_dotu(c, float _Complex);
+DEFERRED_dotu(z, double _Complex);
+
+/**
+ * Write the results of all deferred reductions.
+ */
+void b2c_scalars_sync(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
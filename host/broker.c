@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+#include "broker.h"
+#include "../common.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const char *host_broker_path(void) {
+    static char path[sizeof ((struct sockaddr_un *) NULL)->sun_path];
+    const char *env;
+
+    if (path[0])
+        return path;
+    if ((env = getenv("BLAS2CUDA_BROKER")) && *env)
+        snprintf(path, sizeof path, "%s", env);
+    else if ((env = getenv("XDG_RUNTIME_DIR")) && *env)
+        snprintf(path, sizeof path, "%s/blas2cuda-broker.sock", env);
+    else
+        snprintf(path, sizeof path, "/tmp/blas2cuda-broker-%u.sock", (unsigned) getuid());
+    return path;
+}
+
+bool host_broker_send(int sock, const void *buf, size_t size, int fd) {
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { (void *) buf, size };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    ssize_t sent;
+
+    if (fd != -1) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof control.buf;
+        control.hdr.cmsg_level = SOL_SOCKET;
+        control.hdr.cmsg_type = SCM_RIGHTS;
+        control.hdr.cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(&control.hdr), &fd, sizeof fd);
+    }
+    while (iov.iov_len > 0) {
+        if ((sent = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        /* the fd goes with the first byte */
+        msg.msg_control = NULL;
+        msg.msg_controllen = 0;
+        iov.iov_base = (char *) iov.iov_base + sent;
+        iov.iov_len -= sent;
+    }
+    return true;
+}
+
+bool host_broker_recv(int sock, void *buf, size_t size, int *fd) {
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { buf, size };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    struct cmsghdr *cmsg;
+    ssize_t got;
+
+    if (fd) {
+        *fd = -1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof control.buf;
+    }
+    while (iov.iov_len > 0) {
+        if ((got = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) <= 0) {
+            if (got < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                int received;
+
+                memcpy(&received, CMSG_DATA(cmsg), sizeof received);
+                if (fd && *fd == -1)
+                    *fd = received;
+                else
+                    close(received);
+            }
+        msg.msg_control = NULL;
+        msg.msg_controllen = 0;
+        iov.iov_base = (char *) iov.iov_base + got;
+        iov.iov_len -= got;
+    }
+    if (iov.iov_len > 0 && fd && *fd != -1) {
+        close(*fd);
+        *fd = -1;
+    }
+    return iov.iov_len == 0;
+}
+
+/* rank side */
+
+/* requests are made one at a time, each waiting for its reply */
+static int broker_sock = -1;
+static bool broker_lost;
+static pthread_mutex_t broker_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool host_broker_connect(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    bool connected;
+    int sock;
+
+    pthread_mutex_lock(&broker_lock);
+    /* the daemon may run with libblas2cuda preloaded, but not on itself */
+    if (broker_sock == -1 && !broker_lost && !getenv("BLAS2CUDA_BROKERD")) {
+        strncpy(addr.sun_path, host_broker_path(), sizeof addr.sun_path - 1);
+        if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0) {
+            if (connect(sock, (struct sockaddr *) &addr, sizeof addr) == 0)
+                broker_sock = sock;
+            else
+                close(sock);
+        }
+    }
+    connected = broker_sock != -1;
+    pthread_mutex_unlock(&broker_lock);
+    return connected;
+}
+
+/**
+ * Send {@msg}, followed by {@data}, and wait for the reply. Once the
+ * connection is gone, every request fails, and calls run in the rank.
+ */
+static bool broker_request(const struct host_broker_msg *msg, const void *data, int fd,
+        struct host_broker_reply *reply) {
+    bool ok;
+
+    pthread_mutex_lock(&broker_lock);
+    ok = broker_sock != -1
+        && host_broker_send(broker_sock, msg, sizeof *msg, fd)
+        && (!msg->size || host_broker_send(broker_sock, data, msg->size, -1))
+        && host_broker_recv(broker_sock, reply, sizeof *reply, NULL);
+    if (!ok && broker_sock != -1) {
+        writef(STDERR_FILENO, "blas2cuda: lost the broker at %s, running calls here\n",
+                host_broker_path());
+        close(broker_sock);
+        broker_sock = -1;
+        broker_lost = true;
+    }
+    pthread_mutex_unlock(&broker_lock);
+    return ok;
+}
+
+void host_broker_share(void *dev, size_t size, int fd) {
+    const struct host_broker_msg msg = { BROKER_SHARE, 0, (uintptr_t) dev, size };
+    struct host_broker_reply reply;
+
+    /* if it fails, the calls that use it run here */
+    broker_request(&msg, NULL, fd, &reply);
+}
+
+void host_broker_unshare(void *dev) {
+    const struct host_broker_msg msg = { BROKER_UNSHARE, 0, (uintptr_t) dev, 0 };
+    struct host_broker_reply reply;
+
+    broker_request(&msg, NULL, -1, &reply);
+}
+
+bool host_broker_call(const void *call, size_t size, struct host_broker_reply *reply) {
+    const struct host_broker_msg msg = { BROKER_CALL, size, 0, 0 };
+
+    return broker_request(&msg, call, -1, reply) && reply->status == BROKER_DONE;
+}
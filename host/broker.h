@@ -0,0 +1,125 @@
+#ifndef HOST_BROKER_H
+#define HOST_BROKER_H
+
+/*
+ * The broker lets the ranks of a job on one node share a device through a
+ * daemon, blas2cuda-broker, instead of each opening it. It is the
+ * "broker" backend (libblas2cuda-broker.so), the host emulation with:
+ *
+ * - device memory in memfds, which are passed to the daemon over its Unix
+ *   socket (SCM_RIGHTS) and mapped there too, so that operands are never
+ *   copied between the rank and the daemon
+ * - cuBLAS calls sent to the daemon when their turn comes on the stream,
+ *   the stream waiting for the reply. Streams, events, graphs and copies
+ *   stay in the rank.
+ *
+ * The daemon runs the calls of all of its ranks on a few executor threads
+ * through the next BLAS library (the host BLAS, or the device if it runs
+ * with libblas2cuda preloaded). If the daemon is not running, the backend
+ * sees no device and the next one is loaded instead. A call that the
+ * daemon cannot run (e.g. it points to memory that the daemon does not
+ * have, or the daemon has gone away) runs in the rank.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum host_broker_op {
+    BROKER_SHARE,           /* map [addr, addr + len), with the fd sent along */
+    BROKER_UNSHARE,         /* unmap the memory shared at addr */
+    BROKER_CALL,            /* run the call in the size bytes that follow */
+};
+
+struct host_broker_msg {
+    uint32_t op;
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+};
+
+enum host_broker_status {
+    BROKER_DONE,            /* the call ran, and result[] has its value if returned */
+    BROKER_DECLINED,        /* the call did not run: the rank runs it */
+    BROKER_FAILED,          /* sharing or unsharing failed */
+};
+
+struct host_broker_reply {
+    int32_t status;
+    uint32_t returned;
+    unsigned char result[16];
+};
+
+/**
+ * The path of the socket of the daemon: $BLAS2CUDA_BROKER if set, else
+ * blas2cuda-broker.sock in $XDG_RUNTIME_DIR, or in /tmp with the user id.
+ */
+const char *host_broker_path(void);
+
+/**
+ * Send all of [{@buf}, {@buf} + {@size}) on {@sock}, with {@fd} along if
+ * it is not -1.
+ * @return false if the connection is gone
+ */
+bool host_broker_send(int sock, const void *buf, size_t size, int fd);
+
+/**
+ * Receive {@size} bytes from {@sock} into {@buf}. If {@fd} is not NULL,
+ * it is set to the fd that came along, or -1.
+ * @return false if the connection is gone
+ */
+bool host_broker_recv(int sock, void *buf, size_t size, int *fd);
+
+/*
+ * rank side (the broker backend)
+ */
+
+/**
+ * Connect to the daemon, if not connected already.
+ * @return true if connected
+ */
+bool host_broker_connect(void);
+
+/**
+ * Share [{@dev}, {@dev} + {@size}), mapped from {@fd}, with the daemon.
+ * The caller keeps {@fd}.
+ */
+void host_broker_share(void *dev, size_t size, int fd);
+
+/**
+ * Stop sharing the memory at {@dev}, before it is unmapped.
+ */
+void host_broker_unshare(void *dev);
+
+/**
+ * Have the daemon run the call in [{@call}, {@call} + {@size}).
+ * @return true if it ran; {@reply} says whether it returned a value
+ */
+bool host_broker_call(const void *call, size_t size, struct host_broker_reply *reply);
+
+/*
+ * both sides (host/cublas.c)
+ */
+
+/**
+ * Run the call in [{@buf}, {@buf} + {@size}) received from a rank. The
+ * call names one of a fixed table of routines, against which its
+ * arguments are checked: every operand, with the extent that its
+ * dimensions, leading dimension, increment, stride and batch give it, must
+ * be in memory that the rank shared, as host_dev_ptr() sees it (NULL for
+ * memory that it did not share). A value that is not returned to shared
+ * memory goes to {@reply}.
+ *
+ * @return false if the call is not one that this daemon can run
+ */
+bool host_call_serve(void *buf, size_t size, struct host_broker_reply *reply);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
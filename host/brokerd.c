@@ -0,0 +1,374 @@
+#define _GNU_SOURCE
+#include "host.h"
+#include "broker.h"
+#include "../common.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * blas2cuda-broker [-j <executors>] [<socket>]
+ *
+ * The daemon of the broker backend (see broker.h). Each rank that connects
+ * gets a thread, which maps the memory that the rank shares and queues its
+ * calls. The calls of all ranks run in the order they come on the
+ * executors (1 by default), so that they take turns on the device instead
+ * of each rank launching work of its own; a rank has at most one call in
+ * flight. Calls go to the BLAS library that the daemon is linked with, or
+ * to the device if it runs with libblas2cuda preloaded.
+ */
+
+#define MAX_CALL_SIZE   (64 << 10)
+
+/* memory that a rank shares */
+struct mapping {
+    char *rank;             /* as seen by the rank */
+    char *local;
+    size_t size;
+};
+
+struct client {
+    int sock;
+    pid_t pid;
+    struct mapping *maps;   /* sorted by rank */
+    size_t num_maps, max_maps;
+    unsigned long calls, declined;
+};
+
+struct job {
+    struct client *client;
+    void *call;
+    size_t size;
+    struct host_broker_reply reply;
+    bool done;
+    struct job *next;
+};
+
+static struct job *jobs_head, *jobs_tail;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobs_done = PTHREAD_COND_INITIALIZER;
+
+/* the rank whose call runs on this thread */
+static __thread struct client *current;
+
+static const char *sock_path;
+
+/* for host/cublas.c */
+
+/* routines are looked up by name, so the BLAS library must stay linked in */
+extern void sgemm_();
+static __attribute__((used)) void (*const blas_needed)() = sgemm_;
+
+void *runtime_blas_func(const char *name) {
+    return dlsym(RTLD_DEFAULT, name);
+}
+
+void *host_alloc(size_t size) {
+    return calloc(1, size);
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+/* the daemon has no streams: calls run as they are submitted */
+void host_submit(cudaStream_t stream, struct host_task *task) {
+    task->run(task);
+    host_free(task);
+}
+
+cudaError_t cudaStreamSynchronize(cudaStream_t stream) {
+    return cudaSuccess;
+}
+
+/**
+ * The mapping of the current rank that contains {@ptr}, or the index where
+ * it would go.
+ */
+static size_t mapping_find(const struct client *client, const char *ptr, bool *found) {
+    size_t lo = 0, hi = client->num_maps;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (ptr < client->maps[mid].rank)
+            hi = mid;
+        else if (ptr >= client->maps[mid].rank + client->maps[mid].size)
+            lo = mid + 1;
+        else {
+            *found = true;
+            return mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+void *host_dev_ptr(const void *ptr) {
+    bool found;
+    size_t i;
+
+    if (!current)
+        return NULL;
+    i = mapping_find(current, ptr, &found);
+    return found ? current->maps[i].local + ((const char *) ptr - current->maps[i].rank) : NULL;
+}
+
+/* mappings, which only the thread of the client changes, while no call of its runs */
+
+static bool client_map(struct client *client, uint64_t addr, uint64_t len, int fd) {
+    char *local;
+    bool found;
+    size_t i;
+
+    if (fd == -1 || len == 0)
+        return false;
+    mapping_find(client, (char *) (uintptr_t) addr, &found);
+    if (found)
+        return false;
+    if (client->num_maps == client->max_maps) {
+        size_t max = client->max_maps ? 2 * client->max_maps : 64;
+        struct mapping *maps = realloc(client->maps, max * sizeof *maps);
+
+        if (!maps)
+            return false;
+        client->maps = maps;
+        client->max_maps = max;
+    }
+    if ((local = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        return false;
+
+    i = mapping_find(client, (char *) (uintptr_t) addr, &found);
+    memmove(&client->maps[i + 1], &client->maps[i], (client->num_maps - i) * sizeof *client->maps);
+    client->maps[i] = (struct mapping) { (char *) (uintptr_t) addr, local, len };
+    client->num_maps++;
+    return true;
+}
+
+static void client_unmap(struct client *client, uint64_t addr) {
+    struct mapping m;
+    bool found;
+    size_t i;
+
+    i = mapping_find(client, (char *) (uintptr_t) addr, &found);
+    if (!found || client->maps[i].rank != (char *) (uintptr_t) addr)
+        return;
+    m = client->maps[i];
+    memmove(&client->maps[i], &client->maps[i + 1], (client->num_maps - i - 1) * sizeof *client->maps);
+    client->num_maps--;
+    munmap(m.local, m.size);
+}
+
+/* calls */
+
+static void *executor(void *arg) {
+    struct job *job;
+
+    pthread_mutex_lock(&jobs_lock);
+    for (;;) {
+        while (!jobs_head)
+            pthread_cond_wait(&jobs_queued, &jobs_lock);
+        job = jobs_head;
+        if (!(jobs_head = job->next))
+            jobs_tail = NULL;
+        pthread_mutex_unlock(&jobs_lock);
+
+        current = job->client;
+        job->reply.status = host_call_serve(job->call, job->size, &job->reply)
+            ? BROKER_DONE : BROKER_DECLINED;
+        current = NULL;
+
+        pthread_mutex_lock(&jobs_lock);
+        job->done = true;
+        pthread_cond_broadcast(&jobs_done);
+    }
+    return NULL;
+}
+
+/**
+ * Queue the call in {@buf} for the executors, and wait for it.
+ */
+static void client_call(struct client *client, void *buf, size_t size, struct host_broker_reply *reply) {
+    struct job job = { .client = client, .call = buf, .size = size };
+
+    pthread_mutex_lock(&jobs_lock);
+    if (jobs_tail)
+        jobs_tail->next = &job;
+    else
+        jobs_head = &job;
+    jobs_tail = &job;
+    pthread_cond_signal(&jobs_queued);
+    while (!job.done)
+        pthread_cond_wait(&jobs_done, &jobs_lock);
+    pthread_mutex_unlock(&jobs_lock);
+
+    *reply = job.reply;
+    client->calls++;
+    client->declined += reply->status != BROKER_DONE;
+}
+
+static void *client_serve(void *arg) {
+    struct client *client = arg;
+    struct host_broker_msg msg;
+    struct host_broker_reply reply;
+    void *buf;
+    int fd;
+
+    if (!(buf = malloc(MAX_CALL_SIZE)))
+        goto out;
+    while (host_broker_recv(client->sock, &msg, sizeof msg, &fd)) {
+        memset(&reply, 0, sizeof reply);
+        reply.status = BROKER_DONE;
+        switch (msg.op) {
+            case BROKER_SHARE:
+                if (!client_map(client, msg.addr, msg.len, fd))
+                    reply.status = BROKER_FAILED;
+                break;
+            case BROKER_UNSHARE:
+                client_unmap(client, msg.addr);
+                break;
+            case BROKER_CALL:
+                if (msg.size > MAX_CALL_SIZE || !host_broker_recv(client->sock, buf, msg.size, NULL))
+                    goto disconnect;
+                client_call(client, buf, msg.size, &reply);
+                break;
+            default:
+                goto disconnect;
+        }
+        if (fd != -1)
+            close(fd);
+        if (!host_broker_send(client->sock, &reply, sizeof reply, -1))
+            break;
+        continue;
+disconnect:
+        if (fd != -1)
+            close(fd);
+        break;
+    }
+
+out:
+    writef(STDOUT_FILENO, "blas2cuda-broker: rank %d left after %lu calls (%lu run by the rank)\n",
+            client->pid, client->calls, client->declined);
+    while (client->num_maps > 0)
+        client_unmap(client, (uintptr_t) client->maps[0].rank);
+    close(client->sock);
+    free(client->maps);
+    free(client);
+    free(buf);
+    return NULL;
+}
+
+/* startup */
+
+static void on_signal(int sig) {
+    unlink(sock_path);
+    _exit(0);
+}
+
+/**
+ * Listen on {@path}, taking it over from a daemon that is gone.
+ */
+static int listen_on(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int sock;
+
+    if (strlen(path) >= sizeof addr.sun_path) {
+        writef(STDERR_FILENO, "blas2cuda-broker: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        return -1;
+    if (connect(sock, (struct sockaddr *) &addr, sizeof addr) == 0) {
+        writef(STDERR_FILENO, "blas2cuda-broker: already running at %s\n", path);
+        close(sock);
+        return -1;
+    }
+    unlink(path);
+    /* only for the user's ranks */
+    umask(077);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof addr) < 0 || listen(sock, SOMAXCONN) < 0) {
+        writef(STDERR_FILENO, "blas2cuda-broker: cannot listen on %s: %s\n", path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void usage(const char *prog) {
+    writef(STDERR_FILENO, "usage: %s [-j <executors>] [<socket>]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    int num_executors = 1;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int opt, sock;
+
+    while ((opt = getopt(argc, argv, "j:")) != -1) {
+        if (opt != 'j' || (num_executors = atoi(optarg)) <= 0)
+            usage(argv[0]);
+    }
+    if (optind < argc - 1)
+        usage(argv[0]);
+    if (optind == argc - 1)
+        setenv("BLAS2CUDA_BROKER", argv[optind], 1);
+    /* if libblas2cuda is preloaded, it must not use the broker backend */
+    setenv("BLAS2CUDA_BROKERD", "1", 1);
+
+    sock_path = host_broker_path();
+    if ((sock = listen_on(sock_path)) < 0)
+        return EXIT_FAILURE;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < num_executors; ++i)
+        if (pthread_create(&thread, &attr, executor, NULL) != 0) {
+            writef(STDERR_FILENO, "blas2cuda-broker: cannot start executors\n");
+            unlink(sock_path);
+            return EXIT_FAILURE;
+        }
+    writef(STDOUT_FILENO, "blas2cuda-broker: listening on %s with %d executor%s\n",
+            sock_path, num_executors, num_executors > 1 ? "s" : "");
+
+    for (;;) {
+        struct ucred cred;
+        socklen_t len = sizeof cred;
+        struct client *client;
+        int conn;
+
+        if ((conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            writef(STDERR_FILENO, "blas2cuda-broker: accept: %s\n", strerror(errno));
+            break;
+        }
+        if (!(client = calloc(1, sizeof *client))) {
+            close(conn);
+            continue;
+        }
+        client->sock = conn;
+        client->pid = getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 ? cred.pid : -1;
+        writef(STDOUT_FILENO, "blas2cuda-broker: rank %d connected\n", client->pid);
+        if (pthread_create(&thread, &attr, client_serve, client) != 0) {
+            close(conn);
+            free(client);
+        }
+    }
+    unlink(sock_path);
+    return EXIT_FAILURE;
+}
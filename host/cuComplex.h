@@ -0,0 +1,8 @@
+#ifndef HOST_CUCOMPLEX_H
+#define HOST_CUCOMPLEX_H
+
+/* laid out like float _Complex and double _Complex */
+typedef struct { float x, y; } cuComplex;
+typedef struct { double x, y; } cuDoubleComplex;
+
+#endif
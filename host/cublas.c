@@ -0,0 +1,1388 @@
+#define _GNU_SOURCE
+#include "host.h"
+#include "cublas_api.h"
+#include "../blas.h"
+#include "../common.h"
+#include "../runtime-blas.h"
+#if HOST_BROKER
+#include "broker.h"
+#elif HOST_REMOTE
+#include "remote.h"
+#include <time.h>
+#endif
+#include <complex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct cublasContext {
+    cudaStream_t stream;
+    cublasPointerMode_t mode;
+};
+
+cublasStatus_t cublasCreate(cublasHandle_t *handle) {
+    struct cublasContext *ctx;
+
+    if (!(ctx = host_alloc(sizeof *ctx)))
+        return CUBLAS_STATUS_ALLOC_FAILED;
+    *handle = ctx;
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+cublasStatus_t cublasDestroy(cublasHandle_t handle) {
+    host_free(handle);
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+cublasStatus_t cublasSetStream(cublasHandle_t handle, cudaStream_t streamId) {
+    handle->stream = streamId;
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+cublasStatus_t cublasGetStream(cublasHandle_t handle, cudaStream_t *streamId) {
+    *streamId = handle->stream;
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+cublasStatus_t cublasSetPointerMode(cublasHandle_t handle, cublasPointerMode_t mode) {
+    handle->mode = mode;
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+cublasStatus_t cublasGetPointerMode(cublasHandle_t handle, cublasPointerMode_t *mode) {
+    *mode = handle->mode;
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+/*
+ * A routine of the next BLAS library, with its arguments. Fortran takes all
+ * of its arguments by reference, so each argument is a pointer, either to
+ * device memory or to a value saved in the call (scalars are copied when
+ * the pointer mode is host, since the caller's may be gone by the time the
+ * call runs). Every routine is called through the same pointer type with
+ * MAX_ARGS pointer arguments, the ones after its own being ignored, which
+ * holds on the ABIs where the caller cleans up the stack.
+ */
+#define MAX_ARGS 18
+
+enum ret_kind { RET_NONE, RET_INT, RET_FLOAT, RET_DOUBLE, RET_CFLOAT, RET_CDOUBLE };
+
+/* every routine, which a call sent to a daemon or server names by index */
+enum call_routine {
+#define ROUTINE_INDEX(routine, name, ...) ROUTINE_##name,
+    CUBLAS_ROUTINES(ROUTINE_INDEX)
+    NUM_ROUTINES
+};
+
+struct call {
+    struct host_task task;
+    void (*fn)(void);
+    enum ret_kind ret;
+    void *result;                   /* where a function's value goes */
+    int num_args;
+    int num_chars;                  /* character arguments, for their lengths */
+    uint32_t by_value;              /* arguments saved in values[] */
+    void *args[MAX_ARGS];
+    union {
+        int i;
+        char c;
+        double complex z;
+    } values[MAX_ARGS];
+    /* for the routines that cuBLAS has and BLAS doesn't */
+    size_t elem_size;
+    int batch;
+    long long strides[3];
+    const void *src;
+    int ld_src;
+#if HOST_BROKER || HOST_REMOTE
+    unsigned short routine;         /* in call_routines[] */
+    void **moved;                   /* in the daemon: the matrices of a batch */
+#endif
+};
+
+typedef void (*f77_void)();
+typedef int (*f77_int)();
+typedef float (*f77_float)();
+typedef double (*f77_double)();
+typedef float complex (*f77_cfloat)();
+typedef double complex (*f77_cdouble)();
+
+#define f77(fname) ((void (*)(void)) runtime_blas_next(fname))
+
+/**
+ * The arguments of {@c}, followed by the lengths of its character
+ * arguments as gfortran passes them.
+ */
+static void call_args(struct call *c, void *args[MAX_ARGS]) {
+    int i;
+
+    for (i = 0; i < c->num_args; ++i)
+        args[i] = (c->by_value & (1u << i)) ? (void *) &c->values[i] : c->args[i];
+    for (; i < MAX_ARGS; ++i)
+        args[i] = (void *) (uintptr_t) (i - c->num_args < c->num_chars);
+}
+
+#define ARGS(a) a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8],\
+    a[9], a[10], a[11], a[12], a[13], a[14], a[15], a[16], a[17]
+
+static void call_invoke(struct call *c, void *a[MAX_ARGS]) {
+    switch (c->ret) {
+        case RET_NONE:    ((f77_void) c->fn)(ARGS(a)); break;
+        case RET_INT:     *(int *) c->result = ((f77_int) c->fn)(ARGS(a)); break;
+        case RET_FLOAT:   *(float *) c->result = ((f77_float) c->fn)(ARGS(a)); break;
+        case RET_DOUBLE:  *(double *) c->result = ((f77_double) c->fn)(ARGS(a)); break;
+        case RET_CFLOAT:  *(float complex *) c->result = ((f77_cfloat) c->fn)(ARGS(a)); break;
+        case RET_CDOUBLE: *(double complex *) c->result = ((f77_cdouble) c->fn)(ARGS(a)); break;
+    }
+}
+
+static void call_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    void *a[MAX_ARGS];
+
+    call_args(c, a);
+    call_invoke(c, a);
+}
+
+static struct call *call_new(enum call_routine routine, void (*fn)(void)) {
+    struct call *c;
+
+    if (!(c = host_alloc(sizeof *c))) {
+        writef(STDERR_FILENO, "blas2cuda: host: failed to allocate call\n");
+        abort();
+    }
+    c->task.size = sizeof *c;
+    c->task.run = call_run;
+    c->fn = fn;
+#if HOST_BROKER || HOST_REMOTE
+    c->routine = routine;
+#endif
+    return c;
+}
+
+static void *arg_value(struct call *c) {
+    const int i = c->num_args++;
+
+    c->by_value |= 1u << i;
+    return &c->values[i];
+}
+
+static void arg_int(struct call *c, int value) {
+    *(int *) arg_value(c) = value;
+}
+
+static void arg_char(struct call *c, char value) {
+    *(char *) arg_value(c) = value;
+    c->num_chars++;
+}
+
+#define arg_op(c, op)   arg_char(c, "NTC"[op])
+#define arg_fill(c, f)  arg_char(c, "LU"[f])
+#define arg_diag(c, d)  arg_char(c, "NU"[d])
+#define arg_side(c, s)  arg_char(c, "LR"[s])
+
+/* a matrix or vector, or an output */
+static void arg_ptr(struct call *c, const void *ptr) {
+    c->args[c->num_args++] = host_dev_ptr(ptr);
+}
+
+/* a scalar, which is read when the call is made in host pointer mode */
+static void arg_scalar(struct call *c, cublasHandle_t handle, const void *ptr, size_t size) {
+    if (handle->mode == CUBLAS_POINTER_MODE_HOST)
+        memcpy(arg_value(c), ptr, size);
+    else
+        arg_ptr(c, ptr);
+}
+
+#if HOST_BROKER
+static void broker_wrap(struct call *c);
+#elif HOST_REMOTE
+static void remote_wrap(struct call *c);
+#endif
+
+/**
+ * Enqueue {@c} on the handle's stream. Routines that return results wait
+ * for them in host pointer mode, as with cuBLAS.
+ */
+static cublasStatus_t call_submit(cublasHandle_t handle, struct call *c, bool returns) {
+#if HOST_BROKER
+    broker_wrap(c);
+#elif HOST_REMOTE
+    remote_wrap(c);
+#endif
+    host_submit(handle->stream, &c->task);
+    if (returns && handle->mode == CUBLAS_POINTER_MODE_HOST)
+        cudaStreamSynchronize(handle->stream);
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+static cublasStatus_t call_return(cublasHandle_t handle, struct call *c,
+        enum ret_kind ret, void *result) {
+    c->ret = ret;
+    c->result = host_dev_ptr(result);
+    return call_submit(handle, c, true);
+}
+
+#define ret_kind(x) _Generic(*(x),                                          \
+        int: RET_INT,                                                       \
+        float: RET_FLOAT,                                                   \
+        double: RET_DOUBLE,                                                 \
+        cuComplex: RET_CFLOAT,                                              \
+        cuDoubleComplex: RET_CDOUBLE)
+
+#define scalar(x)   arg_scalar(c, handle, x, sizeof *(x))
+
+/* the arguments of ?gemm_, with the operands at these positions */
+enum { GEMM_A = 6, GEMM_B = 8, GEMM_C = 11 };
+
+#if HOST_BROKER || HOST_REMOTE
+/*
+ * What a daemon or server knows of each routine: calls come with the index
+ * of theirs, and nothing else that they say about themselves is taken on
+ * trust. {@check} checks the arguments of a call against the layout and
+ * extents that the routine has, and moves its pointers to the memory of
+ * the daemon.
+ */
+struct routine {
+    const char *fname;              /* of the next BLAS library, or NULL */
+    void (*run)(struct host_task *task);
+    bool (*check)(struct call *c);
+    enum ret_kind ret;
+    size_t elem_size;
+};
+
+#define ROUTINE(name, fname, run, check, ret, T)                            \
+    static const struct routine routine_##name = { fname, run, check, ret, sizeof(T) };
+
+static const int gemm_pos[3] = { GEMM_A, GEMM_B, GEMM_C };
+
+/**
+ * {@ptr} moved to the daemon, if all of [{@ptr}, {@ptr} + {@size}) is in
+ * the same shared memory, or NULL.
+ */
+static void *dev_range(const void *ptr, size_t size) {
+    const uintptr_t last = (uintptr_t) ptr + size - 1;
+    char *first;
+
+    if (size == 0 || last < (uintptr_t) ptr || !(first = host_dev_ptr(ptr)))
+        return NULL;
+    return host_dev_ptr((const void *) last) == first + size - 1 ? first : NULL;
+}
+
+/* {@ptr}, to {@elems} elements of {@c}, moved to the daemon */
+static bool elems_move(const struct call *c, const void *ptr, uint64_t elems, void **moved) {
+    size_t size;
+
+    *moved = NULL;
+    if (elems == 0)
+        return true;
+    return !__builtin_mul_overflow(elems, c->elem_size, &size) && (*moved = dev_range(ptr, size));
+}
+
+/* argument {@i} of {@c}, to {@elems} elements */
+static bool arg_move(struct call *c, int i, uint64_t elems) {
+    return elems_move(c, c->args[i], elems, &c->args[i]);
+}
+
+/* a vector of {@n} elements, as level 1 routines take it */
+static uint64_t vec_elems(int n, int inc) {
+    return n > 0 ? 1 + (uint64_t) (n - 1) * (uint64_t) llabs(inc) : 0;
+}
+
+/* a vector of {@n} elements, as level 2 routines take it */
+static bool vec_check(int n, int inc, uint64_t *elems) {
+    *elems = vec_elems(n, inc);
+    return n >= 0 && inc != 0;
+}
+
+/* a {@rows} by {@cols} matrix with leading dimension {@ld} */
+static bool mat_check(long long rows, long long cols, int ld, uint64_t *elems) {
+    *elems = rows > 0 && cols > 0 ? (uint64_t) (cols - 1) * ld + rows : 0;
+    return rows >= 0 && cols >= 0 && ld >= (rows > 1 ? rows : 1);
+}
+
+/* a packed triangular matrix of order {@n} */
+static bool packed_check(int n, uint64_t *elems) {
+    *elems = n > 0 ? (uint64_t) n * (n + 1) / 2 : 0;
+    return n >= 0;
+}
+
+static bool char_in(char c, const char *set) {
+    return c && strchr(set, c);
+}
+
+/**
+ * Check that the arguments of {@c} are laid out as in {@layout}, a letter
+ * per argument: 't' for an operation, 'u' a triangle, 'd' a diagonal, 's'
+ * a side, 'i' an integer, 'a' a scalar, which is moved if it is not a
+ * value, and 'p' a pointer, which the caller moves.
+ */
+static bool call_layout(struct call *c, const char *layout) {
+    const int num_args = strlen(layout);
+    int num_chars = 0;
+
+    if (c->num_args != num_args || (c->by_value >> num_args))
+        return false;
+    for (int i = 0; i < num_args; ++i) {
+        const bool value = c->by_value & (1u << i);
+        const char v = c->values[i].c;
+
+        switch (layout[i]) {
+            case 't': if (!value || !char_in(v, "NTC")) return false; break;
+            case 'u': if (!value || !char_in(v, "LU")) return false; break;
+            case 'd': if (!value || !char_in(v, "NU")) return false; break;
+            case 's': if (!value || !char_in(v, "LR")) return false; break;
+            case 'i': if (!value) return false; break;
+            case 'a': if (!value && !arg_move(c, i, 1)) return false; break;
+            case 'p': if (value) return false; break;
+        }
+        num_chars += strchr("tuds", layout[i]) != NULL;
+    }
+    return c->num_chars == num_chars;
+}
+
+#define iv(k)   (c->values[k].i)
+#define cv(k)   (c->values[k].c)
+
+/* Level 1 */
+static bool check_vec(struct call *c) {
+    return call_layout(c, "ipi") && arg_move(c, 1, vec_elems(iv(0), iv(2)));
+}
+
+static bool check_axpy(struct call *c) {
+    return call_layout(c, "iapipi")
+        && arg_move(c, 2, vec_elems(iv(0), iv(3))) && arg_move(c, 4, vec_elems(iv(0), iv(5)));
+}
+
+static bool check_vv(struct call *c) {
+    return call_layout(c, "ipipi")
+        && arg_move(c, 1, vec_elems(iv(0), iv(2))) && arg_move(c, 3, vec_elems(iv(0), iv(4)));
+}
+
+static bool check_scal(struct call *c) {
+    return call_layout(c, "iapi") && arg_move(c, 2, vec_elems(iv(0), iv(3)));
+}
+
+static bool check_rot(struct call *c) {
+    return call_layout(c, "ipipiaa")
+        && arg_move(c, 1, vec_elems(iv(0), iv(2))) && arg_move(c, 3, vec_elems(iv(0), iv(4)));
+}
+
+static bool check_rotg(struct call *c) {
+    return call_layout(c, "pppp")
+        && arg_move(c, 0, 1) && arg_move(c, 1, 1) && arg_move(c, 2, 1) && arg_move(c, 3, 1);
+}
+
+static bool check_rotm(struct call *c) {
+    return call_layout(c, "ipipip") && arg_move(c, 1, vec_elems(iv(0), iv(2)))
+        && arg_move(c, 3, vec_elems(iv(0), iv(4))) && arg_move(c, 5, 5);
+}
+
+static bool check_rotmg(struct call *c) {
+    return call_layout(c, "ppppp") && arg_move(c, 0, 1) && arg_move(c, 1, 1)
+        && arg_move(c, 2, 1) && arg_move(c, 3, 1) && arg_move(c, 4, 5);
+}
+
+/* Level 2 */
+static bool check_gemv(struct call *c) {
+    const bool notrans = cv(0) == 'N';
+    uint64_t a, x, y;
+
+    return call_layout(c, "tiiapipiapi") && mat_check(iv(1), iv(2), iv(5), &a)
+        && vec_check(notrans ? iv(2) : iv(1), iv(7), &x)
+        && vec_check(notrans ? iv(1) : iv(2), iv(10), &y)
+        && arg_move(c, 4, a) && arg_move(c, 6, x) && arg_move(c, 9, y);
+}
+
+static bool check_gbmv(struct call *c) {
+    const bool notrans = cv(0) == 'N';
+    uint64_t a, x, y;
+
+    return call_layout(c, "tiiiiapipiapi") && iv(1) >= 0 && iv(3) >= 0 && iv(4) >= 0
+        && mat_check(1LL + iv(3) + iv(4), iv(2), iv(7), &a)
+        && vec_check(notrans ? iv(2) : iv(1), iv(9), &x)
+        && vec_check(notrans ? iv(1) : iv(2), iv(12), &y)
+        && arg_move(c, 6, a) && arg_move(c, 8, x) && arg_move(c, 11, y);
+}
+
+static bool check_trxv(struct call *c) {
+    uint64_t a, x;
+
+    return call_layout(c, "utdipipi") && mat_check(iv(3), iv(3), iv(5), &a)
+        && vec_check(iv(3), iv(7), &x) && arg_move(c, 4, a) && arg_move(c, 6, x);
+}
+
+static bool check_tbxv(struct call *c) {
+    uint64_t a, x;
+
+    return call_layout(c, "utdiipipi") && iv(4) >= 0 && mat_check(iv(4) + 1LL, iv(3), iv(6), &a)
+        && vec_check(iv(3), iv(8), &x) && arg_move(c, 5, a) && arg_move(c, 7, x);
+}
+
+static bool check_tpxv(struct call *c) {
+    uint64_t a, x;
+
+    return call_layout(c, "utdippi") && packed_check(iv(3), &a) && vec_check(iv(3), iv(6), &x)
+        && arg_move(c, 4, a) && arg_move(c, 5, x);
+}
+
+static bool check_symvx(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "uiapipiapi") && mat_check(iv(1), iv(1), iv(4), &a)
+        && vec_check(iv(1), iv(6), &x) && vec_check(iv(1), iv(9), &y)
+        && arg_move(c, 3, a) && arg_move(c, 5, x) && arg_move(c, 8, y);
+}
+
+static bool check_sbmvx(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "uiiapipiapi") && iv(2) >= 0 && mat_check(iv(2) + 1LL, iv(1), iv(5), &a)
+        && vec_check(iv(1), iv(7), &x) && vec_check(iv(1), iv(10), &y)
+        && arg_move(c, 4, a) && arg_move(c, 6, x) && arg_move(c, 9, y);
+}
+
+static bool check_spmvx(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "uiappiapi") && packed_check(iv(1), &a)
+        && vec_check(iv(1), iv(5), &x) && vec_check(iv(1), iv(8), &y)
+        && arg_move(c, 3, a) && arg_move(c, 4, x) && arg_move(c, 7, y);
+}
+
+static bool check_syrx(struct call *c) {
+    uint64_t a, x;
+
+    return call_layout(c, "uiapipi") && vec_check(iv(1), iv(4), &x)
+        && mat_check(iv(1), iv(1), iv(6), &a) && arg_move(c, 3, x) && arg_move(c, 5, a);
+}
+
+static bool check_sprx(struct call *c) {
+    uint64_t a, x;
+
+    return call_layout(c, "uiapip") && vec_check(iv(1), iv(4), &x) && packed_check(iv(1), &a)
+        && arg_move(c, 3, x) && arg_move(c, 5, a);
+}
+
+static bool check_syr2x(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "uiapipipi")
+        && vec_check(iv(1), iv(4), &x) && vec_check(iv(1), iv(6), &y)
+        && mat_check(iv(1), iv(1), iv(8), &a)
+        && arg_move(c, 3, x) && arg_move(c, 5, y) && arg_move(c, 7, a);
+}
+
+static bool check_spr2x(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "uiapipip") && vec_check(iv(1), iv(4), &x) && vec_check(iv(1), iv(6), &y)
+        && packed_check(iv(1), &a) && arg_move(c, 3, x) && arg_move(c, 5, y) && arg_move(c, 7, a);
+}
+
+static bool check_gerx(struct call *c) {
+    uint64_t a, x, y;
+
+    return call_layout(c, "iiapipipi")
+        && vec_check(iv(0), iv(4), &x) && vec_check(iv(1), iv(6), &y)
+        && mat_check(iv(0), iv(1), iv(8), &a)
+        && arg_move(c, 3, x) && arg_move(c, 5, y) && arg_move(c, 7, a);
+}
+
+/* Level 3 */
+
+/* the extents of the operands of ?gemm_ */
+static bool gemm_extents(struct call *c, uint64_t elems[3]) {
+    const int m = iv(2), n = iv(3), k = iv(4);
+
+    return call_layout(c, "ttiiiapipiapi") && k >= 0
+        && mat_check(cv(0) == 'N' ? m : k, cv(0) == 'N' ? k : m, iv(7), &elems[0])
+        && mat_check(cv(1) == 'N' ? k : n, cv(1) == 'N' ? n : k, iv(9), &elems[1])
+        && mat_check(m, n, iv(12), &elems[2]);
+}
+
+static bool check_gemm(struct call *c) {
+    uint64_t e[3];
+
+    return gemm_extents(c, e)
+        && arg_move(c, GEMM_A, e[0]) && arg_move(c, GEMM_B, e[1]) && arg_move(c, GEMM_C, e[2]);
+}
+
+/*
+ * The matrices of a batch are moved once, to moved[], since the arrays of
+ * pointers are in memory that the rank can change while the call runs.
+ */
+static bool check_gemm_batched(struct call *c) {
+    uint64_t e[3];
+
+    void *const *arrays[3];
+
+    if (!gemm_extents(c, e) || c->batch < 0)
+        return false;
+    for (int j = 0; j < 3; ++j)
+        if (!(arrays[j] = dev_range(c->args[gemm_pos[j]], c->batch * sizeof *arrays[j])) && c->batch)
+            return false;
+    if (!(c->moved = host_alloc((3 * (size_t) c->batch + 1) * sizeof *c->moved)))
+        return false;
+    for (int j = 0; j < 3; ++j) {
+        void *const *array = arrays[j];
+        void **moved = &c->moved[j * (size_t) c->batch];
+
+        for (int i = 0; i < c->batch; ++i)
+            if (!elems_move(c, array[i], e[j], &moved[i]))
+                return false;
+        c->args[gemm_pos[j]] = moved;
+    }
+    return true;
+}
+
+static bool check_gemm_strided(struct call *c) {
+    uint64_t e[3];
+    size_t stride, offset;
+
+    if (!gemm_extents(c, e) || c->batch < 0
+            || !(c->moved = host_alloc((3 * (size_t) c->batch + 1) * sizeof *c->moved)))
+        return false;
+    for (int j = 0; j < 3; ++j) {
+        void **moved = &c->moved[j * (size_t) c->batch];
+
+        if (c->strides[j] < 0 || __builtin_mul_overflow(c->strides[j], c->elem_size, &stride))
+            return false;
+        for (int i = 0; i < c->batch; ++i)
+            if (__builtin_mul_overflow((size_t) i, stride, &offset)
+                    || !elems_move(c, (const void *) ((uintptr_t) c->args[gemm_pos[j]] + offset),
+                        e[j], &moved[i]))
+                return false;
+        c->args[gemm_pos[j]] = moved;
+    }
+    return true;
+}
+
+/* on the arguments of ?gemm_, with a triangle for the first */
+static bool check_syrkx(struct call *c) {
+    const bool notrans = cv(1) == 'N';
+    const int n = iv(2), k = iv(4);
+    uint64_t a, b, cc;
+
+    return call_layout(c, "utiiiapipiapi") && iv(3) == n && k >= 0
+        && mat_check(notrans ? n : k, notrans ? k : n, iv(7), &a)
+        && mat_check(notrans ? n : k, notrans ? k : n, iv(9), &b) && mat_check(n, n, iv(12), &cc)
+        && arg_move(c, GEMM_A, a) && arg_move(c, GEMM_B, b) && arg_move(c, GEMM_C, cc);
+}
+
+static bool check_symmx(struct call *c) {
+    const int ka = cv(0) == 'L' ? iv(2) : iv(3);
+    uint64_t a, b, cc;
+
+    return call_layout(c, "suiiapipiapi") && mat_check(ka, ka, iv(6), &a)
+        && mat_check(iv(2), iv(3), iv(8), &b) && mat_check(iv(2), iv(3), iv(11), &cc)
+        && arg_move(c, 5, a) && arg_move(c, 7, b) && arg_move(c, 10, cc);
+}
+
+/* ?syrk_ and ?syr2k_ take op(A) to be A or A^T, ?herk_ and ?her2k_ A or A^H */
+static bool check_rankk(struct call *c, char trans) {
+    const bool notrans = cv(1) == 'N';
+    uint64_t a, cc;
+
+    return call_layout(c, "utiiapiapi") && (notrans || cv(1) == trans) && iv(3) >= 0
+        && mat_check(notrans ? iv(2) : iv(3), notrans ? iv(3) : iv(2), iv(6), &a)
+        && mat_check(iv(2), iv(2), iv(9), &cc) && arg_move(c, 5, a) && arg_move(c, 8, cc);
+}
+
+static bool check_syrk(struct call *c) { return check_rankk(c, 'T'); }
+static bool check_herk(struct call *c) { return check_rankk(c, 'C'); }
+
+static bool check_rank2k(struct call *c, char trans) {
+    const bool notrans = cv(1) == 'N';
+    uint64_t a, b, cc;
+
+    return call_layout(c, "utiiapipiapi") && (notrans || cv(1) == trans) && iv(3) >= 0
+        && mat_check(notrans ? iv(2) : iv(3), notrans ? iv(3) : iv(2), iv(6), &a)
+        && mat_check(notrans ? iv(2) : iv(3), notrans ? iv(3) : iv(2), iv(8), &b)
+        && mat_check(iv(2), iv(2), iv(11), &cc)
+        && arg_move(c, 5, a) && arg_move(c, 7, b) && arg_move(c, 10, cc);
+}
+
+static bool check_syr2k(struct call *c) { return check_rank2k(c, 'T'); }
+static bool check_her2k(struct call *c) { return check_rank2k(c, 'C'); }
+
+/* ?trsm_, and ?trmm_ with C for B */
+static bool check_trxm(struct call *c) {
+    const int ka = cv(0) == 'L' ? iv(4) : iv(5);
+    uint64_t a, b;
+
+    return call_layout(c, "sutdiiapipi") && mat_check(ka, ka, iv(8), &a)
+        && mat_check(iv(4), iv(5), iv(10), &b) && arg_move(c, 7, a) && arg_move(c, 9, b);
+}
+
+/* and the B that is copied to C first */
+static bool check_trmm(struct call *c) {
+    uint64_t b;
+
+    return check_trxm(c) && mat_check(iv(4), iv(5), c->ld_src, &b)
+        && elems_move(c, c->src, b, (void **) &c->src);
+}
+
+static bool check_geam(struct call *c) {
+    uint64_t a, b, cc;
+
+    return call_layout(c, "ttiiapiapipi")
+        && mat_check(cv(0) == 'N' ? iv(2) : iv(3), cv(0) == 'N' ? iv(3) : iv(2), iv(6), &a)
+        && mat_check(cv(1) == 'N' ? iv(2) : iv(3), cv(1) == 'N' ? iv(3) : iv(2), iv(9), &b)
+        && mat_check(iv(2), iv(3), iv(11), &cc)
+        && arg_move(c, 5, a) && arg_move(c, 8, b) && arg_move(c, 10, cc);
+}
+
+#undef iv
+#undef cv
+#else
+#define ROUTINE(name, fname, run, check, ret, T)
+#endif
+
+/* Level 1 */
+#define DEF_iamax(name, p, T)                                               \
+ROUTINE(name, "i" #p "amax_", call_run, check_vec, RET_INT, T)              \
+CUBLAS_iamax(name, T) {                                                     \
+    struct call *c = call_new(ROUTINE_##name, f77(i##p##amax_));            \
+    arg_int(c, n); arg_ptr(c, x); arg_int(c, incx);                         \
+    return call_return(handle, c, RET_INT, result);                         \
+}
+
+#define DEF_iamin(name, p, T)                                               \
+ROUTINE(name, "i" #p "amin_", call_run, check_vec, RET_INT, T)              \
+CUBLAS_iamin(name, T) {                                                     \
+    struct call *c = call_new(ROUTINE_##name, f77(i##p##amin_));            \
+    arg_int(c, n); arg_ptr(c, x); arg_int(c, incx);                         \
+    return call_return(handle, c, RET_INT, result);                         \
+}
+
+#define DEF_reduce(routine, name, fname, S, T)                              \
+ROUTINE(name, #fname, call_run, check_vec, ret_kind((S *) 0), T)            \
+CUBLAS_##routine(name, S, T) {                                              \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_int(c, n); arg_ptr(c, x); arg_int(c, incx);                         \
+    return call_return(handle, c, ret_kind(result), result);                \
+}
+
+#define DEF_asum(name, p, S, T) DEF_reduce(asum, name, p##asum_, S, T)
+#define DEF_nrm2(name, p, S, T) DEF_reduce(nrm2, name, p##nrm2_, S, T)
+
+#define DEF_axpy(name, p, T)                                                \
+ROUTINE(name, #p "axpy_", call_run, check_axpy, RET_NONE, T)                \
+CUBLAS_axpy(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##axpy_));               \
+    arg_int(c, n); scalar(alpha);                                           \
+    arg_ptr(c, x); arg_int(c, incx); arg_ptr(c, y); arg_int(c, incy);       \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_vv(routine, name, fname, T)                                     \
+ROUTINE(name, #fname, call_run, check_vv, RET_NONE, T)                      \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_int(c, n);                                                          \
+    arg_ptr(c, x); arg_int(c, incx); arg_ptr(c, y); arg_int(c, incy);       \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_copy(name, p, T) DEF_vv(copy, name, p##copy_, T)
+#define DEF_swap(name, p, T) DEF_vv(swap, name, p##swap_, T)
+
+#define DEF_scal(name, p, S, T)                                             \
+ROUTINE(name, #p "scal_", call_run, check_scal, RET_NONE, T)                \
+CUBLAS_scal(name, S, T) {                                                   \
+    struct call *c = call_new(ROUTINE_##name, f77(p##scal_));               \
+    arg_int(c, n); scalar(alpha); arg_ptr(c, x); arg_int(c, incx);          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_dotx(routine, name, fname, T)                                   \
+ROUTINE(name, #fname, call_run, check_vv, ret_kind((T *) 0), T)             \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_int(c, n);                                                          \
+    arg_ptr(c, x); arg_int(c, incx); arg_ptr(c, y); arg_int(c, incy);       \
+    return call_return(handle, c, ret_kind(result), result);                \
+}
+
+#define DEF_dot(name, p, T)  DEF_dotx(dot, name, p##dot_, T)
+#define DEF_dotu(name, p, T) DEF_dotx(dotu, name, p##dotu_, T)
+#define DEF_dotc(name, p, T) DEF_dotx(dotc, name, p##dotc_, T)
+
+/* {@c} is an argument of theirs */
+#define DEF_rot(name, p, S, T)                                              \
+ROUTINE(name, #p "rot_", call_run, check_rot, RET_NONE, T)                  \
+CUBLAS_rot(name, S, T) {                                                    \
+    struct call *call = call_new(ROUTINE_##name, f77(p##rot_));             \
+    arg_int(call, n);                                                       \
+    arg_ptr(call, x); arg_int(call, incx);                                  \
+    arg_ptr(call, y); arg_int(call, incy);                                  \
+    arg_scalar(call, handle, c, sizeof *c);                                 \
+    arg_scalar(call, handle, s, sizeof *s);                                 \
+    return call_submit(handle, call, false);                                \
+}
+
+/* all of their arguments are scalars, which they update */
+#define DEF_rotg(name, p, S, T)                                             \
+ROUTINE(name, #p "rotg_", call_run, check_rotg, RET_NONE, T)                \
+CUBLAS_rotg(name, S, T) {                                                   \
+    struct call *call = call_new(ROUTINE_##name, f77(p##rotg_));            \
+    arg_ptr(call, a); arg_ptr(call, b); arg_ptr(call, c); arg_ptr(call, s); \
+    return call_submit(handle, call, true);                                 \
+}
+
+#define DEF_rotm(name, p, T)                                                \
+ROUTINE(name, #p "rotm_", call_run, check_rotm, RET_NONE, T)                \
+CUBLAS_rotm(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##rotm_));               \
+    arg_int(c, n);                                                          \
+    arg_ptr(c, x); arg_int(c, incx); arg_ptr(c, y); arg_int(c, incy);       \
+    arg_ptr(c, param);                                                      \
+    return call_submit(handle, c, handle->mode == CUBLAS_POINTER_MODE_HOST);\
+}
+
+#define DEF_rotmg(name, p, T)                                               \
+ROUTINE(name, #p "rotmg_", call_run, check_rotmg, RET_NONE, T)              \
+CUBLAS_rotmg(name, T) {                                                     \
+    struct call *c = call_new(ROUTINE_##name, f77(p##rotmg_));              \
+    arg_ptr(c, d1); arg_ptr(c, d2); arg_ptr(c, x1); arg_ptr(c, y1);         \
+    arg_ptr(c, param);                                                      \
+    return call_submit(handle, c, true);                                    \
+}
+
+/* Level 2 */
+#define DEF_gemv(name, p, T)                                                \
+ROUTINE(name, #p "gemv_", call_run, check_gemv, RET_NONE, T)                \
+CUBLAS_gemv(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##gemv_));               \
+    arg_op(c, trans); arg_int(c, m); arg_int(c, n);                         \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    scalar(beta); arg_ptr(c, y); arg_int(c, incy);                          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_gbmv(name, p, T)                                                \
+ROUTINE(name, #p "gbmv_", call_run, check_gbmv, RET_NONE, T)                \
+CUBLAS_gbmv(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##gbmv_));               \
+    arg_op(c, trans); arg_int(c, m); arg_int(c, n);                         \
+    arg_int(c, kl); arg_int(c, ku);                                         \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    scalar(beta); arg_ptr(c, y); arg_int(c, incy);                          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_trxv(routine, name, fname, T)                                   \
+ROUTINE(name, #fname, call_run, check_trxv, RET_NONE, T)                    \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_op(c, trans); arg_diag(c, diag);                 \
+    arg_int(c, n); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_trmv(name, p, T) DEF_trxv(trmv, name, p##trmv_, T)
+#define DEF_trsv(name, p, T) DEF_trxv(trsv, name, p##trsv_, T)
+
+#define DEF_tbxv(routine, name, fname, T)                                   \
+ROUTINE(name, #fname, call_run, check_tbxv, RET_NONE, T)                    \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_op(c, trans); arg_diag(c, diag);                 \
+    arg_int(c, n); arg_int(c, k); arg_ptr(c, A); arg_int(c, lda);           \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_tbmv(name, p, T) DEF_tbxv(tbmv, name, p##tbmv_, T)
+#define DEF_tbsv(name, p, T) DEF_tbxv(tbsv, name, p##tbsv_, T)
+
+#define DEF_tpxv(routine, name, fname, T)                                   \
+ROUTINE(name, #fname, call_run, check_tpxv, RET_NONE, T)                    \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_op(c, trans); arg_diag(c, diag);                 \
+    arg_int(c, n); arg_ptr(c, AP); arg_ptr(c, x); arg_int(c, incx);         \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_tpmv(name, p, T) DEF_tpxv(tpmv, name, p##tpmv_, T)
+#define DEF_tpsv(name, p, T) DEF_tpxv(tpsv, name, p##tpsv_, T)
+
+#define DEF_symvx(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_symvx, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    scalar(beta); arg_ptr(c, y); arg_int(c, incy);                          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_symv(name, p, T) DEF_symvx(symv, name, p##symv_, T)
+#define DEF_hemv(name, p, T) DEF_symvx(hemv, name, p##hemv_, T)
+
+#define DEF_sbmvx(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_sbmvx, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n); arg_int(c, k);                        \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, x); arg_int(c, incx);                                        \
+    scalar(beta); arg_ptr(c, y); arg_int(c, incy);                          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_sbmv(name, p, T) DEF_sbmvx(sbmv, name, p##sbmv_, T)
+#define DEF_hbmv(name, p, T) DEF_sbmvx(hbmv, name, p##hbmv_, T)
+
+#define DEF_spmvx(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_spmvx, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, AP); arg_ptr(c, x); arg_int(c, incx);         \
+    scalar(beta); arg_ptr(c, y); arg_int(c, incy);                          \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_spmv(name, p, T) DEF_spmvx(spmv, name, p##spmv_, T)
+#define DEF_hpmv(name, p, T) DEF_spmvx(hpmv, name, p##hpmv_, T)
+
+#define DEF_syrx(routine, name, fname, S, T)                                \
+ROUTINE(name, #fname, call_run, check_syrx, RET_NONE, T)                    \
+CUBLAS_##routine(name, S, T) {                                              \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, x); arg_int(c, incx);                         \
+    arg_ptr(c, A); arg_int(c, lda);                                         \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_syr(name, p, S, T) DEF_syrx(syr, name, p##syr_, S, T)
+#define DEF_her(name, p, S, T) DEF_syrx(her, name, p##her_, S, T)
+
+#define DEF_sprx(routine, name, fname, S, T)                                \
+ROUTINE(name, #fname, call_run, check_sprx, RET_NONE, T)                    \
+CUBLAS_##routine(name, S, T) {                                              \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, x); arg_int(c, incx); arg_ptr(c, AP);         \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_spr(name, p, S, T) DEF_sprx(spr, name, p##spr_, S, T)
+#define DEF_hpr(name, p, S, T) DEF_sprx(hpr, name, p##hpr_, S, T)
+
+#define DEF_syr2x(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_syr2x, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, x); arg_int(c, incx);                         \
+    arg_ptr(c, y); arg_int(c, incy); arg_ptr(c, A); arg_int(c, lda);        \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_syr2(name, p, T) DEF_syr2x(syr2, name, p##syr2_, T)
+#define DEF_her2(name, p, T) DEF_syr2x(her2, name, p##her2_, T)
+
+#define DEF_spr2x(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_spr2x, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_int(c, n);                                       \
+    scalar(alpha); arg_ptr(c, x); arg_int(c, incx);                         \
+    arg_ptr(c, y); arg_int(c, incy); arg_ptr(c, AP);                        \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_spr2(name, p, T) DEF_spr2x(spr2, name, p##spr2_, T)
+#define DEF_hpr2(name, p, T) DEF_spr2x(hpr2, name, p##hpr2_, T)
+
+#define DEF_gerx(routine, name, fname, T)                                   \
+ROUTINE(name, #fname, call_run, check_gerx, RET_NONE, T)                    \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_int(c, m); arg_int(c, n);                                           \
+    scalar(alpha); arg_ptr(c, x); arg_int(c, incx);                         \
+    arg_ptr(c, y); arg_int(c, incy); arg_ptr(c, A); arg_int(c, lda);        \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_ger(name, p, T)  DEF_gerx(ger, name, p##ger_, T)
+#define DEF_geru(name, p, T) DEF_gerx(geru, name, p##geru_, T)
+#define DEF_gerc(name, p, T) DEF_gerx(gerc, name, p##gerc_, T)
+
+/* Level 3 */
+
+static void gemm_args(struct call *c, cublasHandle_t handle,
+        cublasOperation_t transa, cublasOperation_t transb,
+        int m, int n, int k, const void *alpha, const void *A, int lda,
+        const void *B, int ldb, const void *beta, void *C, int ldc) {
+    arg_op(c, transa); arg_op(c, transb);
+    arg_int(c, m); arg_int(c, n); arg_int(c, k);
+    arg_scalar(c, handle, alpha, c->elem_size);
+    arg_ptr(c, A); arg_int(c, lda);
+    arg_ptr(c, B); arg_int(c, ldb);
+    arg_scalar(c, handle, beta, c->elem_size);
+    arg_ptr(c, C); arg_int(c, ldc);
+}
+
+/* 3M is only a different algorithm, which the next BLAS may not have */
+#define DEF_gemmx(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_gemm, RET_NONE, T)                    \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    c->elem_size = sizeof(T);                                               \
+    gemm_args(c, handle, transa, transb, m, n, k,                           \
+            alpha, A, lda, B, ldb, beta, C, ldc);                           \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_gemm(name, p, T)   DEF_gemmx(gemm, name, p##gemm_, T)
+#define DEF_gemm3m(name, p, T) DEF_gemmx(gemm3m, name, p##gemm_, T)
+
+/* the arrays of pointers are in device memory, and read when the call runs */
+static void gemm_batched_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    void *const *arrays[3] = { c->args[GEMM_A], c->args[GEMM_B], c->args[GEMM_C] };
+    void *a[MAX_ARGS];
+
+    call_args(c, a);
+    for (int i = 0; i < c->batch; ++i) {
+        a[GEMM_A] = host_dev_ptr(arrays[0][i]);
+        a[GEMM_B] = host_dev_ptr(arrays[1][i]);
+        a[GEMM_C] = host_dev_ptr(arrays[2][i]);
+        call_invoke(c, a);
+    }
+}
+
+#define DEF_gemmBatched(name, p, T)                                         \
+ROUTINE(name, #p "gemm_", gemm_batched_run, check_gemm_batched, RET_NONE, T)\
+CUBLAS_gemmBatched(name, T) {                                               \
+    struct call *c = call_new(ROUTINE_##name, f77(p##gemm_));               \
+    c->task.run = gemm_batched_run;                                         \
+    c->elem_size = sizeof(T);                                               \
+    c->batch = batchCount;                                                  \
+    gemm_args(c, handle, transa, transb, m, n, k,                           \
+            alpha, Aarray, lda, Barray, ldb, beta, (void *) Carray, ldc);   \
+    return call_submit(handle, c, false);                                   \
+}
+
+/*
+ * The matrices are strided in the program's view, but each managed object
+ * has a device mapping of its own, so every matrix is moved separately.
+ */
+static void gemm_strided_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    const int pos[3] = { GEMM_A, GEMM_B, GEMM_C };
+    void *a[MAX_ARGS];
+
+    call_args(c, a);
+    for (int i = 0; i < c->batch; ++i) {
+        for (int j = 0; j < 3; ++j)
+            a[pos[j]] = host_dev_ptr((char *) c->args[pos[j]] + i * c->strides[j] * c->elem_size);
+        call_invoke(c, a);
+    }
+}
+
+#define DEF_gemmStridedBatched(name, p, T)                                  \
+ROUTINE(name, #p "gemm_", gemm_strided_run, check_gemm_strided, RET_NONE, T)\
+CUBLAS_gemmStridedBatched(name, T) {                                        \
+    struct call *c = call_new(ROUTINE_##name, f77(p##gemm_));               \
+    c->task.run = gemm_strided_run;                                         \
+    c->elem_size = sizeof(T);                                               \
+    c->batch = batchCount;                                                  \
+    c->strides[0] = strideA;                                                \
+    c->strides[1] = strideB;                                                \
+    c->strides[2] = strideC;                                                \
+    gemm_args(c, handle, transa, transb, m, n, k,                           \
+            alpha, A, lda, B, ldb, beta, C, ldc);                           \
+    c->args[GEMM_A] = (void *) A;                                           \
+    c->args[GEMM_B] = (void *) B;                                           \
+    c->args[GEMM_C] = C;                                                    \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_symmx(routine, name, fname, T)                                  \
+ROUTINE(name, #fname, call_run, check_symmx, RET_NONE, T)                   \
+CUBLAS_##routine(name, T) {                                                 \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_side(c, side); arg_fill(c, uplo); arg_int(c, m); arg_int(c, n);     \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, B); arg_int(c, ldb);                                         \
+    scalar(beta); arg_ptr(c, C); arg_int(c, ldc);                           \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_symm(name, p, T) DEF_symmx(symm, name, p##symm_, T)
+#define DEF_hemm(name, p, T) DEF_symmx(hemm, name, p##hemm_, T)
+
+#define DEF_syrkx_(routine, name, fname, S, T)                              \
+ROUTINE(name, #fname, call_run, check_##routine, RET_NONE, T)               \
+CUBLAS_##routine(name, S, T) {                                              \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_op(c, trans); arg_int(c, n); arg_int(c, k);      \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    scalar(beta); arg_ptr(c, C); arg_int(c, ldc);                           \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_syrk(name, p, S, T) DEF_syrkx_(syrk, name, p##syrk_, S, T)
+#define DEF_herk(name, p, S, T) DEF_syrkx_(herk, name, p##herk_, S, T)
+
+#define DEF_syr2kx(routine, name, fname, S, T)                              \
+ROUTINE(name, #fname, call_run, check_##routine, RET_NONE, T)               \
+CUBLAS_##routine(name, S, T) {                                              \
+    struct call *c = call_new(ROUTINE_##name, f77(fname));                  \
+    arg_fill(c, uplo); arg_op(c, trans); arg_int(c, n); arg_int(c, k);      \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, B); arg_int(c, ldb);                                         \
+    scalar(beta); arg_ptr(c, C); arg_int(c, ldc);                           \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_syr2k(name, p, S, T) DEF_syr2kx(syr2k, name, p##syr2k_, S, T)
+#define DEF_her2k(name, p, S, T) DEF_syr2kx(her2k, name, p##her2k_, S, T)
+
+/*
+ * syrkx (C = alpha op(A) op(B)^T + beta C, in one triangle) is not in BLAS.
+ * It is done one column at a time with ?gemm_, on the part of the column
+ * in the triangle.
+ */
+static void syrkx_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    const bool upper = c->values[0].c == 'U';
+    const bool trans = c->values[1].c != 'N';
+    const int n = c->values[2].i;
+    const size_t es = c->elem_size;
+    char *const A = c->args[GEMM_A], *const B = c->args[GEMM_B], *const C = c->args[GEMM_C];
+    const int lda = c->values[GEMM_A + 1].i, ldb = c->values[GEMM_B + 1].i, ldc = c->values[GEMM_C + 1].i;
+    void *a[MAX_ARGS];
+
+    call_args(c, a);
+    /* gemm(op(A), op(B)^T, rows, 1, k), rows from first to first + rows - 1 */
+    c->values[0].c = trans ? 'T' : 'N';
+    c->values[1].c = trans ? 'N' : 'T';
+    c->values[3].i = 1;
+    for (int j = 0; j < n; ++j) {
+        const int first = upper ? 0 : j;
+
+        c->values[2].i = upper ? j + 1 : n - j;
+        a[GEMM_A] = A + (trans ? (size_t) first * lda : (size_t) first) * es;
+        a[GEMM_B] = B + (trans ? (size_t) j * ldb : (size_t) j) * es;
+        a[GEMM_C] = C + (first + (size_t) j * ldc) * es;
+        call_invoke(c, a);
+    }
+}
+
+#define DEF_syrkx(name, p, S, T)                                            \
+ROUTINE(name, #p "gemm_", syrkx_run, check_syrkx, RET_NONE, T)              \
+CUBLAS_syrkx(name, S, T) {                                                  \
+    struct call *c = call_new(ROUTINE_##name, f77(p##gemm_));               \
+    c->task.run = syrkx_run;                                                \
+    c->elem_size = sizeof(T);                                               \
+    gemm_args(c, handle, (cublasOperation_t) uplo, trans, n, n, k,          \
+            alpha, A, lda, B, ldb, beta, C, ldc);                           \
+    c->values[0].c = "LU"[uplo];                                            \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define DEF_trsm(name, p, T)                                                \
+ROUTINE(name, #p "trsm_", call_run, check_trxm, RET_NONE, T)                \
+CUBLAS_trsm(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##trsm_));               \
+    arg_side(c, side); arg_fill(c, uplo); arg_op(c, trans);                 \
+    arg_diag(c, diag); arg_int(c, m); arg_int(c, n);                        \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, B); arg_int(c, ldb);                                         \
+    return call_submit(handle, c, false);                                   \
+}
+
+/* cuBLAS's trmm is out of place (C = alpha op(A) B): copy B to C first */
+static void trmm_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    const int m = c->values[4].i, n = c->values[5].i;
+    const int ldc = c->values[10].i;
+    const size_t es = c->elem_size;
+    char *const C = c->args[9];
+
+    if (c->src != C)
+        for (int j = 0; j < n; ++j)
+            memmove(C + (size_t) j * ldc * es,
+                    (const char *) c->src + (size_t) j * c->ld_src * es, m * es);
+    call_run(task);
+}
+
+#define DEF_trmm(name, p, T)                                                \
+ROUTINE(name, #p "trmm_", trmm_run, check_trmm, RET_NONE, T)                \
+CUBLAS_trmm(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, f77(p##trmm_));               \
+    c->task.run = trmm_run;                                                 \
+    c->elem_size = sizeof(T);                                               \
+    c->src = host_dev_ptr(B);                                               \
+    c->ld_src = ldb;                                                        \
+    arg_side(c, side); arg_fill(c, uplo); arg_op(c, trans);                 \
+    arg_diag(c, diag); arg_int(c, m); arg_int(c, n);                        \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    arg_ptr(c, C); arg_int(c, ldc);                                         \
+    return call_submit(handle, c, false);                                   \
+}
+
+/*
+ * geam (C = alpha op(A) + beta op(B)) is not in BLAS either, and is done
+ * with loops. As with cuBLAS, A is not read if alpha is 0, nor B if beta
+ * is 0, and C may be A or B when that one is not transposed.
+ */
+#define op_elem(M, ld, op, i, j, CONJ)                                      \
+    ((op) == 'N' ? (M)[(i) + (size_t) (j) * (ld)] :                         \
+     (op) == 'T' ? (M)[(j) + (size_t) (i) * (ld)] :                         \
+     CONJ((M)[(j) + (size_t) (i) * (ld)]))
+
+#define no_conj(x) (x)
+
+#define DEF_geam_run(p, T, CONJ)                                            \
+static void geam_run_##p(struct host_task *task) {                          \
+    struct call *c = (struct call *) task;                                  \
+    void *a[MAX_ARGS];                                                      \
+    call_args(c, a);                                                        \
+    const char opa = c->values[0].c, opb = c->values[1].c;                  \
+    const int m = c->values[2].i, n = c->values[3].i;                       \
+    const T alpha = *(T *) a[4], beta = *(T *) a[7];                        \
+    const T *A = a[5], *B = a[8];                                           \
+    const int lda = c->values[6].i, ldb = c->values[9].i;                   \
+    T *C = a[10];                                                           \
+    const int ldc = c->values[11].i;                                        \
+    for (int j = 0; j < n; ++j)                                             \
+        for (int i = 0; i < m; ++i) {                                       \
+            T v = 0;                                                        \
+            if (alpha != 0)                                                 \
+                v += alpha * op_elem(A, lda, opa, i, j, CONJ);              \
+            if (beta != 0)                                                  \
+                v += beta * op_elem(B, ldb, opb, i, j, CONJ);               \
+            C[i + (size_t) j * ldc] = v;                                    \
+        }                                                                   \
+}
+
+DEF_geam_run(s, float, no_conj)
+DEF_geam_run(d, double, no_conj)
+DEF_geam_run(c, float complex, conjf)
+DEF_geam_run(z, double complex, conj)
+
+#define DEF_geam(name, p, T)                                                \
+ROUTINE(name, NULL, geam_run_##p, check_geam, RET_NONE, T)                  \
+CUBLAS_geam(name, T) {                                                      \
+    struct call *c = call_new(ROUTINE_##name, NULL);                        \
+    c->task.run = geam_run_##p;                                             \
+    arg_op(c, transa); arg_op(c, transb); arg_int(c, m); arg_int(c, n);     \
+    scalar(alpha); arg_ptr(c, A); arg_int(c, lda);                          \
+    scalar(beta); arg_ptr(c, B); arg_int(c, ldb);                           \
+    arg_ptr(c, C); arg_int(c, ldc);                                         \
+    return call_submit(handle, c, false);                                   \
+}
+
+#define CUBLAS_DEFINE(routine, name, p, ...) DEF_##routine(name, p, __VA_ARGS__)
+
+CUBLAS_ROUTINES(CUBLAS_DEFINE)
+
+#if HOST_BROKER || HOST_REMOTE
+static const struct routine *const call_routines[NUM_ROUTINES] = {
+#define ROUTINE_ENTRY(routine, name, ...) [ROUTINE_##name] = &routine_##name,
+    CUBLAS_ROUTINES(ROUTINE_ENTRY)
+};
+
+static const size_t ret_size[] = {
+    [RET_NONE] = 0, [RET_INT] = sizeof(int), [RET_FLOAT] = sizeof(float),
+    [RET_DOUBLE] = sizeof(double), [RET_CFLOAT] = sizeof(float complex),
+    [RET_CDOUBLE] = sizeof(double complex),
+};
+
+#if HOST_BROKER
+/* in the rank: send the call to the daemon, or run it here if it won't */
+static void broker_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    struct host_broker_reply reply;
+
+    if (!host_broker_call(c, sizeof *c, &reply))
+        call_routines[c->routine]->run(task);
+    else if (reply.returned)
+        memcpy(c->result, reply.result, ret_size[c->ret]);
+}
+
+static void broker_wrap(struct call *c) {
+    c->task.run = broker_run;
+}
+#elif HOST_REMOTE
+/* calls of fewer flops always run here */
+#define REMOTE_MIN_FLOPS    (2.0 * 256 * 256 * 256)
+#define MAX_OPERANDS        256
+
+/**
+ * The flops of {@c}, if it is a level 3 call that can be sent to the
+ * server, or 0.
+ */
+static double call_flops(const struct call *c) {
+    const struct routine *const r = call_routines[c->routine];
+    const char *const routine = r->fname ? r->fname + 1 : "";
+    const double scale = r->fname && (r->fname[0] == 'c' || r->fname[0] == 'z') ? 4 : 1;
+    const bool left = c->values[0].c == 'L';
+
+    if (strcmp(routine, "gemm_") == 0) {
+        const double m = c->values[2].i, n = c->values[3].i, k = c->values[4].i;
+        const int batch = c->batch > 0 ? c->batch : 1;
+
+        /* syrkx only does a triangle */
+        return scale * 2 * m * n * k * batch / (r->run == syrkx_run ? 2 : 1);
+    }
+    if (strcmp(routine, "symm_") == 0 || strcmp(routine, "hemm_") == 0) {
+        const double m = c->values[2].i, n = c->values[3].i;
+
+        return scale * 2 * m * n * (left ? m : n);
+    }
+    if (strcmp(routine, "syrk_") == 0 || strcmp(routine, "herk_") == 0
+            || strcmp(routine, "syr2k_") == 0 || strcmp(routine, "her2k_") == 0) {
+        const double n = c->values[2].i, k = c->values[3].i;
+
+        return scale * (routine[3] == '2' ? 2 : 1) * n * n * k;
+    }
+    if (strcmp(routine, "trsm_") == 0 || strcmp(routine, "trmm_") == 0) {
+        const double m = c->values[4].i, n = c->values[5].i;
+
+        return scale * m * n * (left ? m : n);
+    }
+    return 0;
+}
+
+struct operands {
+    struct host_remote_operand op[MAX_OPERANDS];
+    void *local[MAX_OPERANDS];
+    size_t num, bytes;
+};
+
+/* the region of device memory that {@ptr} is in, once */
+static bool operand_add(struct operands *ops, const void *ptr) {
+    void *start, *dev;
+    size_t size;
+
+    if (!host_dev_region(ptr, &start, &dev, &size))
+        return false;
+    for (size_t i = 0; i < ops->num; ++i)
+        if (ops->local[i] == dev)
+            return true;
+    if (ops->num == MAX_OPERANDS)
+        return false;
+    ops->op[ops->num] = (struct host_remote_operand) { (uintptr_t) dev, (uintptr_t) start, size };
+    ops->local[ops->num++] = dev;
+    ops->bytes += size;
+    return true;
+}
+
+/**
+ * The memory that {@c} touches, which the server has to have: all that
+ * its routine checks there.
+ * @return false if some of it is not device memory
+ */
+static bool call_operands(const struct call *c, struct operands *ops) {
+    const bool strided = call_routines[c->routine]->run == gemm_strided_run;
+    const bool batched = call_routines[c->routine]->run == gemm_batched_run;
+
+    ops->num = ops->bytes = 0;
+    if ((strided || batched) && (c->batch < 0 || c->num_args <= GEMM_C))
+        return false;
+    for (int i = 0; i < c->num_args; ++i) {
+        if ((c->by_value & (1u << i)) || !c->args[i])
+            continue;
+        if (strided && (i == GEMM_A || i == GEMM_B || i == GEMM_C))
+            continue;
+        if (!operand_add(ops, c->args[i]))
+            return false;
+    }
+    if (c->src && !operand_add(ops, c->src))
+        return false;
+    /* a value that is not returned to device memory comes back in the reply */
+    if (c->ret != RET_NONE && c->result)
+        operand_add(ops, c->result);
+    for (int j = 0; j < 3 && (strided || batched); ++j)
+        for (int i = 0; i < c->batch; ++i)
+            if (!operand_add(ops, strided
+                        ? (const char *) c->args[gemm_pos[j]] + i * c->strides[j] * c->elem_size
+                        : ((void *const *) c->args[gemm_pos[j]])[i]))
+                return false;
+    return true;
+}
+
+/* in the program: send the call to the server if it is worth it, or run it here */
+static void remote_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    const double flops = call_flops(c);
+    struct host_broker_reply reply;
+    struct timespec start, end;
+    struct operands ops;
+
+    if (flops >= REMOTE_MIN_FLOPS && call_operands(c, &ops) && host_remote_pick(flops, ops.bytes)
+            && host_remote_call(c, sizeof *c, flops, ops.op, ops.local, ops.num, &reply)) {
+        if (reply.returned)
+            memcpy(c->result, reply.result, ret_size[c->ret]);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    call_routines[c->routine]->run(task);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (flops >= REMOTE_MIN_FLOPS)
+        host_remote_ran_here(flops, (end.tv_sec - start.tv_sec) * 1000000000L
+                + end.tv_nsec - start.tv_nsec);
+}
+
+static void remote_wrap(struct call *c) {
+    c->task.run = remote_run;
+}
+#endif
+
+/* in the daemon or server: a batch whose matrices the check moved */
+static void gemm_moved_run(struct host_task *task) {
+    struct call *c = (struct call *) task;
+    void *a[MAX_ARGS];
+
+    call_args(c, a);
+    for (int i = 0; i < c->batch; ++i) {
+        for (int j = 0; j < 3; ++j)
+            a[gemm_pos[j]] = ((void **) c->args[gemm_pos[j]])[i];
+        call_invoke(c, a);
+    }
+}
+
+bool host_call_serve(void *buf, size_t size, struct host_broker_reply *reply) {
+    struct call *c = buf;
+    const struct routine *r;
+    bool ok;
+
+    if (size != sizeof *c || c->routine >= NUM_ROUTINES)
+        return false;
+    /* the rest comes from the routine, or is checked against it */
+    r = call_routines[c->routine];
+    c->task.run = r->run;
+    c->ret = r->ret;
+    c->elem_size = r->elem_size;
+    c->moved = NULL;
+    if (r->fname && !(c->fn = (void (*)(void)) runtime_blas_func(r->fname)))
+        return false;
+    if ((ok = r->check(c))) {
+        if (c->moved)
+            c->task.run = gemm_moved_run;
+        /* the value of a function goes back in the reply, unless it goes to shared memory */
+        reply->returned = c->ret != RET_NONE
+            && !(c->result && (c->result = dev_range(c->result, ret_size[c->ret])));
+        if (reply->returned)
+            c->result = reply->result;
+        c->task.run(&c->task);
+    }
+    host_free(c->moved);
+    return ok;
+}
+#endif
@@ -0,0 +1,443 @@
+#ifndef HOST_CUBLAS_API_H
+#define HOST_CUBLAS_API_H
+
+/*
+ * The subset of cuBLAS that libgpublas uses, for the host backend (see
+ * host.h). Each routine is enqueued on the handle's stream and runs there
+ * through the next BLAS library.
+ */
+
+#include "cuda_runtime.h"
+#include "cuComplex.h"
+
+typedef enum {
+    CUBLAS_STATUS_SUCCESS = 0,
+    CUBLAS_STATUS_NOT_INITIALIZED = 1,
+    CUBLAS_STATUS_ALLOC_FAILED = 3,
+    CUBLAS_STATUS_INVALID_VALUE = 7,
+    CUBLAS_STATUS_ARCH_MISMATCH = 8,
+    CUBLAS_STATUS_MAPPING_ERROR = 11,
+    CUBLAS_STATUS_EXECUTION_FAILED = 13,
+    CUBLAS_STATUS_INTERNAL_ERROR = 14,
+    CUBLAS_STATUS_NOT_SUPPORTED = 15,
+    CUBLAS_STATUS_LICENSE_ERROR = 16,
+} cublasStatus_t;
+
+typedef enum {
+    CUBLAS_OP_N = 0,
+    CUBLAS_OP_T = 1,
+    CUBLAS_OP_C = 2,
+} cublasOperation_t;
+
+typedef enum {
+    CUBLAS_FILL_MODE_LOWER = 0,
+    CUBLAS_FILL_MODE_UPPER = 1,
+} cublasFillMode_t;
+
+typedef enum {
+    CUBLAS_DIAG_NON_UNIT = 0,
+    CUBLAS_DIAG_UNIT = 1,
+} cublasDiagType_t;
+
+typedef enum {
+    CUBLAS_SIDE_LEFT = 0,
+    CUBLAS_SIDE_RIGHT = 1,
+} cublasSideMode_t;
+
+typedef enum {
+    CUBLAS_POINTER_MODE_HOST = 0,
+    CUBLAS_POINTER_MODE_DEVICE = 1,
+} cublasPointerMode_t;
+
+typedef struct cublasContext *cublasHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+cublasStatus_t cublasCreate(cublasHandle_t *handle);
+cublasStatus_t cublasDestroy(cublasHandle_t handle);
+cublasStatus_t cublasSetStream(cublasHandle_t handle, cudaStream_t streamId);
+cublasStatus_t cublasGetStream(cublasHandle_t handle, cudaStream_t *streamId);
+cublasStatus_t cublasSetPointerMode(cublasHandle_t handle, cublasPointerMode_t mode);
+cublasStatus_t cublasGetPointerMode(cublasHandle_t handle, cublasPointerMode_t *mode);
+
+/*
+ * The routines are declared with these macros, which host/cublas.c reuses
+ * to define them. {@name} is the part of the name after "cublas", {@T} the
+ * element type and {@S} the real type of the same precision.
+ */
+
+/* Level 1 */
+#define CUBLAS_iamax(name, T)                                               \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const T *x, int incx, int *result)
+
+#define CUBLAS_asum(name, S, T)                                             \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const T *x, int incx, S *result)
+
+#define CUBLAS_axpy(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const T *alpha, const T *x, int incx, T *y, int incy)
+
+#define CUBLAS_copy(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const T *x, int incx, T *y, int incy)
+
+#define CUBLAS_swap(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        T *x, int incx, T *y, int incy)
+
+#define CUBLAS_scal(name, S, T)                                             \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const S *alpha, T *x, int incx)
+
+#define CUBLAS_dot(name, T)                                                 \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        const T *x, int incx, const T *y, int incy, T *result)
+
+#define CUBLAS_rot(name, S, T)                                              \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        T *x, int incx, T *y, int incy, const S *c, const S *s)
+
+#define CUBLAS_rotg(name, S, T)                                             \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        T *a, T *b, S *c, T *s)
+
+#define CUBLAS_rotm(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, int n,                   \
+        T *x, int incx, T *y, int incy, const T *param)
+
+#define CUBLAS_rotmg(name, T)                                               \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        T *d1, T *d2, T *x1, const T *y1, T *param)
+
+/* Level 2 */
+#define CUBLAS_gemv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasOperation_t trans, \
+        int m, int n, const T *alpha, const T *A, int lda,                  \
+        const T *x, int incx, const T *beta, T *y, int incy)
+
+#define CUBLAS_gbmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasOperation_t trans, \
+        int m, int n, int kl, int ku, const T *alpha, const T *A, int lda,  \
+        const T *x, int incx, const T *beta, T *y, int incy)
+
+#define CUBLAS_trmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        cublasOperation_t trans, cublasDiagType_t diag,                     \
+        int n, const T *A, int lda, T *x, int incx)
+
+#define CUBLAS_tbmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        cublasOperation_t trans, cublasDiagType_t diag,                     \
+        int n, int k, const T *A, int lda, T *x, int incx)
+
+#define CUBLAS_tpmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        cublasOperation_t trans, cublasDiagType_t diag,                     \
+        int n, const T *AP, T *x, int incx)
+
+#define CUBLAS_symv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const T *alpha, const T *A, int lda,                         \
+        const T *x, int incx, const T *beta, T *y, int incy)
+
+#define CUBLAS_sbmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, int k, const T *alpha, const T *A, int lda,                  \
+        const T *x, int incx, const T *beta, T *y, int incy)
+
+#define CUBLAS_spmv(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const T *alpha, const T *AP,                                 \
+        const T *x, int incx, const T *beta, T *y, int incy)
+
+#define CUBLAS_syr(name, S, T)                                              \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const S *alpha, const T *x, int incx, T *A, int lda)
+
+#define CUBLAS_spr(name, S, T)                                              \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const S *alpha, const T *x, int incx, T *AP)
+
+#define CUBLAS_syr2(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const T *alpha, const T *x, int incx,                        \
+        const T *y, int incy, T *A, int lda)
+
+#define CUBLAS_spr2(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle, cublasFillMode_t uplo,   \
+        int n, const T *alpha, const T *x, int incx,                        \
+        const T *y, int incy, T *AP)
+
+#define CUBLAS_ger(name, T)                                                 \
+cublasStatus_t cublas##name(cublasHandle_t handle, int m, int n,            \
+        const T *alpha, const T *x, int incx,                               \
+        const T *y, int incy, T *A, int lda)
+
+/* Level 3 */
+#define CUBLAS_gemm(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasOperation_t transa, cublasOperation_t transb,                 \
+        int m, int n, int k, const T *alpha, const T *A, int lda,           \
+        const T *B, int ldb, const T *beta, T *C, int ldc)
+
+#define CUBLAS_gemmBatched(name, T)                                         \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasOperation_t transa, cublasOperation_t transb,                 \
+        int m, int n, int k, const T *alpha,                                \
+        const T *const Aarray[], int lda,                                   \
+        const T *const Barray[], int ldb, const T *beta,                    \
+        T *const Carray[], int ldc, int batchCount)
+
+#define CUBLAS_gemmStridedBatched(name, T)                                  \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasOperation_t transa, cublasOperation_t transb,                 \
+        int m, int n, int k, const T *alpha,                                \
+        const T *A, int lda, long long strideA,                             \
+        const T *B, int ldb, long long strideB, const T *beta,              \
+        T *C, int ldc, long long strideC, int batchCount)
+
+#define CUBLAS_symm(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasSideMode_t side, cublasFillMode_t uplo,                       \
+        int m, int n, const T *alpha, const T *A, int lda,                  \
+        const T *B, int ldb, const T *beta, T *C, int ldc)
+
+#define CUBLAS_syrk(name, S, T)                                             \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasFillMode_t uplo, cublasOperation_t trans,                     \
+        int n, int k, const S *alpha, const T *A, int lda,                  \
+        const S *beta, T *C, int ldc)
+
+#define CUBLAS_syr2k(name, S, T)                                            \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasFillMode_t uplo, cublasOperation_t trans,                     \
+        int n, int k, const T *alpha, const T *A, int lda,                  \
+        const T *B, int ldb, const S *beta, T *C, int ldc)
+
+#define CUBLAS_trsm(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasSideMode_t side, cublasFillMode_t uplo,                       \
+        cublasOperation_t trans, cublasDiagType_t diag,                     \
+        int m, int n, const T *alpha, const T *A, int lda, T *B, int ldb)
+
+#define CUBLAS_trmm(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasSideMode_t side, cublasFillMode_t uplo,                       \
+        cublasOperation_t trans, cublasDiagType_t diag,                     \
+        int m, int n, const T *alpha, const T *A, int lda,                  \
+        const T *B, int ldb, T *C, int ldc)
+
+#define CUBLAS_geam(name, T)                                                \
+cublasStatus_t cublas##name(cublasHandle_t handle,                          \
+        cublasOperation_t transa, cublasOperation_t transb,                 \
+        int m, int n, const T *alpha, const T *A, int lda,                  \
+        const T *beta, const T *B, int ldb, T *C, int ldc)
+
+/*
+ * Every routine, as X(routine, name, prefix, types...), where {@prefix} is
+ * the type prefix of the routines of the next BLAS library that do the work.
+ */
+#define CUBLAS_ROUTINES(X)                                                  \
+    X(iamax, Isamax, s, float)                                              \
+    X(iamax, Idamax, d, double)                                             \
+    X(iamax, Icamax, c, cuComplex)                                          \
+    X(iamax, Izamax, z, cuDoubleComplex)                                    \
+    X(iamin, Isamin, s, float)                                              \
+    X(iamin, Idamin, d, double)                                             \
+    X(iamin, Icamin, c, cuComplex)                                          \
+    X(iamin, Izamin, z, cuDoubleComplex)                                    \
+    X(asum, Sasum, s, float, float)                                         \
+    X(asum, Dasum, d, double, double)                                       \
+    X(asum, Scasum, sc, float, cuComplex)                                   \
+    X(asum, Dzasum, dz, double, cuDoubleComplex)                            \
+    X(nrm2, Snrm2, s, float, float)                                         \
+    X(nrm2, Dnrm2, d, double, double)                                       \
+    X(nrm2, Scnrm2, sc, float, cuComplex)                                   \
+    X(nrm2, Dznrm2, dz, double, cuDoubleComplex)                            \
+    X(axpy, Saxpy, s, float)                                                \
+    X(axpy, Daxpy, d, double)                                               \
+    X(axpy, Caxpy, c, cuComplex)                                            \
+    X(axpy, Zaxpy, z, cuDoubleComplex)                                      \
+    X(copy, Scopy, s, float)                                                \
+    X(copy, Dcopy, d, double)                                               \
+    X(copy, Ccopy, c, cuComplex)                                            \
+    X(copy, Zcopy, z, cuDoubleComplex)                                      \
+    X(swap, Sswap, s, float)                                                \
+    X(swap, Dswap, d, double)                                               \
+    X(swap, Cswap, c, cuComplex)                                            \
+    X(swap, Zswap, z, cuDoubleComplex)                                      \
+    X(scal, Sscal, s, float, float)                                         \
+    X(scal, Dscal, d, double, double)                                       \
+    X(scal, Cscal, c, cuComplex, cuComplex)                                 \
+    X(scal, Zscal, z, cuDoubleComplex, cuDoubleComplex)                     \
+    X(scal, Csscal, cs, float, cuComplex)                                   \
+    X(scal, Zdscal, zd, double, cuDoubleComplex)                            \
+    X(dot, Sdot, s, float)                                                  \
+    X(dot, Ddot, d, double)                                                 \
+    X(dotu, Cdotu, c, cuComplex)                                            \
+    X(dotu, Zdotu, z, cuDoubleComplex)                                      \
+    X(dotc, Cdotc, c, cuComplex)                                            \
+    X(dotc, Zdotc, z, cuDoubleComplex)                                      \
+    X(rot, Srot, s, float, float)                                           \
+    X(rot, Drot, d, double, double)                                         \
+    X(rot, Csrot, cs, float, cuComplex)                                     \
+    X(rot, Zdrot, zd, double, cuDoubleComplex)                              \
+    X(rotg, Srotg, s, float, float)                                         \
+    X(rotg, Drotg, d, double, double)                                       \
+    X(rotg, Crotg, c, float, cuComplex)                                     \
+    X(rotg, Zrotg, z, double, cuDoubleComplex)                              \
+    X(rotm, Srotm, s, float)                                                \
+    X(rotm, Drotm, d, double)                                               \
+    X(rotmg, Srotmg, s, float)                                              \
+    X(rotmg, Drotmg, d, double)                                             \
+    X(gemv, Sgemv, s, float)                                                \
+    X(gemv, Dgemv, d, double)                                               \
+    X(gemv, Cgemv, c, cuComplex)                                            \
+    X(gemv, Zgemv, z, cuDoubleComplex)                                      \
+    X(gbmv, Sgbmv, s, float)                                                \
+    X(gbmv, Dgbmv, d, double)                                               \
+    X(gbmv, Cgbmv, c, cuComplex)                                            \
+    X(gbmv, Zgbmv, z, cuDoubleComplex)                                      \
+    X(trmv, Strmv, s, float)                                                \
+    X(trmv, Dtrmv, d, double)                                               \
+    X(trmv, Ctrmv, c, cuComplex)                                            \
+    X(trmv, Ztrmv, z, cuDoubleComplex)                                      \
+    X(trsv, Strsv, s, float)                                                \
+    X(trsv, Dtrsv, d, double)                                               \
+    X(trsv, Ctrsv, c, cuComplex)                                            \
+    X(trsv, Ztrsv, z, cuDoubleComplex)                                      \
+    X(tbmv, Stbmv, s, float)                                                \
+    X(tbmv, Dtbmv, d, double)                                               \
+    X(tbmv, Ctbmv, c, cuComplex)                                            \
+    X(tbmv, Ztbmv, z, cuDoubleComplex)                                      \
+    X(tbsv, Stbsv, s, float)                                                \
+    X(tbsv, Dtbsv, d, double)                                               \
+    X(tbsv, Ctbsv, c, cuComplex)                                            \
+    X(tbsv, Ztbsv, z, cuDoubleComplex)                                      \
+    X(tpmv, Stpmv, s, float)                                                \
+    X(tpmv, Dtpmv, d, double)                                               \
+    X(tpmv, Ctpmv, c, cuComplex)                                            \
+    X(tpmv, Ztpmv, z, cuDoubleComplex)                                      \
+    X(tpsv, Stpsv, s, float)                                                \
+    X(tpsv, Dtpsv, d, double)                                               \
+    X(tpsv, Ctpsv, c, cuComplex)                                            \
+    X(tpsv, Ztpsv, z, cuDoubleComplex)                                      \
+    X(symv, Ssymv, s, float)                                                \
+    X(symv, Dsymv, d, double)                                               \
+    X(hemv, Chemv, c, cuComplex)                                            \
+    X(hemv, Zhemv, z, cuDoubleComplex)                                      \
+    X(sbmv, Ssbmv, s, float)                                                \
+    X(sbmv, Dsbmv, d, double)                                               \
+    X(hbmv, Chbmv, c, cuComplex)                                            \
+    X(hbmv, Zhbmv, z, cuDoubleComplex)                                      \
+    X(spmv, Sspmv, s, float)                                                \
+    X(spmv, Dspmv, d, double)                                               \
+    X(hpmv, Chpmv, c, cuComplex)                                            \
+    X(hpmv, Zhpmv, z, cuDoubleComplex)                                      \
+    X(syr, Ssyr, s, float, float)                                           \
+    X(syr, Dsyr, d, double, double)                                         \
+    X(her, Cher, c, float, cuComplex)                                       \
+    X(her, Zher, z, double, cuDoubleComplex)                                \
+    X(spr, Sspr, s, float, float)                                           \
+    X(spr, Dspr, d, double, double)                                         \
+    X(hpr, Chpr, c, float, cuComplex)                                       \
+    X(hpr, Zhpr, z, double, cuDoubleComplex)                                \
+    X(syr2, Ssyr2, s, float)                                                \
+    X(syr2, Dsyr2, d, double)                                               \
+    X(her2, Cher2, c, cuComplex)                                            \
+    X(her2, Zher2, z, cuDoubleComplex)                                      \
+    X(spr2, Sspr2, s, float)                                                \
+    X(spr2, Dspr2, d, double)                                               \
+    X(hpr2, Chpr2, c, cuComplex)                                            \
+    X(hpr2, Zhpr2, z, cuDoubleComplex)                                      \
+    X(ger, Sger, s, float)                                                  \
+    X(ger, Dger, d, double)                                                 \
+    X(geru, Cgeru, c, cuComplex)                                            \
+    X(geru, Zgeru, z, cuDoubleComplex)                                      \
+    X(gerc, Cgerc, c, cuComplex)                                            \
+    X(gerc, Zgerc, z, cuDoubleComplex)                                      \
+    X(gemm, Sgemm, s, float)                                                \
+    X(gemm, Dgemm, d, double)                                               \
+    X(gemm, Cgemm, c, cuComplex)                                            \
+    X(gemm, Zgemm, z, cuDoubleComplex)                                      \
+    X(gemm3m, Cgemm3m, c, cuComplex)                                        \
+    X(gemm3m, Zgemm3m, z, cuDoubleComplex)                                  \
+    X(gemmBatched, SgemmBatched, s, float)                                  \
+    X(gemmBatched, DgemmBatched, d, double)                                 \
+    X(gemmBatched, CgemmBatched, c, cuComplex)                              \
+    X(gemmBatched, ZgemmBatched, z, cuDoubleComplex)                        \
+    X(gemmStridedBatched, SgemmStridedBatched, s, float)                    \
+    X(gemmStridedBatched, DgemmStridedBatched, d, double)                   \
+    X(gemmStridedBatched, CgemmStridedBatched, c, cuComplex)                \
+    X(gemmStridedBatched, ZgemmStridedBatched, z, cuDoubleComplex)          \
+    X(symm, Ssymm, s, float)                                                \
+    X(symm, Dsymm, d, double)                                               \
+    X(symm, Csymm, c, cuComplex)                                            \
+    X(symm, Zsymm, z, cuDoubleComplex)                                      \
+    X(hemm, Chemm, c, cuComplex)                                            \
+    X(hemm, Zhemm, z, cuDoubleComplex)                                      \
+    X(syrk, Ssyrk, s, float, float)                                         \
+    X(syrk, Dsyrk, d, double, double)                                       \
+    X(syrk, Csyrk, c, cuComplex, cuComplex)                                 \
+    X(syrk, Zsyrk, z, cuDoubleComplex, cuDoubleComplex)                     \
+    X(herk, Cherk, c, float, cuComplex)                                     \
+    X(herk, Zherk, z, double, cuDoubleComplex)                              \
+    X(syr2k, Ssyr2k, s, float, float)                                       \
+    X(syr2k, Dsyr2k, d, double, double)                                     \
+    X(syr2k, Csyr2k, c, cuComplex, cuComplex)                               \
+    X(syr2k, Zsyr2k, z, cuDoubleComplex, cuDoubleComplex)                   \
+    X(her2k, Cher2k, c, float, cuComplex)                                   \
+    X(her2k, Zher2k, z, double, cuDoubleComplex)                            \
+    X(syrkx, Ssyrkx, s, float, float)                                       \
+    X(syrkx, Dsyrkx, d, double, double)                                     \
+    X(syrkx, Csyrkx, c, cuComplex, cuComplex)                               \
+    X(syrkx, Zsyrkx, z, cuDoubleComplex, cuDoubleComplex)                   \
+    X(trsm, Strsm, s, float)                                                \
+    X(trsm, Dtrsm, d, double)                                               \
+    X(trsm, Ctrsm, c, cuComplex)                                            \
+    X(trsm, Ztrsm, z, cuDoubleComplex)                                      \
+    X(trmm, Strmm, s, float)                                                \
+    X(trmm, Dtrmm, d, double)                                               \
+    X(trmm, Ctrmm, c, cuComplex)                                            \
+    X(trmm, Ztrmm, z, cuDoubleComplex)                                      \
+    X(geam, Sgeam, s, float)                                                \
+    X(geam, Dgeam, d, double)                                               \
+    X(geam, Cgeam, c, cuComplex)                                            \
+    X(geam, Zgeam, z, cuDoubleComplex)
+
+/* routines that share the arguments of another */
+#define CUBLAS_iamin        CUBLAS_iamax
+#define CUBLAS_nrm2         CUBLAS_asum
+#define CUBLAS_dotu         CUBLAS_dot
+#define CUBLAS_dotc         CUBLAS_dot
+#define CUBLAS_trsv         CUBLAS_trmv
+#define CUBLAS_tbsv         CUBLAS_tbmv
+#define CUBLAS_tpsv         CUBLAS_tpmv
+#define CUBLAS_hemv         CUBLAS_symv
+#define CUBLAS_hbmv         CUBLAS_sbmv
+#define CUBLAS_hpmv         CUBLAS_spmv
+#define CUBLAS_her          CUBLAS_syr
+#define CUBLAS_hpr          CUBLAS_spr
+#define CUBLAS_her2         CUBLAS_syr2
+#define CUBLAS_hpr2         CUBLAS_spr2
+#define CUBLAS_geru         CUBLAS_ger
+#define CUBLAS_gerc         CUBLAS_ger
+#define CUBLAS_gemm3m       CUBLAS_gemm
+#define CUBLAS_hemm         CUBLAS_symm
+#define CUBLAS_herk         CUBLAS_syrk
+#define CUBLAS_her2k        CUBLAS_syr2k
+#define CUBLAS_syrkx        CUBLAS_syr2k
+
+#define CUBLAS_DECLARE(routine, name, f77, ...) CUBLAS_##routine(name, __VA_ARGS__);
+
+CUBLAS_ROUTINES(CUBLAS_DECLARE)
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
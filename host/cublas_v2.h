@@ -0,0 +1,6 @@
+#ifndef HOST_CUBLAS_V2_H
+#define HOST_CUBLAS_V2_H
+
+#include "cublas_api.h"
+
+#endif
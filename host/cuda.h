@@ -0,0 +1,7 @@
+#ifndef HOST_CUDA_H
+#define HOST_CUDA_H
+
+/* the host backend has no driver API */
+#include "cuda_runtime.h"
+
+#endif
@@ -0,0 +1,785 @@
+#define _GNU_SOURCE
+#include "host.h"
+#include "../common.h"
+#include "../lib/obj_tracker.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#if HOST_BROKER
+#include "broker.h"
+#elif HOST_REMOTE
+#include "remote.h"
+#endif
+
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+
+void *host_alloc(size_t size) {
+    return __libc_calloc(1, size);
+}
+
+void host_free(void *ptr) {
+    __libc_free(ptr);
+}
+
+static __thread cudaError_t last_error;
+
+static cudaError_t fail(cudaError_t err) {
+    last_error = err;
+    return err;
+}
+
+const char *cudaGetErrorName(cudaError_t error) {
+    switch (error) {
+        case cudaSuccess:                       return "cudaSuccess";
+        case cudaErrorInvalidValue:             return "cudaErrorInvalidValue";
+        case cudaErrorMemoryAllocation:         return "cudaErrorMemoryAllocation";
+        case cudaErrorInitializationError:      return "cudaErrorInitializationError";
+        case cudaErrorNoDevice:                 return "cudaErrorNoDevice";
+        case cudaErrorInvalidResourceHandle:    return "cudaErrorInvalidResourceHandle";
+        case cudaErrorNotReady:                 return "cudaErrorNotReady";
+        case cudaErrorStreamCaptureUnsupported: return "cudaErrorStreamCaptureUnsupported";
+        case cudaErrorGraphExecUpdateFailure:   return "cudaErrorGraphExecUpdateFailure";
+    }
+    return "cudaErrorUnknown";
+}
+
+const char *cudaGetErrorString(cudaError_t error) {
+    switch (error) {
+        case cudaSuccess:                       return "no error";
+        case cudaErrorInvalidValue:             return "invalid argument";
+        case cudaErrorMemoryAllocation:         return "out of memory";
+        case cudaErrorInitializationError:      return "initialization error";
+        case cudaErrorNoDevice:                 return "no CUDA-capable device is detected";
+        case cudaErrorInvalidResourceHandle:    return "invalid resource handle";
+        case cudaErrorNotReady:                 return "device not ready";
+        case cudaErrorStreamCaptureUnsupported: return "operation not permitted when stream is capturing";
+        case cudaErrorGraphExecUpdateFailure:   return "the graph update was not performed";
+    }
+    return "unknown error";
+}
+
+cudaError_t cudaGetLastError(void) {
+    cudaError_t err = last_error;
+
+    last_error = cudaSuccess;
+    return err;
+}
+
+/* simulated link */
+
+static double link_bytes_per_ns;
+static long link_latency_ns;
+
+#if HOST_REMOTE
+/* the link is the network to the server, which is not simulated */
+void host_link_configure(double bandwidth, double latency) {
+    host_remote_link(bandwidth, latency);
+}
+#else
+void host_link_configure(double bandwidth, double latency) {
+    /* 1 GB/s is 1 byte/ns */
+    link_bytes_per_ns = bandwidth;
+    link_latency_ns = latency * 1000;
+}
+#endif
+
+static void link_transfer(size_t size) {
+    long ns = link_latency_ns;
+    struct timespec ts;
+
+    if (link_bytes_per_ns > 0)
+        ns += size / link_bytes_per_ns;
+    if (ns <= 0)
+        return;
+    ts.tv_sec = ns / 1000000000L;
+    ts.tv_nsec = ns % 1000000000L;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/* device memory */
+
+struct region {
+    char *start;        /* as seen by the host */
+    char *dev;          /* as seen by the device; the same for device memory */
+    size_t size;
+};
+
+/* sorted by start */
+static struct region *regions;
+static size_t num_regions, max_regions;
+static pthread_rwlock_t regions_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * The region that contains {@ptr}, or the index where it would go.
+ */
+static size_t region_find_locked(const char *ptr, bool *found) {
+    size_t lo = 0, hi = num_regions;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (ptr < regions[mid].start)
+            hi = mid;
+        else if (ptr >= regions[mid].start + regions[mid].size)
+            lo = mid + 1;
+        else {
+            *found = true;
+            return mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+static cudaError_t region_add(char *start, char *dev, size_t size) {
+    bool found;
+    size_t i;
+
+    pthread_rwlock_wrlock(&regions_lock);
+    if (num_regions == max_regions) {
+        size_t max = max_regions ? 2 * max_regions : 64;
+        struct region *r = __libc_realloc(regions, max * sizeof *r);
+
+        if (!r) {
+            pthread_rwlock_unlock(&regions_lock);
+            return fail(cudaErrorMemoryAllocation);
+        }
+        regions = r;
+        max_regions = max;
+    }
+    i = region_find_locked(start, &found);
+    memmove(&regions[i + 1], &regions[i], (num_regions - i) * sizeof *regions);
+    regions[i] = (struct region) { start, dev, size };
+    num_regions++;
+    pthread_rwlock_unlock(&regions_lock);
+    return cudaSuccess;
+}
+
+void *host_dev_ptr(const void *ptr) {
+    void *dev = (void *) ptr;
+    bool found;
+    size_t i;
+
+    if (!ptr)
+        return NULL;
+    pthread_rwlock_rdlock(&regions_lock);
+    i = region_find_locked(ptr, &found);
+    if (found)
+        dev = regions[i].dev + ((const char *) ptr - regions[i].start);
+    pthread_rwlock_unlock(&regions_lock);
+    return dev;
+}
+
+bool host_dev_region(const void *ptr, void **start, void **dev, size_t *size) {
+    bool found;
+    size_t i;
+
+    pthread_rwlock_rdlock(&regions_lock);
+    i = region_find_locked(ptr, &found);
+    for (size_t j = 0; j < num_regions && !found; ++j)
+        if ((const char *) ptr >= regions[j].dev && (const char *) ptr < regions[j].dev + regions[j].size) {
+            found = true;
+            i = j;
+        }
+    if (found) {
+        *start = regions[i].start;
+        *dev = regions[i].dev;
+        *size = regions[i].size;
+    }
+    pthread_rwlock_unlock(&regions_lock);
+    return found;
+}
+
+static size_t page_round(size_t size) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+
+    return size ? (size + page - 1) / page * page : page;
+}
+
+#if HOST_BROKER
+/* device memory is shared with the broker, so it is in a memfd too */
+cudaError_t cudaMalloc(void **devPtr, size_t size) {
+    const size_t len = page_round(size);
+    char *p = MAP_FAILED;
+    int fd;
+
+    if ((fd = memfd_create("libgpublas-device", MFD_CLOEXEC)) < 0)
+        return fail(cudaErrorMemoryAllocation);
+    if (ftruncate(fd, len) == 0
+            && (p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED)
+        host_broker_share(p, len, fd);
+    close(fd);
+    if (p == MAP_FAILED || region_add(p, p, len) != cudaSuccess) {
+        if (p != MAP_FAILED) {
+            host_broker_unshare(p);
+            munmap(p, len);
+        }
+        return fail(cudaErrorMemoryAllocation);
+    }
+    *devPtr = p;
+    return cudaSuccess;
+}
+#else
+cudaError_t cudaMalloc(void **devPtr, size_t size) {
+    const size_t len = page_round(size);
+    char *p;
+
+    if ((p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        return fail(cudaErrorMemoryAllocation);
+    if (region_add(p, p, len) != cudaSuccess) {
+        munmap(p, len);
+        return cudaErrorMemoryAllocation;
+    }
+    *devPtr = p;
+    return cudaSuccess;
+}
+#endif
+
+cudaError_t cudaMallocManaged(void **devPtr, size_t size, unsigned int flags) {
+    const size_t len = page_round(size);
+    char *p = MAP_FAILED, *dev = MAP_FAILED;
+    int fd;
+
+    if ((fd = memfd_create("libgpublas-managed", MFD_CLOEXEC)) < 0)
+        return fail(cudaErrorMemoryAllocation);
+    if (ftruncate(fd, len) == 0
+            && (p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED)
+        dev = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#if HOST_BROKER
+    /* under both addresses, since batched calls can be given either */
+    if (dev != MAP_FAILED) {
+        host_broker_share(p, len, fd);
+        host_broker_share(dev, len, fd);
+    }
+#endif
+    close(fd);
+    if (dev == MAP_FAILED || region_add(p, dev, len) != cudaSuccess) {
+        if (p != MAP_FAILED)
+            munmap(p, len);
+        if (dev != MAP_FAILED) {
+#if HOST_BROKER
+            host_broker_unshare(p);
+            host_broker_unshare(dev);
+#endif
+            munmap(dev, len);
+        }
+        return fail(cudaErrorMemoryAllocation);
+    }
+    *devPtr = p;
+    return cudaSuccess;
+}
+
+cudaError_t cudaFree(void *devPtr) {
+    struct region r;
+    bool found;
+    size_t i;
+
+    if (!devPtr)
+        return cudaSuccess;
+
+    /* like cudaFree(), wait for the device first */
+    cudaDeviceSynchronize();
+    pthread_rwlock_wrlock(&regions_lock);
+    i = region_find_locked(devPtr, &found);
+    if (!found || regions[i].start != devPtr) {
+        pthread_rwlock_unlock(&regions_lock);
+        return fail(cudaErrorInvalidValue);
+    }
+    r = regions[i];
+    memmove(&regions[i], &regions[i + 1], (num_regions - i - 1) * sizeof *regions);
+    num_regions--;
+    pthread_rwlock_unlock(&regions_lock);
+
+#if HOST_BROKER
+    host_broker_unshare(r.start);
+    if (r.dev != r.start)
+        host_broker_unshare(r.dev);
+#endif
+    munmap(r.start, r.size);
+    if (r.dev != r.start)
+        munmap(r.dev, r.size);
+    return cudaSuccess;
+}
+
+/* streams */
+
+struct task_list {
+    struct host_task *head, *tail;
+    unsigned num_tasks;
+};
+
+static void list_append(struct task_list *list, struct host_task *task) {
+    task->next = NULL;
+    if (list->tail)
+        list->tail->next = task;
+    else
+        list->head = task;
+    list->tail = task;
+    list->num_tasks++;
+}
+
+static void list_clear(struct task_list *list) {
+    struct host_task *task, *next;
+
+    for (task = list->head; task; task = next) {
+        next = task->next;
+        host_free(task);
+    }
+    memset(list, 0, sizeof *list);
+}
+
+static struct host_task *task_clone(const struct host_task *task) {
+    struct host_task *copy;
+
+    if (!(copy = host_alloc(task->size))) {
+        writef(STDERR_FILENO, "blas2cuda: host: failed to allocate task\n");
+        abort();
+    }
+    memcpy(copy, task, task->size);
+    copy->next = NULL;
+    return copy;
+}
+
+struct CUgraph_st {
+    struct task_list tasks;
+};
+
+struct CUgraphExec_st {
+    struct task_list tasks;
+};
+
+struct CUstream_st {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;            /* new work, completed work or exit */
+    struct task_list queue;
+    unsigned long submitted;
+    unsigned long completed;
+    bool blocking;                  /* synchronizes with the legacy stream */
+    bool exiting;
+    cudaGraph_t capture;            /* graph being captured, if any */
+    pthread_t thread;
+    struct CUstream_st *next;
+};
+
+static struct CUstream_st *streams;
+static pthread_mutex_t streams_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *stream_worker(void *arg) {
+    struct CUstream_st *stream = arg;
+    struct host_task *task;
+
+    /* kernels and the BLAS library they call allocate untracked memory */
+    obj_tracker_internal_enter();
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (!stream->queue.head && !stream->exiting)
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        if (!(task = stream->queue.head))
+            break;
+        if (!(stream->queue.head = task->next))
+            stream->queue.tail = NULL;
+        stream->queue.num_tasks--;
+        pthread_mutex_unlock(&stream->lock);
+
+        task->run(task);
+        host_free(task);
+
+        pthread_mutex_lock(&stream->lock);
+        stream->completed++;
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    obj_tracker_internal_leave();
+    return NULL;
+}
+
+static void stream_sync(struct CUstream_st *stream) {
+    pthread_mutex_lock(&stream->lock);
+    while (stream->completed < stream->submitted)
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/**
+ * Wait for all streams, or only those that synchronize with the legacy
+ * default stream.
+ */
+static void streams_sync(bool only_blocking) {
+    pthread_mutex_lock(&streams_lock);
+    for (struct CUstream_st *s = streams; s; s = s->next)
+        if (s->blocking || !only_blocking)
+            stream_sync(s);
+    pthread_mutex_unlock(&streams_lock);
+}
+
+void host_submit(cudaStream_t stream, struct host_task *task) {
+    if (!stream) {
+        streams_sync(true);
+        task->run(task);
+        host_free(task);
+        return;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->capture)
+        list_append(&stream->capture->tasks, task);
+    else {
+        list_append(&stream->queue, task);
+        stream->submitted++;
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+cudaError_t cudaStreamCreateWithFlags(cudaStream_t *pStream, unsigned int flags) {
+    struct CUstream_st *stream;
+
+    if (!(stream = host_alloc(sizeof *stream)))
+        return fail(cudaErrorMemoryAllocation);
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    stream->blocking = !(flags & cudaStreamNonBlocking);
+    if (pthread_create(&stream->thread, NULL, stream_worker, stream) != 0) {
+        host_free(stream);
+        return fail(cudaErrorMemoryAllocation);
+    }
+
+    pthread_mutex_lock(&streams_lock);
+    stream->next = streams;
+    streams = stream;
+    pthread_mutex_unlock(&streams_lock);
+    *pStream = stream;
+    return cudaSuccess;
+}
+
+cudaError_t cudaStreamCreate(cudaStream_t *pStream) {
+    return cudaStreamCreateWithFlags(pStream, cudaStreamDefault);
+}
+
+cudaError_t cudaStreamDestroy(cudaStream_t stream) {
+    struct CUstream_st **p;
+
+    if (!stream)
+        return fail(cudaErrorInvalidResourceHandle);
+
+    pthread_mutex_lock(&streams_lock);
+    for (p = &streams; *p && *p != stream; p = &(*p)->next)
+        ;
+    if (*p)
+        *p = stream->next;
+    pthread_mutex_unlock(&streams_lock);
+
+    /* the worker runs what is left first */
+    pthread_mutex_lock(&stream->lock);
+    stream->exiting = true;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+
+    if (stream->capture) {
+        list_clear(&stream->capture->tasks);
+        host_free(stream->capture);
+    }
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    host_free(stream);
+    return cudaSuccess;
+}
+
+cudaError_t cudaStreamSynchronize(cudaStream_t stream) {
+    if (stream)
+        stream_sync(stream);
+    else
+        streams_sync(true);
+    return cudaSuccess;
+}
+
+cudaError_t cudaDeviceSynchronize(void) {
+    streams_sync(false);
+    return cudaSuccess;
+}
+
+cudaError_t cudaMemcpy(void *dst, const void *src, size_t count, enum cudaMemcpyKind kind) {
+    /* like a copy on the legacy default stream */
+    streams_sync(true);
+    if (kind == cudaMemcpyHostToDevice || kind == cudaMemcpyDeviceToDevice || kind == cudaMemcpyDefault)
+        dst = host_dev_ptr(dst);
+    if (kind == cudaMemcpyDeviceToHost || kind == cudaMemcpyDeviceToDevice || kind == cudaMemcpyDefault)
+        src = host_dev_ptr(src);
+    memcpy(dst, src, count);
+    if (kind == cudaMemcpyHostToDevice || kind == cudaMemcpyDeviceToHost)
+        link_transfer(count);
+    return cudaSuccess;
+}
+
+/* events */
+
+struct CUevent_st {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned long recorded;         /* times recorded */
+    unsigned long completed;        /* the last record that completed */
+    unsigned refs;                  /* the event and the tasks that use it */
+};
+
+struct event_task {
+    struct host_task task;
+    cudaEvent_t event;
+    unsigned long seq;
+};
+
+static void event_put(cudaEvent_t event) {
+    bool last;
+
+    pthread_mutex_lock(&event->lock);
+    last = --event->refs == 0;
+    pthread_mutex_unlock(&event->lock);
+    if (last) {
+        pthread_cond_destroy(&event->cond);
+        pthread_mutex_destroy(&event->lock);
+        host_free(event);
+    }
+}
+
+static void event_wait(cudaEvent_t event, unsigned long seq) {
+    pthread_mutex_lock(&event->lock);
+    while (event->completed < seq)
+        pthread_cond_wait(&event->cond, &event->lock);
+    pthread_mutex_unlock(&event->lock);
+}
+
+static void record_run(struct host_task *task) {
+    struct event_task *t = (struct event_task *) task;
+
+    pthread_mutex_lock(&t->event->lock);
+    if (t->seq > t->event->completed)
+        t->event->completed = t->seq;
+    pthread_cond_broadcast(&t->event->cond);
+    pthread_mutex_unlock(&t->event->lock);
+    event_put(t->event);
+}
+
+static void wait_run(struct host_task *task) {
+    struct event_task *t = (struct event_task *) task;
+
+    event_wait(t->event, t->seq);
+    event_put(t->event);
+}
+
+static bool capturing(cudaStream_t stream) {
+    bool ret;
+
+    if (!stream)
+        return false;
+    pthread_mutex_lock(&stream->lock);
+    ret = stream->capture != NULL;
+    pthread_mutex_unlock(&stream->lock);
+    return ret;
+}
+
+/**
+ * Enqueue {@run} for the current record of {@event} on {@stream}.
+ */
+static cudaError_t event_submit(cudaEvent_t event, cudaStream_t stream,
+        void (*run)(struct host_task *), bool record) {
+    struct event_task *t;
+
+    /* graphs only hold kernels */
+    if (capturing(stream))
+        return fail(cudaErrorStreamCaptureUnsupported);
+    if (!(t = host_alloc(sizeof *t)))
+        return fail(cudaErrorMemoryAllocation);
+    t->task.size = sizeof *t;
+    t->task.run = run;
+    t->event = event;
+
+    pthread_mutex_lock(&event->lock);
+    t->seq = record ? ++event->recorded : event->recorded;
+    event->refs++;
+    pthread_mutex_unlock(&event->lock);
+    host_submit(stream, &t->task);
+    return cudaSuccess;
+}
+
+cudaError_t cudaEventCreateWithFlags(cudaEvent_t *event, unsigned int flags) {
+    struct CUevent_st *ev;
+
+    if (!(ev = host_alloc(sizeof *ev)))
+        return fail(cudaErrorMemoryAllocation);
+    pthread_mutex_init(&ev->lock, NULL);
+    pthread_cond_init(&ev->cond, NULL);
+    ev->refs = 1;
+    *event = ev;
+    return cudaSuccess;
+}
+
+cudaError_t cudaEventCreate(cudaEvent_t *event) {
+    return cudaEventCreateWithFlags(event, cudaEventDefault);
+}
+
+cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t stream) {
+    return event_submit(event, stream, record_run, true);
+}
+
+cudaError_t cudaStreamWaitEvent(cudaStream_t stream, cudaEvent_t event, unsigned int flags) {
+    return event_submit(event, stream, wait_run, false);
+}
+
+cudaError_t cudaEventQuery(cudaEvent_t event) {
+    bool done;
+
+    pthread_mutex_lock(&event->lock);
+    done = event->completed >= event->recorded;
+    pthread_mutex_unlock(&event->lock);
+    return done ? cudaSuccess : cudaErrorNotReady;
+}
+
+cudaError_t cudaEventSynchronize(cudaEvent_t event) {
+    unsigned long seq;
+
+    pthread_mutex_lock(&event->lock);
+    seq = event->recorded;
+    pthread_mutex_unlock(&event->lock);
+    event_wait(event, seq);
+    return cudaSuccess;
+}
+
+cudaError_t cudaEventDestroy(cudaEvent_t event) {
+    event_put(event);
+    return cudaSuccess;
+}
+
+/* graphs */
+
+cudaError_t cudaStreamBeginCapture(cudaStream_t stream, enum cudaStreamCaptureMode mode) {
+    cudaGraph_t graph;
+
+    if (!stream)
+        return fail(cudaErrorStreamCaptureUnsupported);
+    if (!(graph = host_alloc(sizeof *graph)))
+        return fail(cudaErrorMemoryAllocation);
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->capture) {
+        pthread_mutex_unlock(&stream->lock);
+        host_free(graph);
+        return fail(cudaErrorStreamCaptureUnsupported);
+    }
+    stream->capture = graph;
+    pthread_mutex_unlock(&stream->lock);
+    return cudaSuccess;
+}
+
+cudaError_t cudaStreamEndCapture(cudaStream_t stream, cudaGraph_t *pGraph) {
+    if (!stream)
+        return fail(cudaErrorInvalidResourceHandle);
+    pthread_mutex_lock(&stream->lock);
+    *pGraph = stream->capture;
+    stream->capture = NULL;
+    pthread_mutex_unlock(&stream->lock);
+    return *pGraph ? cudaSuccess : fail(cudaErrorInvalidValue);
+}
+
+static void list_copy(struct task_list *dst, const struct task_list *src) {
+    for (const struct host_task *task = src->head; task; task = task->next)
+        list_append(dst, task_clone(task));
+}
+
+cudaError_t cudaGraphInstantiateWithFlags(cudaGraphExec_t *pGraphExec, cudaGraph_t graph,
+        unsigned long long flags) {
+    cudaGraphExec_t exec;
+
+    if (!(exec = host_alloc(sizeof *exec)))
+        return fail(cudaErrorMemoryAllocation);
+    list_copy(&exec->tasks, &graph->tasks);
+    *pGraphExec = exec;
+    return cudaSuccess;
+}
+
+cudaError_t cudaGraphExecUpdate(cudaGraphExec_t hGraphExec, cudaGraph_t hGraph,
+        cudaGraphExecUpdateResultInfo *resultInfo) {
+    const struct host_task *a = hGraphExec->tasks.head, *b = hGraph->tasks.head;
+
+    /* the same calls, with different arguments */
+    while (a && b && a->run == b->run && a->size == b->size) {
+        a = a->next;
+        b = b->next;
+    }
+    memset(resultInfo, 0, sizeof *resultInfo);
+    if (a || b) {
+        resultInfo->result = cudaGraphExecUpdateErrorTopologyChanged;
+        return fail(cudaErrorGraphExecUpdateFailure);
+    }
+    list_clear(&hGraphExec->tasks);
+    list_copy(&hGraphExec->tasks, &hGraph->tasks);
+    return cudaSuccess;
+}
+
+cudaError_t cudaGraphLaunch(cudaGraphExec_t graphExec, cudaStream_t stream) {
+    /* copied, so that the graph can be updated or destroyed meanwhile */
+    for (const struct host_task *task = graphExec->tasks.head; task; task = task->next)
+        host_submit(stream, task_clone(task));
+    return cudaSuccess;
+}
+
+cudaError_t cudaGraphDestroy(cudaGraph_t graph) {
+    list_clear(&graph->tasks);
+    host_free(graph);
+    return cudaSuccess;
+}
+
+cudaError_t cudaGraphExecDestroy(cudaGraphExec_t graphExec) {
+    list_clear(&graphExec->tasks);
+    host_free(graphExec);
+    return cudaSuccess;
+}
+
+/* device */
+
+#if HOST_BROKER
+/* the device is the daemon's, if it is running */
+cudaError_t cudaGetDeviceCount(int *count) {
+    *count = host_broker_connect() ? 1 : 0;
+    return *count ? cudaSuccess : fail(cudaErrorNoDevice);
+}
+#elif HOST_REMOTE
+/* the device is the server's, if it is set and up */
+cudaError_t cudaGetDeviceCount(int *count) {
+    *count = host_remote_connect() ? 1 : 0;
+    return *count ? cudaSuccess : fail(cudaErrorNoDevice);
+}
+#else
+cudaError_t cudaGetDeviceCount(int *count) {
+    *count = 1;
+    return cudaSuccess;
+}
+#endif
+
+cudaError_t cudaGetDeviceProperties(struct cudaDeviceProp *prop, int device) {
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (device != 0)
+        return fail(cudaErrorInvalidValue);
+    memset(prop, 0, sizeof *prop);
+#if HOST_BROKER
+    snprintf(prop->name, sizeof prop->name, "broker at %s", host_broker_path());
+#elif HOST_REMOTE
+    snprintf(prop->name, sizeof prop->name, "server at %s", host_remote_address());
+#else
+    snprintf(prop->name, sizeof prop->name, "host emulation (%ld CPUs)", cpus);
+#endif
+    prop->totalGlobalMem = (size_t) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    prop->multiProcessorCount = cpus;
+    /* kernels use mappings of their own, so the host can touch managed memory */
+    prop->managedMemory = 1;
+    prop->concurrentManagedAccess = 1;
+    return cudaSuccess;
+}
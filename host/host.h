@@ -0,0 +1,73 @@
+#ifndef HOST_H
+#define HOST_H
+
+/*
+ * The host backend runs libgpublas without a GPU, by emulating the parts of
+ * the CUDA runtime and cuBLAS that the CUDA backend uses. It is built with
+ * USE_CUDA and USE_HOST, with this directory ahead of the real CUDA headers,
+ * so that the interposition, object tracking and scheduling code runs
+ * unchanged. It is loaded as the "host" backend (see backend.h).
+ *
+ * - device memory is a separate heap of mappings in host memory. Managed
+ *   memory is mapped twice: the program gets one mapping, and the "device"
+ *   uses the other, so that kernels are not affected by the page protection
+ *   of pending objects (see pending.h), as with a real device.
+ * - each stream is a host thread that runs calls in the order they are
+ *   enqueued; cuBLAS calls run on it through the next BLAS library.
+ * - copies between the host and the device can pay for a simulated link
+ *   (see host_link_configure()).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cuda_runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Work enqueued on a stream. Tasks are freed once they have run, and are
+ * copied byte for byte ({@size} bytes) into and out of graphs, so they must
+ * not point into themselves.
+ */
+struct host_task {
+    struct host_task *next;
+    size_t size;
+    void (*run)(struct host_task *task);
+};
+
+/**
+ * Enqueue {@task}, which must have been allocated with host_alloc(), on
+ * {@stream}. Tasks on the legacy default stream (NULL) run right away on
+ * the calling thread, after the work on all blocking streams. If {@stream}
+ * is being captured, the task is added to its graph instead.
+ */
+void host_submit(cudaStream_t stream, struct host_task *task);
+
+/**
+ * The address of {@ptr} as seen by the device. Pointers into managed
+ * memory are moved to the device mapping; others are returned as is.
+ */
+void *host_dev_ptr(const void *ptr);
+
+/**
+ * The region of device or managed memory that contains {@ptr}, as seen by
+ * the host or by the device: its {@start} and {@dev} addresses and its
+ * {@size}.
+ * @return false if {@ptr} is not in device or managed memory
+ */
+bool host_dev_region(const void *ptr, void **start, void **dev, size_t *size);
+
+/**
+ * Memory for the bookkeeping of the backend, which bypasses the object
+ * tracker.
+ */
+void *host_alloc(size_t size);
+void host_free(void *ptr);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
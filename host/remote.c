@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include "remote.h"
+#include "host.h"
+#include "../common.h"
+#include <errno.h>
+#include <limits.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/* the rounds of XXH64, in four lanes, and MurmurHash3's finalizer */
+#define HASH_P1 0x9e3779b185ebca87ULL
+#define HASH_P2 0xc2b2ae3d27d4eb4fULL
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return x << r | x >> (64 - r);
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t w) {
+    return rotl(acc + w * HASH_P2, 31) * HASH_P1;
+}
+
+static inline uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ h >> 33;
+}
+
+void host_remote_hash(const void *buf, size_t size, struct host_remote_hash *hash) {
+    const unsigned char *p = buf;
+    uint64_t v[4] = { HASH_P1 + HASH_P2, HASH_P2, 0, -HASH_P1 };
+    uint64_t w[4], tail = 0;
+    size_t i;
+
+    for (i = 0; i + sizeof w <= size; i += sizeof w) {
+        memcpy(w, p + i, sizeof w);
+        for (int l = 0; l < 4; ++l)
+            v[l] = hash_round(v[l], w[l]);
+    }
+    memcpy(w, p + i, (size - i) / 8 * 8);
+    for (size_t l = 0; l < (size - i) / 8; ++l)
+        v[l] = hash_round(v[l], w[l]);
+    i += (size - i) / 8 * 8;
+    memcpy(&tail, p + i, size - i);
+    v[3] = hash_round(v[3], tail);
+
+    hash->h[0] = hash_mix(size ^ (v[0] + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18)));
+    hash->h[1] = hash_mix(size ^ (v[3] + rotl(v[2], 7) + rotl(v[1], 12) + rotl(v[0], 18)) * HASH_P1);
+}
+
+/**
+ * Skip the first {@done} bytes of {@iov}.
+ */
+static void iov_advance(struct iovec **iov, int *iovcnt, size_t done) {
+    while (*iovcnt > 0 && done >= (*iov)->iov_len) {
+        done -= (*iov)->iov_len;
+        ++*iov;
+        --*iovcnt;
+    }
+    if (*iovcnt > 0) {
+        (*iov)->iov_base = (char *) (*iov)->iov_base + done;
+        (*iov)->iov_len -= done;
+    }
+}
+
+bool host_remote_sendv(int sock, struct iovec *iov, int iovcnt) {
+    iov_advance(&iov, &iovcnt, 0);
+    while (iovcnt > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovcnt < IOV_MAX ? iovcnt : IOV_MAX };
+        ssize_t sent;
+
+        if ((sent = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        iov_advance(&iov, &iovcnt, sent);
+    }
+    return true;
+}
+
+bool host_remote_recvv(int sock, struct iovec *iov, int iovcnt) {
+    iov_advance(&iov, &iovcnt, 0);
+    while (iovcnt > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovcnt < IOV_MAX ? iovcnt : IOV_MAX };
+        ssize_t got;
+
+        if ((got = recvmsg(sock, &msg, MSG_WAITALL)) <= 0) {
+            if (got < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        iov_advance(&iov, &iovcnt, got);
+    }
+    return true;
+}
+
+/* client side */
+
+static long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* calls are made one at a time, each waiting for its reply */
+static int remote_sock = -1;
+static bool remote_lost;
+static pthread_mutex_t remote_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *host_remote_address(void) {
+    const char *env = getenv("BLAS2CUDA_REMOTE");
+
+    return env ? env : "";
+}
+
+/**
+ * Connect to {@address}: <host>[:<port>], or [<IPv6 address>][:<port>].
+ */
+static int remote_open(const char *address) {
+    const struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res, *ai;
+    const char *port = REMOTE_PORT, *end;
+    char host[NI_MAXHOST];
+    int sock = -1, one = 1, err;
+    size_t len;
+
+    if (address[0] == '[' && (end = strchr(address, ']'))) {
+        ++address;
+        len = end - address;
+        if (end[1] == ':')
+            port = end + 2;
+    } else if ((end = strrchr(address, ':'))) {
+        len = end - address;
+        port = end + 1;
+    } else
+        len = strlen(address);
+    if (len >= sizeof host) {
+        writef(STDERR_FILENO, "blas2cuda: remote: host name too long\n");
+        return -1;
+    }
+    memcpy(host, address, len);
+    host[len] = '\0';
+
+    if ((err = getaddrinfo(host, port, &hints, &res)) != 0) {
+        writef(STDERR_FILENO, "blas2cuda: remote: cannot resolve %s - %s\n", host, gai_strerror(err));
+        return -1;
+    }
+    for (ai = res; ai && sock == -1; ai = ai->ai_next) {
+        if ((sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) < 0)
+            continue;
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (sock == -1) {
+        writef(STDERR_FILENO, "blas2cuda: remote: cannot connect to %s:%s\n", host, port);
+    } else
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return sock;
+}
+
+bool host_remote_connect(void) {
+    bool connected;
+
+    pthread_mutex_lock(&remote_lock);
+    if (remote_sock == -1 && !remote_lost && *host_remote_address())
+        remote_sock = remote_open(host_remote_address());
+    connected = remote_sock != -1;
+    pthread_mutex_unlock(&remote_lock);
+    return connected;
+}
+
+/*
+ * The cost model. Rates are in bytes or flops per ns (1 GB/s is 1 byte/ns),
+ * averaged over the calls they are measured on, and 0 until then.
+ */
+static struct {
+    pthread_mutex_t lock;
+    double link_rate;           /* of the network */
+    double round_trip_ns;
+    bool rate_given, round_trip_given;  /* not measured */
+    double hash_rate;           /* of the chunks of a call, on both sides */
+    double traffic;             /* bytes sent and received per byte of operands */
+    double remote_rate, local_rate;
+} model = { .lock = PTHREAD_MUTEX_INITIALIZER, .traffic = 1 };
+
+/* until the network is measured */
+#define DEFAULT_LINK_RATE       1.0
+#define DEFAULT_ROUND_TRIP_NS   100e3
+
+/* transfers too small to measure the bandwidth on */
+#define MIN_MEASURED_BYTES      REMOTE_CHUNK
+
+static void average(double *rate, double value) {
+    *rate = *rate > 0 ? 0.75 * *rate + 0.25 * value : value;
+}
+
+void host_remote_link(double bandwidth, double latency) {
+    pthread_mutex_lock(&model.lock);
+    model.rate_given = bandwidth > 0;
+    model.link_rate = bandwidth;
+    model.round_trip_given = latency > 0;
+    model.round_trip_ns = 2 * latency * 1000;
+    pthread_mutex_unlock(&model.lock);
+}
+
+bool host_remote_pick(double flops, size_t bytes) {
+    bool pick;
+
+    pthread_mutex_lock(&model.lock);
+    if (!model.remote_rate)
+        pick = true;
+    else if (!model.local_rate)
+        pick = false;
+    else {
+        const double link_rate = model.link_rate > 0 ? model.link_rate : DEFAULT_LINK_RATE;
+        const double round_trip_ns = model.round_trip_ns > 0 ? model.round_trip_ns : DEFAULT_ROUND_TRIP_NS;
+        /* a call is two round trips: its hashes, then the chunks the server needs */
+        double remote_ns = 2 * round_trip_ns + model.traffic * bytes / link_rate
+            + flops / model.remote_rate;
+
+        if (model.hash_rate > 0)
+            remote_ns += bytes / model.hash_rate;
+        pick = remote_ns < flops / model.local_rate;
+    }
+    pthread_mutex_unlock(&model.lock);
+    return pick;
+}
+
+void host_remote_ran_here(double flops, long ns) {
+    if (ns <= 0)
+        return;
+    pthread_mutex_lock(&model.lock);
+    average(&model.local_rate, flops / ns);
+    pthread_mutex_unlock(&model.lock);
+}
+
+/**
+ * Send the call, its operands and the hashes of their {@num_chunks}
+ * {@chunks}, then the chunks the server needs, and receive the reply and
+ * the memory that changed. The caller holds the lock.
+ *
+ * @return the bytes sent and received, or -1 if the connection is gone
+ */
+static long long remote_exchange(const struct host_remote_msg *msg, const void *call,
+        const struct host_remote_operand *operands, const struct host_remote_hash *hashes,
+        struct iovec *chunks, struct host_remote_reply *reply, long *round_trip_ns) {
+    const uint64_t num_chunks = msg->num_chunks;
+    struct iovec head[4] = {
+        { (void *) msg, sizeof *msg },
+        { (void *) call, msg->size },
+        { (void *) operands, msg->num_operands * sizeof *operands },
+        { (void *) hashes, num_chunks * sizeof *hashes },
+    };
+    unsigned char *need = NULL;
+    struct host_remote_range *ranges = NULL;
+    struct iovec *iov = NULL;
+    long long moved = -1, bytes = 0;
+    long start = now_ns();
+    int n = 0;
+
+    if (!(need = host_alloc(num_chunks)) || !(iov = host_alloc(num_chunks * sizeof *iov)))
+        goto out;
+    if (!host_remote_sendv(remote_sock, head, 4)
+            || !host_remote_recvv(remote_sock, &(struct iovec) { need, num_chunks }, 1))
+        goto out;
+    *round_trip_ns = now_ns() - start;
+
+    for (uint64_t j = 0; j < num_chunks; ++j)
+        if (need[j]) {
+            iov[n++] = chunks[j];
+            bytes += chunks[j].iov_len;
+        }
+    if (!host_remote_sendv(remote_sock, iov, n)
+            || !host_remote_recvv(remote_sock, &(struct iovec) { reply, sizeof *reply }, 1))
+        goto out;
+
+    host_free(iov);
+    iov = NULL;
+    if (!(ranges = host_alloc(reply->num_ranges * sizeof *ranges + 1))
+            || !(iov = host_alloc(reply->num_ranges * sizeof *iov + 1))
+            || !host_remote_recvv(remote_sock,
+                &(struct iovec) { ranges, reply->num_ranges * sizeof *ranges }, 1))
+        goto out;
+    for (uint32_t i = 0; i < reply->num_ranges; ++i) {
+        const struct host_remote_range *r = &ranges[i];
+
+        if (r->chunk >= num_chunks || r->offset > chunks[r->chunk].iov_len
+                || r->len > chunks[r->chunk].iov_len - r->offset)
+            goto out;
+        iov[i].iov_base = (char *) chunks[r->chunk].iov_base + r->offset;
+        iov[i].iov_len = r->len;
+        bytes += r->len;
+    }
+    if (host_remote_recvv(remote_sock, iov, reply->num_ranges))
+        moved = bytes;
+out:
+    host_free(iov);
+    host_free(ranges);
+    host_free(need);
+    return moved;
+}
+
+bool host_remote_call(const void *call, size_t size, double flops,
+        const struct host_remote_operand *operands, void *const *local, size_t num_operands,
+        struct host_broker_reply *reply) {
+    struct host_remote_msg msg = { size, num_operands, 0 };
+    struct host_remote_hash *hashes = NULL;
+    struct iovec *chunks = NULL;
+    struct host_remote_reply remote_reply;
+    long long moved = -1;
+    long start, hashed, round_trip_ns = 0;
+    size_t bytes = 0;
+    uint64_t j = 0;
+
+    for (size_t i = 0; i < num_operands; ++i) {
+        msg.num_chunks += host_remote_chunks(operands[i].len);
+        bytes += operands[i].len;
+    }
+    if (!(hashes = host_alloc(msg.num_chunks * sizeof *hashes))
+            || !(chunks = host_alloc(msg.num_chunks * sizeof *chunks))) {
+        host_free(hashes);
+        return false;
+    }
+
+    start = now_ns();
+    for (size_t i = 0; i < num_operands; ++i)
+        for (uint64_t off = 0; off < operands[i].len; off += REMOTE_CHUNK, ++j) {
+            chunks[j].iov_base = (char *) local[i] + off;
+            chunks[j].iov_len = operands[i].len - off < REMOTE_CHUNK ? operands[i].len - off : REMOTE_CHUNK;
+            host_remote_hash(chunks[j].iov_base, chunks[j].iov_len, &hashes[j]);
+        }
+    hashed = now_ns();
+
+    pthread_mutex_lock(&remote_lock);
+    if (remote_sock != -1) {
+        moved = remote_exchange(&msg, call, operands, hashes, chunks, &remote_reply, &round_trip_ns);
+        if (moved < 0) {
+            writef(STDERR_FILENO, "blas2cuda: lost the server at %s, running calls here\n",
+                    host_remote_address());
+            close(remote_sock);
+            remote_sock = -1;
+            remote_lost = true;
+        }
+    }
+    pthread_mutex_unlock(&remote_lock);
+    host_free(chunks);
+    host_free(hashes);
+    if (moved < 0 || remote_reply.call.status != BROKER_DONE)
+        return false;
+
+    pthread_mutex_lock(&model.lock);
+    if (hashed > start)
+        average(&model.hash_rate, (double) bytes / (hashed - start));
+    if (bytes > 0)
+        average(&model.traffic, (double) moved / bytes);
+    if (remote_reply.run_ns > 0)
+        average(&model.remote_rate, flops / remote_reply.run_ns);
+    if (!model.round_trip_given)
+        average(&model.round_trip_ns, round_trip_ns);
+    if (!model.rate_given) {
+        const long transfer_ns = now_ns() - hashed - 2 * round_trip_ns - (long) remote_reply.run_ns;
+
+        if (moved >= MIN_MEASURED_BYTES && transfer_ns > 0)
+            average(&model.link_rate, (double) moved / transfer_ns);
+    }
+    pthread_mutex_unlock(&model.lock);
+
+    *reply = remote_reply.call;
+    return true;
+}
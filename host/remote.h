@@ -0,0 +1,151 @@
+#ifndef HOST_REMOTE_H
+#define HOST_REMOTE_H
+
+/*
+ * The remote backend (libblas2cuda-remote.so) sends large level 3 calls to
+ * a server on another machine, blas2cuda-server, over TCP. It is the host
+ * emulation, in which device memory stays in the process, with:
+ *
+ * - a cost model that picks, call by call, between running a call here
+ *   and sending it, from the bandwidth and latency of the network and the
+ *   rates that calls have run at on either side (see host_remote_pick())
+ * - the memory that a call touches sent along with it, in chunks of
+ *   REMOTE_CHUNK bytes. The server keeps the chunks it has seen in a cache
+ *   keyed by the hash of their contents, so a matrix that is used again
+ *   (or a part of it that has not changed) is not sent again: the call
+ *   goes first with the hashes of its chunks, and the server asks for the
+ *   ones that it does not have. Chunks are sent and received straight from
+ *   and into device memory with scatter/gather I/O, and the server caches
+ *   each one as the next is on the wire.
+ * - the bytes that the call changed sent back with its reply, and only
+ *   those, since calls on other streams may write to other parts of the
+ *   same memory in the meantime.
+ *
+ * The server runs the calls through the BLAS library that it is linked
+ * with, or the device if it runs with libblas2cuda preloaded. A call names
+ * one of the routines of the backend, and only runs if all that it
+ * touches is in the memory sent along with it (see host_call_serve()).
+ * Anyone who can reach the server can use it, so it only listens on the
+ * loopback interface unless told otherwise.
+ */
+
+#include "broker.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REMOTE_CHUNK    (1 << 20)
+#define REMOTE_PORT     "4884"
+
+struct host_remote_hash {
+    uint64_t h[2];
+};
+
+/*
+ * A call: the client sends the message, the call, its operands and the
+ * hashes of all of their chunks; the server answers with a byte per chunk,
+ * non-zero for those it needs, which the client sends next. The server
+ * runs the call, and replies with the ranges of memory that it changed,
+ * followed by their contents.
+ */
+struct host_remote_msg {
+    uint32_t size;              /* of the call */
+    uint32_t num_operands;
+    uint64_t num_chunks;
+};
+
+/* memory that a call touches */
+struct host_remote_operand {
+    uint64_t addr;              /* as seen by the call */
+    uint64_t alias;             /* the program's address of the same memory, or addr */
+    uint64_t len;
+};
+
+/* memory that a call changed, in one of its chunks */
+struct host_remote_range {
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t len;
+};
+
+struct host_remote_reply {
+    struct host_broker_reply call;
+    uint32_t num_ranges;
+    uint32_t reserved;
+    uint64_t run_ns;            /* that the call took on the server */
+};
+
+/**
+ * The number of chunks of an operand of {@len} bytes.
+ */
+static inline uint64_t host_remote_chunks(uint64_t len) {
+    return (len + REMOTE_CHUNK - 1) / REMOTE_CHUNK;
+}
+
+/**
+ * Hash [{@buf}, {@buf} + {@size}) into {@hash}.
+ */
+void host_remote_hash(const void *buf, size_t size, struct host_remote_hash *hash);
+
+/**
+ * Send or receive all of the memory in {@iov}, which is modified.
+ * @return false if the connection is gone
+ */
+bool host_remote_sendv(int sock, struct iovec *iov, int iovcnt);
+bool host_remote_recvv(int sock, struct iovec *iov, int iovcnt);
+
+/*
+ * client side (the remote backend)
+ */
+
+/**
+ * The server: $BLAS2CUDA_REMOTE, as <host>[:<port>].
+ */
+const char *host_remote_address(void);
+
+/**
+ * Connect to the server, if not connected already.
+ * @return true if connected
+ */
+bool host_remote_connect(void);
+
+/**
+ * Use a network of {@bandwidth} GB/s and {@latency} microseconds in the
+ * cost model, instead of measuring it. 0 means measure.
+ */
+void host_remote_link(double bandwidth, double latency);
+
+/**
+ * Whether a call of {@flops} that touches {@bytes} of memory is worth
+ * sending to the server rather than running here. Until the rates on both
+ * sides are known, the first calls go to the server, and then one runs
+ * here.
+ */
+bool host_remote_pick(double flops, size_t bytes);
+
+/**
+ * A call of {@flops} ran here in {@ns}.
+ */
+void host_remote_ran_here(double flops, long ns);
+
+/**
+ * Have the server run the call in [{@call}, {@call} + {@size}), of
+ * {@flops}, on the {@num_operands} {@operands}, which are at {@local} in
+ * this process. What it changes is written back to {@local}.
+ *
+ * @return true if it ran; {@reply} says whether it returned a value
+ */
+bool host_remote_call(const void *call, size_t size, double flops,
+        const struct host_remote_operand *operands, void *const *local, size_t num_operands,
+        struct host_broker_reply *reply);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,551 @@
+#define _GNU_SOURCE
+#include "host.h"
+#include "remote.h"
+#include "../common.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+/*
+ * blas2cuda-server [-c <cache MiB>] [[<address>:]<port>]
+ *
+ * The server of the remote backend (see remote.h). Each client that
+ * connects gets a thread, which receives its calls with the memory that
+ * they touch, runs them and sends back the bytes that they changed. Chunks
+ * of that memory are kept in a cache that all clients share, of 1 GiB by
+ * default, the least recently used ones going first. Calls go to the BLAS library
+ * that the server is linked with, or to the device if it runs with
+ * libblas2cuda preloaded, once they are checked against the memory that
+ * came with them; the client runs those that fail. It listens on
+ * 127.0.0.1:4884 by default.
+ */
+
+#define MAX_CALL_SIZE       (64 << 10)
+#define MAX_OPERANDS        4096
+#define MAX_CALL_BYTES      (64ULL << 30)
+
+/* memory of a call */
+struct operand {
+    char *addr, *alias;     /* as seen by the client */
+    size_t len;
+    char *local;
+    char *before;           /* a copy of it from before the call */
+};
+
+struct client {
+    int sock;
+    char name[NI_MAXHOST + NI_MAXSERV + 1];
+    unsigned long calls, declined;
+    unsigned long long bytes, received, returned;
+};
+
+/* the memory of the call that runs on this thread */
+static __thread struct operand *current;
+static __thread size_t num_current;
+
+/* for host/cublas.c */
+
+/* the routines of host/cublas.c are looked up by name, so the BLAS library must stay linked in */
+extern void sgemm_();
+static __attribute__((used)) void (*const blas_needed)() = sgemm_;
+
+void *runtime_blas_func(const char *name) {
+    return dlsym(RTLD_DEFAULT, name);
+}
+
+void *host_alloc(size_t size) {
+    return calloc(1, size);
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+/* the server has no streams: calls run as they are submitted */
+void host_submit(cudaStream_t stream, struct host_task *task) {
+    task->run(task);
+    host_free(task);
+}
+
+cudaError_t cudaStreamSynchronize(cudaStream_t stream) {
+    return cudaSuccess;
+}
+
+void *host_dev_ptr(const void *ptr) {
+    const char *const p = ptr;
+
+    for (size_t i = 0; i < num_current; ++i) {
+        const struct operand *op = &current[i];
+
+        if (p >= op->addr && p < op->addr + op->len)
+            return op->local + (p - op->addr);
+        if (p >= op->alias && p < op->alias + op->len)
+            return op->local + (p - op->alias);
+    }
+    return NULL;
+}
+
+/* calls are only made by clients */
+bool host_dev_region(const void *ptr, void **start, void **dev, size_t *size) {
+    return false;
+}
+
+/* the cache of chunks */
+
+struct chunk {
+    struct host_remote_hash hash;
+    size_t size;
+    struct chunk *next;                 /* in its bucket */
+    struct chunk *newer, *older;
+    char data[];
+};
+
+#define CACHE_BUCKETS   (1 << 16)
+
+static struct chunk *buckets[CACHE_BUCKETS];
+static struct chunk *newest, *oldest;
+static size_t cache_size, cache_max = 1UL << 30;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct chunk **cache_find_locked(const struct host_remote_hash *hash, size_t size) {
+    struct chunk **p = &buckets[hash->h[0] % CACHE_BUCKETS];
+
+    while (*p && (memcmp(&(*p)->hash, hash, sizeof *hash) != 0 || (*p)->size != size))
+        p = &(*p)->next;
+    return p;
+}
+
+static void lru_unlink_locked(struct chunk *c) {
+    if (c->newer)
+        c->newer->older = c->older;
+    else
+        newest = c->older;
+    if (c->older)
+        c->older->newer = c->newer;
+    else
+        oldest = c->newer;
+}
+
+static void lru_push_locked(struct chunk *c) {
+    c->newer = NULL;
+    c->older = newest;
+    if (newest)
+        newest->newer = c;
+    else
+        oldest = c;
+    newest = c;
+}
+
+/**
+ * Copy the chunk of {@size} bytes with {@hash} to {@dst}.
+ * @return false if it is not in the cache
+ */
+static bool cache_get(const struct host_remote_hash *hash, void *dst, size_t size) {
+    struct chunk *c;
+
+    pthread_mutex_lock(&cache_lock);
+    if ((c = *cache_find_locked(hash, size))) {
+        memcpy(dst, c->data, size);
+        lru_unlink_locked(c);
+        lru_push_locked(c);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return c != NULL;
+}
+
+/**
+ * Add the chunk [{@src}, {@src} + {@size}) to the cache, as {@hash}.
+ */
+static void cache_put(const struct host_remote_hash *hash, const void *src, size_t size) {
+    struct chunk **p, *c;
+
+    if (size > cache_max || !(c = malloc(sizeof *c + size)))
+        return;
+    c->hash = *hash;
+    c->size = size;
+    memcpy(c->data, src, size);
+
+    pthread_mutex_lock(&cache_lock);
+    if (*(p = cache_find_locked(hash, size))) {
+        pthread_mutex_unlock(&cache_lock);
+        free(c);
+        return;
+    }
+    c->next = NULL;
+    *p = c;
+    lru_push_locked(c);
+    cache_size += size;
+    while (cache_size > cache_max) {
+        struct chunk *old = oldest;
+
+        lru_unlink_locked(old);
+        for (p = &buckets[old->hash.h[0] % CACHE_BUCKETS]; *p != old; p = &(*p)->next)
+            ;
+        *p = old->next;
+        cache_size -= old->size;
+        free(old);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/* calls */
+
+static long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* the state of a call that is being received */
+struct session {
+    struct host_remote_msg msg;
+    void *call;
+    struct host_remote_operand *operands;
+    struct host_remote_hash *hashes;
+    struct operand *ops;
+    struct iovec *chunks;               /* of the local memory of the operands */
+    size_t *chunk_ops;                  /* the operand of each chunk */
+    unsigned char *need;
+    struct host_remote_range *ranges;   /* that the call changed */
+    size_t num_ranges, max_ranges;
+};
+
+static void session_free(struct session *s) {
+    for (size_t i = 0; s->ops && i < s->msg.num_operands; ++i) {
+        if (s->ops[i].local)
+            munmap(s->ops[i].local, s->ops[i].len);
+        if (s->ops[i].before)
+            munmap(s->ops[i].before, s->ops[i].len);
+    }
+    free(s->ranges);
+    free(s->need);
+    free(s->chunk_ops);
+    free(s->chunks);
+    free(s->ops);
+    free(s->hashes);
+    free(s->operands);
+    free(s->call);
+}
+
+/**
+ * Receive what comes after the message of a call, and map memory for its
+ * operands.
+ * @return false if the client is to be dropped
+ */
+static bool session_start(struct client *client, struct session *s) {
+    const struct host_remote_msg *msg = &s->msg;
+    unsigned long long bytes = 0;
+    uint64_t num_chunks = 0, j = 0;
+
+    if (msg->size > MAX_CALL_SIZE || msg->num_operands > MAX_OPERANDS)
+        return false;
+    if (!(s->call = malloc(msg->size ? msg->size : 1))
+            || !(s->operands = calloc(msg->num_operands, sizeof *s->operands))
+            || !host_remote_recvv(client->sock, (struct iovec[]) {
+                { s->call, msg->size },
+                { s->operands, msg->num_operands * sizeof *s->operands } }, 2))
+        return false;
+    for (uint32_t i = 0; i < msg->num_operands; ++i) {
+        bytes += s->operands[i].len;
+        num_chunks += host_remote_chunks(s->operands[i].len);
+    }
+    if (num_chunks != msg->num_chunks || bytes > MAX_CALL_BYTES
+            || !(s->hashes = calloc(num_chunks, sizeof *s->hashes))
+            || !host_remote_recvv(client->sock, &(struct iovec) { s->hashes, num_chunks * sizeof *s->hashes }, 1)
+            || !(s->ops = calloc(msg->num_operands, sizeof *s->ops))
+            || !(s->chunks = calloc(num_chunks, sizeof *s->chunks))
+            || !(s->chunk_ops = calloc(num_chunks, sizeof *s->chunk_ops))
+            || !(s->need = calloc(num_chunks, 1)))
+        return false;
+
+    for (uint32_t i = 0; i < msg->num_operands; ++i) {
+        const struct host_remote_operand *op = &s->operands[i];
+        struct operand *o = &s->ops[i];
+
+        /* changes are found word by word */
+        if (op->len == 0 || op->len % sizeof(uint32_t))
+            return false;
+        o->addr = (char *) (uintptr_t) op->addr;
+        o->alias = (char *) (uintptr_t) op->alias;
+        o->len = op->len;
+        if ((o->local = mmap(NULL, op->len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED
+                || (o->before = mmap(NULL, op->len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+            if (o->local == MAP_FAILED)
+                o->local = NULL;
+            o->before = NULL;
+            return false;
+        }
+        for (uint64_t off = 0; off < op->len; off += REMOTE_CHUNK, ++j) {
+            s->chunk_ops[j] = i;
+            s->chunks[j].iov_base = o->local + off;
+            s->chunks[j].iov_len = op->len - off < REMOTE_CHUNK ? op->len - off : REMOTE_CHUNK;
+        }
+    }
+    client->bytes += bytes;
+    return true;
+}
+
+/**
+ * Fill the operands in from the cache, and receive the chunks that it
+ * does not have, caching each one as the next comes in.
+ */
+static bool session_fill(struct client *client, struct session *s) {
+    const uint64_t num_chunks = s->msg.num_chunks;
+
+    for (uint64_t j = 0; j < num_chunks; ++j)
+        s->need[j] = !cache_get(&s->hashes[j], s->chunks[j].iov_base, s->chunks[j].iov_len);
+    if (!host_remote_sendv(client->sock, &(struct iovec) { s->need, num_chunks }, 1))
+        return false;
+    for (uint64_t j = 0; j < num_chunks; ++j) {
+        struct iovec iov = s->chunks[j];
+
+        if (!s->need[j])
+            continue;
+        if (!host_remote_recvv(client->sock, &iov, 1))
+            return false;
+        /* under the hash of what came, which is what the client sent */
+        host_remote_hash(s->chunks[j].iov_base, s->chunks[j].iov_len, &s->hashes[j]);
+        cache_put(&s->hashes[j], s->chunks[j].iov_base, s->chunks[j].iov_len);
+        client->received += s->chunks[j].iov_len;
+    }
+    return true;
+}
+
+static bool range_add(struct session *s, uint32_t chunk, size_t offset, size_t len) {
+    if (s->num_ranges == s->max_ranges) {
+        const size_t max = s->max_ranges ? 2 * s->max_ranges : 64;
+        struct host_remote_range *ranges = realloc(s->ranges, max * sizeof *ranges);
+
+        if (!ranges)
+            return false;
+        s->ranges = ranges;
+        s->max_ranges = max;
+    }
+    s->ranges[s->num_ranges++] = (struct host_remote_range) { chunk, offset, len };
+    return true;
+}
+
+/**
+ * Add the runs of words of chunk {@j} that the call changed to the ranges.
+ * @return false if it changed and could not be added
+ */
+static bool session_diff(struct session *s, uint32_t j) {
+    const struct operand *op = &s->ops[s->chunk_ops[j]];
+    const uint32_t *now = s->chunks[j].iov_base;
+    const uint32_t *old = (const uint32_t *) (op->before + ((const char *) now - op->local));
+    const size_t words = s->chunks[j].iov_len / sizeof *now;
+    struct host_remote_hash hash;
+    size_t i = 0, first;
+
+    if (memcmp(now, old, s->chunks[j].iov_len) == 0)
+        return true;
+    while (i < words) {
+        if (i + 16 <= words && memcmp(now + i, old + i, 16 * sizeof *now) == 0)
+            i += 16;
+        else if (now[i] == old[i])
+            i++;
+        else {
+            for (first = i; i < words && now[i] != old[i]; ++i)
+                ;
+            if (!range_add(s, j, first * sizeof *now, (i - first) * sizeof *now))
+                return false;
+        }
+    }
+    host_remote_hash(now, s->chunks[j].iov_len, &hash);
+    cache_put(&hash, now, s->chunks[j].iov_len);
+    return true;
+}
+
+/**
+ * Run the call, and send the reply and the memory that it changed.
+ */
+static bool session_run(struct client *client, struct session *s) {
+    struct host_remote_reply reply = { 0 };
+    struct iovec *iov;
+    long start;
+    bool ok = true;
+
+    for (uint32_t i = 0; i < s->msg.num_operands; ++i)
+        memcpy(s->ops[i].before, s->ops[i].local, s->ops[i].len);
+    current = s->ops;
+    num_current = s->msg.num_operands;
+    start = now_ns();
+    reply.call.status = host_call_serve(s->call, s->msg.size, &reply.call) ? BROKER_DONE : BROKER_DECLINED;
+    reply.run_ns = now_ns() - start;
+    current = NULL;
+    num_current = 0;
+
+    client->calls++;
+    if (reply.call.status != BROKER_DONE)
+        client->declined++;
+    else
+        for (uint64_t j = 0; j < s->msg.num_chunks && ok; ++j)
+            ok = session_diff(s, j);
+    if (!ok || !(iov = calloc(s->num_ranges + 2, sizeof *iov)))
+        return false;
+
+    reply.num_ranges = s->num_ranges;
+    iov[0] = (struct iovec) { &reply, sizeof reply };
+    iov[1] = (struct iovec) { s->ranges, s->num_ranges * sizeof *s->ranges };
+    for (size_t i = 0; i < s->num_ranges; ++i) {
+        const struct host_remote_range *r = &s->ranges[i];
+
+        iov[i + 2] = (struct iovec) { (char *) s->chunks[r->chunk].iov_base + r->offset, r->len };
+        client->returned += r->len;
+    }
+    ok = host_remote_sendv(client->sock, iov, s->num_ranges + 2);
+    free(iov);
+    return ok;
+}
+
+static void *client_serve(void *arg) {
+    struct client *client = arg;
+
+    for (;;) {
+        struct session s = { 0 };
+        bool ok;
+
+        if (!host_remote_recvv(client->sock, &(struct iovec) { &s.msg, sizeof s.msg }, 1))
+            break;
+        ok = session_start(client, &s) && session_fill(client, &s) && session_run(client, &s);
+        session_free(&s);
+        if (!ok)
+            break;
+    }
+
+    writef(STDOUT_FILENO, "blas2cuda-server: %s left after %lu calls (%lu run by the client), "
+            "%.1f of %.1f MiB of operands sent, %.1f MiB returned\n",
+            client->name, client->calls, client->declined, client->received / 1048576.0,
+            client->bytes / 1048576.0, client->returned / 1048576.0);
+    close(client->sock);
+    free(client);
+    return NULL;
+}
+
+/* startup */
+
+static void on_signal(int sig) {
+    _exit(0);
+}
+
+/**
+ * Listen on {@address}: [<host>:]<port>, or [<IPv6 address>]:<port>.
+ */
+static int listen_on(const char *address) {
+    const struct addrinfo hints = {
+        .ai_flags = AI_PASSIVE, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res, *ai;
+    const char *port = address, *end;
+    char host[NI_MAXHOST] = "127.0.0.1";
+    int sock = -1, one = 1, err;
+
+    if (address[0] == '[' && (end = strchr(address, ']')) && end[1] == ':') {
+        snprintf(host, sizeof host, "%.*s", (int) (end - address - 1), address + 1);
+        port = end + 2;
+    } else if ((end = strrchr(address, ':'))) {
+        snprintf(host, sizeof host, "%.*s", (int) (end - address), address);
+        port = end + 1;
+    }
+    if ((err = getaddrinfo(host, port, &hints, &res)) != 0) {
+        writef(STDERR_FILENO, "blas2cuda-server: cannot resolve %s - %s\n", address, gai_strerror(err));
+        return -1;
+    }
+    for (ai = res; ai && sock == -1; ai = ai->ai_next) {
+        if ((sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) < 0)
+            continue;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (bind(sock, ai->ai_addr, ai->ai_addrlen) < 0 || listen(sock, SOMAXCONN) < 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (sock == -1)
+        writef(STDERR_FILENO, "blas2cuda-server: cannot listen on %s:%s: %s\n", host, port, strerror(errno));
+    return sock;
+}
+
+static void usage(const char *prog) {
+    writef(STDERR_FILENO, "usage: %s [-c <cache MiB>] [[<address>:]<port>]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *address = REMOTE_PORT;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int opt, sock;
+    char *end;
+
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        if (opt != 'c')
+            usage(argv[0]);
+        cache_max = strtoul(optarg, &end, 10) << 20;
+        if (*end || end == optarg)
+            usage(argv[0]);
+    }
+    if (optind < argc - 1)
+        usage(argv[0]);
+    if (optind == argc - 1)
+        address = argv[optind];
+    /* if libblas2cuda is preloaded, it must not send calls back here */
+    unsetenv("BLAS2CUDA_REMOTE");
+
+    if ((sock = listen_on(address)) < 0)
+        return EXIT_FAILURE;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    writef(STDOUT_FILENO, "blas2cuda-server: listening on %s with a cache of %lu MiB\n",
+            address, (unsigned long) (cache_max >> 20));
+
+    for (;;) {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof addr;
+        char host[NI_MAXHOST], serv[NI_MAXSERV];
+        struct client *client;
+        int conn;
+
+        if ((conn = accept4(sock, (struct sockaddr *) &addr, &len, SOCK_CLOEXEC)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            writef(STDERR_FILENO, "blas2cuda-server: accept: %s\n", strerror(errno));
+            break;
+        }
+        if (!(client = calloc(1, sizeof *client))) {
+            close(conn);
+            continue;
+        }
+        client->sock = conn;
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &(int) { 1 }, sizeof(int));
+        if (getnameinfo((struct sockaddr *) &addr, len, host, sizeof host, serv, sizeof serv,
+                    NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+            snprintf(client->name, sizeof client->name, "%s:%s", host, serv);
+        else
+            strcpy(client->name, "?");
+        writef(STDOUT_FILENO, "blas2cuda-server: %s connected\n", client->name);
+        if (pthread_create(&thread, &attr, client_serve, client) != 0) {
+            close(conn);
+            free(client);
+        }
+    }
+    return EXIT_FAILURE;
+}
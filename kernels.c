@@ -0,0 +1,392 @@
+#include "kernels.h"
+#include "common.h"
+
+size_t b2c_kernels_built = 0;
+double b2c_kernels_build_ms = 0;
+size_t b2c_kernels_loaded = 0;
+double b2c_kernels_load_ms = 0;
+
+#if USE_OPENCL
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "blas2cuda.h"
+#include "runtime.h"
+#include "runtime-blas.h"
+#include "scheduler.h"
+#include "lib/obj_tracker.h"
+
+extern cl_context opencl_ctx;
+
+/* programs that have been created but not built yet */
+#define KERNELS_MAX_UNBUILT     16
+
+/* the order of the matrices of the prebuild calls; see prebuild_calls() */
+#define PREBUILD_N              64
+
+static struct kernels_unbuilt {
+    cl_program program;
+    uint64_t key;
+    double create_ms;   /* time spent creating it from a cached binary */
+    bool cached;
+} unbuilt[KERNELS_MAX_UNBUILT];
+static unsigned num_unbuilt;
+static pthread_mutex_t kernels_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t prebuild_thread;
+static bool prebuilding;
+static bool prebuild_stop;
+
+static double now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+/* FNV-1a */
+static uint64_t kernels_hash(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static void *kernels_next(const char *fname) {
+    void *func = dlsym(RTLD_NEXT, fname);
+
+    if (!func) {
+        writef(STDERR_FILENO, "blas2cuda: failed to find %s: %s\n", fname, dlerror());
+        abort();
+    }
+    return func;
+}
+
+/**
+ * Only the programs of clBLAS and of this library are cached: their build
+ * options don't change from one run to the next.
+ */
+static bool kernels_cacheable(const void *caller) {
+    static const void *own_base, *clblas_base;
+    Dl_info info;
+
+    if (!own_base && dladdr((void *) b2c_kernels_prebuild, &info))
+        own_base = info.dli_fbase;
+    if (!clblas_base && dladdr((void *) clblasSetup, &info))
+        clblas_base = info.dli_fbase;
+    return dladdr(caller, &info) && info.dli_fbase
+        && (info.dli_fbase == own_base || info.dli_fbase == clblas_base);
+}
+
+/**
+ * Hash the device of {@context}, its driver version and the source of a
+ * program into {@key}. Contexts with more than one device are not cached.
+ */
+static bool kernels_key(cl_context context, cl_uint count, const char **strings,
+        const size_t *lengths, cl_device_id *device, uint64_t *key)
+{
+    char name[256], driver[256];
+    size_t size;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    if (clGetContextInfo(context, CL_CONTEXT_DEVICES, sizeof *device, device, &size) != CL_SUCCESS
+            || size != sizeof *device
+            || clGetDeviceInfo(*device, CL_DEVICE_NAME, sizeof name, name, NULL) != CL_SUCCESS
+            || clGetDeviceInfo(*device, CL_DRIVER_VERSION, sizeof driver, driver, NULL) != CL_SUCCESS)
+        return false;
+
+    hash = kernels_hash(hash, name, strnlen(name, sizeof name) + 1);
+    hash = kernels_hash(hash, driver, strnlen(driver, sizeof driver) + 1);
+    for (cl_uint i = 0; i < count; i++)
+        hash = kernels_hash(hash, strings[i],
+                lengths && lengths[i] ? lengths[i] : strlen(strings[i]));
+    *key = hash;
+    return true;
+}
+
+static bool kernels_path(char *path, size_t size, uint64_t key, bool create) {
+    char dir[PATH_MAX];
+
+    if (!runtime_cache_dir(dir, sizeof dir, create))
+        return false;
+    if (strlen(dir) + sizeof "/kernels" > sizeof dir)
+        return false;
+    strcat(dir, "/kernels");
+    if (create && mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return false;
+    return snprintf(path, size, "%s/%016" PRIx64 ".bin", dir, key) < (int) size;
+}
+
+/**
+ * Create the program with {@key} from its cached binary, if there is one
+ * that the driver accepts. Binaries that it rejects are removed.
+ */
+static cl_program kernels_load(cl_context context, cl_device_id device, uint64_t key) {
+    char path[PATH_MAX];
+    unsigned char *binary = NULL;
+    cl_program program = NULL;
+    struct stat st;
+    size_t size, done = 0;
+    cl_int err, status;
+    ssize_t ret;
+    int fd;
+
+    if (!kernels_path(path, sizeof path, key, false) || (fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || !(binary = malloc(st.st_size))) {
+        close(fd);
+        return NULL;
+    }
+    size = st.st_size;
+    while (done < size && (ret = read(fd, binary + done, size - done)) > 0)
+        done += ret;
+    close(fd);
+
+    if (done == size) {
+        program = clCreateProgramWithBinary(context, 1, &device, &size,
+                (const unsigned char **) &binary, &status, &err);
+        if (runtime_is_error(err) || runtime_is_error(status)) {
+            if (!runtime_is_error(err))
+                clReleaseProgram(program);
+            program = NULL;
+            unlink(path);
+        }
+    }
+    free(binary);
+    return program;
+}
+
+/**
+ * Write the binary of {@program}, which was just built, to the cache. The
+ * file is renamed into place, so that other processes never see a part of
+ * it.
+ */
+static void kernels_save(cl_program program, uint64_t key) {
+    char path[PATH_MAX], tmp[PATH_MAX];
+    unsigned char *binary;
+    cl_uint num_devices;
+    size_t size, done = 0;
+    ssize_t ret;
+    int fd;
+
+    if (clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof num_devices, &num_devices, NULL) != CL_SUCCESS
+            || num_devices != 1
+            || clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof size, &size, NULL) != CL_SUCCESS
+            || size == 0 || !(binary = malloc(size)))
+        return;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof binary, &binary, NULL) != CL_SUCCESS
+            || !kernels_path(path, sizeof path, key, true)
+            || snprintf(tmp, sizeof tmp, "%s.%d", path, (int) getpid()) >= (int) sizeof tmp
+            || (fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        free(binary);
+        return;
+    }
+    while (done < size && (ret = write(fd, binary + done, size - done)) > 0)
+        done += ret;
+    if (close(fd) < 0 || done < size || rename(tmp, path) < 0) {
+        writef(STDERR_FILENO, "blas2cuda: WARNING: failed to write to the kernel cache: %s\n", strerror(errno));
+        unlink(tmp);
+    }
+    free(binary);
+}
+
+static void kernels_remember(cl_program program, uint64_t key, bool cached, double create_ms) {
+    unsigned i;
+
+    pthread_mutex_lock(&kernels_lock);
+    for (i = 0; i < num_unbuilt && unbuilt[i].program != program; i++)
+        ;
+    if (i < KERNELS_MAX_UNBUILT) {
+        unbuilt[i] = (struct kernels_unbuilt) { program, key, create_ms, cached };
+        if (i == num_unbuilt)
+            num_unbuilt++;
+    }
+    pthread_mutex_unlock(&kernels_lock);
+}
+
+static bool kernels_forget(cl_program program, struct kernels_unbuilt *entry) {
+    bool found = false;
+
+    pthread_mutex_lock(&kernels_lock);
+    for (unsigned i = 0; i < num_unbuilt; i++)
+        if (unbuilt[i].program == program) {
+            *entry = unbuilt[i];
+            unbuilt[i] = unbuilt[--num_unbuilt];
+            found = true;
+            break;
+        }
+    pthread_mutex_unlock(&kernels_lock);
+    return found;
+}
+
+CL_API_ENTRY cl_program CL_API_CALL clCreateProgramWithSource(cl_context context, cl_uint count,
+        const char **strings, const size_t *lengths, cl_int *errcode_ret)
+{
+    static __typeof__(clCreateProgramWithSource) *next;
+    double start = now_ms();
+    cl_device_id device;
+    cl_program program;
+    uint64_t key;
+
+    if (!next)
+        next = (__typeof__(next)) kernels_next(__func__);
+    if (!kernels_cacheable(__builtin_return_address(0))
+            || !kernels_key(context, count, strings, lengths, &device, &key))
+        return next(context, count, strings, lengths, errcode_ret);
+
+    if ((program = kernels_load(context, device, key))) {
+        if (errcode_ret)
+            *errcode_ret = CL_SUCCESS;
+        kernels_remember(program, key, true, now_ms() - start);
+        return program;
+    }
+    if ((program = next(context, count, strings, lengths, errcode_ret)))
+        kernels_remember(program, key, false, 0);
+    return program;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL clBuildProgram(cl_program program, cl_uint num_devices,
+        const cl_device_id *device_list, const char *options,
+        void (CL_CALLBACK *pfn_notify)(cl_program, void *), void *user_data)
+{
+    static __typeof__(clBuildProgram) *next;
+    struct kernels_unbuilt entry;
+    double start, elapsed;
+    cl_int err;
+
+    if (!next)
+        next = (__typeof__(next)) kernels_next(__func__);
+    if (!kernels_forget(program, &entry))
+        return next(program, num_devices, device_list, options, pfn_notify, user_data);
+
+    start = now_ms();
+    err = next(program, num_devices, device_list, options, pfn_notify, user_data);
+    elapsed = now_ms() - start;
+
+    pthread_mutex_lock(&kernels_lock);
+    if (entry.cached) {
+        b2c_kernels_loaded++;
+        b2c_kernels_load_ms += entry.create_ms + elapsed;
+    } else {
+        b2c_kernels_built++;
+        b2c_kernels_build_ms += elapsed;
+    }
+    pthread_mutex_unlock(&kernels_lock);
+
+    /* with a callback, the build may not be done yet */
+    if (!entry.cached && !runtime_is_error(err) && !pfn_notify)
+        kernels_save(program, entry.key);
+    return err;
+}
+
+static bool prebuild_stopped(void) {
+    return __atomic_load_n(&prebuild_stop, __ATOMIC_ACQUIRE);
+}
+
+#define prebuild_call(expr) do {\
+    if (!prebuild_stopped())\
+        call_kernel(expr);\
+} while (0)
+
+/*
+ * clBLAS has separate kernels for sizes that are a multiple of its tiles
+ * and for the others, so each shape is issued with PREBUILD_N and with
+ * PREBUILD_N + 1. The operands are not initialized: only the kernels
+ * matter.
+ */
+static void prebuild_calls(cl_mem a, cl_mem b, cl_mem c, cl_mem scratch) {
+    static const clblasTranspose trans[] = { clblasNoTrans, clblasTrans };
+    const FloatComplex c_one = floatComplex(1, 0), c_zero = floatComplex(0, 0);
+    const DoubleComplex z_one = doubleComplex(1, 0), z_zero = doubleComplex(0, 0);
+
+    for (size_t n = PREBUILD_N; n <= PREBUILD_N + 1; n++) {
+        for (int ta = 0; ta < 2; ta++)
+            for (int tb = 0; tb < 2; tb++) {
+                prebuild_call(clblasSgemm(clblasColumnMajor, trans[ta], trans[tb], n, n, n,
+                            1, a, 0, n, b, 0, n, 0, c, 0, n, b2c_queue_args()));
+                prebuild_call(clblasDgemm(clblasColumnMajor, trans[ta], trans[tb], n, n, n,
+                            1, a, 0, n, b, 0, n, 0, c, 0, n, b2c_queue_args()));
+            }
+        prebuild_call(clblasCgemm(clblasColumnMajor, clblasNoTrans, clblasNoTrans, n, n, n,
+                    c_one, a, 0, n, b, 0, n, c_zero, c, 0, n, b2c_queue_args()));
+        prebuild_call(clblasZgemm(clblasColumnMajor, clblasNoTrans, clblasNoTrans, n, n, n,
+                    z_one, a, 0, n, b, 0, n, z_zero, c, 0, n, b2c_queue_args()));
+
+        for (int t = 0; t < 2; t++) {
+            prebuild_call(clblasSgemv(clblasColumnMajor, trans[t], n, n,
+                        1, a, 0, n, b, 0, 1, 0, c, 0, 1, b2c_queue_args()));
+            prebuild_call(clblasDgemv(clblasColumnMajor, trans[t], n, n,
+                        1, a, 0, n, b, 0, 1, 0, c, 0, 1, b2c_queue_args()));
+        }
+
+        prebuild_call(clblasSaxpy(n, 1, a, 0, 1, c, 0, 1, b2c_queue_args()));
+        prebuild_call(clblasDaxpy(n, 1, a, 0, 1, c, 0, 1, b2c_queue_args()));
+        prebuild_call(clblasSdot(n, c, 0, a, 0, 1, b, 0, 1, scratch, b2c_queue_args()));
+        prebuild_call(clblasDdot(n, c, 0, a, 0, 1, b, 0, 1, scratch, b2c_queue_args()));
+        prebuild_call(clblasSnrm2(n, c, 0, a, 0, 1, scratch, b2c_queue_args()));
+        prebuild_call(clblasDnrm2(n, c, 0, a, 0, 1, scratch, b2c_queue_args()));
+        prebuild_call(clblasSscal(n, 1, c, 0, 1, b2c_queue_args()));
+        prebuild_call(clblasDscal(n, 1, c, 0, 1, b2c_queue_args()));
+    }
+}
+
+static void *prebuild(void *arg) {
+    const size_t size = (PREBUILD_N + 1) * (PREBUILD_N + 1) * sizeof(DoubleComplex);
+    cl_mem bufs[4];
+    cl_int err = CL_SUCCESS;
+    int num_bufs;
+
+    obj_tracker_internal_enter();
+    for (num_bufs = 0; num_bufs < 4; num_bufs++) {
+        bufs[num_bufs] = clCreateBuffer(opencl_ctx, CL_MEM_READ_WRITE, size, NULL, &err);
+        if (runtime_is_error(err))
+            break;
+    }
+    if (num_bufs == 4)
+        prebuild_calls(bufs[0], bufs[1], bufs[2], bufs[3]);
+    else
+        writef(STDERR_FILENO, "blas2cuda: failed to allocate prebuild operands: %s\n",
+                runtime_error_string(err));
+
+    /* OpenCL keeps the buffers until the calls that use them are done */
+    while (num_bufs > 0)
+        clReleaseMemObject(bufs[--num_bufs]);
+    obj_tracker_internal_leave();
+    return NULL;
+}
+
+void b2c_kernels_prebuild(void) {
+    int err;
+
+    if (!b2c_options.prebuild)
+        return;
+    if ((err = pthread_create(&prebuild_thread, NULL, prebuild, NULL)) == 0)
+        prebuilding = true;
+    else
+        writef(STDERR_FILENO, "blas2cuda: failed to start prebuild thread: %s\n", strerror(err));
+}
+
+void b2c_kernels_fini(void) {
+    __atomic_store_n(&prebuild_stop, true, __ATOMIC_RELEASE);
+    if (prebuilding)
+        pthread_join(prebuild_thread, NULL);
+    prebuilding = false;
+}
+
+#else
+
+void b2c_kernels_prebuild(void) {
+}
+
+void b2c_kernels_fini(void) {
+}
+
+#endif
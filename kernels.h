@@ -0,0 +1,55 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-disk cache of compiled OpenCL programs (OpenCL only).
+ *
+ * clBLAS generates and builds the kernels of a routine from source the
+ * first time the routine is called with a given precision, transposition
+ * and shape class, which can take seconds per kernel, in every process.
+ * The library interposes clCreateProgramWithSource() and clBuildProgram(),
+ * which clBLAS calls through the dynamic linker, and keeps the binaries of
+ * the programs that clBLAS (and the runtime) builds in
+ * $XDG_CACHE_HOME/blas2cuda/kernels/. Each file is named after a hash of
+ * the device name, the driver version and the program source, so a driver
+ * update or a different device builds the programs again. Later runs
+ * create the programs from these binaries instead.
+ *
+ * Programs are assumed to be built with the same options every time for a
+ * given source, which holds for clBLAS. Programs of the application itself
+ * are left alone.
+ */
+
+/** programs built from source, and the time spent building them */
+extern size_t b2c_kernels_built;
+extern double b2c_kernels_build_ms;
+
+/** programs created from cached binaries, and the time spent on them */
+extern size_t b2c_kernels_loaded;
+extern double b2c_kernels_load_ms;
+
+/**
+ * With the prebuild option, start issuing tiny calls to the routines that
+ * the usual workloads use (gemm, gemv and the level 1 routines of iterative
+ * solvers) on a thread of its own, so that their kernels are built or
+ * loaded before the application needs them. Called once the runtime is up.
+ */
+void b2c_kernels_prebuild(void);
+
+/**
+ * Stop issuing prebuild calls and wait for the thread to exit.
+ */
+void b2c_kernels_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
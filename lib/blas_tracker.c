@@ -123,8 +123,8 @@ void blas_tracker_fini(void) {
 }
 
 /* Level 1 */
-#define ASUM_TRACK(prefix, T)                   \
-DECLARE_CBLAS__ASUM(prefix, T) {                \
+#define ASUM_TRACK(prefix, S, T)                \
+DECLARE_CBLAS__ASUM(prefix, S, T) {             \
     typeof(cblas_##prefix##asum) *fun;          \
     print_objtrack_info(x);                     \
     if ((fun = get_real_blas_fun(__func__)))    \
@@ -132,13 +132,13 @@ DECLARE_CBLAS__ASUM(prefix, T) {                \
     abort();                                    \
 }
 
-ASUM_TRACK(s, float)
-ASUM_TRACK(sc, float _Complex)
-ASUM_TRACK(d, double)
-ASUM_TRACK(dz, double _Complex)
+ASUM_TRACK(s, float, float)
+ASUM_TRACK(sc, float, float _Complex)
+ASUM_TRACK(d, double, double)
+ASUM_TRACK(dz, double, double _Complex)
 
-#define AXPY_TRACK(prefix, T)                   \
-DECLARE_CBLAS__AXPY(prefix, T) {                \
+#define AXPY_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__AXPY(prefix, T, SC) {            \
     typeof(cblas_##prefix##axpy) *fun;          \
     print_objtrack_info(x);                     \
     print_objtrack_info(y);                     \
@@ -148,10 +148,10 @@ DECLARE_CBLAS__AXPY(prefix, T) {                \
         abort();                                \
 }
 
-AXPY_TRACK(s, float)
-AXPY_TRACK(d, double)
-AXPY_TRACK(c, float _Complex)
-AXPY_TRACK(z, double _Complex)
+AXPY_TRACK(s, float, const float)
+AXPY_TRACK(d, double, const double)
+AXPY_TRACK(c, float _Complex, const float _Complex *)
+AXPY_TRACK(z, double _Complex, const double _Complex *)
 
 #define COPY_TRACK(prefix, type)                \
 DECLARE_CBLAS__COPY(prefix, type) {             \
@@ -210,19 +210,19 @@ DECLARE_CBLAS__DOTU(prefix, T) {                \
 DOTU_TRACK(c, float _Complex)
 DOTU_TRACK(z, double _Complex)
 
-#define NRM2_TRACK(prefix, T)                   \
-DECLARE_CBLAS__NRM2(prefix, T) {                \
-    typeof(cblas_##prefix##_nrm2) *fun;         \
+#define NRM2_TRACK(prefix, S, T)                \
+DECLARE_CBLAS__NRM2(prefix, S, T) {             \
+    typeof(cblas_##prefix##nrm2) *fun;          \
     print_objtrack_info(x);                     \
     if ((fun = get_real_blas_fun(__func__)))    \
         return fun(n, x, incx);                 \
     abort();                                    \
 }
 
-NRM2_TRACK(s, float)
-NRM2_TRACK(d, double)
-NRM2_TRACK(sc, float _Complex)
-NRM2_TRACK(dz, double _Complex)
+NRM2_TRACK(s, float, float)
+NRM2_TRACK(d, double, double)
+NRM2_TRACK(sc, float, float _Complex)
+NRM2_TRACK(dz, double, double _Complex)
 
 #define ROT_TRACK(prefix, S, T)                 \
 DECLARE_CBLAS__ROT(prefix, S, T) {              \
@@ -277,12 +277,12 @@ DECLARE_CBLAS__SCAL(prefix, S, T) {             \
         abort();                                \
 }
 
-SCAL_TRACK(s, float, float)
-SCAL_TRACK(d, double, double)
-SCAL_TRACK(c, float _Complex, float _Complex)
-SCAL_TRACK(z, double _Complex, double _Complex)
-SCAL_TRACK(cs, float _Complex, float)
-SCAL_TRACK(zd, double _Complex, double)
+SCAL_TRACK(s, float, const float)
+SCAL_TRACK(d, double, const double)
+SCAL_TRACK(c, float _Complex, const float _Complex *)
+SCAL_TRACK(z, double _Complex, const double _Complex *)
+SCAL_TRACK(cs, float _Complex, const float)
+SCAL_TRACK(zd, double _Complex, const double)
 
 #define SWAP_TRACK(prefix, T)                   \
 DECLARE_CBLAS__SWAP(prefix, T) {                \
@@ -330,8 +330,8 @@ I_AMIN_TRACK(c, float _Complex)
 I_AMIN_TRACK(z, double _Complex)
 
 /* Level 2 */
-#define GBMV_TRACK(prefix, T)                   \
-DECLARE_CBLAS__GBMV(prefix, T) {                \
+#define GBMV_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__GBMV(prefix, T, SC) {            \
     typeof(cblas_##prefix##gbmv) *fun;          \
     print_objtrack_info(A);                     \
     print_objtrack_info(x);                     \
@@ -349,13 +349,13 @@ DECLARE_CBLAS__GBMV(prefix, T) {                \
         abort();                                \
 }
 
-GBMV_TRACK(s, float)
-GBMV_TRACK(d, double)
-GBMV_TRACK(c, float _Complex)
-GBMV_TRACK(z, double _Complex)
+GBMV_TRACK(s, float, const float)
+GBMV_TRACK(d, double, const double)
+GBMV_TRACK(c, float _Complex, const float _Complex *)
+GBMV_TRACK(z, double _Complex, const double _Complex *)
 
-#define GEMV_TRACK(prefix, T)                   \
-DECLARE_CBLAS__GEMV(prefix, T) {                \
+#define GEMV_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__GEMV(prefix, T, SC) {            \
     typeof(cblas_##prefix##gemv) *fun;          \
     print_objtrack_info(A);                     \
     print_objtrack_info(x);                     \
@@ -372,10 +372,10 @@ DECLARE_CBLAS__GEMV(prefix, T) {                \
         abort();                                \
 }
 
-GEMV_TRACK(s, float)
-GEMV_TRACK(d, double)
-GEMV_TRACK(c, float _Complex)
-GEMV_TRACK(z, double _Complex)
+GEMV_TRACK(s, float, const float)
+GEMV_TRACK(d, double, const double)
+GEMV_TRACK(c, float _Complex, const float _Complex *)
+GEMV_TRACK(z, double _Complex, const double _Complex *)
 
 #define GER_TRACK(prefix, T)                    \
 DECLARE_CBLAS__GER(prefix, T) {                 \
@@ -782,7 +782,7 @@ DECLARE_CBLAS__TPMV(prefix, T) {                \
                 uplo,                           \
                 trans,                          \
                 diag,                           \
-                n, k,                           \
+                n,                              \
                 ap,                             \
                 x, incx);                       \
     else                                        \
@@ -863,8 +863,8 @@ TRSV_TRACK(z, double _Complex)
 
 
 /* Level 3 */
-#define GEMM_TRACK(prefix, T)                   \
-DECLARE_CBLAS__GEMM(prefix, T) {                \
+#define GEMM_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__GEMM(prefix, T, SC) {            \
     typeof(cblas_##prefix##gemm) *fun;          \
     print_objtrack_info(a);                     \
     print_objtrack_info(b);                     \
@@ -881,10 +881,10 @@ DECLARE_CBLAS__GEMM(prefix, T) {                \
         abort();                                \
 }
 
-GEMM_TRACK(s, float)
-GEMM_TRACK(d, double)
-GEMM_TRACK(c, float _Complex)
-GEMM_TRACK(z, double _Complex)
+GEMM_TRACK(s, float, const float)
+GEMM_TRACK(d, double, const double)
+GEMM_TRACK(c, float _Complex, const float _Complex *)
+GEMM_TRACK(z, double _Complex, const double _Complex *)
 
 #define HEMM_TRACK(prefix, T)                   \
 DECLARE_CBLAS__HEMM(prefix, T) {                \
@@ -949,8 +949,8 @@ DECLARE_CBLAS__HER2K(prefix, S, T) {            \
 HER2K_TRACK(c, float, float _Complex)
 HER2K_TRACK(z, double, double _Complex)
 
-#define SYMM_TRACK(prefix, T)                   \
-DECLARE_CBLAS__SYMM(prefix, T) {                \
+#define SYMM_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__SYMM(prefix, T, SC) {            \
     typeof(cblas_##prefix##symm) *fun;          \
     print_objtrack_info(a);                     \
     print_objtrack_info(b);                     \
@@ -967,14 +967,14 @@ DECLARE_CBLAS__SYMM(prefix, T) {                \
         abort();                                \
 }
 
-SYMM_TRACK(s, float)
-SYMM_TRACK(d, double)
-SYMM_TRACK(c, float _Complex)
-SYMM_TRACK(z, double _Complex)
+SYMM_TRACK(s, float, const float)
+SYMM_TRACK(d, double, const double)
+SYMM_TRACK(c, float _Complex, const float _Complex *)
+SYMM_TRACK(z, double _Complex, const double _Complex *)
 
 
-#define SYRK_TRACK(prefix, T)                   \
-DECLARE_CBLAS__SYRK(prefix, T) {                \
+#define SYRK_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__SYRK(prefix, T, SC) {            \
     typeof(cblas_##prefix##syrk) *fun;          \
     print_objtrack_info(a);                     \
     print_objtrack_info(c);                     \
@@ -989,14 +989,14 @@ DECLARE_CBLAS__SYRK(prefix, T) {                \
         abort();                                \
 }
 
-SYRK_TRACK(s, float)
-SYRK_TRACK(d, double)
-SYRK_TRACK(c, float _Complex)
-SYRK_TRACK(z, double _Complex)
+SYRK_TRACK(s, float, const float)
+SYRK_TRACK(d, double, const double)
+SYRK_TRACK(c, float _Complex, const float _Complex *)
+SYRK_TRACK(z, double _Complex, const double _Complex *)
 
 
-#define SYR2K_TRACK(prefix, T)                  \
-DECLARE_CBLAS__SYR2K(prefix, T) {               \
+#define SYR2K_TRACK(prefix, T, SC)              \
+DECLARE_CBLAS__SYR2K(prefix, T, SC) {           \
     typeof(cblas_##prefix##syr2k) *fun;         \
     print_objtrack_info(a);                     \
     print_objtrack_info(b);                     \
@@ -1013,14 +1013,14 @@ DECLARE_CBLAS__SYR2K(prefix, T) {               \
         abort();                                \
 }
 
-SYR2K_TRACK(s, float)
-SYR2K_TRACK(d, double)
-SYR2K_TRACK(c, float _Complex)
-SYR2K_TRACK(z, double _Complex)
+SYR2K_TRACK(s, float, const float)
+SYR2K_TRACK(d, double, const double)
+SYR2K_TRACK(c, float _Complex, const float _Complex *)
+SYR2K_TRACK(z, double _Complex, const double _Complex *)
 
 
-#define TRMM_TRACK(prefix, T)                   \
-DECLARE_CBLAS__TRMM(prefix, T) {                \
+#define TRMM_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__TRMM(prefix, T, SC) {            \
     typeof(cblas_##prefix##trmm) *fun;          \
     print_objtrack_info(a);                     \
     print_objtrack_info(b);                     \
@@ -1034,14 +1034,14 @@ DECLARE_CBLAS__TRMM(prefix, T) {                \
         abort();                                \
 }
 
-TRMM_TRACK(s, float)
-TRMM_TRACK(d, double)
-TRMM_TRACK(c, float _Complex)
-TRMM_TRACK(z, double _Complex)
+TRMM_TRACK(s, float, const float)
+TRMM_TRACK(d, double, const double)
+TRMM_TRACK(c, float _Complex, const float _Complex *)
+TRMM_TRACK(z, double _Complex, const double _Complex *)
 
 
-#define TRSM_TRACK(prefix, T)                   \
-DECLARE_CBLAS__TRSM(prefix, T) {                \
+#define TRSM_TRACK(prefix, T, SC)               \
+DECLARE_CBLAS__TRSM(prefix, T, SC) {            \
     typeof(cblas_##prefix##trsm) *fun;          \
     print_objtrack_info(a);                     \
     print_objtrack_info(b);                     \
@@ -1055,10 +1055,10 @@ DECLARE_CBLAS__TRSM(prefix, T) {                \
         abort();                                \
 }
 
-TRSM_TRACK(s, float)
-TRSM_TRACK(d, double)
-TRSM_TRACK(c, float _Complex)
-TRSM_TRACK(z, double _Complex)
+TRSM_TRACK(s, float, const float)
+TRSM_TRACK(d, double, const double)
+TRSM_TRACK(c, float _Complex, const float _Complex *)
+TRSM_TRACK(z, double _Complex, const double _Complex *)
 
 /* Fortran */
 
@@ -55,6 +55,7 @@ enum heuristic hfunc = H_RANDOM;
 static bool initialized = false;
 static bool initializing = false;
 static bool destroying = false;
+static bool decommissioned = false;     /* with objects left over */
 static pid_t creation_thread = 0;
 static void *objects = NULL;
 static unsigned long num_objects = 0;
@@ -482,11 +483,46 @@ void obj_tracker_print_info(enum objprint_type type, const char *fname, const st
                 tm.tv_sec, tm.tv_nsec, info->uid);
 }
 
+/*
+ * fork() only copies the thread that calls it, so the tree must not be in
+ * the middle of a change by another thread then, and the child gets a lock
+ * of its own: the write lock taken for the fork belongs to a thread that
+ * the child doesn't have.
+ */
+static bool fork_locked;
+
+static void fork_prepare(void) {
+    if (!initialized || grabbed_reader_lock || grabbed_writer_lock)
+        return;
+    write_lock();
+    fork_locked = true;
+}
+
+static void fork_parent(void) {
+    if (fork_locked) {
+        fork_locked = false;
+        unlock();
+    }
+}
+
+static void fork_child(void) {
+    int err;
+
+    if (fork_locked) {
+        fork_locked = false;
+        if ((err = pthread_rwlock_init(&rwlock, NULL)) != 0) {
+            writef(STDERR_FILENO, "objtracker: failed to initialize rwlock in child: %s\n", strerror(err));
+            abort();
+        }
+    }
+}
+
 #if STANDALONE
 __attribute__((constructor))
 #endif
 void obj_tracker_init(bool tracking_enabled)
 {
+    static bool registered_fork_handlers = false;
 /*    extern char etext, edata, end; */
     if (!initialized && !initializing) {
         tracking = false;
@@ -501,6 +537,10 @@ void obj_tracker_init(bool tracking_enabled)
         }
 
         obj_tracker_get_fptrs();
+        if (!registered_fork_handlers) {
+            pthread_atfork(fork_prepare, fork_parent, fork_child);
+            registered_fork_handlers = true;
+        }
         initialized = true;
 
 #if STANDALONE
@@ -527,7 +567,10 @@ int obj_tracker_load(const char *filename, struct objmngr *mngr)
  * Checks for exact equality.
  */
 static int objects_compare(const void *o1, const void *o2) {
-    return ((const struct objinfo *)o1)->ptr - ((const struct objinfo *)o2)->ptr;
+    const uintptr_t p1 = (uintptr_t) ((const struct objinfo *)o1)->ptr;
+    const uintptr_t p2 = (uintptr_t) ((const struct objinfo *)o2)->ptr;
+
+    return (p1 > p2) - (p1 < p2);
 }
 
 /**
@@ -554,6 +597,19 @@ static int objects_compare_subset(const void *o1, const void *o2) {
     return objects_compare(o1, o2);
 }
 
+/**
+ * Finds the pointers into the object {@o1}, which lie after it.
+ */
+static int objects_compare_child(const void *o1, const void *o2) {
+    const struct objinfo *parent = o1;
+    const struct objinfo *oi2 = o2;
+
+    if (oi2->parent == parent)
+        return 0;
+
+    return oi2->ptr > parent->ptr ? -1 : 1;
+}
+
 static void *insert_objinfo(struct objinfo *oinfo)
 {
     void *node;
@@ -571,8 +627,11 @@ static void *insert_objinfo(struct objinfo *oinfo)
 
     node = tsearch(oinfo, &objects, objects_compare);
 
-    if (node) {
+    /* another thread may have added the same pointer */
+    if (node && *(struct objinfo **) node == oinfo) {
         __sync_fetch_and_add(&num_objects, 1);
+        if (oinfo->parent)
+            oinfo->parent->children++;
     }
 
     unlock();
@@ -630,12 +689,43 @@ const struct objinfo *obj_tracker_objinfo_subptr(void *ptr)
     oinfo->ci.alloc = result->ci.alloc;
     oinfo->parent = result;
 
-    if (!(node = insert_objinfo(oinfo)))
+    if (!(node = insert_objinfo(oinfo))) {
+        internal_free(oinfo);
         return NULL;
+    }
+    if (*(struct objinfo **)node != oinfo)
+        internal_free(oinfo);
 
     return *(struct objinfo **)node;
 }
 
+void *obj_tracker_attach(const struct objinfo *info, void *data)
+{
+    struct objinfo *obj = (struct objinfo *)(info->parent ? info->parent : info);
+    void *attached = NULL;
+
+    if (__atomic_compare_exchange_n(&obj->data, &attached, data, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return data;
+    return attached;
+}
+
+static void (*foreach_fn)(const struct objinfo *info);
+
+static void foreach_visit(const void *node, VISIT which, int depth) {
+    const struct objinfo *info = *(struct objinfo *const *)node;
+
+    if ((which == postorder || which == leaf) && !info->parent)
+        foreach_fn(info);
+}
+
+void obj_tracker_foreach(void (*fn)(const struct objinfo *info))
+{
+    foreach_fn = fn;
+    twalk(objects, foreach_visit);
+    foreach_fn = NULL;
+}
+
 #if STANDALONE
 __attribute__((destructor))
 #endif
@@ -649,8 +739,16 @@ void obj_tracker_fini(void) {
             abort();
         }
 
-        tdestroy(objects, real_free);
-        objects = NULL;
+        /*
+         * Objects still tracked now are freed later, if at all, e.g. by
+         * libc on exit. Keep them so that these frees can be recognized
+         * and skipped, instead of being passed to glibc.
+         */
+        if (num_objects == 0) {
+            tdestroy(objects, real_free);
+            objects = NULL;
+        } else
+            decommissioned = true;
 
 #if STANDALONE
         blas_tracker_fini();
@@ -747,6 +845,19 @@ static void *delete_objinfo(void *node, struct objmngr *mngr)
     objinfo = *(struct objinfo **) node;
     result = tdelete(objinfo, &objects, objects_compare);
 
+    /* pointers into the object go with it, before its memory is reused */
+    while (objinfo->children > 0) {
+        struct objinfo *child;
+
+        if (!(node = tfind(objinfo, &objects, objects_compare_child)))
+            break;
+        child = *(struct objinfo **) node;
+        tdelete(child, &objects, objects_compare);
+        real_free(child);
+        objinfo->children--;
+        __sync_fetch_and_add(&num_objects, -1);
+    }
+
     unlock();
     grabbed_writer_lock = false;
 
@@ -759,6 +870,8 @@ static void *delete_objinfo(void *node, struct objmngr *mngr)
     obj_tracker_print_info(OBJPRINT_UNTRACK, "free", objinfo);
 #endif
     memcpy(mngr, &objinfo->ci.mngr, sizeof(*mngr));
+    if (objinfo->data && mngr->release)
+        mngr->release(objinfo->ptr, objinfo->data);
     real_free(objinfo);
 
     obj_tracker_internal_leave();
@@ -924,9 +1037,17 @@ void *realloc(void *ptr, size_t size) {
             writef(STDOUT_FILENO,"realloc: returning NULL because real_realloc is undefined\n");
             return NULL;
         }
-        new_ptr = real_realloc(ptr, size);
-        if (ptr_info)
-            untrack_object(ptr, &mngr);
+        if (ptr_info) {
+            /* the object's manager owns it, so move it to the heap */
+            size_t old_size = ptr_info->ci.mngr.get_size(ptr);
+
+            if ((new_ptr = real_malloc(size))) {
+                memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+                if (untrack_object(ptr, &mngr))
+                    mngr.dtor(ptr);
+            }
+        } else
+            new_ptr = real_realloc(ptr, size);
         return debug_alloc(new_ptr, "realloc", !(!initialized || initializing));
     }
 
@@ -950,6 +1071,10 @@ void free(void *ptr) {
     struct objmngr mngr;
 
     if (inside || inside_internal || destroying || initializing || !initialized) {
+        struct objinfo leftover = { .ptr = ptr };
+
+        if (decommissioned && !initialized && tfind(&leftover, &objects, objects_compare))
+            return;
         if (real_free)
             real_free(ptr);
         return;
@@ -962,8 +1087,12 @@ void free(void *ptr) {
         abort();
     }
 
-    /* We have a valid function pointer to free(). */
-    if (ptr && tracking) {
+    /*
+     * We have a valid function pointer to free(). Objects that were
+     * tracked before tracking was turned off (e.g. in a forked child)
+     * still go back to their manager.
+     */
+    if (ptr && (tracking || num_objects)) {
         /*
          * Set our defaults in case we
          * fail to set mngr.
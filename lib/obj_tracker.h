@@ -88,6 +88,8 @@ struct objmngr {
     void *(*realloc)(void *, size_t);
     void (*dtor)(void *);
     size_t (*get_size)(void *);
+    /* release the data attached to an object (optional) */
+    void (*release)(void *ptr, void *data);
 };
 
 struct alloc_callinfo {
@@ -112,6 +114,7 @@ struct objinfo {
     uint64_t nth_alloc;     /* the nth call to malloc()/calloc() */
     uint64_t children;      /* number of children */
     struct objinfo *parent; /* only if size == 0 */
+    void *data;             /* see obj_tracker_attach() */
 };
 
 enum objprint_type {
@@ -161,10 +164,27 @@ const struct objinfo *obj_tracker_objinfo(void *ptr);
  * the behavior is the same as obj_tracker_objinfo.
  * If this pointer is contained within an object managed by
  * the object tracking system, a new definition is created
- * and returned. Otherwise, return NULL.
+ * and returned, which is removed along with the object.
+ * Otherwise, return NULL.
  */
 const struct objinfo *obj_tracker_objinfo_subptr(void *ptr);
 
+/**
+ * Attach {@data} to the object {@info} (or to its parent), unless the
+ * object already has data. The object manager's release() is called on
+ * the data when the object is untracked.
+ * @return the data attached to the object, which is {@data} if it was
+ * attached
+ */
+void *obj_tracker_attach(const struct objinfo *info, void *data);
+
+/**
+ * Call {@fn} on each tracked object, but not on pointers into objects.
+ * Only for when no other thread can use the tracker, e.g. in a forked
+ * child.
+ */
+void obj_tracker_foreach(void (*fn)(const struct objinfo *info));
+
 /**
  * Decommission the object tracker.
  */
@@ -0,0 +1,454 @@
+#define _GNU_SOURCE
+#include "pending.h"
+#include "scheduler.h"
+#include "batch.h"
+#include "common.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define MAX_PENDING 256
+#define MAX_EVENTS  4   /* calls in flight per object */
+
+struct pending_obj {
+    const void *ptr;            /* start of the object */
+    uintptr_t start, end;       /* protected pages */
+    bool writes;                /* whether the device writes the object */
+    /*
+     * Calls that use the object. Calls on different streams may complete
+     * in any order, unless one depends on the other.
+     */
+    struct b2c_event *events[MAX_EVENTS];
+    unsigned num_events;
+    bool held;                  /* used by buffered calls (see batch.h) */
+};
+
+static struct pending_obj pending[MAX_PENDING];
+static unsigned num_pending;
+/*
+ * Threads take pending_lock and then table_busy; the fault handler can't
+ * use the mutex, and only takes table_busy.
+ */
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool table_busy;
+/* whether this thread holds the table, or runs the fault handler */
+static __thread volatile sig_atomic_t holds_lock, in_fault;
+
+/*
+ * Events dropped by the fault handler, which can't release them itself
+ * since that may free them. Released by the next thread that unlocks the
+ * table.
+ */
+static struct b2c_event *dropped[MAX_PENDING * MAX_EVENTS];
+static unsigned num_dropped;
+
+/* set once protecting an object failed; calls complete synchronously from then on */
+static bool unprotectable;
+
+static bool installed;
+static struct sigaction old_action;
+static uintptr_t page_size;
+
+static void lock_table(void) {
+    pthread_mutex_lock(&pending_lock);
+    while (__atomic_exchange_n(&table_busy, true, __ATOMIC_ACQUIRE))
+        sched_yield();
+    holds_lock = true;
+}
+
+static void unlock_table(void) {
+    while (num_dropped)
+        b2c_event_put(dropped[--num_dropped]);
+    holds_lock = false;
+    __atomic_store_n(&table_busy, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pending_lock);
+}
+
+static void event_drop(struct b2c_event *ev) {
+    if (in_fault)
+        dropped[num_dropped++] = ev;
+    else
+        b2c_event_put(ev);
+}
+
+static void obj_wait(const struct pending_obj *obj) {
+    for (unsigned i = 0; i < obj->num_events; i++)
+        b2c_event_wait(obj->events[i]);
+}
+
+/**
+ * Add the last call of this thread to the events of {@obj}, replacing the
+ * events of the calls it is ordered after.
+ */
+static void obj_add_last(struct pending_obj *obj) {
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < obj->num_events; i++) {
+        if (b2c_sched_after(obj->events[i]))
+            b2c_event_put(obj->events[i]);
+        else
+            obj->events[n++] = obj->events[i];
+    }
+
+    if (n == MAX_EVENTS) {
+        b2c_event_wait(obj->events[0]);
+        b2c_event_put(obj->events[0]);
+        memmove(&obj->events[0], &obj->events[1], --n * sizeof obj->events[0]);
+    }
+    obj->events[n++] = b2c_event_get(b2c_sched_last());
+    obj->num_events = n;
+}
+
+/**
+ * Protect the pages of {@obj}. If that fails, e.g. because the driver
+ * doesn't allow it on the memory it maps, host accesses can't be tracked
+ * and later calls complete synchronously.
+ * @return 0 on success, < 0 on error
+ */
+static int protect(const struct pending_obj *obj) {
+    if (mprotect((void *) obj->start, obj->end - obj->start,
+                obj->writes ? PROT_NONE : PROT_READ) < 0) {
+        __atomic_store_n(&unprotectable, true, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+static void drop_events(struct pending_obj *obj) {
+    for (unsigned e = 0; e < obj->num_events; e++)
+        event_drop(obj->events[e]);
+    obj->num_events = 0;
+}
+
+/**
+ * Restore the protection of the remaining objects that share pages with
+ * [start, end), after that range has been made accessible again.
+ * Writers are protected last, since they are the most restrictive.
+ * Objects that can't be protected again are waited for.
+ */
+static void reprotect(uintptr_t start, uintptr_t end) {
+    for (int writers = 0; writers <= 1; writers++)
+        for (unsigned i = 0; i < num_pending; i++)
+            if (pending[i].writes == writers && pending[i].start < end && start < pending[i].end
+                    && protect(&pending[i]) < 0) {
+                obj_wait(&pending[i]);
+                drop_events(&pending[i]);
+            }
+}
+
+/**
+ * Make the pages of the entry at {@i} accessible again, and remove it.
+ * Changing the protection of a range can fail (e.g. with ENOMEM, when it
+ * splits a mapping and the process has too many); the object is then
+ * waited for and stays in the table without events, to be retried later,
+ * and later calls complete synchronously like after protect() fails.
+ * @return 0 on success, < 0 on error
+ */
+static int remove_at(unsigned i) {
+    struct pending_obj obj = pending[i];
+
+    if (mprotect((void *) obj.start, obj.end - obj.start, PROT_READ | PROT_WRITE) < 0) {
+        const int err = errno;
+
+        obj_wait(&pending[i]);
+        drop_events(&pending[i]);
+        pending[i].held = false;
+        __atomic_store_n(&unprotectable, true, __ATOMIC_RELAXED);
+        if (!in_fault)
+            writef(STDERR_FILENO, "blas2cuda: failed to unprotect %p: %s. Synchronizing after every call.\n",
+                    obj.ptr, strerror(err));
+        return -1;
+    }
+    pending[i] = pending[--num_pending];
+    for (unsigned e = 0; e < obj.num_events; e++)
+        event_drop(obj.events[e]);
+    reprotect(obj.start, obj.end);
+    return 0;
+}
+
+/**
+ * Wait for and release all objects that have pages in [start, end).
+ * Objects that are still held by buffered calls stay protected.
+ * @return whether there were any, and the others could be made accessible
+ */
+static bool resolve_locked(uintptr_t start, uintptr_t end) {
+    bool found = false, stuck = false;
+
+    for (unsigned i = 0; i < num_pending; ) {
+        if (pending[i].start < end && start < pending[i].end) {
+            obj_wait(&pending[i]);
+            found = true;
+            if (pending[i].held) {
+                drop_events(&pending[i]);
+                i++;
+            } else if (remove_at(i) < 0) {
+                stuck = true;
+                i++;
+            }
+        } else
+            i++;
+    }
+
+    return found && !stuck;
+}
+
+static void synchronize_locked(void) {
+    b2c_sched_finish();
+    for (unsigned i = 0; i < num_pending; ) {
+        if (pending[i].held) {
+            drop_events(&pending[i]);
+            i++;
+        } else if (remove_at(i) < 0)
+            i++;
+    }
+}
+
+/**
+ * Find the entry of {@obj}, or add one. If the table is full, all calls
+ * are waited for first, unless {@may_wait} is false.
+ * @return the entry, or NULL if there is no room
+ */
+static struct pending_obj *entry_get_locked(const struct objinfo *obj, bool writes, bool may_wait) {
+    struct pending_obj *entry;
+
+    for (unsigned i = 0; i < num_pending; i++)
+        if (pending[i].ptr == obj->ptr) {
+            pending[i].writes |= writes;
+            return &pending[i];
+        }
+
+    if (num_pending == MAX_PENDING && may_wait)
+        synchronize_locked();
+    if (num_pending == MAX_PENDING)
+        return NULL;
+
+    entry = &pending[num_pending++];
+    entry->ptr = obj->ptr;
+    entry->start = (uintptr_t) obj->ptr & ~(page_size - 1);
+    entry->end = ((uintptr_t) obj->ptr + obj->size + page_size - 1) & ~(page_size - 1);
+    entry->writes = writes;
+    entry->num_events = 0;
+    entry->held = false;
+    return entry;
+}
+
+/*
+ * The handler interrupts whatever the faulting thread was doing. Accesses
+ * to pending objects come from the application, but a fault can also be
+ * raised while the thread is in the library (e.g. holding one of its
+ * locks), or in the handler itself. The handler never waits for a lock
+ * that the thread holds, and leaves such faults to the previous action
+ * instead of deadlocking.
+ *
+ * It only waits for events that have been recorded, and otherwise sticks
+ * to async-signal-safe functions: buffered calls are issued by another
+ * thread (see b2c_batch_flush_fault()), and the events it drops are
+ * released later. If the pages can't be made accessible, the access is
+ * left to the previous action as well.
+ */
+static void pending_fault(int sig, siginfo_t *info, void *ucontext) {
+    const uintptr_t page = (uintptr_t) info->si_addr & ~(page_size - 1);
+    bool resolved = false;
+
+    if (!holds_lock && !in_fault) {
+        in_fault = true;
+        /* buffered calls may use the object, so have them issued first */
+        if (b2c_batch_flush_fault()) {
+            while (__atomic_exchange_n(&table_busy, true, __ATOMIC_ACQUIRE))
+                poll(NULL, 0, 1);
+            holds_lock = true;
+            resolved = resolve_locked(page, page + page_size);
+            holds_lock = false;
+            __atomic_store_n(&table_busy, false, __ATOMIC_RELEASE);
+        }
+        in_fault = false;
+    }
+
+    if (resolved)
+        return;     /* retry the access */
+
+    if (old_action.sa_flags & SA_SIGINFO)
+        old_action.sa_sigaction(sig, info, ucontext);
+    else if (old_action.sa_handler != SIG_DFL && old_action.sa_handler != SIG_IGN)
+        old_action.sa_handler(sig);
+    else
+        /* the access faults again with the previous action */
+        sigaction(SIGSEGV, &old_action, NULL);
+}
+
+/**
+ * Whether managed memory can be protected. The drivers map it themselves,
+ * and some don't allow its protection to change.
+ */
+static bool can_protect(void) {
+    void *probe = NULL;
+    uintptr_t page;
+    int err = 0;
+
+    obj_tracker_internal_enter();
+    if (runtime_is_error(runtime_malloc_shared(&probe, 2 * page_size)) || !probe) {
+        obj_tracker_internal_leave();
+        errno = ENOMEM;
+        return false;
+    }
+    page = ((uintptr_t) probe + page_size - 1) & ~(page_size - 1);
+    if (mprotect((void *) page, page_size, PROT_READ) < 0
+            || mprotect((void *) page, page_size, PROT_READ | PROT_WRITE) < 0)
+        err = errno;
+    runtime_free(probe);
+    obj_tracker_internal_leave();
+    errno = err;
+    return !err;
+}
+
+int b2c_pending_init(void) {
+    struct sigaction action = { 0 };
+
+    page_size = sysconf(_SC_PAGESIZE);
+    if (!can_protect())
+        return -1;
+    action.sa_sigaction = pending_fault;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &old_action) < 0)
+        return -1;
+    installed = true;
+    return 0;
+}
+
+void b2c_pending_add(const struct objinfo *info, bool writes) {
+    const struct objinfo *obj = info->parent ? info->parent : info;
+    struct pending_obj *entry;
+
+    if (!installed || !obj->size || !b2c_sched_last())
+        return;
+
+    if (__atomic_load_n(&unprotectable, __ATOMIC_RELAXED)) {
+        /* can't track host accesses, so wait now */
+        b2c_event_wait(b2c_sched_last());
+        return;
+    }
+
+    lock_table();
+    if (!(entry = entry_get_locked(obj, writes, true))) {
+        /* all entries are held, so wait now */
+        b2c_event_wait(b2c_sched_last());
+        unlock_table();
+        return;
+    }
+    obj_add_last(entry);
+
+    if (protect(entry) < 0) {
+        /* can't track host accesses to this object, so wait now */
+        obj_wait(entry);
+        if (entry->held)
+            drop_events(entry);
+        else
+            remove_at(entry - pending);
+    } else if (!entry->writes)
+        reprotect(entry->start, entry->end);
+    unlock_table();
+}
+
+bool b2c_pending_hold(const struct objinfo *info, bool writes) {
+    const struct objinfo *obj = info->parent ? info->parent : info;
+    struct pending_obj *entry;
+    bool held = false;
+
+    if (!installed || !obj->size || __atomic_load_n(&unprotectable, __ATOMIC_RELAXED))
+        return false;
+
+    lock_table();
+    if ((entry = entry_get_locked(obj, writes, false))) {
+        if (protect(entry) < 0) {
+            if (!entry->held && !entry->num_events)
+                remove_at(entry - pending);
+        } else {
+            entry->held = held = true;
+            if (!entry->writes)
+                reprotect(entry->start, entry->end);
+        }
+    }
+    unlock_table();
+    return held;
+}
+
+void b2c_pending_unhold(void) {
+    lock_table();
+    for (unsigned i = 0; i < num_pending; ) {
+        if (pending[i].held && !pending[i].num_events) {
+            if (remove_at(i) < 0)
+                i++;
+        } else {
+            pending[i].held = false;
+            i++;
+        }
+    }
+    unlock_table();
+}
+
+void b2c_pending_wait(const void *ptr) {
+    if (!installed)
+        return;
+
+    b2c_batch_flush();
+    lock_table();
+    for (unsigned i = 0; i < num_pending; i++)
+        if (pending[i].ptr == ptr) {
+            resolve_locked(pending[i].start, pending[i].end);
+            break;
+        }
+    unlock_table();
+}
+
+void b2c_synchronize(void) {
+    b2c_batch_flush();
+    lock_table();
+    synchronize_locked();
+    unlock_table();
+}
+
+void b2c_pending_fork_prepare(void) {
+    b2c_batch_flush();
+    lock_table();
+    synchronize_locked();
+}
+
+void b2c_pending_fork_parent(void) {
+    unlock_table();
+}
+
+void b2c_pending_fork_child(void) {
+    /*
+     * The events of objects that are still held belong to streams that the
+     * child doesn't have, so drop the objects without waiting for them.
+     */
+    for (unsigned i = 0; i < num_pending; i++)
+        mprotect((void *) pending[i].start, pending[i].end - pending[i].start,
+                PROT_READ | PROT_WRITE);
+    num_pending = 0;
+    num_dropped = 0;
+    if (installed) {
+        sigaction(SIGSEGV, &old_action, NULL);
+        installed = false;
+    }
+    pthread_mutex_init(&pending_lock, NULL);
+    table_busy = false;
+    holds_lock = false;
+}
+
+void b2c_pending_fini(void) {
+    if (!installed)
+        return;
+
+    b2c_synchronize();
+    lock_table();
+    sigaction(SIGSEGV, &old_action, NULL);
+    installed = false;
+    unlock_table();
+}
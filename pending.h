@@ -0,0 +1,93 @@
+#ifndef PENDING_H
+#define PENDING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "runtime.h"
+#include "lib/obj_tracker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Completion tracking for managed objects.
+ *
+ * With the async option, and unless b2c_must_synchronize is set anyway,
+ * wrappers return as soon as their work is enqueued. Each managed object
+ * that was used by enqueued work keeps the completion events of those
+ * calls (see scheduler.h), and its pages are protected: objects that are
+ * written by the device can't be accessed by the host, and objects that
+ * are read by the device can't be written. When the host touches such a
+ * page, the fault handler waits for the events of the object, lifts the
+ * protection and resumes the faulting access.
+ *
+ * Protected pages are not accessible to system calls either (they fail
+ * with EFAULT), so programs that pass results straight to the kernel
+ * should call b2c_synchronize() first, or leave the async option off. The
+ * same goes for programs that pass them to the device runtime themselves,
+ * since the fault handler calls into it.
+ *
+ * If the pages of managed memory can't be protected, which is up to the
+ * driver that maps it, calls complete synchronously instead.
+ */
+
+/**
+ * Install the fault handler, if the pages of managed memory can be
+ * protected.
+ * @return 0 on success, < 0 on error (with errno set)
+ */
+int b2c_pending_init(void);
+
+/**
+ * Record that the last call issued by this thread uses the managed object
+ * {@info}, and writes to it if {@writes} is set.
+ */
+void b2c_pending_add(const struct objinfo *info, bool writes);
+
+/**
+ * Protect the managed object {@info} for a call that is buffered instead
+ * of issued (see batch.h), which writes to it if {@writes} is set. Until
+ * b2c_pending_unhold(), host accesses to the object flush buffered calls
+ * before waiting for them.
+ * @return whether the object is held; if not, the call must not be buffered
+ */
+bool b2c_pending_hold(const struct objinfo *info, bool writes);
+
+/**
+ * Release the objects held by buffered calls, once those calls have been
+ * issued and recorded with b2c_pending_add().
+ */
+void b2c_pending_unhold(void);
+
+/**
+ * Wait for the work that uses the managed object at {@ptr}, if any.
+ */
+void b2c_pending_wait(const void *ptr);
+
+/**
+ * Wait for all enqueued work. This is an explicit synchronization point
+ * that applications can call as well.
+ */
+void b2c_synchronize(void);
+
+/**
+ * Around fork(): wait for all enqueued work, and keep other threads from
+ * protecting more objects until the fork is done. In the child, which runs
+ * no work, objects that are still held are made accessible as they are
+ * and the fault handler is removed.
+ */
+void b2c_pending_fork_prepare(void);
+void b2c_pending_fork_parent(void);
+void b2c_pending_fork_child(void);
+
+/**
+ * Wait for all enqueued work and remove the fault handler.
+ */
+void b2c_pending_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,325 @@
+#define _GNU_SOURCE
+#include "replay.h"
+#include "batch.h"
+#include "pending.h"
+#include "callsite.h"
+#include "common.h"
+#include "lib/obj_tracker.h"
+#include <pthread.h>
+#include <string.h>
+
+#define MAX_PLANS   8
+#define MIN_SEEN    2       /* times a sequence is seen before it is captured */
+#define MAX_CUTS    2       /* times a plan is cut short before it is dropped */
+
+size_t b2c_replay_launches = 0;
+size_t b2c_replay_calls = 0;
+size_t b2c_replay_cut = 0;
+
+#if USE_CUDA
+struct plan {
+    uint64_t keys[B2C_REPLAY_MAX_CALLS];
+    unsigned num_keys;
+    unsigned seen;
+    unsigned cuts;
+    unsigned long used;         /* when it was last seen, for replacement */
+    cudaGraphExec_t exec;       /* from the last complete capture */
+};
+
+static struct plan plans[MAX_PLANS];
+static unsigned long tick;
+
+/* the plan being captured */
+static struct {
+    struct plan *plan;
+    unsigned pos;               /* calls captured so far */
+    pthread_t thread;
+    struct {
+        const struct objinfo *info;
+        bool writes;
+    } objs[B2C_MAX_OPERANDS];
+    unsigned num_objs;
+} rec;
+
+static cudaStream_t stream;
+static pthread_mutex_t replay_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the calls of this thread since the last one that couldn't be captured */
+static __thread struct {
+    uint64_t keys[B2C_REPLAY_MAX_CALLS];
+    unsigned num_keys;
+    bool overflow;
+} seq;
+
+static __thread bool flushing;
+
+static uint64_t call_key(const char *site, const struct b2c_sched_op *ops, unsigned num_ops) {
+    uint64_t key = b2c_shape_hash(B2C_SHAPE_HASH_INIT, (int64_t) (uintptr_t) site);
+
+    for (unsigned i = 0; i < num_ops; i++) {
+        key = b2c_shape_hash(key, (int64_t) ops[i].start);
+        key = b2c_shape_hash(key, (int64_t) ops[i].end);
+        key = b2c_shape_hash(key, ops[i].writes);
+    }
+    return key;
+}
+
+/**
+ * End the sequence of this thread. A sequence of two calls or more that
+ * has been seen before counts towards its plan; others get a plan of their
+ * own, replacing the one that was seen least recently.
+ */
+static void seq_end_locked(void) {
+    struct plan *plan = NULL, *victim = &plans[0];
+
+    if (seq.num_keys >= 2 && !seq.overflow) {
+        for (unsigned i = 0; i < MAX_PLANS && !plan; i++) {
+            if (plans[i].num_keys == seq.num_keys
+                    && !memcmp(plans[i].keys, seq.keys, seq.num_keys * sizeof seq.keys[0]))
+                plan = &plans[i];
+            else if (plans[i].used < victim->used)
+                victim = &plans[i];
+        }
+        if (!plan && victim != rec.plan) {
+            if (victim->exec)
+                cudaGraphExecDestroy(victim->exec);
+            memset(victim, 0, sizeof *victim);
+            memcpy(victim->keys, seq.keys, seq.num_keys * sizeof seq.keys[0]);
+            victim->num_keys = seq.num_keys;
+            plan = victim;
+        }
+        if (plan) {
+            plan->seen++;
+            plan->used = ++tick;
+        }
+    }
+    seq.num_keys = 0;
+    seq.overflow = false;
+}
+
+/**
+ * Add a call to the sequence of this thread. A call that starts the
+ * sequence again ends it.
+ */
+static void seq_add_locked(uint64_t key) {
+    if (seq.num_keys && key == seq.keys[0])
+        seq_end_locked();
+    if (seq.num_keys == B2C_REPLAY_MAX_CALLS)
+        seq.overflow = true;
+    else
+        seq.keys[seq.num_keys++] = key;
+}
+
+/**
+ * The most frequent plan that starts with {@key}, if it can be captured.
+ */
+static struct plan *plan_find_locked(uint64_t key) {
+    struct plan *best = NULL;
+
+    for (unsigned i = 0; i < MAX_PLANS; i++)
+        if (plans[i].num_keys && plans[i].keys[0] == key
+                && plans[i].seen >= MIN_SEEN && plans[i].cuts < MAX_CUTS
+                && (!best || plans[i].seen > best->seen))
+            best = &plans[i];
+    return best;
+}
+
+/**
+ * Add the objects that {@ops} are in to those of the plan being captured,
+ * and hold them.
+ * @return false if there are too many objects, or one can't be held
+ */
+static bool rec_add_locked(const struct b2c_sched_op *ops, unsigned num_ops) {
+    for (unsigned i = 0; i < num_ops; i++) {
+        const struct objinfo *info = obj_tracker_objinfo_subptr((void *) ops[i].start);
+        unsigned j = 0;
+
+        if (!info)
+            return false;
+        if (info->parent)
+            info = info->parent;
+        while (j < rec.num_objs && rec.objs[j].info != info)
+            j++;
+        if (j == B2C_MAX_OPERANDS || !b2c_pending_hold(info, ops[i].writes))
+            return false;
+        if (j == rec.num_objs) {
+            rec.objs[j].info = info;
+            rec.objs[j].writes = false;
+            rec.num_objs++;
+        }
+        rec.objs[j].writes |= ops[i].writes;
+    }
+    return true;
+}
+
+static bool exec_update(cudaGraphExec_t exec, cudaGraph_t graph) {
+#if CUDART_VERSION >= 12000
+    cudaGraphExecUpdateResultInfo info;
+
+    return cudaGraphExecUpdate(exec, graph, &info) == cudaSuccess;
+#else
+    cudaGraphNode_t node;
+    enum cudaGraphExecUpdateResult result;
+
+    return cudaGraphExecUpdate(exec, graph, &node, &result) == cudaSuccess;
+#endif
+}
+
+/**
+ * Launch the calls captured so far as a single call on the objects of the
+ * plan. Plans that are complete keep their executable graph for the next
+ * time.
+ */
+static size_t replay_flush(void) {
+    struct plan *plan;
+    cudaGraph_t graph = NULL;
+    cudaGraphExec_t exec;
+    bool complete;
+
+    pthread_mutex_lock(&replay_lock);
+    if (!(plan = rec.plan)) {
+        pthread_mutex_unlock(&replay_lock);
+        return 0;
+    }
+
+    runtime_fatal_errmsg(cudaStreamEndCapture(stream, &graph), __func__);
+    complete = rec.pos == plan->num_keys;
+    if (complete && plan->exec && exec_update(plan->exec, graph))
+        exec = plan->exec;
+    else {
+        /* a failed update leaves an error behind */
+        cudaGetLastError();
+        runtime_fatal_errmsg(cudaGraphInstantiateWithFlags(&exec, graph, 0), __func__);
+        if (complete) {
+            if (plan->exec)
+                cudaGraphExecDestroy(plan->exec);
+            plan->exec = exec;
+        }
+    }
+    cudaGraphDestroy(graph);
+
+    /* not to be captured itself */
+    flushing = true;
+    for (unsigned i = 0; i < rec.num_objs; i++)
+        b2c_sched_operand(rec.objs[i].info->ptr, rec.objs[i].info->size, rec.objs[i].writes);
+    call_kernel(runtime_fatal_errmsg(cudaGraphLaunch(exec, b2c_sched_stream()), __func__));
+    for (unsigned i = 0; i < rec.num_objs; i++)
+        b2c_pending_add(rec.objs[i].info, rec.objs[i].writes);
+    flushing = false;
+
+    if (complete) {
+        b2c_replay_launches++;
+        b2c_replay_calls += rec.pos;
+    } else {
+        /* freed once the launch completes */
+        cudaGraphExecDestroy(exec);
+        b2c_replay_cut++;
+        if (++plan->cuts == MAX_CUTS && plan->exec) {
+            cudaGraphExecDestroy(plan->exec);
+            plan->exec = NULL;
+        }
+    }
+    rec.plan = NULL;
+    rec.num_objs = 0;
+    pthread_mutex_unlock(&replay_lock);
+
+    /* these are not batched into one kernel */
+    return 0;
+}
+
+/**
+ * Start capturing {@plan} with the call being issued.
+ */
+static bool rec_start_locked(struct plan *plan, const struct b2c_sched_op *ops, unsigned num_ops) {
+    runtime_error_t err;
+    bool started = false;
+
+    /* the batch lock comes first; whoever has it may be issuing calls */
+    if (!b2c_batch_trylock())
+        return false;
+
+    rec.num_objs = 0;
+    if (!b2c_batch_buffered() && rec_add_locked(ops, num_ops)) {
+        if (!stream && runtime_is_error(err = cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking))) {
+            writef(STDERR_FILENO, "blas2cuda: failed to create capture stream: %s\n",
+                    runtime_error_string(err));
+            abort();
+        }
+        runtime_fatal_errmsg(cudaStreamBeginCapture(stream, cudaStreamCaptureModeRelaxed), __func__);
+        rec.plan = plan;
+        rec.pos = 1;
+        rec.thread = pthread_self();
+        b2c_batch_start(replay_flush);
+        started = true;
+    } else if (rec.num_objs) {
+        /* nothing else is buffered, so these are the only objects held */
+        b2c_pending_unhold();
+        rec.num_objs = 0;
+    }
+    b2c_batch_unlock();
+    return started;
+}
+
+bool b2c_replay_call(const char *site, const struct b2c_sched_op *ops, unsigned num_ops,
+        bool recordable) {
+    const uint64_t key = call_key(site, ops, num_ops);
+    struct plan *plan;
+
+    if (flushing)
+        return false;
+
+    pthread_mutex_lock(&replay_lock);
+    if (!recordable) {
+        /* if a plan is being captured, the scheduler launches it now */
+        seq_end_locked();
+        pthread_mutex_unlock(&replay_lock);
+        return false;
+    }
+    seq_add_locked(key);
+
+    if (rec.plan) {
+        if (pthread_equal(rec.thread, pthread_self())
+                && rec.pos < rec.plan->num_keys && rec.plan->keys[rec.pos] == key
+                && rec_add_locked(ops, num_ops)) {
+            rec.pos++;
+            return true;
+        }
+        /* cut short; the scheduler launches what was captured */
+        pthread_mutex_unlock(&replay_lock);
+        return false;
+    }
+
+    if ((plan = plan_find_locked(key)) && rec_start_locked(plan, ops, num_ops))
+        return true;
+    pthread_mutex_unlock(&replay_lock);
+    return false;
+}
+
+cudaStream_t b2c_replay_stream(void) {
+    return stream;
+}
+
+void b2c_replay_end(void) {
+    const bool complete = rec.pos == rec.plan->num_keys;
+
+    pthread_mutex_unlock(&replay_lock);
+    if (complete)
+        b2c_batch_flush();
+}
+#endif
+
+void b2c_replay_fini(void) {
+#if USE_CUDA
+    pthread_mutex_lock(&replay_lock);
+    for (unsigned i = 0; i < MAX_PLANS; i++)
+        if (plans[i].exec) {
+            cudaGraphExecDestroy(plans[i].exec);
+            plans[i].exec = NULL;
+        }
+    if (stream) {
+        cudaStreamDestroy(stream);
+        stream = NULL;
+    }
+    pthread_mutex_unlock(&replay_lock);
+#endif
+}
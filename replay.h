@@ -0,0 +1,79 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "runtime.h"
+#include "scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Replay plans for repeated sequences of calls (CUDA only).
+ *
+ * Timestep loops issue the same calls on the same operands every
+ * iteration. Each call is identified by a key, a hash of the routine that
+ * issues it and of the ranges it uses. A sequence of keys that is seen
+ * twice in a row, without calls that can't be recorded in between, becomes
+ * a plan. The next time its first call comes along, the calls of the plan
+ * are captured into a CUDA graph on a stream of their own instead of being
+ * issued, and the graph is launched as a single call once the last of them
+ * has been captured. Later iterations are captured again and applied to
+ * the same executable graph with cudaGraphExecUpdate(), which picks up
+ * changed scalars, so the calls of a plan cost one launch per iteration.
+ *
+ * Captured calls are buffered calls (see batch.h): their objects are held,
+ * and a host access to one of them, b2c_synchronize(), or a call that
+ * doesn't follow the plan launches what has been captured so far. A plan
+ * that is cut short twice is not used again.
+ *
+ * Calls that use temporary device memory, or write to result slots (see
+ * scalars.h), can't be captured; they end sequences.
+ */
+
+/* calls per plan */
+#define B2C_REPLAY_MAX_CALLS    64
+
+/** executable graphs launched for complete plans, and the calls in them */
+extern size_t b2c_replay_launches, b2c_replay_calls;
+
+/** plans that were cut short */
+extern size_t b2c_replay_cut;
+
+#if USE_CUDA
+/**
+ * Called by the scheduler for the next call of this thread, issued by
+ * {@site} on the {@num_ops} ranges in {@ops}. {@recordable} is false if
+ * the call can't be captured.
+ * @return whether the call is to be captured on b2c_replay_stream(); if
+ * so, the plan is held until b2c_replay_end()
+ */
+bool b2c_replay_call(const char *site, const struct b2c_sched_op *ops, unsigned num_ops,
+        bool recordable);
+
+/**
+ * The stream that captured calls are issued on.
+ */
+cudaStream_t b2c_replay_stream(void);
+
+/**
+ * Called by the scheduler once a call has been captured. Launches the plan
+ * if that was its last call.
+ */
+void b2c_replay_end(void);
+#endif
+
+/**
+ * Destroy plans and the capture stream. Captured calls must have been
+ * launched.
+ */
+void b2c_replay_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
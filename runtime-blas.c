@@ -11,12 +11,16 @@
 
 
 #if USE_CUDA
-cublasHandle_t b2c_cublas_handle;
+/* the handle of the first thread that issues calls */
+cublasHandle_t b2c_main_handle;
+
+/* the handle of the call being issued by this thread (see scheduler.h) */
+__thread cublasHandle_t b2c_cublas_handle;
 #endif
 
 runtime_blas_error_t runtime_blas_init(void) {
 #if USE_CUDA
-    return cublasCreate(&b2c_cublas_handle);
+    return cublasCreate(&b2c_main_handle);
 #else
     return clblasSetup();
 #endif
@@ -24,7 +28,7 @@ runtime_blas_error_t runtime_blas_init(void) {
 
 runtime_blas_error_t runtime_blas_fini(void) {
 #if USE_CUDA
-    return cublasDestroy(b2c_cublas_handle);
+    return cublasDestroy(b2c_main_handle);
 #else
     clblasTeardown();
     return CL_SUCCESS;
@@ -57,8 +61,12 @@ int runtime_blas_lsame(const char *side_p, const char *ch_p) {
     return lsame_(side_p, ch_p);
 }
 
+void *runtime_blas_find(const char *name) {
+    return dlsym(RTLD_NEXT, name);
+}
+
 void *runtime_blas_func(const char *name) {
-    void *fptr = dlsym(RTLD_NEXT, name);
+    void *fptr = runtime_blas_find(name);
 
     if (fptr == NULL) {
         writef(STDERR_FILENO, "blas2cuda: failed to lookup '%s': %s\n", name, dlerror());
@@ -82,8 +82,32 @@ int runtime_blas_lsame(const char *side_p, const char *ch_p);
 
 void *runtime_blas_func(const char *name);
 
+void *runtime_blas_find(const char *name);
+
 #ifdef __cplusplus
 };
 #endif
 
+/**
+ * The routine {@fname} in the next BLAS library. The lookup is only done
+ * on the first use, so this can be used on hot paths.
+ */
+#define runtime_blas_next(fname) ({\
+    static typeof(fname) *next_##fname;\
+    if (!next_##fname)\
+        next_##fname = (typeof(fname) *) runtime_blas_func(#fname);\
+    next_##fname;\
+})
+
+/**
+ * Like runtime_blas_next(), but {@fallback} if the next BLAS library has no
+ * {@fname}, for extensions that not every library has.
+ */
+#define runtime_blas_next_or(fname, fallback) ({\
+    static typeof(fname) *next_##fname;\
+    if (!next_##fname && !(next_##fname = (typeof(fname) *) runtime_blas_find(#fname)))\
+        next_##fname = (fallback);\
+    next_##fname;\
+})
+
 #endif
@@ -1,8 +1,13 @@
 #pragma once
 #include "runtime.h"
+#include "runtime-blas.h"
 #include "common.h"
+#include "blas2cuda.h"
+#include "scalars.h"
+#include "pending.h"
+#include "scheduler.h"
+#include "svm.h"
 #include "lib/obj_tracker.h"
-#include <assert.h>
 #include <type_traits>
 #include <iostream>
 
@@ -13,6 +18,33 @@ extern cl_command_queue opencl_cmd_queue;
 extern cl_context opencl_ctx;
 #endif
 
+#if USE_OPENCL
+/**
+ * The buffer that wraps the managed object {@obj}, backed by its SVM.
+ * It is created on first use and kept with the object's info, so that
+ * calls don't create and release a buffer for each operand; the object
+ * manager releases it when the object is freed (see blas2cuda.c).
+ */
+static inline cl_mem b2c_object_buffer(const struct objinfo *obj) {
+    cl_mem buffer = (cl_mem) __atomic_load_n(&obj->data, __ATOMIC_ACQUIRE);
+    cl_mem attached;
+    runtime_error_t err;
+
+    if (buffer)
+        return buffer;
+    buffer = clCreateBuffer(opencl_ctx, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, obj->size, obj->ptr, &err);
+    if (runtime_is_error(err)) {
+        writef(STDERR_FILENO, "blas2cuda: failed to create a buffer backed by %p: %s\n",
+                obj->ptr, runtime_error_string(err));
+        abort();
+    }
+    // another thread may have been first
+    if ((attached = (cl_mem) obj_tracker_attach(obj, buffer)) != buffer)
+        clReleaseMemObject(buffer);
+    return attached;
+}
+#endif
+
 /**
  * RAII for GPU buffers.
  */
@@ -25,6 +57,8 @@ private:
     T *gpu_ptr;
 #else
     cl_mem gpu_ptr;
+    size_t off = 0;     // of host_ptr in gpu_ptr, in elements of T
+    bool own_buffer = false;    // created for this call alone
 #endif
     bool grabbed;
 public:
@@ -38,8 +72,11 @@ public:
         runtime_error_t err;
         objtracker_guard guard;
 
+        b2c_runtime_ensure();
         if (size == 0) {
             size_t dummy_size = 32 * sizeof *host_ptr;  /* just pick some arbitrary size */
+
+            b2c_sched_private();
 #if USE_CUDA
             err = runtime_malloc((void **)&this->gpu_ptr, dummy_size);
 #elif USE_OPENCL
@@ -55,6 +92,7 @@ public:
 
         if (!host_ptr) {
             // host_ptr is NULL, so create a brand new buffer
+            b2c_sched_private();
 #if USE_CUDA
             err = runtime_malloc((void **)&this->gpu_ptr, size);
 #else
@@ -71,18 +109,36 @@ public:
 #if USE_CUDA
             this->gpu_ptr = host_ptr;
 #else
-            // create a buffer that is backed by SVM
-            assert(this->o_info->ptr == host_ptr && "cannot create CL buffer within CL buffer");
-            this->gpu_ptr = clCreateBuffer(opencl_ctx, this->get_mem_flags() | CL_MEM_USE_HOST_PTR, size, (void *)host_ptr, &err);
-            if (runtime_is_error(err)) {
-                writef(STDERR_FILENO, "blas2cuda: failed to create a buffer backed by %p: %s\n",
-                        host_ptr, runtime_error_string(err));
-                abort();
+            // use the buffer that wraps the whole object, and pass interior
+            // pointers as an offset into it
+            const struct objinfo *obj = this->o_info->parent ? this->o_info->parent : this->o_info;
+            size_t skip = (const char *)host_ptr - (const char *)obj->ptr;
+
+            this->off = skip / sizeof *host_ptr;
+            if (skip % sizeof *host_ptr == 0)
+                this->gpu_ptr = b2c_object_buffer(obj);
+            else {
+                // not a whole number of elements into the object
+                const char *start = (const char *)obj->ptr + skip % sizeof *host_ptr;
+
+                this->gpu_ptr = clCreateBuffer(opencl_ctx, this->get_mem_flags() | CL_MEM_USE_HOST_PTR,
+                        (const char *)host_ptr + size - start, (void *)start, &err);
+                if (runtime_is_error(err)) {
+                    writef(STDERR_FILENO, "blas2cuda: failed to create a buffer backed by %p: %s\n",
+                            host_ptr, runtime_error_string(err));
+                    abort();
+                }
+                this->own_buffer = true;
             }
+            // the device can only use coarse-grained SVM while it is unmapped
+            b2c_svm_unmap(host_ptr, size);
 #endif
+            // calls that use the same object are ordered by the scheduler
+            b2c_sched_operand(host_ptr, size, !is_const);
             b2c_hits++;
         } else {
             // copy host_ptr contents over to GPU
+            b2c_sched_private();
 #if USE_CUDA
             err = runtime_malloc((void **)&this->gpu_ptr, size);
 #else
@@ -115,14 +171,16 @@ public:
 
 private:
     void cleanup_unmanaged() {
-        if (!is_const) {
+        if constexpr (!is_const) {
             runtime_error_t err;
 
             // copy the GPU buffer back to host
-            if (this->grabbed) {
+            if (this->grabbed && this->host_ptr) {
     #if USE_CUDA
                 err = runtime_memcpy_dtoh(this->host_ptr, this->gpu_ptr, this->size);
     #else
+                // the call may be on another queue
+                b2c_sched_wait_last();
                 err = clEnqueueReadBuffer(opencl_cmd_queue, this->gpu_ptr, CL_TRUE, 0, this->size, (void *) this->host_ptr, 0, NULL, NULL);
     #endif
                 if (runtime_is_error(err)) {
@@ -153,9 +211,18 @@ public:
                         this->gpu_ptr, runtime_error_string(err));
                 abort();
             }
-        } else
-            // this is a managed object, so all we have to do is map it again
-            err = runtime_svm_map((void *)this->host_ptr, this->o_info->size);
+        } else {
+            // this is a managed object, so all we have to do is map what the call used
+            b2c_svm_map(this->host_ptr, this->size);
+#if USE_OPENCL
+            if (this->own_buffer)
+                err = clReleaseMemObject(this->gpu_ptr);
+#endif
+            // and have the host wait for the kernel when it touches the object
+            // (replay plans hold the objects of captured calls themselves)
+            if (this->grabbed && !b2c_must_synchronize && !b2c_sched_recorded())
+                b2c_pending_add(this->o_info, !is_const);
+        }
 
         if (runtime_is_error(err)) {
             writef(STDERR_FILENO, "blas2cuda: %s: failed to cleanup %p: %s\n", __func__,
@@ -173,4 +240,152 @@ public:
         this->grabbed = true;
         return this->gpu_ptr;
     }
+
+#if USE_OPENCL
+    /**
+     * Offset of {@host_ptr} in the buffer, in elements of T.
+     */
+    size_t offset() {
+        return this->off;
+    }
+#endif
 };
+
+/**
+ * RAII for the scalar result of a reduction.
+ * By default the result is written to {@host_ptr} by the time this goes out
+ * of scope. With the device_scalars option, or for deferred reductions, it
+ * is written to a device-side slot instead (see scalars.h), so that it can
+ * be copied back together with other results. Deferred results are left
+ * pending; others are flushed, along with any pending results, when this
+ * goes out of scope.
+ */
+template <typename S>
+class devscalar {
+private:
+    S *host_ptr;
+    bool deferred;
+    bool in_slot;
+    int slot;
+#if USE_OPENCL
+    cl_mem buffer;
+#endif
+public:
+    devscalar(S *host_ptr, bool deferred) : host_ptr(host_ptr), deferred(deferred),
+        in_slot(deferred || b2c_options.device_scalars), slot(-1) {
+        // the result is copied back by the host
+        b2c_runtime_ensure();
+        b2c_sched_private();
+        if (in_slot) {
+            pthread_mutex_lock(&b2c_scalars_lock);
+            slot = b2c_scalar_reserve(host_ptr, sizeof *host_ptr);
+        }
+#if USE_OPENCL
+        else {
+            runtime_error_t err;
+
+            this->buffer = clCreateBuffer(opencl_ctx, CL_MEM_WRITE_ONLY, sizeof *host_ptr, NULL, &err);
+            if (runtime_is_error(err)) {
+                writef(STDERR_FILENO, "blas2cuda: failed to allocate %zu B on device: %s\n",
+                        sizeof *host_ptr, runtime_error_string(err));
+                abort();
+            }
+        }
+#endif
+    }
+
+    ~devscalar() {
+        if (in_slot) {
+            if (!deferred)
+                b2c_scalars_flush();
+            pthread_mutex_unlock(&b2c_scalars_lock);
+        }
+#if USE_OPENCL
+        else {
+            runtime_error_t err;
+
+            b2c_sched_wait_last();
+            err = clEnqueueReadBuffer(opencl_cmd_queue, this->buffer, CL_TRUE, 0, sizeof *host_ptr, (void *) host_ptr, 0, NULL, NULL);
+            if (runtime_is_error(err)) {
+                writef(STDERR_FILENO, "blas2cuda: failed to copy %zu B from %p (GPU) ---> %p (CPU): %s\n",
+                        sizeof *host_ptr, this->buffer, host_ptr, runtime_error_string(err));
+                abort();
+            }
+            clReleaseMemObject(this->buffer);
+        }
+#endif
+    }
+
+#if USE_CUDA
+    /**
+     * The handle to run the reduction with. The result pointer is
+     * interpreted according to its pointer mode.
+     */
+    cublasHandle_t handle() {
+        extern __thread cublasHandle_t b2c_cublas_handle;
+        return in_slot ? b2c_scalar_handle() : b2c_cublas_handle;
+    }
+
+    operator S*() {
+        return in_slot ? (S *) b2c_scalar_devptr(slot) : host_ptr;
+    }
+#else
+    operator cl_mem() {
+        return in_slot ? b2c_scalar_buffer() : this->buffer;
+    }
+
+    /**
+     * Offset of the result in the buffer, in elements of S.
+     */
+    size_t offset() {
+        return in_slot ? b2c_scalar_offset(slot, sizeof(S)) : 0;
+    }
+#endif
+};
+
+/**
+ * Whether all of {@ptrs} are in memory shared with the device.
+ */
+template <typename... Ptrs>
+static inline bool b2c_resident(Ptrs... ptrs) {
+    objtracker_guard guard;
+    if (__atomic_load_n(&b2c_passthrough, __ATOMIC_ACQUIRE))
+        return false;
+    return (... && obj_tracker_objinfo_subptr((void *) ptrs));
+}
+
+/**
+ * Level 1 and 2 routines do as much work as there is data to move, so they
+ * are only run on the device when all of their {@operands} (a parenthesized
+ * list) are already shared with it. Otherwise, or if {@cond} does not hold
+ * (invalid arguments, quick returns, negative strides), the call is
+ * forwarded to {@fname} in the next BLAS library with the remaining
+ * arguments.
+ */
+#ifndef USE_GPU_ALWAYS
+#define resident_or_forward(fname, cond, operands, ...)\
+    if (!(cond) || !b2c_resident operands)\
+        return runtime_blas_next(fname)(__VA_ARGS__);
+#else
+#define resident_or_forward(fname, cond, operands, ...)\
+    if (!(cond) || !b2c_device_usable())\
+        return runtime_blas_next(fname)(__VA_ARGS__);
+#endif
+
+/**
+ * Like resident_or_forward(), for deferred reductions, which return their
+ * result through {@result} instead.
+ */
+#ifndef USE_GPU_ALWAYS
+#define resident_or_compute(fname, result, cond, operands, ...)\
+    if (!(cond) || !b2c_resident operands) {\
+        *(result) = runtime_blas_next(fname)(__VA_ARGS__);\
+        return;\
+    }
+#else
+#define resident_or_compute(fname, result, cond, operands, ...)\
+    if (!(cond) || !b2c_device_usable()) {\
+        *(result) = runtime_blas_next(fname)(__VA_ARGS__);\
+        return;\
+    }
+#endif
@@ -2,18 +2,35 @@
 #include "common.h"
 #include <stdbool.h>
 
+#if USE_CUDA
+#include "backend.h"
+#endif
+
 #if USE_OPENCL
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "clext.h"
 
 cl_context opencl_ctx;
 cl_command_queue opencl_cmd_queue;
 bool opencl_finegrained;
+cl_device_type opencl_device_type;
 
 struct opencl_device {
     cl_device_id id;
     char *name;
+    char *driver_version;
     cl_device_type type;
     cl_device_svm_capabilities svm_capabilities;
+    cl_ulong global_mem_size;
+    cl_uint compute_units;
+    double score;               /* see opencl_probe_device() */
     bool is_valid;
 };
 
@@ -84,7 +101,30 @@ struct opencl_platform *runtime_get_platforms(cl_int *err_in, cl_uint *nplatform
                             NULL)) != CL_SUCCESS)
                 continue;
 
+            if ((*err_in = clGetDeviceInfo(device_ids[d], CL_DRIVER_VERSION, 0, NULL, &device_name_sz)) != CL_SUCCESS)
+                continue;
+            curr_device->driver_version = calloc(1, device_name_sz);
+            if ((*err_in = clGetDeviceInfo(device_ids[d], CL_DRIVER_VERSION,
+                            device_name_sz,
+                            curr_device->driver_version,
+                            NULL)) != CL_SUCCESS)
+                continue;
+
+            if ((*err_in = clGetDeviceInfo(device_ids[d], CL_DEVICE_GLOBAL_MEM_SIZE,
+                            sizeof curr_device->global_mem_size,
+                            &curr_device->global_mem_size,
+                            NULL)) != CL_SUCCESS)
+                continue;
+
+            if ((*err_in = clGetDeviceInfo(device_ids[d], CL_DEVICE_MAX_COMPUTE_UNITS,
+                            sizeof curr_device->compute_units,
+                            &curr_device->compute_units,
+                            NULL)) != CL_SUCCESS)
+                continue;
+
             writef(STDOUT_FILENO, "  Device [%u] = %s (%s)\n", d, curr_device->name, clDeviceTypeGetString(curr_device->type));
+            writef(STDOUT_FILENO, "   %u compute units, %lu MiB of global memory\n",
+                    curr_device->compute_units, (unsigned long) (curr_device->global_mem_size >> 20));
             writef(STDOUT_FILENO, "   SVM capabilities:\n");
 
             if ((*err_in = clGetDeviceInfo(device_ids[d], CL_DEVICE_SVM_CAPABILITIES, 
@@ -115,16 +155,340 @@ end:
 }
 
 void opencl_platform_cleanup(struct opencl_platform platform) {
-    for (cl_uint d = 0; platform.devices && d < platform.num_devices; d++)
+    for (cl_uint d = 0; platform.devices && d < platform.num_devices; d++) {
         free(platform.devices[d].name);
+        free(platform.devices[d].driver_version);
+    }
     free(platform.devices);
     free(platform.name);
 }
 
+/* device ranking */
+
+struct opencl_candidate {
+    struct opencl_platform *platform;
+    struct opencl_device *device;
+    cl_uint p, d;
+    bool scored;
+};
+
+static const char opencl_probe_source[] =
+    "__kernel void probe_gemm(const int n, __global const float *a,\n"
+    "        __global const float *b, __global float *c) {\n"
+    "    const int i = get_global_id(0), j = get_global_id(1);\n"
+    "    float sum = 0;\n"
+    "    for (int l = 0; l < n; l++)\n"
+    "        sum += a[i + l * n] * b[l + j * n];\n"
+    "    c[i + j * n] = sum;\n"
+    "}\n";
+
+#define PROBE_GEMM_N        256
+#define PROBE_COPY_SIZE     (16 << 20)
+#define PROBE_OFFLOAD_N     512.0
+
+static double elapsed_ns(const struct timespec *start) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Time a naive gemm of order PROBE_GEMM_N and a copy of PROBE_COPY_SIZE
+ * bytes to {@device}. The score is the number of gemm calls of order
+ * PROBE_OFFLOAD_N, copying their three operands, that the device would
+ * run per second, which weighs its throughput against its link. Returns 0
+ * if the probe fails.
+ */
+static double opencl_probe_device(cl_platform_id platform, struct opencl_device *device)
+{
+    cl_int err;
+    cl_context ctx = NULL;
+    cl_command_queue queue = NULL;
+    cl_program program = NULL;
+    cl_kernel kernel = NULL;
+    cl_mem bufs[3] = { NULL, NULL, NULL };
+    cl_mem copy_buf = NULL;
+    void *host_buf = NULL;
+    const cl_int n = PROBE_GEMM_N;
+    const size_t global[2] = { PROBE_GEMM_N, PROBE_GEMM_N };
+    const char *source = opencl_probe_source;
+    struct timespec start;
+    double copy_ns = 0, gemm_ns = 0;
+    double score = 0;
+
+    ctx = clCreateContext(
+            (cl_context_properties[]){
+                CL_CONTEXT_PLATFORM,
+                (cl_context_properties) platform,
+                0
+            }, 1,
+            &device->id, NULL,
+            NULL, &err);
+    if (runtime_is_error(err))
+        goto end;
+    queue = clCreateCommandQueueWithProperties(ctx, device->id, (cl_queue_properties[]) { 0 }, &err);
+    if (runtime_is_error(err))
+        goto end;
+    program = clCreateProgramWithSource(ctx, 1, &source, NULL, &err);
+    if (runtime_is_error(err)
+            || runtime_is_error(err = clBuildProgram(program, 1, &device->id, NULL, NULL, NULL)))
+        goto end;
+    kernel = clCreateKernel(program, "probe_gemm", &err);
+    if (runtime_is_error(err))
+        goto end;
+
+    if (!(host_buf = calloc(1, PROBE_COPY_SIZE))) {
+        err = CL_OUT_OF_HOST_MEMORY;
+        goto end;
+    }
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                PROBE_GEMM_N * PROBE_GEMM_N * sizeof(float), host_buf, &err);
+        if (runtime_is_error(err)
+                || runtime_is_error(err = clSetKernelArg(kernel, i + 1, sizeof bufs[i], &bufs[i])))
+            goto end;
+    }
+    if (runtime_is_error(err = clSetKernelArg(kernel, 0, sizeof n, &n)))
+        goto end;
+    copy_buf = clCreateBuffer(ctx, CL_MEM_READ_WRITE, PROBE_COPY_SIZE, NULL, &err);
+    if (runtime_is_error(err))
+        goto end;
+
+    /* the first round pays for one-time costs */
+    for (int round = 0; round < 2; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (runtime_is_error(err = clEnqueueWriteBuffer(queue, copy_buf, CL_TRUE,
+                        0, PROBE_COPY_SIZE, host_buf, 0, NULL, NULL)))
+            goto end;
+        copy_ns = elapsed_ns(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (runtime_is_error(err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL))
+                || runtime_is_error(err = clFinish(queue)))
+            goto end;
+        gemm_ns = elapsed_ns(&start);
+    }
+
+    /* 1 GB/s is 1 byte/ns, and 1 GFLOP/s is 1 flop/ns */
+    const double bandwidth = PROBE_COPY_SIZE / copy_ns;
+    const double gflops = 2.0 * PROBE_GEMM_N * PROBE_GEMM_N * PROBE_GEMM_N / gemm_ns;
+    const double offload_ns = 2 * PROBE_OFFLOAD_N * PROBE_OFFLOAD_N * PROBE_OFFLOAD_N / gflops
+        + 3 * PROBE_OFFLOAD_N * PROBE_OFFLOAD_N * sizeof(float) / bandwidth;
+
+    score = 1e9 / offload_ns;
+    writef(STDOUT_FILENO, "blas2cuda: probed %s: %.1f GFLOP/s, %.1f GB/s\n",
+            device->name, gflops, bandwidth);
+
+end:
+    if (runtime_is_error(err))
+        writef(STDERR_FILENO, "blas2cuda: %s: failed to probe %s - %s\n",
+                __func__, device->name, runtime_error_string(err));
+    free(host_buf);
+    if (copy_buf)
+        clReleaseMemObject(copy_buf);
+    for (int i = 0; i < 3; i++)
+        if (bufs[i])
+            clReleaseMemObject(bufs[i]);
+    if (kernel)
+        clReleaseKernel(kernel);
+    if (program)
+        clReleaseProgram(program);
+    if (queue)
+        clReleaseCommandQueue(queue);
+    if (ctx)
+        clReleaseContext(ctx);
+    return score;
+}
+
+bool runtime_cache_dir(char *dir, size_t size, bool create)
+{
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (cache_home && *cache_home) {
+        if (snprintf(dir, size, "%s", cache_home) >= (int) size)
+            return false;
+    } else if (home && *home) {
+        if (snprintf(dir, size, "%s/.cache", home) >= (int) size)
+            return false;
+    } else
+        return false;
+
+    if (create && mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return false;
+    if (strlen(dir) + sizeof "/blas2cuda" > size)
+        return false;
+    strcat(dir, "/blas2cuda");
+    if (create && mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return false;
+    return true;
+}
+
+/**
+ * The file that caches the scores of the devices of this machine. Home
+ * directories are often shared by the nodes of a cluster, so its name
+ * includes the host name.
+ */
+static bool opencl_rank_cache_path(char *path, size_t size, bool create)
+{
+    char dir[PATH_MAX];
+    char host[256];
+
+    if (gethostname(host, sizeof host) < 0)
+        return false;
+    host[sizeof host - 1] = '\0';
+
+    if (!runtime_cache_dir(dir, sizeof dir, create))
+        return false;
+
+    return snprintf(path, size, "%s/opencl-devices-%s", dir, host) < (int) size;
+}
+
+/*
+ * Each line of the cache is:
+ *   <score> TAB <platform> TAB <device> TAB <driver version>
+ */
+static void opencl_rank_cache_load(struct opencl_candidate *candidates, size_t num_candidates)
+{
+    char path[PATH_MAX];
+    char *line = NULL;
+    size_t line_size = 0;
+    FILE *file;
+
+    if (!opencl_rank_cache_path(path, sizeof path, false) || !(file = fopen(path, "r")))
+        return;
+
+    while (getline(&line, &line_size, file) > 0) {
+        char *saveptr = NULL;
+        char *score = strtok_r(line, "\t\n", &saveptr);
+        char *platform = strtok_r(NULL, "\t\n", &saveptr);
+        char *device = strtok_r(NULL, "\t\n", &saveptr);
+        char *driver_version = strtok_r(NULL, "\t\n", &saveptr);
+
+        if (!driver_version)
+            continue;
+        for (size_t i = 0; i < num_candidates; i++) {
+            struct opencl_candidate *c = &candidates[i];
+
+            if (!c->scored && strcmp(platform, c->platform->name) == 0
+                    && strcmp(device, c->device->name) == 0
+                    && strcmp(driver_version, c->device->driver_version) == 0) {
+                c->device->score = strtod(score, NULL);
+                c->scored = true;
+                break;
+            }
+        }
+    }
+    free(line);
+    fclose(file);
+}
+
+static void opencl_rank_cache_save(const struct opencl_candidate *candidates, size_t num_candidates)
+{
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 32];
+    int fd;
+
+    if (!opencl_rank_cache_path(path, sizeof path, true)) {
+        writef(STDERR_FILENO, "blas2cuda: %s: no place for the device cache\n", __func__);
+        return;
+    }
+    /* other processes may be reading it */
+    snprintf(tmp_path, sizeof tmp_path, "%s.%d", path, (int) getpid());
+    if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        writef(STDERR_FILENO, "blas2cuda: %s: failed to write the device cache: %s\n", __func__, strerror(errno));
+        return;
+    }
+    for (size_t i = 0; i < num_candidates; i++)
+        writef(fd, "%g\t%s\t%s\t%s\n", candidates[i].device->score,
+                candidates[i].platform->name, candidates[i].device->name,
+                candidates[i].device->driver_version);
+    close(fd);
+    if (rename(tmp_path, path) < 0) {
+        writef(STDERR_FILENO, "blas2cuda: %s: failed to write the device cache: %s\n", __func__, strerror(errno));
+        unlink(tmp_path);
+    }
+}
+
+static int opencl_candidate_compare(const void *p1, const void *p2) {
+    const struct opencl_candidate *c1 = p1;
+    const struct opencl_candidate *c2 = p2;
+    const cl_device_svm_capabilities svm = CL_DEVICE_SVM_COARSE_GRAIN_BUFFER | CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+    const bool has_svm1 = c1->device->svm_capabilities & svm;
+    const bool has_svm2 = c2->device->svm_capabilities & svm;
+    const bool fine1 = c1->device->svm_capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+    const bool fine2 = c2->device->svm_capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+
+    if (has_svm1 != has_svm2)
+        return has_svm2 - has_svm1;
+    if (c1->device->score != c2->device->score)
+        return c2->device->score > c1->device->score ? 1 : -1;
+    if (fine1 != fine2)
+        return fine2 - fine1;
+    if (c1->device->compute_units != c2->device->compute_units)
+        return c2->device->compute_units > c1->device->compute_units ? 1 : -1;
+    if (c1->device->global_mem_size != c2->device->global_mem_size)
+        return c2->device->global_mem_size > c1->device->global_mem_size ? 1 : -1;
+    return c1->p != c2->p ? (c1->p > c2->p ? 1 : -1) : (c1->d > c2->d ? 1 : -1);
+}
+
+/**
+ * Sort the devices, best first. Managed objects live in SVM, so devices
+ * without it come last; then come the score of a probe (see
+ * opencl_probe_device()), fine-grained SVM (which lets calls overlap with
+ * the host), compute units and global memory. Scores are cached on disk,
+ * and devices are only probed the first time they are seen (or after a
+ * driver update).
+ */
+static void opencl_rank_devices(struct opencl_candidate *candidates, size_t num_candidates)
+{
+    bool probed = false;
+
+    opencl_rank_cache_load(candidates, num_candidates);
+    for (size_t i = 0; i < num_candidates; i++)
+        if (!candidates[i].scored) {
+            candidates[i].device->score = opencl_probe_device(candidates[i].platform->id, candidates[i].device);
+            candidates[i].scored = true;
+            probed = true;
+        }
+    if (probed)
+        opencl_rank_cache_save(candidates, num_candidates);
+
+    qsort(candidates, num_candidates, sizeof *candidates, opencl_candidate_compare);
+}
+
+/**
+ * The device named by {@spec}: "<platform>:<device>" (indices), or a part
+ * of a device name.
+ */
+static struct opencl_candidate *opencl_find_device(struct opencl_candidate *candidates,
+        size_t num_candidates, const char *spec)
+{
+    unsigned p, d;
+    int len = 0;
+
+    if (sscanf(spec, "%u:%u%n", &p, &d, &len) == 2 && spec[len] == '\0') {
+        for (size_t i = 0; i < num_candidates; i++)
+            if (candidates[i].p == p && candidates[i].d == d)
+                return &candidates[i];
+        return NULL;
+    }
+    for (size_t i = 0; i < num_candidates; i++)
+        if (strstr(candidates[i].device->name, spec))
+            return &candidates[i];
+    return NULL;
+}
+
 #endif /* USE_OPENCL */
 
 runtime_error_t runtime_init(runtime_init_info_t info) {
 #if USE_CUDA
+    if (!runtime_backend_load(info.backend))
+        return cudaErrorNoDevice;
+#if USE_HOST
+    host_link_configure(info.link_bandwidth, info.link_latency);
+#endif
     return cudaSuccess;
 #else
     runtime_error_t err;
@@ -139,39 +503,68 @@ runtime_error_t runtime_init(runtime_init_info_t info) {
 
     if (!have_platform) {
         writef(STDERR_FILENO, "blas2cuda: %s: failed to get OpenCL platforms - %s\n", __func__, runtime_error_string(err));
-        abort();
+        return runtime_is_error(err) ? err : CL_DEVICE_NOT_FOUND;
     }
 
-    // create a context for a platform and device
-    struct opencl_platform *selected_platform = NULL;
-    struct opencl_device *selected_device = NULL;
-    for (cl_uint p = 0; p < num_platforms && !selected_device; p++) {
+    // rank the devices, unless one was asked for
+    struct opencl_candidate *candidates = NULL;
+    size_t num_candidates = 0;
+
+    for (cl_uint p = 0; p < num_platforms; p++)
+        num_candidates += opencl_platforms[p].is_valid ? opencl_platforms[p].num_devices : 0;
+    if (num_candidates && !(candidates = calloc(num_candidates, sizeof *candidates)))
+        return CL_OUT_OF_HOST_MEMORY;
+    num_candidates = 0;
+    for (cl_uint p = 0; p < num_platforms; p++) {
         struct opencl_platform *const curr_platform = &opencl_platforms[p];
         if (!curr_platform->is_valid)
             continue;
-        for (cl_uint d = 0; d < curr_platform->num_devices && !selected_device; d++) {
-            struct opencl_device *const curr_device = &curr_platform->devices[d];
-            if (!curr_device->is_valid)
-                continue;
-            opencl_ctx = clCreateContext(
-                    (cl_context_properties[]){
-                        CL_CONTEXT_PLATFORM,
-                        (cl_context_properties) curr_platform->id,
-                        0
-                    }, 1,
-                    &curr_device->id, NULL,
-                    NULL, &err);
-            if (runtime_is_error(err))
-                return err;
-            // we will break now that opencl_ctx has been initialized
-            selected_device = curr_device;
-            selected_platform = curr_platform;
-            if (p != info.platform)
-                writef(STDERR_FILENO, "blas2cuda: %s: WARNING: could not select platform #%d (%s)\n", __func__, info.platform, curr_platform->name);
-            if (d != info.device)
-                writef(STDERR_FILENO, "blas2cuda: %s: WARNING: could not select device #%d (%s)\n", __func__, info.device, curr_device->name);
+        for (cl_uint d = 0; d < curr_platform->num_devices; d++)
+            if (curr_platform->devices[d].is_valid)
+                candidates[num_candidates++] = (struct opencl_candidate) {
+                    curr_platform, &curr_platform->devices[d], p, d, false
+                };
+    }
+
+    struct opencl_candidate *requested = NULL;
+    if (info.device && !(requested = opencl_find_device(candidates, num_candidates, info.device)))
+        writef(STDERR_FILENO, "blas2cuda: %s: WARNING: could not select device '%s'\n", __func__, info.device);
+    if (requested) {
+        // try it first, then the others in order
+        struct opencl_candidate first = *requested;
+        memmove(candidates + 1, candidates, (requested - candidates) * sizeof *candidates);
+        candidates[0] = first;
+    } else
+        opencl_rank_devices(candidates, num_candidates);
+
+    // create a context for the best device that has one
+    struct opencl_platform *selected_platform = NULL;
+    struct opencl_device *selected_device = NULL;
+    err = CL_DEVICE_NOT_FOUND;
+    for (size_t i = 0; i < num_candidates && !selected_device; i++) {
+        struct opencl_platform *const curr_platform = candidates[i].platform;
+        struct opencl_device *const curr_device = candidates[i].device;
+
+        opencl_ctx = clCreateContext(
+                (cl_context_properties[]){
+                    CL_CONTEXT_PLATFORM,
+                    (cl_context_properties) curr_platform->id,
+                    0
+                }, 1,
+                &curr_device->id, NULL,
+                NULL, &err);
+        if (runtime_is_error(err)) {
+            writef(STDERR_FILENO, "blas2cuda: %s: WARNING: could not create a context for %s - %s\n",
+                    __func__, curr_device->name, runtime_error_string(err));
+            continue;
         }
+        // we will break now that opencl_ctx has been initialized
+        selected_device = curr_device;
+        selected_platform = curr_platform;
+        if (requested && i > 0)
+            writef(STDERR_FILENO, "blas2cuda: %s: WARNING: could not select device '%s'\n", __func__, info.device);
     }
+    free(candidates);
 
     if (!selected_device) {
         writef(STDERR_FILENO, "blas2cuda: %s: FATAL: could not select a device\n", __func__);
@@ -188,6 +581,9 @@ runtime_error_t runtime_init(runtime_init_info_t info) {
         writef(STDOUT_FILENO, "blas2cuda: %s: selected %s [%s]\n", 
                __func__, selected_platform->name, selected_device->name);
 
+    opencl_finegrained = selected_device->svm_capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+    opencl_device_type = selected_device->type;
+
     return err;
 #endif
 }
@@ -253,7 +649,9 @@ runtime_error_t runtime_malloc_shared(void **sharedbuf_in, size_t size) {
 #if USE_CUDA
     err = cudaMallocManaged(sharedbuf_in, size, cudaMemAttachGlobal);
 #else
-    *sharedbuf_in = clSVMAlloc(opencl_ctx, CL_MEM_READ_WRITE, size, 0);
+    *sharedbuf_in = clSVMAlloc(opencl_ctx,
+            CL_MEM_READ_WRITE | (opencl_finegrained ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0),
+            size, 0);
     err = RUNTIME_ERROR_SUCCESS;
 #endif
     return err;
@@ -269,31 +667,3 @@ runtime_error_t runtime_free(void *gpubuf) {
 #endif
     return err;
 }
-
-runtime_error_t runtime_svm_map(void *sharedbuf, size_t size) {
-    runtime_error_t err;
-#if USE_CUDA
-    // sharedbuf was allocated with cudaMallocManaged, so we do nothing
-    err = RUNTIME_ERROR_SUCCESS;
-#else
-    err = opencl_finegrained ? RUNTIME_ERROR_SUCCESS :
-        clEnqueueSVMMap(opencl_cmd_queue, 
-            CL_TRUE /* block until this completes */, 
-            CL_MEM_READ_WRITE, sharedbuf, size, 0, NULL, NULL);
-#endif
-    return err;
-}
-
-runtime_error_t runtime_svm_unmap(void *sharedbuf) {
-    runtime_error_t err;
-#if USE_CUDA
-    // sharedbuf was allocated with cudaMallocManaged, so we do nothing
-    err = RUNTIME_ERROR_SUCCESS;
-#else
-    err = opencl_finegrained ? RUNTIME_ERROR_SUCCESS :
-        clEnqueueSVMUnmap(opencl_cmd_queue,
-            sharedbuf,
-            0, NULL, NULL);
-#endif
-    return err;
-}
@@ -1,6 +1,9 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #if USE_CUDA
 #include <cuda.h>
 #include <cuda_runtime.h>
@@ -14,21 +17,37 @@ typedef cudaError_t runtime_error_t;
 #define runtime_error_name cudaGetErrorName
 #define runtime_error_string cudaGetErrorString
 
-typedef void *runtime_init_info_t;
-#define RUNTIME_INIT_INFO_DEFAULT NULL
+typedef struct _runtime_init_info {
+    const char *backend;        /* see backend.h, or NULL for the default */
+#if USE_HOST
+    /*
+     * the simulated link between the host and the device (see host/host.h),
+     * or the network to the server of the remote backend (host/remote.h)
+     */
+    double link_bandwidth;      /* GB/s, or 0 for none */
+    double link_latency;        /* us */
+#endif
+} runtime_init_info_t;
+
+#define RUNTIME_INIT_INFO_DEFAULT (runtime_init_info_t){0}
 
 /**
  * Any expressions that ultimately make a CUDA kernel call should be wrapped with this.
  * 
- * This disables the Object Tracker for the current thread and calls cudaDeviceSynchronize(),
- * to avoid bus errors either caused by trying to access unified memory during a kernel call 
+ * This disables the Object Tracker for the current thread, and issues the call on a
+ * stream selected by the scheduler (see scheduler.h). If the device can't access
+ * managed memory concurrently with the host, it calls cudaDeviceSynchronize(), to avoid
+ * bus errors either caused by trying to access unified memory during a kernel call 
  * (alloc_managed() writes the buffer size to the buffer) or after the kernel has been called
- * but the results have not been synchronized.
+ * but the results have not been synchronized. Otherwise, it returns as soon as the kernel
+ * is enqueued, and host accesses to its operands wait for it (see pending.h).
  */
 #define call_kernel(expr) {\
     extern bool b2c_must_synchronize;\
     obj_tracker_internal_enter();\
+    b2c_sched_begin(__func__);\
     expr;\
+    b2c_sched_end();\
     obj_tracker_internal_leave();\
     if (b2c_must_synchronize)\
         cudaDeviceSynchronize();\
@@ -48,20 +67,28 @@ typedef cl_int runtime_error_t;
 #define runtime_error_string clGetErrorString
 
 typedef struct _runtime_init_info {
-    unsigned platform;
-    unsigned device;
+    /*
+     * "<platform>:<device>", a part of a device name, or NULL to pick the
+     * best device (see opencl_rank_devices())
+     */
+    const char *device;
 } runtime_init_info_t;
 
-#define RUNTIME_INIT_INFO_DEFAULT (runtime_init_info_t){0,0}
+#define RUNTIME_INIT_INFO_DEFAULT (runtime_init_info_t){0}
 
+/**
+ * Like the CUDA version. clBLAS calls get their queue, wait list and
+ * completion event from b2c_queue_args().
+ */
 #define call_kernel(expr) {\
-    extern cl_command_queue opencl_cmd_queue;\
     extern bool b2c_must_synchronize;\
     obj_tracker_internal_enter();\
+    b2c_sched_begin(__func__);\
     expr;\
+    b2c_sched_end();\
     obj_tracker_internal_leave();\
     if (b2c_must_synchronize)\
-        clFinish(opencl_cmd_queue);\
+        b2c_sched_wait_last();\
 } while (0)
 
 #else
@@ -73,7 +100,8 @@ extern "C" {
 #endif
 
 /**
- * Initialize the runtime (only used for OpenCL so far).
+ * Initialize the runtime. On CUDA, this loads the backend (see backend.h).
+ * Fails if there is no device to use.
  */
 runtime_error_t runtime_init(runtime_init_info_t info);
 
@@ -112,17 +140,15 @@ runtime_error_t runtime_malloc_shared(void **sharedbuf_in, size_t size);
  */
 runtime_error_t runtime_free(void *gpubuf);
 
+#if USE_OPENCL
 /**
- * Map a shared buffer into the host address space. If fine-grained access is
- * supported, this does nothing.
+ * Put the directory for files that are kept across runs
+ * ($XDG_CACHE_HOME/blas2cuda, or ~/.cache/blas2cuda) in {@dir}, and create
+ * it if {@create} is set.
+ * @return false if there is no such directory
  */
-runtime_error_t runtime_svm_map(void *sharedbuf, size_t size);
-
-/**
- * Unmap a shared buffer into the host address space. If fine-grained access 
- * is supported, this does nothing.
- */
-runtime_error_t runtime_svm_unmap(void *sharedbuf);
+bool runtime_cache_dir(char *dir, size_t size, bool create);
+#endif
 
 #ifdef __cplusplus
 };
@@ -0,0 +1,146 @@
+#include "scalars.h"
+#include "deferred.h"
+#include "scheduler.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_SCALAR_SLOTS    64
+#define SCALAR_SLOT_SIZE    16  /* large enough for a double complex */
+
+pthread_mutex_t b2c_scalars_lock = PTHREAD_MUTEX_INITIALIZER;
+size_t b2c_scalars_flushes = 0;
+size_t b2c_scalars_results = 0;
+
+#if USE_OPENCL
+extern cl_command_queue opencl_cmd_queue;
+extern cl_context opencl_ctx;
+#endif
+
+static struct {
+    void *dest;
+    size_t size;
+} pending[NUM_SCALAR_SLOTS];
+static unsigned num_pending;
+
+static uint8_t staging[NUM_SCALAR_SLOTS * SCALAR_SLOT_SIZE];
+
+#if USE_CUDA
+static void *slots_dev;
+static cublasHandle_t scalar_handle;
+#else
+static cl_mem slots_dev;
+#endif
+
+static void scalars_init(void) {
+    runtime_error_t err;
+#if USE_CUDA
+    runtime_blas_error_t berr;
+
+    if ((berr = cublasCreate(&scalar_handle)) != RUNTIME_BLAS_ERROR_SUCCESS
+            || (berr = cublasSetPointerMode(scalar_handle, CUBLAS_POINTER_MODE_DEVICE)) != RUNTIME_BLAS_ERROR_SUCCESS) {
+        writef(STDERR_FILENO, "blas2cuda: failed to create BLAS context for scalar results: %s\n",
+                runtime_blas_error_msg(berr));
+        abort();
+    }
+    err = runtime_malloc(&slots_dev, sizeof staging);
+#else
+    slots_dev = clCreateBuffer(opencl_ctx, CL_MEM_READ_WRITE, sizeof staging, NULL, &err);
+#endif
+    if (runtime_is_error(err)) {
+        writef(STDERR_FILENO, "blas2cuda: failed to allocate %zu B on device: %s\n",
+                sizeof staging, runtime_error_string(err));
+        abort();
+    }
+}
+
+int b2c_scalar_reserve(void *dest, size_t size) {
+    if (!slots_dev)
+        scalars_init();
+
+    if (num_pending == NUM_SCALAR_SLOTS)
+        b2c_scalars_flush();
+
+    pending[num_pending].dest = dest;
+    pending[num_pending].size = size < SCALAR_SLOT_SIZE ? size : SCALAR_SLOT_SIZE;
+    return num_pending++;
+}
+
+#if USE_CUDA
+cublasHandle_t b2c_scalar_handle(void) {
+    runtime_blas_error_t berr;
+
+    /* shared by all threads, so it follows the call being issued */
+    if ((berr = cublasSetStream(scalar_handle, b2c_sched_stream())) != RUNTIME_BLAS_ERROR_SUCCESS) {
+        writef(STDERR_FILENO, "blas2cuda: failed to select stream: %s\n",
+                runtime_blas_error_msg(berr));
+        abort();
+    }
+    return scalar_handle;
+}
+
+void *b2c_scalar_devptr(int slot) {
+    return (uint8_t *) slots_dev + slot * SCALAR_SLOT_SIZE;
+}
+#else
+cl_mem b2c_scalar_buffer(void) {
+    return slots_dev;
+}
+
+size_t b2c_scalar_offset(int slot, size_t elem_size) {
+    return slot * SCALAR_SLOT_SIZE / elem_size;
+}
+#endif
+
+void b2c_scalars_flush(void) {
+    runtime_error_t err;
+    size_t size = num_pending * SCALAR_SLOT_SIZE;
+
+    if (!num_pending)
+        return;
+
+    /*
+     * The copy on the default stream is ordered after the reductions that
+     * write the slots, whatever their stream. Queues are not ordered with
+     * each other, so wait for all of them.
+     */
+#if USE_CUDA
+    err = runtime_memcpy_dtoh(staging, slots_dev, size);
+#else
+    b2c_sched_finish();
+    err = clEnqueueReadBuffer(opencl_cmd_queue, slots_dev, CL_TRUE, 0, size, staging, 0, NULL, NULL);
+#endif
+    if (runtime_is_error(err)) {
+        writef(STDERR_FILENO, "blas2cuda: failed to copy %u scalar results from device: %s\n",
+                num_pending, runtime_error_string(err));
+        abort();
+    }
+
+    for (unsigned i = 0; i < num_pending; i++)
+        memcpy(pending[i].dest, &staging[i * SCALAR_SLOT_SIZE], pending[i].size);
+
+    b2c_scalars_flushes++;
+    b2c_scalars_results += num_pending;
+    num_pending = 0;
+}
+
+void b2c_scalars_fini(void) {
+    pthread_mutex_lock(&b2c_scalars_lock);
+    if (slots_dev) {
+        b2c_scalars_flush();
+#if USE_CUDA
+        runtime_free(slots_dev);
+        cublasDestroy(scalar_handle);
+#else
+        clReleaseMemObject(slots_dev);
+#endif
+        slots_dev = NULL;
+    }
+    pthread_mutex_unlock(&b2c_scalars_lock);
+}
+
+void b2c_scalars_sync(void) {
+    pthread_mutex_lock(&b2c_scalars_lock);
+    b2c_scalars_flush();
+    pthread_mutex_unlock(&b2c_scalars_lock);
+}
@@ -0,0 +1,75 @@
+#ifndef SCALARS_H
+#define SCALARS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "runtime.h"
+#include "runtime-blas.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scalar results of reductions (dot, nrm2, asum) can be written by the
+ * device to slots of a small device buffer instead of host memory, so that
+ * the host does not have to wait for each reduction in turn. Pending
+ * results are copied back to their destinations on the host all at once,
+ * with a single transfer, when they are flushed.
+ *
+ * The functions below must be called with b2c_scalars_lock held, from
+ * b2c_scalar_reserve() until the reduction has been enqueued.
+ */
+extern pthread_mutex_t b2c_scalars_lock;
+
+/** number of transfers done by flushes, and number of results returned */
+extern size_t b2c_scalars_flushes, b2c_scalars_results;
+
+/**
+ * Reserve a slot for a result of {@size} bytes (at most 16) that will be
+ * written to {@dest} on the next flush. If all slots are taken, pending
+ * results are flushed first.
+ * @return the slot
+ */
+int b2c_scalar_reserve(void *dest, size_t size);
+
+#if USE_CUDA
+/**
+ * The handle to use for reductions that write to a slot, set to the stream
+ * of the call being issued. Its pointer mode is always
+ * CUBLAS_POINTER_MODE_DEVICE.
+ */
+cublasHandle_t b2c_scalar_handle(void);
+
+/**
+ * Device address of {@slot}.
+ */
+void *b2c_scalar_devptr(int slot);
+#else
+/**
+ * The buffer that holds all slots.
+ */
+cl_mem b2c_scalar_buffer(void);
+
+/**
+ * Offset of {@slot} in the buffer, in units of {@elem_size}.
+ */
+size_t b2c_scalar_offset(int slot, size_t elem_size);
+#endif
+
+/**
+ * Wait for the device and copy all pending results to their destinations.
+ */
+void b2c_scalars_flush(void);
+
+/**
+ * Flush pending results and release the device buffer.
+ */
+void b2c_scalars_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,639 @@
+#define _GNU_SOURCE
+#include "scheduler.h"
+#include "scalars.h"
+#include "batch.h"
+#include "replay.h"
+#include "svm.h"
+#include "blas2cuda.h"
+#include "runtime-blas.h"
+#include "common.h"
+#include "lib/obj_tracker.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CALLS       256     /* in flight */
+#define MAX_RANGES      1024    /* in flight */
+#define MAX_LANES       16      /* threads with a handle of their own */
+
+#if USE_CUDA
+extern cublasHandle_t b2c_main_handle;
+extern __thread cublasHandle_t b2c_cublas_handle;
+#else
+extern cl_context opencl_ctx;
+
+__thread struct b2c_sched_call b2c_sched_cur;
+#endif
+
+struct range {
+    uintptr_t start, end;
+    bool writes;
+    struct b2c_event *event;
+};
+
+struct dep {
+    unsigned stream;
+    unsigned long seq;
+};
+
+/* the call being issued by this thread */
+static __thread struct {
+    struct range ops[B2C_MAX_OPERANDS];
+    unsigned num_ops;
+    bool overflow;              /* too many operands to track */
+    bool private_mem;           /* uses device memory of its own */
+    bool recorded;              /* captured into a replay plan */
+    bool started;               /* this thread has issued calls */
+    unsigned home;              /* first stream tried for calls without dependencies */
+    struct b2c_event *deps[B2C_MAX_STREAMS];
+    unsigned num_deps;
+    bool all_deps;              /* depends on all in-flight calls */
+    unsigned stream;
+    /* the last call issued, and what it was ordered after */
+    struct b2c_event *last;
+    struct dep last_deps[B2C_MAX_STREAMS];
+    unsigned num_last_deps;
+#if USE_OPENCL
+    cl_event unmapped;          /* the unmaps of its operands (see svm.h) */
+#endif
+} call;
+
+static unsigned num_streams;
+static bool in_order = true;
+#if USE_CUDA
+static cudaStream_t streams[B2C_MAX_STREAMS];
+#else
+static cl_command_queue queues[B2C_MAX_STREAMS];
+#endif
+static struct b2c_event *stream_last[B2C_MAX_STREAMS];
+static unsigned num_threads;
+static unsigned long next_seq;
+
+static struct b2c_event *calls[MAX_CALLS];
+static unsigned num_calls;
+static struct range ranges[MAX_RANGES];
+static unsigned num_ranges;
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+
+#if USE_CUDA
+/*
+ * A cuBLAS handle for the calls of one thread, so that threads can issue
+ * calls at the same time. Lanes are created on the first call of a thread,
+ * and passed on to the next thread when it exits; once all of them are
+ * taken, new threads share the lane with the fewest threads.
+ */
+struct lane {
+    cublasHandle_t handle;
+    unsigned threads;
+    pthread_mutex_t lock;       /* held while a call is issued */
+};
+
+static struct lane lanes[MAX_LANES];
+static unsigned num_lanes;
+static __thread struct lane *lane;
+#endif
+
+size_t b2c_sched_calls = 0;
+size_t b2c_sched_dependent = 0;
+size_t b2c_sched_peak = 0;
+size_t b2c_sched_inflight = 0;
+
+struct b2c_event *b2c_event_get(struct b2c_event *ev) {
+    __atomic_add_fetch(&ev->refs, 1, __ATOMIC_RELAXED);
+    return ev;
+}
+
+void b2c_event_put(struct b2c_event *ev) {
+    if (__atomic_sub_fetch(&ev->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+#if USE_CUDA
+        cudaEventDestroy(ev->event);
+#else
+        clReleaseEvent(ev->event);
+#endif
+        internal_free(ev);
+    }
+}
+
+void b2c_event_wait(struct b2c_event *ev) {
+    runtime_error_t err;
+
+    if (__atomic_load_n(&ev->done, __ATOMIC_ACQUIRE))
+        return;
+#if USE_CUDA
+    err = cudaEventSynchronize(ev->event);
+#else
+    err = clWaitForEvents(1, &ev->event);
+#endif
+    runtime_fatal_errmsg(err, __func__);
+}
+
+static bool event_done(struct b2c_event *ev) {
+    if (!__atomic_load_n(&ev->done, __ATOMIC_ACQUIRE)) {
+#if USE_CUDA
+        if (cudaEventQuery(ev->event) == cudaErrorNotReady)
+            return false;
+#else
+        cl_int status;
+
+        if (clGetEventInfo(ev->event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                    sizeof status, &status, NULL) == CL_SUCCESS && status > CL_COMPLETE)
+            return false;
+#endif
+        __atomic_store_n(&ev->done, true, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+/**
+ * Forget about calls that have completed. Each event is queried once,
+ * through the list of calls; ranges and streams then only check whether
+ * their event was seen complete.
+ */
+static void retire_locked(void) {
+    for (unsigned i = 0; i < num_calls; ) {
+        if (event_done(calls[i])) {
+            b2c_event_put(calls[i]);
+            calls[i] = calls[--num_calls];
+        } else
+            i++;
+    }
+
+    for (unsigned i = 0; i < num_ranges; ) {
+        if (ranges[i].event->done) {
+            b2c_event_put(ranges[i].event);
+            ranges[i] = ranges[--num_ranges];
+        } else
+            i++;
+    }
+
+    for (unsigned s = 0; s < num_streams; s++)
+        if (stream_last[s] && stream_last[s]->done) {
+            b2c_event_put(stream_last[s]);
+            stream_last[s] = NULL;
+        }
+}
+
+static void finish_locked(void) {
+    for (unsigned s = 0; s < num_streams; s++)
+#if USE_CUDA
+        runtime_fatal_errmsg(cudaStreamSynchronize(streams[s]), __func__);
+#else
+        runtime_fatal_errmsg(clFinish(queues[s]), __func__);
+#endif
+    for (unsigned i = 0; i < num_calls; i++)
+        __atomic_store_n(&calls[i]->done, true, __ATOMIC_RELEASE);
+    retire_locked();
+}
+
+/**
+ * Add {@ev} to the dependencies of the call being issued. On in-order
+ * streams, only the latest dependency on each stream matters.
+ */
+static void add_dep(struct b2c_event *ev) {
+    for (unsigned i = 0; i < call.num_deps; i++) {
+        if (call.deps[i] == ev)
+            return;
+        if (in_order && call.deps[i]->stream == ev->stream) {
+            if (ev->seq > call.deps[i]->seq)
+                call.deps[i] = ev;
+            return;
+        }
+    }
+
+    if (call.num_deps < B2C_MAX_STREAMS)
+        call.deps[call.num_deps++] = ev;
+    else
+        call.all_deps = true;
+}
+
+/**
+ * Release what a thread holds when it exits.
+ */
+static void thread_exit(void *arg) {
+#if USE_CUDA
+    pthread_mutex_lock(&sched_lock);
+    lane->threads--;
+    pthread_mutex_unlock(&sched_lock);
+    lane = NULL;
+#endif
+    if (call.last) {
+        b2c_event_put(call.last);
+        call.last = NULL;
+    }
+}
+
+/**
+ * Set up this thread before its first call: pick the stream its calls
+ * start from, and a lane.
+ */
+static void thread_start(void) {
+#if USE_CUDA
+    struct lane *l = NULL;
+    runtime_blas_error_t berr;
+#endif
+
+    pthread_mutex_lock(&sched_lock);
+    call.home = num_threads++ % num_streams;
+#if USE_CUDA
+    for (unsigned i = 0; i < num_lanes && !l; i++)
+        if (!lanes[i].threads)
+            l = &lanes[i];
+    if (!l && num_lanes < MAX_LANES) {
+        l = &lanes[num_lanes];
+        /* the first lane gets the handle created at initialization */
+        if (!num_lanes)
+            l->handle = b2c_main_handle;
+        else if ((berr = cublasCreate(&l->handle)) != RUNTIME_BLAS_ERROR_SUCCESS) {
+            writef(STDERR_FILENO, "blas2cuda: failed to create BLAS context for thread: %s\n",
+                    runtime_blas_error_msg(berr));
+            abort();
+        }
+        pthread_mutex_init(&l->lock, NULL);
+        num_lanes++;
+    }
+    if (!l) {
+        l = &lanes[0];
+        for (unsigned i = 1; i < num_lanes; i++)
+            if (lanes[i].threads < l->threads)
+                l = &lanes[i];
+    }
+    l->threads++;
+    lane = l;
+#endif
+    pthread_mutex_unlock(&sched_lock);
+
+    call.started = true;
+    pthread_setspecific(thread_key, &call);
+}
+
+int b2c_sched_init(unsigned n) {
+    runtime_error_t err;
+    int ret;
+
+    if ((ret = pthread_key_create(&thread_key, thread_exit)) != 0) {
+        writef(STDERR_FILENO, "blas2cuda: failed to create thread key: %s\n", strerror(ret));
+        return -1;
+    }
+
+    if (n < 1)
+        n = 1;
+    else if (n > B2C_MAX_STREAMS)
+        n = B2C_MAX_STREAMS;
+
+#if USE_CUDA
+    /* these are blocking streams, so they are ordered with the default stream */
+    for (unsigned s = 0; s < n; s++)
+        if (runtime_is_error(err = cudaStreamCreate(&streams[s]))) {
+            writef(STDERR_FILENO, "blas2cuda: failed to create stream: %s\n",
+                    runtime_error_string(err));
+            return -1;
+        }
+    num_streams = n;
+    writef(STDOUT_FILENO, "blas2cuda: issuing calls on %u streams\n", num_streams);
+#else
+    cl_device_id device;
+    cl_command_queue_properties props = 0;
+
+    if (runtime_is_error(err = clGetContextInfo(opencl_ctx, CL_CONTEXT_DEVICES,
+                    sizeof device, &device, NULL))
+            || runtime_is_error(err = clGetDeviceInfo(device, CL_DEVICE_QUEUE_ON_HOST_PROPERTIES,
+                    sizeof props, &props, NULL))) {
+        writef(STDERR_FILENO, "blas2cuda: failed to query queue properties: %s\n",
+                runtime_error_string(err));
+        return -1;
+    }
+
+    /* a single out-of-order queue does the job of several in-order ones */
+    if (n > 1 && (props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+        in_order = false;
+        n = 1;
+    }
+
+    for (unsigned s = 0; s < n; s++) {
+        queues[s] = clCreateCommandQueueWithProperties(opencl_ctx, device,
+                (cl_queue_properties[]) {
+                    CL_QUEUE_PROPERTIES,
+                    in_order ? 0 : CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
+                    0
+                }, &err);
+        if (runtime_is_error(err)) {
+            writef(STDERR_FILENO, "blas2cuda: failed to create command queue: %s\n",
+                    runtime_error_string(err));
+            return -1;
+        }
+    }
+    num_streams = n;
+    if (in_order) {
+        writef(STDOUT_FILENO, "blas2cuda: issuing calls on %u command queues\n", num_streams);
+    } else {
+        writef(STDOUT_FILENO, "blas2cuda: issuing calls on an out-of-order command queue\n");
+    }
+#endif
+
+    return 0;
+}
+
+void b2c_sched_operand(const void *ptr, size_t size, bool writes) {
+    if (call.num_ops == B2C_MAX_OPERANDS) {
+        call.overflow = true;
+        return;
+    }
+
+    call.ops[call.num_ops].start = (uintptr_t) ptr;
+    call.ops[call.num_ops].end = (uintptr_t) ptr + size;
+    call.ops[call.num_ops].writes = writes;
+    call.num_ops++;
+}
+
+void b2c_sched_private(void) {
+    call.private_mem = true;
+}
+
+#if USE_CUDA
+/**
+ * Take this thread's lane until lane_leave(), and issue calls with its
+ * handle on {@stream}.
+ */
+static void lane_enter(cudaStream_t stream) {
+    runtime_blas_error_t berr;
+
+    pthread_mutex_lock(&lane->lock);
+    b2c_cublas_handle = lane->handle;
+    if ((berr = cublasSetStream(b2c_cublas_handle, stream)) != RUNTIME_BLAS_ERROR_SUCCESS) {
+        writef(STDERR_FILENO, "blas2cuda: failed to select stream: %s\n",
+                runtime_blas_error_msg(berr));
+        abort();
+    }
+}
+
+static void lane_leave(void) {
+    pthread_mutex_unlock(&lane->lock);
+}
+
+/**
+ * Offer the call to the replay plans.
+ * @return whether it was captured
+ */
+static bool replay_call(const char *site) {
+    struct b2c_sched_op ops[B2C_MAX_OPERANDS];
+
+    for (unsigned i = 0; i < call.num_ops; i++) {
+        ops[i].start = call.ops[i].start;
+        ops[i].end = call.ops[i].end;
+        ops[i].writes = call.ops[i].writes;
+    }
+    return b2c_replay_call(site, ops, call.num_ops,
+            !call.overflow && !call.private_mem && call.num_ops > 0);
+}
+#endif
+
+void b2c_sched_begin(const char *site) {
+    struct b2c_event *newest = NULL;
+    unsigned s;
+
+    b2c_runtime_ensure();
+    if (!call.started)
+        thread_start();
+
+#if USE_CUDA
+    if (b2c_options.replay && !b2c_must_synchronize && (call.recorded = replay_call(site))) {
+        /* captures are serialized by the replay plans */
+        lane_enter(b2c_replay_stream());
+        return;
+    }
+#endif
+    call.recorded = false;
+
+    if (b2c_batch_buffered()) {
+        /* buffered calls were made before this one, so issue them first */
+        struct range ops[B2C_MAX_OPERANDS];
+        unsigned num_ops = call.num_ops;
+        bool overflow = call.overflow;
+
+        memcpy(ops, call.ops, num_ops * sizeof *ops);
+        call.num_ops = 0;
+        call.overflow = false;
+        b2c_batch_flush();
+        memcpy(call.ops, ops, num_ops * sizeof *ops);
+        call.num_ops = num_ops;
+        call.overflow = overflow;
+    }
+
+    pthread_mutex_lock(&sched_lock);
+    retire_locked();
+
+    call.num_deps = 0;
+    call.all_deps = false;
+    if (call.overflow) {
+        for (unsigned i = 0; i < num_calls; i++)
+            add_dep(calls[i]);
+    } else {
+        for (unsigned i = 0; i < call.num_ops; i++)
+            for (unsigned j = 0; j < num_ranges; j++)
+                if ((call.ops[i].writes || ranges[j].writes)
+                        && call.ops[i].start < ranges[j].end && ranges[j].start < call.ops[i].end)
+                    add_dep(ranges[j].event);
+    }
+
+    /* held until the call ends; CUDA calls are issued without the scheduler */
+    for (unsigned i = 0; i < call.num_deps; i++) {
+        b2c_event_get(call.deps[i]);
+        if (!newest || call.deps[i]->seq > newest->seq)
+            newest = call.deps[i];
+    }
+
+    if (!in_order)
+        s = 0;
+    else if (newest)
+        /* follow the latest dependency, so that it needs no event */
+        s = newest->stream;
+    else {
+        /* prefer an idle stream, starting from this thread's own */
+        s = call.home;
+        for (unsigned i = 0; i < num_streams; i++)
+            if (!stream_last[(call.home + i) % num_streams]) {
+                s = (call.home + i) % num_streams;
+                break;
+            }
+    }
+    call.stream = s;
+
+    b2c_sched_calls++;
+    if (call.num_deps)
+        b2c_sched_dependent++;
+    b2c_sched_inflight += num_calls + 1;
+    if (num_calls + 1 > b2c_sched_peak)
+        b2c_sched_peak = num_calls + 1;
+
+#if USE_CUDA
+    for (unsigned i = 0; i < call.num_deps; i++)
+        if (call.deps[i]->stream != s)
+            runtime_fatal_errmsg(cudaStreamWaitEvent(streams[s], call.deps[i]->event, 0), __func__);
+    pthread_mutex_unlock(&sched_lock);
+
+    /*
+     * The call is enqueued on the thread's own handle without holding the
+     * scheduler. Calls that are issued at the same time don't depend on
+     * each other, since a call only depends on calls that have returned.
+     */
+    lane_enter(streams[s]);
+#else
+    b2c_sched_cur.queue = queues[s];
+    b2c_sched_cur.num_deps = 0;
+    b2c_sched_cur.event = NULL;
+    if (call.all_deps)
+        /* waits for everything enqueued so far */
+        runtime_fatal_errmsg(clEnqueueBarrierWithWaitList(queues[s], 0, NULL,
+                    &b2c_sched_cur.deps[b2c_sched_cur.num_deps++]), __func__);
+    else
+        for (unsigned i = 0; i < call.num_deps; i++)
+            if (!in_order || call.deps[i]->stream != s)
+                b2c_sched_cur.deps[b2c_sched_cur.num_deps++] = call.deps[i]->event;
+    if ((call.unmapped = b2c_svm_take_event()))
+        b2c_sched_cur.deps[b2c_sched_cur.num_deps++] = call.unmapped;
+#endif
+}
+
+void b2c_sched_end(void) {
+    struct b2c_event *ev;
+    struct b2c_event *prev = call.last;
+    runtime_error_t err;
+
+#if USE_CUDA
+    if (call.recorded) {
+        call.num_ops = 0;
+        call.overflow = false;
+        call.private_mem = false;
+        lane_leave();
+        b2c_replay_end();
+        return;
+    }
+#endif
+
+    if (!(ev = internal_calloc(1, sizeof *ev))) {
+        writef(STDERR_FILENO, "blas2cuda: failed to allocate completion event\n");
+        abort();
+    }
+    ev->stream = call.stream;
+    ev->refs = 1;
+
+#if USE_CUDA
+    runtime_fatal_errmsg(cudaEventCreateWithFlags(&ev->event, cudaEventDisableTiming), __func__);
+
+    /* events are recorded on each stream in the order of their sequence numbers */
+    pthread_mutex_lock(&sched_lock);
+    ev->seq = next_seq++;
+    err = cudaEventRecord(ev->event, streams[call.stream]);
+    lane_leave();
+#else
+    ev->seq = next_seq++;
+    if ((ev->event = b2c_sched_cur.event))
+        err = CL_SUCCESS;
+    else
+        /* nothing was enqueued, but later calls may still depend on this one */
+        err = clEnqueueMarkerWithWaitList(b2c_sched_cur.queue,
+                b2c_sched_cur.num_deps, b2c_sched_cur.num_deps ? b2c_sched_cur.deps : NULL,
+                &ev->event);
+    if (call.all_deps)
+        clReleaseEvent(b2c_sched_cur.deps[0]);
+    if (call.unmapped)
+        clReleaseEvent(call.unmapped);
+#endif
+    runtime_fatal_errmsg(err, __func__);
+
+    if (num_calls == MAX_CALLS || num_ranges + call.num_ops > MAX_RANGES)
+        finish_locked();
+
+    calls[num_calls++] = ev;
+    for (unsigned i = 0; i < call.num_ops && !call.overflow; i++) {
+        ranges[num_ranges] = call.ops[i];
+        ranges[num_ranges].event = b2c_event_get(ev);
+        num_ranges++;
+    }
+    if (stream_last[call.stream])
+        b2c_event_put(stream_last[call.stream]);
+    stream_last[call.stream] = b2c_event_get(ev);
+
+    call.last = b2c_event_get(ev);
+    call.num_last_deps = 0;
+    if (!call.all_deps)
+        for (unsigned i = 0; i < call.num_deps; i++) {
+            call.last_deps[i].stream = call.deps[i]->stream;
+            call.last_deps[i].seq = call.deps[i]->seq;
+            call.num_last_deps++;
+        }
+    call.num_ops = 0;
+    call.overflow = false;
+    call.private_mem = false;
+    pthread_mutex_unlock(&sched_lock);
+
+    for (unsigned i = 0; i < call.num_deps; i++)
+        b2c_event_put(call.deps[i]);
+    if (prev)
+        b2c_event_put(prev);
+}
+
+#if USE_CUDA
+cudaStream_t b2c_sched_stream(void) {
+    return streams[call.stream];
+}
+#endif
+
+bool b2c_sched_recorded(void) {
+    return call.recorded;
+}
+
+struct b2c_event *b2c_sched_last(void) {
+    return call.last;
+}
+
+bool b2c_sched_after(struct b2c_event *ev) {
+    if (!call.last)
+        return false;
+    if (ev == call.last || (in_order && ev->stream == call.last->stream && ev->seq < call.last->seq))
+        return true;
+    for (unsigned i = 0; i < call.num_last_deps; i++)
+        if (call.last_deps[i].stream == ev->stream
+                && (in_order ? ev->seq <= call.last_deps[i].seq : ev->seq == call.last_deps[i].seq))
+            return true;
+    return __atomic_load_n(&ev->done, __ATOMIC_ACQUIRE);
+}
+
+void b2c_sched_wait_last(void) {
+    if (call.last)
+        b2c_event_wait(call.last);
+}
+
+void b2c_sched_finish(void) {
+    pthread_mutex_lock(&sched_lock);
+    finish_locked();
+    pthread_mutex_unlock(&sched_lock);
+}
+
+void b2c_sched_fini(void) {
+    pthread_mutex_lock(&sched_lock);
+    finish_locked();
+#if USE_CUDA
+    cublasSetStream(b2c_main_handle, 0);
+    for (unsigned i = 1; i < num_lanes; i++)
+        cublasDestroy(lanes[i].handle);
+    num_lanes = 0;
+#endif
+    for (unsigned s = 0; s < num_streams; s++)
+#if USE_CUDA
+        cudaStreamDestroy(streams[s]);
+#else
+        clReleaseCommandQueue(queues[s]);
+#endif
+    num_streams = 0;
+    pthread_mutex_unlock(&sched_lock);
+    /* threads that exit from now on have nothing to release */
+    pthread_key_delete(thread_key);
+
+    if (call.last) {
+        b2c_event_put(call.last);
+        call.last = NULL;
+    }
+}
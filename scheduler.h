@@ -0,0 +1,189 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scheduling of offloaded calls onto several streams (CUDA) or command
+ * queues (OpenCL).
+ *
+ * Each call declares the byte ranges of the managed objects it reads and
+ * writes (see gpuptr). A call that reads a range written by an in-flight
+ * call, or writes a range that an in-flight call uses, depends on that
+ * call; calls without dependencies are issued on separate streams, so
+ * they can run concurrently. Dependencies on other streams are expressed
+ * with events, so the host never waits for them.
+ *
+ * Temporary device copies of host operands are private to a call, so they
+ * don't add dependencies. On CUDA, the streams synchronize with the legacy
+ * default stream, which is what copies to and from those temporaries use.
+ * On OpenCL, an out-of-order queue is used if the device supports one,
+ * with every dependency passed in the event wait list; otherwise, several
+ * in-order queues are used, like CUDA streams.
+ *
+ * Each thread starts looking for an idle stream from a stream of its own,
+ * so the calls of concurrent threads spread over the streams. On CUDA,
+ * each thread also gets a cuBLAS handle of its own from a small pool, and
+ * enqueues its calls without holding the scheduler, so threads only
+ * serialize while dependencies are worked out and events recorded. A call
+ * only depends on calls that have returned, so concurrent calls are
+ * independent (if they weren't, the program would have a data race).
+ * clBLAS calls share kernel objects, so on OpenCL, calls are still issued
+ * one at a time.
+ */
+
+#define B2C_MAX_STREAMS     16
+
+/* operands tracked per call */
+#define B2C_MAX_OPERANDS    8
+
+/**
+ * A byte range used by a call.
+ */
+struct b2c_sched_op {
+    uintptr_t start, end;
+    bool writes;
+};
+
+/**
+ * Completion event of an offloaded call. Events are shared by the
+ * scheduler and by pending objects (see pending.h), so they are
+ * reference-counted.
+ */
+struct b2c_event {
+#if USE_CUDA
+    cudaEvent_t event;
+#else
+    cl_event event;
+#endif
+    unsigned stream;            /* the stream the call was issued on */
+    unsigned long seq;          /* issue order */
+    bool done;                  /* seen complete by the scheduler */
+    unsigned refs;
+};
+
+struct b2c_event *b2c_event_get(struct b2c_event *ev);
+
+void b2c_event_put(struct b2c_event *ev);
+
+void b2c_event_wait(struct b2c_event *ev);
+
+#if USE_OPENCL
+/**
+ * Queue, wait list, and completion event for the call being issued by the
+ * current thread.
+ */
+struct b2c_sched_call {
+    cl_command_queue queue;
+    cl_uint num_deps;
+    cl_event deps[B2C_MAX_STREAMS + 1];    /* and the unmaps of its operands (see svm.h) */
+    cl_event event;
+};
+
+extern __thread struct b2c_sched_call b2c_sched_cur;
+
+/**
+ * The trailing arguments of clBLAS functions, for the call being issued.
+ */
+#define b2c_queue_args()\
+    1, &b2c_sched_cur.queue,\
+    b2c_sched_cur.num_deps, b2c_sched_cur.num_deps ? b2c_sched_cur.deps : NULL,\
+    &b2c_sched_cur.event
+#endif
+
+/** calls issued, calls that depended on in-flight calls */
+extern size_t b2c_sched_calls, b2c_sched_dependent;
+
+/** most calls in flight when a call was issued, and their sum over calls */
+extern size_t b2c_sched_peak, b2c_sched_inflight;
+
+/**
+ * Create up to {@num_streams} streams (or queues).
+ * @return 0 on success, < 0 on error
+ */
+int b2c_sched_init(unsigned num_streams);
+
+/**
+ * Declare that the next call issued by this thread uses the {@size} bytes
+ * at {@ptr}, and writes them if {@writes} is set.
+ */
+void b2c_sched_operand(const void *ptr, size_t size, bool writes);
+
+/**
+ * Declare that the next call issued by this thread uses device memory of
+ * its own (a temporary copy, or a result slot), so it can't be recorded
+ * into a replay plan (see replay.h).
+ */
+void b2c_sched_private(void);
+
+/**
+ * Select a stream for the next call from its operands, and make it wait
+ * for the in-flight calls it depends on. Called by call_kernel() with the
+ * name of the function that issues the call ({@site}). Until
+ * b2c_sched_end(), b2c_cublas_handle is this thread's handle (CUDA), or
+ * the scheduler is held (OpenCL).
+ *
+ * With the replay option, the call may be captured into a replay plan
+ * instead.
+ */
+void b2c_sched_begin(const char *site);
+
+/**
+ * Record the completion event of the call that was just issued, and track
+ * its operands until it completes.
+ */
+void b2c_sched_end(void);
+
+#if USE_CUDA
+/**
+ * The stream selected for the call being issued.
+ */
+cudaStream_t b2c_sched_stream(void);
+#endif
+
+/**
+ * Whether the last call of this thread was captured into a replay plan
+ * instead of being issued. Its objects are then held until the plan is
+ * launched, and must not be added to pending objects.
+ */
+bool b2c_sched_recorded(void);
+
+/**
+ * The completion event of the last call issued by this thread, if any.
+ * The reference belongs to the scheduler.
+ */
+struct b2c_event *b2c_sched_last(void);
+
+/**
+ * Whether the last call issued by this thread can only run after {@ev}
+ * has completed.
+ */
+bool b2c_sched_after(struct b2c_event *ev);
+
+/**
+ * Wait for the last call issued by this thread.
+ */
+void b2c_sched_wait_last(void);
+
+/**
+ * Wait for all issued calls.
+ */
+void b2c_sched_finish(void);
+
+/**
+ * Wait for all issued calls and destroy the streams.
+ */
+void b2c_sched_fini(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,281 @@
+#include "svm.h"
+#include "common.h"
+
+size_t b2c_svm_unmapped = 0;
+size_t b2c_svm_mapped = 0;
+size_t b2c_svm_unmapped_bytes = 0;
+
+#if USE_OPENCL
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+#include "scheduler.h"
+#include "lib/obj_tracker.h"
+
+#define SVM_MAX_CHUNKS  64              /* per object, one bit each */
+#define SVM_MIN_CHUNK   (256 << 10)     /* in bytes */
+
+extern cl_command_queue opencl_cmd_queue;
+extern bool opencl_finegrained;
+
+struct svm_obj {
+    char *base;
+    size_t size;
+    size_t chunk;                       /* bytes per chunk */
+    uint64_t mapped;                    /* chunks mapped for the host */
+    uint16_t users[SVM_MAX_CHUNKS];     /* calls using each chunk */
+};
+
+/* tracked allocations, sorted by base */
+static struct svm_obj *objs;
+static unsigned num_objs, max_objs;
+/*
+ * The last unmap enqueued. opencl_cmd_queue is in order, so a call that
+ * waits for it also waits for the unmaps of other threads' calls, whose
+ * chunks it may share.
+ */
+static cl_event last_unmap;
+static pthread_mutex_t svm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* what the next call of this thread waits for */
+static __thread cl_event unmap_event;
+
+/**
+ * The index of the first object whose base is above {@ptr}.
+ */
+static unsigned upper_bound_locked(const void *ptr) {
+    unsigned lo = 0, hi = num_objs;
+
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+
+        if ((const char *) ptr < objs[mid].base)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+static struct svm_obj *find_locked(const void *ptr) {
+    unsigned i = upper_bound_locked(ptr);
+
+    if (i == 0 || (const char *) ptr >= objs[i - 1].base + objs[i - 1].size)
+        return NULL;
+    return &objs[i - 1];
+}
+
+static unsigned num_chunks(const struct svm_obj *obj) {
+    return (obj->size + obj->chunk - 1) / obj->chunk;
+}
+
+/**
+ * The chunks of {@obj} that [{@ptr}, {@ptr} + {@size}) overlaps.
+ */
+static uint64_t chunk_mask(const struct svm_obj *obj, const void *ptr, size_t size) {
+    size_t start = (const char *) ptr - obj->base;
+    size_t end = start + size < obj->size ? start + size : obj->size;
+    unsigned first = start / obj->chunk;
+    unsigned last = (end - 1) / obj->chunk;
+    uint64_t below_last = last == SVM_MAX_CHUNKS - 1 ? ~0ull : (1ull << (last + 1)) - 1;
+
+    return below_last & ~((1ull << first) - 1);
+}
+
+static size_t chunk_size(const struct svm_obj *obj, unsigned i) {
+    size_t start = i * obj->chunk;
+
+    return obj->size - start < obj->chunk ? obj->size - start : obj->chunk;
+}
+
+/**
+ * Map the chunks of {@obj} in {@mask} after {@wait}, if set.
+ * @return the event of the last map, or NULL if there were none
+ */
+static cl_event map_locked(struct svm_obj *obj, uint64_t mask, cl_map_flags flags, cl_event wait) {
+    cl_event ev = NULL;
+
+    for (unsigned i = 0; i < SVM_MAX_CHUNKS; i++) {
+        if (!(mask & (1ull << i)))
+            continue;
+        if (ev)
+            clReleaseEvent(ev);
+        runtime_fatal_errmsg(clEnqueueSVMMap(opencl_cmd_queue, CL_FALSE, flags,
+                    obj->base + i * obj->chunk, chunk_size(obj, i),
+                    wait ? 1 : 0, wait ? &wait : NULL, &ev), __func__);
+    }
+    obj->mapped |= mask;
+    return ev;
+}
+
+/**
+ * Unmap the chunks of {@obj} in {@mask}, and make them the last unmap.
+ */
+static void unmap_locked(struct svm_obj *obj, uint64_t mask) {
+    for (unsigned i = 0; i < SVM_MAX_CHUNKS; i++) {
+        if (!(mask & (1ull << i)))
+            continue;
+        if (last_unmap)
+            clReleaseEvent(last_unmap);
+        runtime_fatal_errmsg(clEnqueueSVMUnmap(opencl_cmd_queue,
+                    obj->base + i * obj->chunk, 0, NULL, &last_unmap), __func__);
+    }
+    obj->mapped &= ~mask;
+}
+
+static void wait_release(cl_event ev) {
+    if (!ev)
+        return;
+    runtime_fatal_errmsg(clWaitForEvents(1, &ev), __func__);
+    clReleaseEvent(ev);
+}
+
+int b2c_svm_track(void *base, size_t size) {
+    struct svm_obj *obj;
+    size_t chunk;
+    unsigned i;
+    cl_event ev;
+
+    if (opencl_finegrained || size == 0)
+        return 0;
+
+    /* whole multiples of the smallest chunk */
+    chunk = (size + SVM_MAX_CHUNKS - 1) / SVM_MAX_CHUNKS;
+    chunk = (chunk + SVM_MIN_CHUNK - 1) / SVM_MIN_CHUNK * SVM_MIN_CHUNK;
+
+    pthread_mutex_lock(&svm_lock);
+    if (num_objs == max_objs) {
+        unsigned new_max = max_objs ? 2 * max_objs : 64;
+        struct svm_obj *new_objs = internal_realloc(objs, new_max * sizeof *objs);
+
+        if (!new_objs) {
+            pthread_mutex_unlock(&svm_lock);
+            return -1;
+        }
+        objs = new_objs;
+        max_objs = new_max;
+    }
+    i = upper_bound_locked(base);
+    memmove(&objs[i + 1], &objs[i], (num_objs - i) * sizeof *objs);
+    num_objs++;
+    obj = &objs[i];
+    memset(obj, 0, sizeof *obj);
+    obj->base = base;
+    obj->size = size;
+    obj->chunk = chunk;
+    /* nothing to copy to the host: the contents are undefined anyway */
+    ev = map_locked(obj, chunk_mask(obj, base, size), CL_MAP_WRITE_INVALIDATE_REGION, NULL);
+    pthread_mutex_unlock(&svm_lock);
+
+    wait_release(ev);
+    return 0;
+}
+
+void b2c_svm_untrack(void *base) {
+    struct svm_obj *obj;
+    cl_event ev = NULL;
+
+    if (opencl_finegrained)
+        return;
+
+    pthread_mutex_lock(&svm_lock);
+    if (!(obj = find_locked(base)) || obj->base != base) {
+        pthread_mutex_unlock(&svm_lock);
+        return;
+    }
+    if (obj->mapped) {
+        unmap_locked(obj, obj->mapped);
+        /* the allocation must outlive the unmaps */
+        clRetainEvent(ev = last_unmap);
+    }
+    memmove(obj, obj + 1, (&objs[num_objs] - (obj + 1)) * sizeof *objs);
+    num_objs--;
+    pthread_mutex_unlock(&svm_lock);
+
+    wait_release(ev);
+}
+
+void b2c_svm_unmap(const void *ptr, size_t size) {
+    struct svm_obj *obj;
+    uint64_t mask;
+
+    if (opencl_finegrained || size == 0)
+        return;
+
+    pthread_mutex_lock(&svm_lock);
+    if (!(obj = find_locked(ptr))) {
+        pthread_mutex_unlock(&svm_lock);
+        return;
+    }
+    mask = chunk_mask(obj, ptr, size);
+    for (unsigned i = 0; i < num_chunks(obj); i++)
+        if (mask & (1ull << i)) {
+            obj->users[i]++;
+            if (obj->mapped & (1ull << i)) {
+                b2c_svm_unmapped++;
+                b2c_svm_unmapped_bytes += chunk_size(obj, i);
+            }
+        }
+    unmap_locked(obj, mask & obj->mapped);
+
+    if (last_unmap && unmap_event != last_unmap) {
+        if (unmap_event)
+            clReleaseEvent(unmap_event);
+        clRetainEvent(unmap_event = last_unmap);
+    }
+    pthread_mutex_unlock(&svm_lock);
+}
+
+void b2c_svm_map(const void *ptr, size_t size) {
+    struct svm_obj *obj;
+    struct b2c_event *last;
+    uint64_t mask, idle = 0;
+    cl_event ev;
+
+    if (opencl_finegrained || size == 0)
+        return;
+
+    pthread_mutex_lock(&svm_lock);
+    if (!(obj = find_locked(ptr))) {
+        pthread_mutex_unlock(&svm_lock);
+        return;
+    }
+    mask = chunk_mask(obj, ptr, size);
+    for (unsigned i = 0; i < num_chunks(obj); i++)
+        if ((mask & (1ull << i)) && obj->users[i] && --obj->users[i] == 0)
+            idle |= 1ull << i;
+    idle &= ~obj->mapped;
+    b2c_svm_mapped += __builtin_popcountll(idle);
+    last = b2c_sched_last();
+    ev = map_locked(obj, idle, CL_MAP_READ | CL_MAP_WRITE, last ? last->event : NULL);
+    pthread_mutex_unlock(&svm_lock);
+
+    wait_release(ev);
+}
+
+cl_event b2c_svm_take_event(void) {
+    cl_event ev = unmap_event;
+
+    unmap_event = NULL;
+    return ev;
+}
+
+#else
+
+int b2c_svm_track(void *base, size_t size) {
+    return 0;
+}
+
+void b2c_svm_untrack(void *base) {
+}
+
+void b2c_svm_unmap(const void *ptr, size_t size) {
+}
+
+void b2c_svm_map(const void *ptr, size_t size) {
+}
+
+#endif
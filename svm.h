@@ -0,0 +1,69 @@
+#ifndef SVM_H
+#define SVM_H
+
+#include <stddef.h>
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host mappings of managed objects in coarse-grained SVM (OpenCL only).
+ *
+ * Coarse-grained SVM can be accessed by the host only while it is mapped,
+ * and by the device only while it is not. Each managed object is mapped in
+ * up to 64 chunks, which are unmapped and mapped again separately: a call
+ * unmaps only the chunks of its operands, without waiting, and the call
+ * itself waits for the unmaps (see b2c_sched_begin()). Once the call is
+ * done, those chunks are mapped again and the rest of the object stays
+ * mapped all along. Chunks are the unit because clEnqueueSVMUnmap() can
+ * only release a whole mapping, not part of one.
+ *
+ * With fine-grained SVM, and on CUDA, these do nothing.
+ */
+
+/** chunks unmapped for calls, and mapped again after them */
+extern size_t b2c_svm_unmapped, b2c_svm_mapped;
+
+/** bytes unmapped for calls */
+extern size_t b2c_svm_unmapped_bytes;
+
+/**
+ * Start tracking the mappings of the allocation [{@base}, {@base} + {@size}),
+ * and map it for the host. Its contents are undefined.
+ * @return 0 on success, < 0 on error
+ */
+int b2c_svm_track(void *base, size_t size);
+
+/**
+ * Unmap what is left mapped of the allocation at {@base}, and stop
+ * tracking it. Called before the allocation is freed.
+ */
+void b2c_svm_untrack(void *base);
+
+/**
+ * Unmap the chunks that [{@ptr}, {@ptr} + {@size}) overlaps, for the next
+ * call issued by this thread.
+ */
+void b2c_svm_unmap(const void *ptr, size_t size);
+
+/**
+ * Map the chunks that [{@ptr}, {@ptr} + {@size}) overlaps for the host
+ * again, once the last call of this thread is done with them.
+ */
+void b2c_svm_map(const void *ptr, size_t size);
+
+#if USE_OPENCL
+/**
+ * The event that the next call of this thread has to wait for before it
+ * uses the chunks unmapped for it, or NULL. The caller releases it.
+ */
+cl_event b2c_svm_take_event(void);
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
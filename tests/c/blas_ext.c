@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * BLAS-like extensions: axpby, gemmt (triangular part of a gemm) and
+ * scaled matrix copies and transpositions (omatcopy, imatcopy), compared
+ * against naive loops. gemmt is skipped if the BLAS library doesn't have
+ * it.
+ */
+
+#ifndef USE_MKL
+/* not in every CBLAS: provided by MKL and recent OpenBLAS, or by libgpublas when preloaded */
+void cblas_dgemmt(const CBLAS_LAYOUT Layout, const CBLAS_UPLO uplo,
+        const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+        const int n, const int k,
+        const double alpha, const double *a, const int lda,
+        const double *b, const int ldb,
+        const double beta, double *c, const int ldc) __attribute__((weak));
+#define HAVE_WEAK_GEMMT
+#endif
+
+#if !defined(USE_MKL) && !defined(OPENBLAS_CONST)
+void cblas_daxpby(const int n, const double alpha, const double *x, const int incx,
+        const double beta, double *y, const int incy) __attribute__((weak));
+
+void cblas_domatcopy(const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE trans,
+        const int rows, const int cols, const double alpha,
+        const double *a, const int lda, double *b, const int ldb) __attribute__((weak));
+
+void cblas_dimatcopy(const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE trans,
+        const int rows, const int cols, const double alpha,
+        double *a, const int lda, const int ldb) __attribute__((weak));
+#define HAVE_WEAK_EXT
+#endif
+
+bool print_res = true;
+
+int n;
+bool have_gemmt = true;
+double *vec_x, *vec_y;
+double *mat_A, *mat_B, *mat_C, *mat_T, *mat_I;
+
+static double init_A(int i) { return (double) (i % 11) / 11; }
+static double init_B(int i) { return (double) (i % 5) - 2; }
+static double init_C(int i) { return (double) (i % 7); }
+
+int prologue(int num) {
+    vec_x = malloc(n * n * sizeof *vec_x);
+    vec_y = malloc(n * n * sizeof *vec_y);
+    mat_A = malloc(n * n * sizeof *mat_A);
+    mat_B = malloc(n * n * sizeof *mat_B);
+    mat_C = malloc(n * n * sizeof *mat_C);
+    mat_T = malloc(n * n * sizeof *mat_T);
+    mat_I = malloc(n * n * sizeof *mat_I);
+    if (!vec_x || !vec_y || !mat_A || !mat_B || !mat_C || !mat_T || !mat_I) {
+        free(vec_x); free(vec_y);
+        free(mat_A); free(mat_B); free(mat_C); free(mat_T); free(mat_I);
+        return -1;
+    }
+
+    for (int i = 0; i < n * n; ++i) {
+        vec_x[i] = init_A(i);
+        vec_y[i] = init_B(i);
+        mat_A[i] = init_A(i);
+        mat_B[i] = init_B(i);
+        mat_C[i] = init_C(i);
+        mat_I[i] = init_C(i);
+    }
+
+    return 0;
+}
+
+void test_blas_ext(void) {
+    /* y = 2 x + 0.5 y */
+    cblas_daxpby(n * n, 2.0, vec_x, 1, 0.5, vec_y, 1);
+    /* lower triangle of C = A B + C */
+    if (have_gemmt)
+        cblas_dgemmt(CblasRowMajor, CblasLower, CblasNoTrans, CblasNoTrans, n, n,
+                1.0, mat_A, n, mat_B, n, 1.0, mat_C, n);
+    /* T = 2 A^T */
+    cblas_domatcopy(CblasRowMajor, CblasTrans, n, n, 2.0, mat_A, n, mat_T, n);
+    /* I = I^T */
+    cblas_dimatcopy(CblasColMajor, CblasTrans, n, n, 1.0, mat_I, n, n);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    for (int i = 0; i < n * n; ++i)
+        if (vec_y[i] != 2 * init_A(i) + 0.5 * init_B(i)) {
+            fprintf(stderr, "daxpby: element %d is %f, expected %f\n",
+                    i, vec_y[i], 2 * init_A(i) + 0.5 * init_B(i));
+            ret = -1;
+            goto out;
+        }
+
+    for (int i = 0; i < n && have_gemmt; ++i)
+        for (int j = 0; j < n; ++j) {
+            double expected = init_C(idx(i, j, n, n));
+
+            if (j <= i)
+                for (int l = 0; l < n; ++l)
+                    expected += init_A(idx(i, l, n, n)) * init_B(idx(l, j, n, n));
+            if (fabs(mat_C[idx(i, j, n, n)] - expected) > 1e-12 * n * (1 + fabs(expected))) {
+                fprintf(stderr, "dgemmt: C(%d,%d) is %f, expected %f\n",
+                        i, j, mat_C[idx(i, j, n, n)], expected);
+                ret = -1;
+                goto out;
+            }
+        }
+
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            if (mat_T[idx(i, j, n, n)] != 2 * init_A(idx(j, i, n, n))) {
+                fprintf(stderr, "domatcopy: T(%d,%d) is %f, expected %f\n",
+                        i, j, mat_T[idx(i, j, n, n)], 2 * init_A(idx(j, i, n, n)));
+                ret = -1;
+                goto out;
+            }
+            if (mat_I[fidx(i, j, n, n)] != init_C(fidx(j, i, n, n))) {
+                fprintf(stderr, "dimatcopy: I(%d,%d) is %f, expected %f\n",
+                        i, j, mat_I[fidx(i, j, n, n)], init_C(fidx(j, i, n, n)));
+                ret = -1;
+                goto out;
+            }
+        }
+
+out:
+    free(vec_x); free(vec_y);
+    free(mat_A); free(mat_B); free(mat_C); free(mat_T); free(mat_I);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+#ifdef HAVE_WEAK_EXT
+    if (!cblas_daxpby || !cblas_domatcopy || !cblas_dimatcopy) {
+        fprintf(stderr, "%s: the BLAS library has no axpby or matcopy\n", argv[0]);
+        return 0;
+    }
+#endif
+#ifdef HAVE_WEAK_GEMMT
+    if (!cblas_dgemmt) {
+        fprintf(stderr, "%s: the BLAS library has no gemmt, skipping it\n", argv[0]);
+        have_gemmt = false;
+    }
+#endif
+    run_test(N_TESTS, &prologue, &test_blas_ext, &epilogue, &pinfo);
+    print_perfinfo("DAXPBY+DGEMMT+DOMATCOPY+DIMATCOPY", n, &pinfo);
+
+    return 0;
+}
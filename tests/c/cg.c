@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Conjugate gradient on a dense SPD matrix, called through the Fortran
+ * interface. Every iteration is a chain of Level 1 and 2 calls on the same
+ * vectors, which only pays off on the device if they stay resident there.
+ */
+
+extern void dgemv_(const char *, const int *, const int *, const double *,
+        const double *, const int *, const double *, const int *,
+        const double *, double *, const int *);
+extern double ddot_(const int *, const double *, const int *, const double *, const int *);
+extern double dnrm2_(const int *, const double *, const int *);
+extern void daxpy_(const int *, const double *, const double *, const int *, double *, const int *);
+extern void dscal_(const int *, const double *, double *, const int *);
+extern void dcopy_(const int *, const double *, const int *, double *, const int *);
+
+#define MAX_ITERS   100
+
+bool print_res = true;
+
+int n;
+double *mat_A, *vec_b, *vec_x, *vec_r, *vec_p, *vec_Ap;
+double resid;
+
+int prologue(int num) {
+    if (!(mat_A = calloc(n * n, sizeof *mat_A)))
+        return -1;
+    if (!(vec_b = calloc(n, sizeof *vec_b))
+            || !(vec_x = calloc(n, sizeof *vec_x))
+            || !(vec_r = calloc(n, sizeof *vec_r))
+            || !(vec_p = calloc(n, sizeof *vec_p))
+            || !(vec_Ap = calloc(n, sizeof *vec_Ap))) {
+        free(mat_A);
+        free(vec_b);
+        free(vec_x);
+        free(vec_r);
+        free(vec_p);
+        return -1;
+    }
+
+    /* symmetric and diagonally dominant */
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i)
+            mat_A[fidx(i, j, n, n)] = i == j ? 2 * n : 1.0 / (1 + abs(i - j));
+        vec_b[j] = j % 7 + 1;
+    }
+
+    return 0;
+}
+
+void test_cg(void) {
+    const int inc = 1;
+    const double one = 1, zero = 0;
+    double rr, rr_new, alpha, beta;
+
+    /* x = 0, r = p = b */
+    dscal_(&n, &zero, vec_x, &inc);
+    dcopy_(&n, vec_b, &inc, vec_r, &inc);
+    dcopy_(&n, vec_b, &inc, vec_p, &inc);
+    rr = ddot_(&n, vec_r, &inc, vec_r, &inc);
+
+    for (int k = 0; k < MAX_ITERS && rr > 1e-20; ++k) {
+        dgemv_("N", &n, &n, &one, mat_A, &n, vec_p, &inc, &zero, vec_Ap, &inc);
+        alpha = rr / ddot_(&n, vec_p, &inc, vec_Ap, &inc);
+        daxpy_(&n, &alpha, vec_p, &inc, vec_x, &inc);
+        alpha = -alpha;
+        daxpy_(&n, &alpha, vec_Ap, &inc, vec_r, &inc);
+        rr_new = ddot_(&n, vec_r, &inc, vec_r, &inc);
+        beta = rr_new / rr;
+        rr = rr_new;
+        /* p = r + beta * p */
+        dscal_(&n, &beta, vec_p, &inc);
+        daxpy_(&n, &one, vec_r, &inc, vec_p, &inc);
+    }
+
+    resid = dnrm2_(&n, vec_r, &inc);
+}
+
+int epilogue(int num) {
+    if (num == N_TESTS - 1 && print_res)
+        printf("n = %d: |r| = %e\n", n, resid);
+
+    free(mat_A);
+    free(vec_b);
+    free(vec_x);
+    free(vec_r);
+    free(vec_p);
+    free(vec_Ap);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+    run_test(N_TESTS, &prologue, &test_cg, &epilogue, &pinfo);
+    print_perfinfo("CG", n, &pinfo);
+
+    return 0;
+}
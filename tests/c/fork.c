@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test.h"
+
+/*
+ * fork() right after a gemm call, like a program that runs a helper
+ * process. The child checks the result of the call, runs gemm calls of its
+ * own on the same matrices and frees and reallocates them, which must
+ * neither hang nor crash. The parent checks that the child did not change
+ * its matrices.
+ */
+
+bool print_res = true;
+
+int n;
+
+static double *A, *B, *C;
+static int failed;
+
+/* C = 2 A, A(i, j) = (i + j) % 5 */
+static bool check(const double *M, double factor) {
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i)
+            if (M[fidx(i, j, n, n)] != factor * ((i + j) % 5))
+                return false;
+    return true;
+}
+
+int prologue(int num) {
+    A = calloc(n * n, sizeof *A);
+    B = calloc(n * n, sizeof *B);
+    C = calloc(n * n, sizeof *C);
+    if (!A || !B || !C)
+        return -1;
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i)
+            A[fidx(i, j, n, n)] = (i + j) % 5;
+    for (int i = 0; i < n; ++i)
+        B[fidx(i, i, n, n)] = 2.0;
+    return 0;
+}
+
+/* in the child */
+static int child_main(void) {
+    double *D;
+
+    if (!check(C, 2.0)) {
+        fprintf(stderr, "child: result of the call before fork() is wrong\n");
+        return 1;
+    }
+    /* C = 4 A */
+    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+            2.0, A, n, B, n, 0.0, C, n);
+    if (!check(C, 4.0)) {
+        fprintf(stderr, "child: result of the call in the child is wrong\n");
+        return 1;
+    }
+    if (!(D = realloc(B, 2 * n * n * sizeof *D))) {
+        fprintf(stderr, "child: failed to reallocate B\n");
+        return 1;
+    }
+    free(D);
+    free(A);
+    free(C);
+    return 0;
+}
+
+void test_fork(void) {
+    pid_t pid;
+    int status;
+
+    /* C = 2 A */
+    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+            1.0, A, n, B, n, 0.0, C, n);
+    fflush(stdout);
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        abort();
+    }
+    if (pid == 0)
+        exit(child_main());
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        failed = 1;
+    if (!check(C, 2.0)) {
+        fprintf(stderr, "parent: the child changed C\n");
+        failed = 1;
+    }
+}
+
+int epilogue(int num) {
+    int ret = failed ? -1 : 0;
+
+    free(A);
+    free(B);
+    free(C);
+    failed = 0;
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+    run_test(N_TESTS, &prologue, &test_fork, &epilogue, &pinfo);
+    print_perfinfo("DGEMM and fork()", n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "test.h"
+
+/*
+ * Many threads making one medium gemm call each at the same moment, a few
+ * times over, like the threads of an OpenMP loop. No call beats the host
+ * on its own; with libgpublas preloaded, calls of different threads that
+ * arrive together should be gathered into batched kernels once the
+ * arrival rate has been measured.
+ *
+ * B = 2I, so each call doubles the thread's matrix exactly.
+ */
+
+#define NUM_THREADS 32
+#define NUM_ROUNDS  4
+
+bool print_res = true;
+
+int n;
+double *mat_B, *mat_X[NUM_THREADS], *mat_Y[NUM_THREADS];
+pthread_barrier_t barrier;
+
+int prologue(int num) {
+    if (!(mat_B = calloc(n * n, sizeof *mat_B)))
+        return -1;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        if (!(mat_X[t] = calloc(n * n, sizeof *mat_X[t]))
+                || !(mat_Y[t] = calloc(n * n, sizeof *mat_Y[t]))) {
+            free(mat_X[t]);
+            while (t-- > 0) {
+                free(mat_X[t]);
+                free(mat_Y[t]);
+            }
+            free(mat_B);
+            return -1;
+        }
+
+    for (int i = 0; i < n; ++i)
+        mat_B[i * n + i] = 2.0;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        for (int i = 0; i < n * n; ++i)
+            mat_X[t][i] = (i + t) % 7;
+
+    return 0;
+}
+
+static void *thread_rounds(void *arg) {
+    int t = (int) (long) arg;
+
+    for (int r = 0; r < NUM_ROUNDS; ++r) {
+        pthread_barrier_wait(&barrier);
+        /* Y = X B + Y */
+        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                1.0, mat_X[t], n, mat_B, n, 1.0, mat_Y[t], n);
+    }
+    return NULL;
+}
+
+void test_gather(void) {
+    pthread_t threads[NUM_THREADS];
+
+    for (int t = 0; t < NUM_THREADS; ++t)
+        if (pthread_create(&threads[t], NULL, thread_rounds, (void *) (long) t) != 0) {
+            fprintf(stderr, "failed to create thread %d\n", t);
+            abort();
+        }
+    for (int t = 0; t < NUM_THREADS; ++t)
+        pthread_join(threads[t], NULL);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    for (int t = 0; t < NUM_THREADS && ret == 0; ++t)
+        for (int i = 0; i < n * n; ++i)
+            if (mat_Y[t][i] != 2 * NUM_ROUNDS * ((i + t) % 7)) {
+                fprintf(stderr, "thread %d: element %d is wrong\n", t, i);
+                ret = -1;
+                break;
+            }
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        free(mat_X[t]);
+        free(mat_Y[t]);
+    }
+    free(mat_B);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    pthread_barrier_init(&barrier, NULL, NUM_THREADS);
+    snprintf(name, sizeof name, "DGEMM %d threads x%d", NUM_THREADS, NUM_ROUNDS);
+    run_test(N_TESTS, &prologue, &test_gather, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+    pthread_barrier_destroy(&barrier);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Complex gemm with the 3M algorithm (cblas_cgemm3m, cblas_zgemm3m),
+ * compared against cblas_cgemm and cblas_zgemm. 3M trades some accuracy
+ * for fewer flops, so results are compared with a tolerance.
+ */
+
+#if !defined(USE_MKL) && !defined(OPENBLAS_CONST)
+/* not in every CBLAS: provided by MKL and OpenBLAS, or by libgpublas when preloaded */
+void cblas_cgemm3m(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const void *alpha, const void *a, const int lda,
+        const void *b, const int ldb,
+        const void *beta, void *c, const int ldc) __attribute__((weak));
+
+void cblas_zgemm3m(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const void *alpha, const void *a, const int lda,
+        const void *b, const int ldb,
+        const void *beta, void *c, const int ldc) __attribute__((weak));
+#define HAVE_WEAK_GEMM3M
+#endif
+
+bool print_res = true;
+
+int n;
+complex float *mat_CA, *mat_CB, *mat_CC;
+complex double *mat_ZA, *mat_ZB, *mat_ZC;
+
+static const complex float c_alpha = 0.5f + 1.0f * I, c_beta = 1.0f - 0.25f * I;
+static const complex double z_alpha = 0.5 + 1.0 * I, z_beta = 1.0 - 0.25 * I;
+
+int prologue(int num) {
+    mat_CA = malloc(n * n * sizeof *mat_CA);
+    mat_CB = malloc(n * n * sizeof *mat_CB);
+    mat_CC = malloc(n * n * sizeof *mat_CC);
+    mat_ZA = malloc(n * n * sizeof *mat_ZA);
+    mat_ZB = malloc(n * n * sizeof *mat_ZB);
+    mat_ZC = malloc(n * n * sizeof *mat_ZC);
+    if (!mat_CA || !mat_CB || !mat_CC || !mat_ZA || !mat_ZB || !mat_ZC) {
+        free(mat_CA); free(mat_CB); free(mat_CC);
+        free(mat_ZA); free(mat_ZB); free(mat_ZC);
+        return -1;
+    }
+
+    for (int i = 0; i < n * n; ++i) {
+        mat_ZA[i] = (double) (i % 11) / 11 - I * (double) (i % 3) / 3;
+        mat_ZB[i] = (double) (i % 5) / 5 + I * 0.25;
+        mat_ZC[i] = (double) (i % 7) - I;
+        mat_CA[i] = mat_ZA[i];
+        mat_CB[i] = mat_ZB[i];
+        mat_CC[i] = mat_ZC[i];
+    }
+
+    return 0;
+}
+
+void test_gemm3m(void) {
+    cblas_cgemm3m(CblasColMajor, CblasNoTrans, CblasConjTrans, n, n, n,
+            &c_alpha, mat_CA, n, mat_CB, n, &c_beta, mat_CC, n);
+    cblas_zgemm3m(CblasRowMajor, CblasTrans, CblasNoTrans, n, n, n,
+            &z_alpha, mat_ZA, n, mat_ZB, n, &z_beta, mat_ZC, n);
+}
+
+int epilogue(int num) {
+    complex float *c_ref = malloc(n * n * sizeof *c_ref);
+    complex double *z_ref = malloc(n * n * sizeof *z_ref);
+    int ret = 0;
+
+    if (!c_ref || !z_ref) {
+        ret = -1;
+        goto out;
+    }
+
+    /* C as set by prologue() */
+    for (int i = 0; i < n * n; ++i) {
+        z_ref[i] = (double) (i % 7) - I;
+        c_ref[i] = z_ref[i];
+    }
+    cblas_cgemm(CblasColMajor, CblasNoTrans, CblasConjTrans, n, n, n,
+            &c_alpha, mat_CA, n, mat_CB, n, &c_beta, c_ref, n);
+    cblas_zgemm(CblasRowMajor, CblasTrans, CblasNoTrans, n, n, n,
+            &z_alpha, mat_ZA, n, mat_ZB, n, &z_beta, z_ref, n);
+
+    for (int i = 0; i < n * n; ++i)
+        if (cabsf(mat_CC[i] - c_ref[i]) > 1e-5f * n * (1 + cabsf(c_ref[i]))) {
+            fprintf(stderr, "cgemm3m: element %d is %f%+fi, expected %f%+fi\n", i,
+                    crealf(mat_CC[i]), cimagf(mat_CC[i]), crealf(c_ref[i]), cimagf(c_ref[i]));
+            ret = -1;
+            break;
+        }
+
+    for (int i = 0; i < n * n && ret == 0; ++i)
+        if (cabs(mat_ZC[i] - z_ref[i]) > 1e-13 * n * (1 + cabs(z_ref[i]))) {
+            fprintf(stderr, "zgemm3m: element %d is %f%+fi, expected %f%+fi\n", i,
+                    creal(mat_ZC[i]), cimag(mat_ZC[i]), creal(z_ref[i]), cimag(z_ref[i]));
+            ret = -1;
+            break;
+        }
+
+out:
+    free(c_ref);
+    free(z_ref);
+    free(mat_CA); free(mat_CB); free(mat_CC);
+    free(mat_ZA); free(mat_ZB); free(mat_ZC);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+#ifdef HAVE_WEAK_GEMM3M
+    if (!cblas_cgemm3m || !cblas_zgemm3m) {
+        fprintf(stderr, "%s: the BLAS library has no 3M gemm\n", argv[0]);
+        return 0;
+    }
+#endif
+    run_test(N_TESTS, &prologue, &test_gemm3m, &epilogue, &pinfo);
+    print_perfinfo("CGEMM3M+ZGEMM3M", n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Batched gemm (MKL's cblas_?gemm_batch and cblas_?gemm_batch_strided),
+ * compared against the same problems computed one by one with
+ * cblas_?gemm. With libgpublas preloaded and the matrices in managed
+ * memory, the groups should run as batched kernels on the device.
+ *
+ *   group 0: NUM_PROBLEMS problems, C = A B
+ *   group 1: 3 problems, C = 2 A^T B + 0.5 C (small, run one by one)
+ *   strided: NUM_PROBLEMS row-major problems, and NUM_PROBLEMS complex ones
+ *
+ * Before the run at N, the problems are checked at a few odd sizes. Run
+ * with the matrices in managed memory (e.g. BLAS2CUDA_OPTIONS=heuristic=true):
+ * they are freed and allocated again every round, and the batches use
+ * pointers into them, which must not outlive them.
+ */
+
+#define NUM_PROBLEMS    16
+#define NUM_GROUP1      3
+#define NUM_MATRICES    (NUM_PROBLEMS + NUM_GROUP1)
+
+static const int check_sizes[] = { 3, 5, 7, 9, 13 };
+
+#ifndef USE_MKL
+/* not in every CBLAS: provided by MKL, or by libgpublas when preloaded */
+void cblas_dgemm_batch(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE *transa_array, const CBLAS_TRANSPOSE *transb_array,
+        const int *m_array, const int *n_array, const int *k_array,
+        const double *alpha_array,
+        const double **a_array, const int *lda_array,
+        const double **b_array, const int *ldb_array,
+        const double *beta_array,
+        double **c_array, const int *ldc_array,
+        const int group_count, const int *group_size) __attribute__((weak));
+
+void cblas_dgemm_batch_strided(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const double alpha,
+        const double *a, const int lda, const int stridea,
+        const double *b, const int ldb, const int strideb,
+        const double beta,
+        double *c, const int ldc, const int stridec,
+        const int batch_size) __attribute__((weak));
+
+void cblas_zgemm_batch_strided(const CBLAS_LAYOUT Layout,
+        const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+        const int m, const int n, const int k,
+        const void *alpha,
+        const void *a, const int lda, const int stridea,
+        const void *b, const int ldb, const int strideb,
+        const void *beta,
+        void *c, const int ldc, const int stridec,
+        const int batch_size) __attribute__((weak));
+#endif
+
+bool print_res = true;
+
+int n;
+int failures;
+double *mat_A, *mat_B, *mat_C, *mat_S;
+complex double *mat_ZA, *mat_ZB, *mat_ZC;
+
+int prologue(int num) {
+    const int count = NUM_MATRICES * n * n;
+
+    mat_A = malloc(count * sizeof *mat_A);
+    mat_B = malloc(count * sizeof *mat_B);
+    mat_C = malloc(count * sizeof *mat_C);
+    mat_S = malloc(NUM_PROBLEMS * n * n * sizeof *mat_S);
+    mat_ZA = malloc(NUM_PROBLEMS * n * n * sizeof *mat_ZA);
+    mat_ZB = malloc(NUM_PROBLEMS * n * n * sizeof *mat_ZB);
+    mat_ZC = malloc(NUM_PROBLEMS * n * n * sizeof *mat_ZC);
+    if (!mat_A || !mat_B || !mat_C || !mat_S || !mat_ZA || !mat_ZB || !mat_ZC) {
+        free(mat_A); free(mat_B); free(mat_C); free(mat_S);
+        free(mat_ZA); free(mat_ZB); free(mat_ZC);
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        mat_A[i] = (double) (i % 13) / 13;
+        mat_B[i] = (double) (i % 7) / 7 - 0.5;
+        mat_C[i] = (double) (i % 5);
+    }
+    for (int i = 0; i < NUM_PROBLEMS * n * n; ++i) {
+        mat_ZA[i] = (double) (i % 11) / 11 + I * ((i % 3) - 1);
+        mat_ZB[i] = (double) (i % 5) / 5 - I * 0.25;
+        mat_ZC[i] = 0;
+    }
+
+    return 0;
+}
+
+void test_gemm_batch(void) {
+    const CBLAS_TRANSPOSE transa[] = { CblasNoTrans, CblasTrans };
+    const CBLAS_TRANSPOSE transb[] = { CblasNoTrans, CblasNoTrans };
+    const int dims[] = { n, n }, ld[] = { n, n };
+    const double alpha[] = { 1.0, 2.0 }, beta[] = { 0.0, 0.5 };
+    const int group_size[] = { NUM_PROBLEMS, NUM_GROUP1 };
+    const double *a[NUM_MATRICES], *b[NUM_MATRICES];
+    double *c[NUM_MATRICES];
+    const complex double zalpha = 1.0 - 0.5 * I, zbeta = 0;
+
+    for (int i = 0; i < NUM_MATRICES; ++i) {
+        a[i] = mat_A + i * n * n;
+        b[i] = mat_B + i * n * n;
+        c[i] = mat_C + i * n * n;
+    }
+
+    cblas_dgemm_batch(CblasColMajor, transa, transb, dims, dims, dims,
+            alpha, a, ld, b, ld, beta, c, ld, 2, group_size);
+    cblas_dgemm_batch_strided(CblasRowMajor, CblasNoTrans, CblasTrans, n, n, n,
+            1.0, mat_A, n, n * n, mat_B, n, n * n, 0.0, mat_S, n, n * n, NUM_PROBLEMS);
+    cblas_zgemm_batch_strided(CblasColMajor, CblasConjTrans, CblasNoTrans, n, n, n,
+            &zalpha, mat_ZA, n, n * n, mat_ZB, n, n * n, &zbeta, mat_ZC, n, n * n, NUM_PROBLEMS);
+}
+
+static bool near(complex double x, complex double ref) {
+    return cabs(x - ref) <= 1e-9 * (1 + cabs(ref));
+}
+
+int epilogue(int num) {
+    const complex double zalpha = 1.0 - 0.5 * I, zbeta = 0;
+    double *ref = malloc(n * n * sizeof *ref);
+    complex double *zref = malloc(n * n * sizeof *zref);
+    int ret = 0;
+
+    if (!ref || !zref) {
+        ret = -1;
+        goto out;
+    }
+
+    /* C was set by the prologue before the batched calls */
+    for (int p = 0; p < NUM_MATRICES && ret == 0; ++p) {
+        const double *A = mat_A + p * n * n, *B = mat_B + p * n * n;
+
+        for (int i = 0; i < n * n; ++i)
+            ref[i] = (double) ((p * n * n + i) % 5);
+        if (p < NUM_PROBLEMS)
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                    1.0, A, n, B, n, 0.0, ref, n);
+        else
+            cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, n, n, n,
+                    2.0, A, n, B, n, 0.5, ref, n);
+        for (int i = 0; i < n * n; ++i)
+            if (!near(mat_C[p * n * n + i], ref[i])) {
+                fprintf(stderr, "gemm_batch: problem %d: element %d is %f, expected %f\n",
+                        p, i, mat_C[p * n * n + i], ref[i]);
+                ret = -1;
+                break;
+            }
+    }
+
+    for (int p = 0; p < NUM_PROBLEMS && ret == 0; ++p) {
+        cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, n, n, n,
+                1.0, mat_A + p * n * n, n, mat_B + p * n * n, n, 0.0, ref, n);
+        for (int i = 0; i < n * n; ++i)
+            if (!near(mat_S[p * n * n + i], ref[i])) {
+                fprintf(stderr, "gemm_batch_strided: problem %d: element %d is %f, expected %f\n",
+                        p, i, mat_S[p * n * n + i], ref[i]);
+                ret = -1;
+                break;
+            }
+    }
+
+    for (int p = 0; p < NUM_PROBLEMS && ret == 0; ++p) {
+        cblas_zgemm(CblasColMajor, CblasConjTrans, CblasNoTrans, n, n, n,
+                &zalpha, mat_ZA + p * n * n, n, mat_ZB + p * n * n, n, &zbeta, zref, n);
+        for (int i = 0; i < n * n; ++i)
+            if (!near(mat_ZC[p * n * n + i], zref[i])) {
+                fprintf(stderr, "zgemm_batch_strided: problem %d: element %d is wrong\n", p, i);
+                ret = -1;
+                break;
+            }
+    }
+
+out:
+    failures += ret < 0;
+    free(ref);
+    free(zref);
+    free(mat_A); free(mat_B); free(mat_C); free(mat_S);
+    free(mat_ZA); free(mat_ZB); free(mat_ZC);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+#ifndef USE_MKL
+    if (!cblas_dgemm_batch || !cblas_dgemm_batch_strided || !cblas_zgemm_batch_strided) {
+        fprintf(stderr, "%s: the BLAS library has no batched gemm\n", argv[0]);
+        return 0;
+    }
+#endif
+    snprintf(name, sizeof name, "DGEMM batch of %d", NUM_MATRICES);
+    for (size_t i = 0; i < sizeof check_sizes / sizeof check_sizes[0]; ++i) {
+        const int size = n;
+
+        n = check_sizes[i];
+        run_test(N_TESTS, &prologue, &test_gemm_batch, &epilogue, &pinfo);
+        n = size;
+    }
+    if (failures)
+        return 1;
+    run_test(N_TESTS, &prologue, &test_gemm_batch, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return failures != 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Many small gemm calls of the same shape on blocks of one array, as in a
+ * blocked factorization or a batch of small problems (C_i = A_i B_i). With
+ * libgpublas preloaded and the array in managed memory, consecutive calls
+ * should be batched into a few kernels, which is reported on exit.
+ *
+ * Entries are small integers, so the results are exact.
+ */
+
+#define NUM_BLOCKS  64
+
+bool print_res = true;
+
+int n;
+double *mem, *mat_A, *mat_B, *mat_C;
+
+int prologue(int num) {
+    const int bsize = n * n;
+
+    if (!(mem = calloc(3 * NUM_BLOCKS * bsize, sizeof *mem)))
+        return -1;
+    mat_A = mem;
+    mat_B = mem + NUM_BLOCKS * bsize;
+    mat_C = mem + 2 * NUM_BLOCKS * bsize;
+
+    for (int i = 0; i < NUM_BLOCKS * bsize; ++i) {
+        mat_A[i] = (i % 5) - 2;
+        mat_B[i] = (i % 3) + 1;
+    }
+
+    return 0;
+}
+
+void test_gemm_blocks(void) {
+    for (int b = 0; b < NUM_BLOCKS; ++b)
+        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                1.0, mat_A + b * n * n, n, mat_B + b * n * n, n,
+                0.0, mat_C + b * n * n, n);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    for (int b = 0; b < NUM_BLOCKS && ret == 0; ++b) {
+        const double *A = mat_A + b * n * n, *B = mat_B + b * n * n, *C = mat_C + b * n * n;
+
+        for (int j = 0; j < n && ret == 0; ++j)
+            for (int i = 0; i < n; ++i) {
+                double sum = 0;
+
+                for (int l = 0; l < n; ++l)
+                    sum += A[fidx(i, l, n, n)] * B[fidx(l, j, n, n)];
+                if (C[fidx(i, j, n, n)] != sum) {
+                    fprintf(stderr, "block %d: C(%d,%d) = %f, expected %f\n",
+                            b, i, j, C[fidx(i, j, n, n)], sum);
+                    ret = -1;
+                    break;
+                }
+            }
+    }
+
+    free(mem);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMM %d blocks", NUM_BLOCKS);
+    run_test(N_TESTS, &prologue, &test_gemm_blocks, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+/*
+ * Sweep of small gemm calls (n = 2..128) in all precisions, called
+ * through the Fortran interface. Run once with and once without
+ * libgpublas preloaded to compare against the host BLAS.
+ *
+ * Before the sweep, the results of small calls are checked against a
+ * reference loop, for all transpose combinations, dimensions that leave
+ * tails of vectors and of the unrolled inner loop (or hit the 16, 32 and
+ * 64 inner dimensions that kernels are specialized on), and alpha/beta
+ * edge cases, among them beta = 0 with NaNs in C. The operands of the check
+ * are static, so they are not managed objects, and calls on them take the
+ * small path rather than batches. Elements are small integers, so results
+ * are exact in all precisions.
+ */
+
+extern void sgemm_(const char *, const char *, const int *, const int *, const int *,
+        const float *, const float *, const int *, const float *, const int *,
+        const float *, float *, const int *);
+extern void dgemm_(const char *, const char *, const int *, const int *, const int *,
+        const double *, const double *, const int *, const double *, const int *,
+        const double *, double *, const int *);
+extern void cgemm_(const char *, const char *, const int *, const int *, const int *,
+        const complex float *, const complex float *, const int *, const complex float *, const int *,
+        const complex float *, complex float *, const int *);
+extern void zgemm_(const char *, const char *, const int *, const int *, const int *,
+        const complex double *, const complex double *, const int *, const complex double *, const int *,
+        const complex double *, complex double *, const int *);
+
+static const int sizes[] = { 2, 4, 8, 16, 24, 32, 48, 64, 96, 128 };
+
+/* m, n, k of the check */
+static const int check_shapes[][3] = {
+    { 1, 1, 1 }, { 3, 5, 7 }, { 17, 33, 16 }, { 64, 1, 32 },
+    { 5, 127, 1 }, { 33, 17, 100 }, { 127, 65, 64 }, { 128, 31, 128 },
+};
+
+/* alpha, beta of the check; NaN in C where beta is 0 */
+static const double check_scalars[][2] = {
+    { 1.5, 0 }, { 1, 1 }, { -0.5, 2 }, { 0, -1 },
+};
+
+#define CHECK_MAX   128
+#define CHECK_PAD   3       /* added to leading dimensions */
+#define CHECK_LD    (CHECK_MAX + CHECK_PAD)
+
+static complex double check_A[CHECK_LD * CHECK_MAX];
+static complex double check_B[CHECK_LD * CHECK_MAX];
+static complex double check_C[CHECK_LD * CHECK_MAX];
+static complex double check_C0[CHECK_LD * CHECK_MAX];
+
+bool print_res = true;
+
+int reps;               /* calls per round */
+int n;
+char prec;
+void *mat_A, *mat_B, *mat_C;
+
+int prologue(int num) {
+    const size_t elem = prec == 's' ? sizeof(float) :
+                        prec == 'd' ? sizeof(double) :
+                        prec == 'c' ? sizeof(complex float) : sizeof(complex double);
+
+    if (!(mat_A = calloc(n * n, elem)))
+        return -1;
+    if (!(mat_B = calloc(n * n, elem))) {
+        free(mat_A);
+        return -1;
+    }
+    if (!(mat_C = calloc(n * n, elem))) {
+        free(mat_A);
+        free(mat_B);
+        return -1;
+    }
+
+    for (int i = 0; i < n * n; ++i) {
+        switch (prec) {
+            case 's':
+                ((float *) mat_A)[i] = i % 7;
+                ((float *) mat_B)[i] = i % 5;
+                break;
+            case 'd':
+                ((double *) mat_A)[i] = i % 7;
+                ((double *) mat_B)[i] = i % 5;
+                break;
+            case 'c':
+                ((complex float *) mat_A)[i] = (i % 7) + (i % 3) * I;
+                ((complex float *) mat_B)[i] = (i % 5) - (i % 2) * I;
+                break;
+            default:
+                ((complex double *) mat_A)[i] = (i % 7) + (i % 3) * I;
+                ((complex double *) mat_B)[i] = (i % 5) - (i % 2) * I;
+                break;
+        }
+    }
+
+    return 0;
+}
+
+void test_gemm(void) {
+    const float s_one = 1, s_zero = 0;
+    const double d_one = 1, d_zero = 0;
+    const complex float c_one = 1, c_zero = 0;
+    const complex double z_one = 1, z_zero = 0;
+
+    for (int r = 0; r < reps; ++r) {
+        switch (prec) {
+            case 's':
+                sgemm_("N", "N", &n, &n, &n, &s_one, mat_A, &n, mat_B, &n, &s_zero, mat_C, &n);
+                break;
+            case 'd':
+                dgemm_("N", "N", &n, &n, &n, &d_one, mat_A, &n, mat_B, &n, &d_zero, mat_C, &n);
+                break;
+            case 'c':
+                cgemm_("N", "N", &n, &n, &n, &c_one, mat_A, &n, mat_B, &n, &c_zero, mat_C, &n);
+                break;
+            default:
+                zgemm_("N", "N", &n, &n, &n, &z_one, mat_A, &n, mat_B, &n, &z_zero, mat_C, &n);
+                break;
+        }
+    }
+}
+
+int epilogue(int num) {
+    free(mat_A);
+    free(mat_B);
+    free(mat_C);
+    return 0;
+}
+
+/* element {@i} of {@mat}, an array of elements of precision {@p} */
+static complex double elem_get(const void *mat, char p, int i) {
+    switch (p) {
+        case 's':
+            return ((const float *) mat)[i];
+        case 'd':
+            return ((const double *) mat)[i];
+        case 'c':
+            return ((const complex float *) mat)[i];
+        default:
+            return ((const complex double *) mat)[i];
+    }
+}
+
+static void elem_set(void *mat, char p, int i, complex double v) {
+    switch (p) {
+        case 's':
+            ((float *) mat)[i] = creal(v);
+            break;
+        case 'd':
+            ((double *) mat)[i] = creal(v);
+            break;
+        case 'c':
+            ((complex float *) mat)[i] = v;
+            break;
+        default:
+            ((complex double *) mat)[i] = v;
+            break;
+    }
+}
+
+/* element (i, l) of op(M), M column-major with leading dimension {@ld} */
+static complex double op_get(const void *mat, char p, char trans, int ld, int i, int l) {
+    if (trans == 'N')
+        return elem_get(mat, p, i + l * ld);
+    if (trans == 'T')
+        return elem_get(mat, p, l + i * ld);
+    return conj(elem_get(mat, p, l + i * ld));
+}
+
+static void call_gemm(char p, char ta, char tb, int m, int n, int k,
+        complex double alpha, int lda, int ldb, complex double beta, int ldc) {
+    const float s_alpha = creal(alpha), s_beta = creal(beta);
+    const double d_alpha = creal(alpha), d_beta = creal(beta);
+    const complex float c_alpha = alpha, c_beta = beta;
+
+    switch (p) {
+        case 's':
+            sgemm_(&ta, &tb, &m, &n, &k, &s_alpha, (float *) check_A, &lda,
+                    (float *) check_B, &ldb, &s_beta, (float *) check_C, &ldc);
+            break;
+        case 'd':
+            dgemm_(&ta, &tb, &m, &n, &k, &d_alpha, (double *) check_A, &lda,
+                    (double *) check_B, &ldb, &d_beta, (double *) check_C, &ldc);
+            break;
+        case 'c':
+            cgemm_(&ta, &tb, &m, &n, &k, &c_alpha, (complex float *) check_A, &lda,
+                    (complex float *) check_B, &ldb, &c_beta, (complex float *) check_C, &ldc);
+            break;
+        default:
+            zgemm_(&ta, &tb, &m, &n, &k, &alpha, check_A, &lda,
+                    check_B, &ldb, &beta, check_C, &ldc);
+            break;
+    }
+}
+
+/**
+ * Check one call against the reference loop.
+ * @return the number of wrong elements of C
+ */
+static int check_gemm(char p, char ta, char tb, int m, int n, int k,
+        complex double alpha, complex double beta) {
+    const bool cplx = p == 'c' || p == 'z';
+    const int lda = (ta == 'N' ? m : k) + CHECK_PAD;
+    const int ldb = (tb == 'N' ? k : n) + CHECK_PAD;
+    const int ldc = m + CHECK_PAD;
+    const int cols_a = ta == 'N' ? k : m, cols_b = tb == 'N' ? n : k;
+    int wrong = 0;
+
+    for (int i = 0; i < lda * cols_a; ++i)
+        elem_set(check_A, p, i, (i * 7 % 11) - 5 + (cplx ? ((i % 5) - 2) * I : 0));
+    for (int i = 0; i < ldb * cols_b; ++i)
+        elem_set(check_B, p, i, (i * 5 % 9) - 4 + (cplx ? ((i % 3) - 1) * I : 0));
+    for (int i = 0; i < ldc * n; ++i) {
+        if (beta == 0)
+            elem_set(check_C, p, i, NAN);
+        else
+            elem_set(check_C, p, i, (i % 13) - 6 + (cplx ? ((i % 4) - 2) * I : 0));
+        check_C0[i] = elem_get(check_C, p, i);
+    }
+
+    call_gemm(p, ta, tb, m, n, k, alpha, lda, ldb, beta, ldc);
+
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < ldc; ++i) {
+            complex double ref = check_C0[i + j * ldc];
+            complex double got = elem_get(check_C, p, i + j * ldc);
+
+            if (i < m) {
+                complex double sum = 0;
+
+                for (int l = 0; l < k; ++l)
+                    sum += op_get(check_A, p, ta, lda, i, l) * op_get(check_B, p, tb, ldb, l, j);
+                ref = alpha * sum + (beta == 0 ? 0 : beta * ref);
+            }
+            /* rows past m must not be touched, NaNs included */
+            if (i < m ? got != ref : memcmp(&got, &ref, sizeof got) != 0) {
+                if (!wrong)
+                    fprintf(stderr, "%cgemm %c%c m=%d n=%d k=%d alpha=%g beta=%g: "
+                            "C(%d, %d) = %g%+gi instead of %g%+gi\n",
+                            p, ta, tb, m, n, k, creal(alpha), creal(beta), i, j,
+                            creal(got), cimag(got), creal(ref), cimag(ref));
+                wrong++;
+            }
+        }
+    return wrong;
+}
+
+/**
+ * Check small calls in all precisions, transpose combinations, shapes and
+ * alpha/beta cases.
+ * @return the number of wrong calls
+ */
+static int check_small(void) {
+    const char *precisions = "sdcz", *trans = "NTC";
+    int calls = 0, wrong = 0;
+
+    for (const char *p = precisions; *p; ++p)
+        for (const char *ta = trans; *ta; ++ta)
+            for (const char *tb = trans; *tb; ++tb)
+                for (size_t s = 0; s < sizeof check_shapes / sizeof check_shapes[0]; ++s)
+                    for (size_t a = 0; a < sizeof check_scalars / sizeof check_scalars[0]; ++a) {
+                        wrong += check_gemm(*p, *ta, *tb,
+                                check_shapes[s][0], check_shapes[s][1], check_shapes[s][2],
+                                check_scalars[a][0], check_scalars[a][1]) != 0;
+                        calls++;
+                    }
+    printf("checked %d small gemm calls: %d wrong\n", calls, wrong);
+    return wrong;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    const char *precisions = "sdcz";
+
+    parse_args(argc, argv, &reps, &print_res);
+    if (check_small())
+        return 1;
+
+    for (const char *p = precisions; *p; ++p) {
+        char name[16];
+
+        prec = *p;
+        snprintf(name, sizeof name, "%cGEMM x%d", prec - 'a' + 'A', reps);
+        for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+            n = sizes[i];
+            run_test(N_TESTS, &prologue, &test_gemm, &epilogue, &pinfo);
+            print_perfinfo(name, n, &pinfo);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Back-to-back independent gemm calls on separate matrices, whose results
+ * are only read after the last call. With libgpublas preloaded, the calls
+ * are queued on the device and the host only waits when it reads a
+ * result, so the timed region should mostly measure enqueueing.
+ */
+
+#define NUM_CALLS   8
+
+bool print_res = true;
+
+int n;
+double *mat_A, *mat_B, *mat_C[NUM_CALLS];
+
+int prologue(int num) {
+    if (!(mat_A = calloc(n * n, sizeof *mat_A)))
+        return -1;
+    if (!(mat_B = calloc(n * n, sizeof *mat_B))) {
+        free(mat_A);
+        return -1;
+    }
+    for (int i = 0; i < NUM_CALLS; ++i)
+        if (!(mat_C[i] = calloc(n * n, sizeof *mat_C[i]))) {
+            while (i-- > 0)
+                free(mat_C[i]);
+            free(mat_A);
+            free(mat_B);
+            return -1;
+        }
+
+    for (int i = 0; i < n * n; ++i) {
+        mat_A[i] = i % 7;
+        mat_B[i] = i % 5;
+    }
+
+    return 0;
+}
+
+void test_pipeline(void) {
+    for (int i = 0; i < NUM_CALLS; ++i)
+        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                1.0 + i, mat_A, n, mat_B, n, 0.0, mat_C[i], n);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    /* reading the results waits for the calls that write them */
+    for (int i = 1; i < NUM_CALLS; ++i)
+        if (mat_C[i][n * n - 1] != (1.0 + i) * mat_C[0][n * n - 1]) {
+            fprintf(stderr, "result of call %d is wrong\n", i);
+            ret = -1;
+        }
+
+    for (int i = 0; i < NUM_CALLS; ++i)
+        free(mat_C[i]);
+    free(mat_A);
+    free(mat_B);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMM x%d (enqueue)", NUM_CALLS);
+    run_test(N_TESTS, &prologue, &test_pipeline, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "test.h"
+
+/*
+ * Several processes issuing gemm calls at the same time, like the ranks of
+ * an MPI job on one node. Each rank is this program run again, and works
+ * on matrices of its own as in the threads test (X1 = X0 B, X0 = X1 B, ...,
+ * with B = 2I). The ranks inherit LD_PRELOAD, so with libgpublas preloaded
+ * they all use the device; with the broker daemon running (see
+ * host/broker.h), through it.
+ */
+
+#define NUM_RANKS   4
+#define NUM_STEPS   8       /* even, so that results end up in X0 */
+
+extern char **environ;
+
+bool print_res = true;
+
+int n;
+
+/* in a rank */
+static int rank_main(int rank) {
+    double *B, *X[2];
+    int ret = 0;
+
+    B = calloc(n * n, sizeof *B);
+    X[0] = calloc(n * n, sizeof *X[0]);
+    X[1] = calloc(n * n, sizeof *X[1]);
+    if (!B || !X[0] || !X[1]) {
+        fprintf(stderr, "rank %d: failed to allocate matrices\n", rank);
+        return 1;
+    }
+    for (int i = 0; i < n; ++i)
+        B[i * n + i] = 2.0;
+    for (int i = 0; i < n * n; ++i)
+        X[0][i] = (i + rank) % 7;
+
+    for (int s = 0; s < NUM_STEPS; ++s)
+        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                1.0, X[s % 2], n, B, n, 0.0, X[(s + 1) % 2], n);
+
+    for (int i = 0; i < n * n; ++i)
+        if (X[0][i] != (1 << NUM_STEPS) * ((i + rank) % 7)) {
+            fprintf(stderr, "rank %d: element %d is wrong\n", rank, i);
+            ret = 1;
+            break;
+        }
+
+    free(X[0]);
+    free(X[1]);
+    free(B);
+    return ret;
+}
+
+int prologue(int num) {
+    return 0;
+}
+
+static int failed;
+
+void test_ranks(void) {
+    pid_t pids[NUM_RANKS];
+    char size[16], rank[NUM_RANKS][16];
+
+    snprintf(size, sizeof size, "%d", n);
+    for (int r = 0; r < NUM_RANKS; ++r) {
+        char *argv[] = { "ranks", "--rank", rank[r], size, NULL };
+
+        snprintf(rank[r], sizeof rank[r], "%d", r);
+        if (posix_spawn(&pids[r], "/proc/self/exe", NULL, NULL, argv, environ) != 0) {
+            perror("posix_spawn");
+            abort();
+        }
+    }
+    for (int r = 0; r < NUM_RANKS; ++r) {
+        int status;
+
+        if (waitpid(pids[r], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+            failed = 1;
+    }
+}
+
+int epilogue(int num) {
+    int ret = failed ? -1 : 0;
+
+    failed = 0;
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    if (argc == 4 && strcmp(argv[1], "--rank") == 0) {
+        n = atoi(argv[3]);
+        return rank_main(atoi(argv[2]));
+    }
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMM %d ranks x%d", NUM_RANKS, NUM_STEPS);
+    run_test(N_TESTS, &prologue, &test_ranks, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * A timestep loop, x <- x + h A x, issuing the same gemv and axpy calls on
+ * the same arrays every step, compared against naive loops. With
+ * libgpublas preloaded and BLAS2CUDA_OPTIONS=async;replay, the calls of a step
+ * should be launched as one graph once the loop has gone around twice.
+ */
+
+#define NUM_STEPS   32
+#define STEP        (1.0 / 64)
+
+bool print_res = true;
+
+int n;
+double *mat_A, *vec_x, *vec_y;
+
+static double init_A(int i) { return (double) (i % 7 - 3) / 7; }
+static double init_x(int i) { return (double) (i % 5) / 5; }
+
+int prologue(int num) {
+    mat_A = malloc(n * n * sizeof *mat_A);
+    vec_x = malloc(n * sizeof *vec_x);
+    vec_y = malloc(n * sizeof *vec_y);
+    if (!mat_A || !vec_x || !vec_y) {
+        free(mat_A); free(vec_x); free(vec_y);
+        return -1;
+    }
+
+    for (int i = 0; i < n * n; ++i)
+        mat_A[i] = init_A(i) / n;
+    for (int i = 0; i < n; ++i)
+        vec_x[i] = init_x(i);
+
+    return 0;
+}
+
+void test_replay(void) {
+    for (int s = 0; s < NUM_STEPS; ++s) {
+        /* y = A x */
+        cblas_dgemv(CblasColMajor, CblasNoTrans, n, n,
+                1.0, mat_A, n, vec_x, 1, 0.0, vec_y, 1);
+        /* x = x + h y */
+        cblas_daxpy(n, STEP, vec_y, 1, vec_x, 1);
+    }
+}
+
+int epilogue(int num) {
+    double *x = malloc(n * sizeof *x), *y = malloc(n * sizeof *y);
+    int ret = 0;
+
+    if (!x || !y) {
+        ret = -1;
+        goto out;
+    }
+
+    for (int i = 0; i < n; ++i)
+        x[i] = init_x(i);
+    for (int s = 0; s < NUM_STEPS; ++s) {
+        for (int i = 0; i < n; ++i) {
+            y[i] = 0;
+            for (int j = 0; j < n; ++j)
+                y[i] += init_A(fidx(i, j, n, n)) / n * x[j];
+        }
+        for (int i = 0; i < n; ++i)
+            x[i] += STEP * y[i];
+    }
+
+    for (int i = 0; i < n; ++i)
+        if (fabs(vec_x[i] - x[i]) > 1e-12 * n * (1 + fabs(x[i]))) {
+            fprintf(stderr, "x[%d] is %f, expected %f\n", i, vec_x[i], x[i]);
+            ret = -1;
+            break;
+        }
+
+out:
+    free(x); free(y);
+    free(mat_A); free(vec_x); free(vec_y);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMV+DAXPY x%d (steps)", NUM_STEPS);
+    run_test(N_TESTS, &prologue, &test_replay, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Row-major Level 3 calls through the CBLAS interface. These are mapped
+ * onto column-major calls by swapping operands, so the results are checked
+ * against a naive row-major reference.
+ */
+
+bool print_res = true;
+
+int n;
+double *mat_A, *mat_B, *mat_C, *mat_ref;
+
+static void ref_gemm(int m, int n, int k, const double *a, const double *b, double *c) {
+    for (int i = 0; i < m; ++i)
+        for (int j = 0; j < n; ++j) {
+            double sum = 0;
+            for (int l = 0; l < k; ++l)
+                sum += a[idx(i, l, m, k)] * b[idx(l, j, k, n)];
+            c[idx(i, j, m, n)] = sum;
+        }
+}
+
+static double max_error(const double *x, const double *y, int len) {
+    double err = 0;
+
+    for (int i = 0; i < len; ++i)
+        err = max(err, fabs(x[i] - y[i]) / max(1.0, fabs(y[i])));
+    return err;
+}
+
+static int check(const char *name, double err) {
+    if (err > 1e-9) {
+        fprintf(stderr, "%s: max relative error %g\n", name, err);
+        return -1;
+    }
+    return 0;
+}
+
+int prologue(int num) {
+    if (!(mat_A = calloc(n * n, sizeof *mat_A))
+            || !(mat_B = calloc(n * n, sizeof *mat_B))
+            || !(mat_C = calloc(n * n, sizeof *mat_C))
+            || !(mat_ref = calloc(n * n, sizeof *mat_ref))) {
+        free(mat_A);
+        free(mat_B);
+        free(mat_C);
+        return -1;
+    }
+
+    /* A is diagonally dominant, so that it can be used for trsm */
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            mat_A[idx(i, j, n, n)] = i == j ? n : ((i + 2 * j) % 7) / 7.0;
+            mat_B[idx(i, j, n, n)] = ((3 * i + j) % 5) / 5.0;
+        }
+
+    return 0;
+}
+
+void test_gemm(void) {
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+            1.0, mat_A, n, mat_B, n, 0.0, mat_C, n);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    if (num == 0) {
+        ref_gemm(n, n, n, mat_A, mat_B, mat_ref);
+        ret = check("dgemm", max_error(mat_C, mat_ref, n * n));
+    }
+
+    free(mat_A);
+    free(mat_B);
+    free(mat_C);
+    free(mat_ref);
+    return ret;
+}
+
+/*
+ * The other routines are only checked once.
+ */
+static int check_others(void) {
+    double *at;
+    int ret = 0;
+
+    if (prologue(0) < 0)
+        return -1;
+    if (!(at = calloc(n * n, sizeof *at))) {
+        epilogue(1);
+        return -1;
+    }
+
+    /* C = A B, with a symmetric A stored in the lower triangle */
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            at[idx(i, j, n, n)] = i >= j ? mat_A[idx(i, j, n, n)] : mat_A[idx(j, i, n, n)];
+    cblas_dsymm(CblasRowMajor, CblasLeft, CblasLower, n, n,
+            1.0, mat_A, n, mat_B, n, 0.0, mat_C, n);
+    ref_gemm(n, n, n, at, mat_B, mat_ref);
+    ret |= check("dsymm", max_error(mat_C, mat_ref, n * n));
+
+    /* upper triangle of C = B B^T */
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            at[idx(i, j, n, n)] = mat_B[idx(j, i, n, n)];
+    cblas_dsyrk(CblasRowMajor, CblasUpper, CblasNoTrans, n, n,
+            1.0, mat_B, n, 0.0, mat_C, n);
+    ref_gemm(n, n, n, mat_B, at, mat_ref);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < i; ++j)
+            mat_C[idx(i, j, n, n)] = mat_ref[idx(i, j, n, n)];
+    ret |= check("dsyrk", max_error(mat_C, mat_ref, n * n));
+
+    /* solve L X = B, then check that L X = B */
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            at[idx(i, j, n, n)] = i >= j ? mat_A[idx(i, j, n, n)] : 0;
+    for (int i = 0; i < n * n; ++i)
+        mat_C[i] = mat_B[i];
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans, CblasNonUnit, n, n,
+            1.0, mat_A, n, mat_C, n);
+    ref_gemm(n, n, n, at, mat_C, mat_ref);
+    ret |= check("dtrsm", max_error(mat_ref, mat_B, n * n));
+
+    free(at);
+    epilogue(1);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+
+    if (check_others() < 0)
+        return 1;
+
+    run_test(N_TESTS, &prologue, &test_gemm, &epilogue, &pinfo);
+    print_perfinfo("DGEMM (row-major)", n, &pinfo);
+
+    return 0;
+}
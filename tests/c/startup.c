@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "test.h"
+
+/*
+ * Process startup time: run a program that never calls BLAS ("true") N
+ * times. The child inherits LD_PRELOAD, so comparing runs with and
+ * without libgpublas preloaded gives the startup cost of the library;
+ * with BLAS2CUDA_OPTIONS=warmup, that of starting the runtime in the
+ * background.
+ */
+
+extern char **environ;
+
+bool print_res = true;
+
+int n;
+
+int prologue(int num) {
+    return 0;
+}
+
+void test_startup(void) {
+    char *argv[] = { "true", NULL };
+
+    for (int i = 0; i < n; ++i) {
+        pid_t pid;
+        int status;
+
+        if (posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) != 0) {
+            perror("posix_spawnp");
+            abort();
+        }
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "child %d failed\n", i);
+            abort();
+        }
+    }
+}
+
+int epilogue(int num) {
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+
+    parse_args(argc, argv, &n, &print_res);
+    run_test(N_TESTS, &prologue, &test_startup, &epilogue, &pinfo);
+    print_perfinfo("STARTUP", n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/*
+ * Interleaved chains of gemm calls. Each chain ping-pongs between two
+ * matrices (X1 = X0 B, X0 = X1 B, ...), so every call depends on the one
+ * before it in the same chain, but not on the calls of the other chains.
+ * With libgpublas preloaded, the chains should be issued on separate
+ * streams (or run out of order on an out-of-order OpenCL queue), and the
+ * achieved concurrency is reported on exit.
+ *
+ * B = 2I, so each step doubles the chain's matrix exactly.
+ */
+
+#define NUM_CHAINS  4
+#define NUM_STEPS   4       /* even, so that results end up in X0 */
+
+bool print_res = true;
+
+int n;
+double *mat_B, *mat_X[NUM_CHAINS][2];
+
+int prologue(int num) {
+    if (!(mat_B = calloc(n * n, sizeof *mat_B)))
+        return -1;
+    for (int c = 0; c < NUM_CHAINS; ++c)
+        for (int i = 0; i < 2; ++i)
+            if (!(mat_X[c][i] = calloc(n * n, sizeof *mat_X[c][i]))) {
+                while (i-- > 0)
+                    free(mat_X[c][i]);
+                while (c-- > 0) {
+                    free(mat_X[c][0]);
+                    free(mat_X[c][1]);
+                }
+                free(mat_B);
+                return -1;
+            }
+
+    for (int i = 0; i < n; ++i)
+        mat_B[i * n + i] = 2.0;
+    for (int c = 0; c < NUM_CHAINS; ++c)
+        for (int i = 0; i < n * n; ++i)
+            mat_X[c][0][i] = (i + c) % 7;
+
+    return 0;
+}
+
+void test_streams(void) {
+    for (int s = 0; s < NUM_STEPS; ++s)
+        for (int c = 0; c < NUM_CHAINS; ++c)
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                    1.0, mat_X[c][s % 2], n, mat_B, n, 0.0, mat_X[c][(s + 1) % 2], n);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    for (int c = 0; c < NUM_CHAINS && ret == 0; ++c)
+        for (int i = 0; i < n * n; ++i)
+            if (mat_X[c][0][i] != (1 << NUM_STEPS) * ((i + c) % 7)) {
+                fprintf(stderr, "chain %d: element %d is wrong\n", c, i);
+                ret = -1;
+                break;
+            }
+
+    for (int c = 0; c < NUM_CHAINS; ++c) {
+        free(mat_X[c][0]);
+        free(mat_X[c][1]);
+    }
+    free(mat_B);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMM %dx%d chains", NUM_CHAINS, NUM_STEPS);
+    run_test(N_TESTS, &prologue, &test_streams, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "test.h"
+
+/*
+ * Several threads issuing gemm calls at the same time, each on matrices of
+ * its own, like the threads of an OpenMP program. Each thread ping-pongs
+ * between two matrices (X1 = X0 B, X0 = X1 B, ...), so its calls depend on
+ * each other but not on those of the other threads. With libgpublas
+ * preloaded, the threads should enqueue their calls concurrently.
+ *
+ * B = 2I, so each step doubles the thread's matrix exactly.
+ */
+
+#define NUM_THREADS 8
+#define NUM_STEPS   8       /* even, so that results end up in X0 */
+
+bool print_res = true;
+
+int n;
+double *mat_B, *mat_X[NUM_THREADS][2];
+
+int prologue(int num) {
+    if (!(mat_B = calloc(n * n, sizeof *mat_B)))
+        return -1;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        for (int i = 0; i < 2; ++i)
+            if (!(mat_X[t][i] = calloc(n * n, sizeof *mat_X[t][i]))) {
+                while (i-- > 0)
+                    free(mat_X[t][i]);
+                while (t-- > 0) {
+                    free(mat_X[t][0]);
+                    free(mat_X[t][1]);
+                }
+                free(mat_B);
+                return -1;
+            }
+
+    for (int i = 0; i < n; ++i)
+        mat_B[i * n + i] = 2.0;
+    for (int t = 0; t < NUM_THREADS; ++t)
+        for (int i = 0; i < n * n; ++i)
+            mat_X[t][0][i] = (i + t) % 7;
+
+    return 0;
+}
+
+static void *thread_steps(void *arg) {
+    int t = (int) (long) arg;
+
+    for (int s = 0; s < NUM_STEPS; ++s)
+        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n,
+                1.0, mat_X[t][s % 2], n, mat_B, n, 0.0, mat_X[t][(s + 1) % 2], n);
+    return NULL;
+}
+
+void test_threads(void) {
+    pthread_t threads[NUM_THREADS];
+
+    for (int t = 0; t < NUM_THREADS; ++t)
+        if (pthread_create(&threads[t], NULL, thread_steps, (void *) (long) t) != 0) {
+            fprintf(stderr, "failed to create thread %d\n", t);
+            abort();
+        }
+    for (int t = 0; t < NUM_THREADS; ++t)
+        pthread_join(threads[t], NULL);
+}
+
+int epilogue(int num) {
+    int ret = 0;
+
+    for (int t = 0; t < NUM_THREADS && ret == 0; ++t)
+        for (int i = 0; i < n * n; ++i)
+            if (mat_X[t][0][i] != (1 << NUM_STEPS) * ((i + t) % 7)) {
+                fprintf(stderr, "thread %d: element %d is wrong\n", t, i);
+                ret = -1;
+                break;
+            }
+
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        free(mat_X[t][0]);
+        free(mat_X[t][1]);
+    }
+    free(mat_B);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    struct perf_info pinfo;
+    char name[32];
+
+    parse_args(argc, argv, &n, &print_res);
+    snprintf(name, sizeof name, "DGEMM %d threads x%d", NUM_THREADS, NUM_STEPS);
+    run_test(N_TESTS, &prologue, &test_threads, &epilogue, &pinfo);
+    print_perfinfo(name, n, &pinfo);
+
+    return 0;
+}